@@ -0,0 +1,113 @@
+// host_test/audio_analysis_bench.c
+// 用真实录音 (组件测试用的 mp3 解码后的 PCM) 测量 audio_analysis_feed() 的开销
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "esp_timer.h"
+#include "mp3dec.h"
+#include "audio_analysis.h"
+
+#define BLOCK_FRAMES    1152    // 与 mp3 每帧输出的采样数相同，即 write_fn 每次收到的数据量
+#define REPEAT          50
+#define MAX_CORE_PCT    1.0     // 请求的上限: 不超过一个核的 1%
+
+static uint8_t *read_file(const char *path, size_t *len)
+{
+    FILE *fp = fopen(path, "rb");
+    if (fp == NULL) {
+        return NULL;
+    }
+    fseek(fp, 0, SEEK_END);
+    *len = (size_t)ftell(fp);
+    fseek(fp, 0, SEEK_SET);
+    uint8_t *buf = malloc(*len);
+    if (buf && fread(buf, 1, *len, fp) != *len) {
+        free(buf);
+        buf = NULL;
+    }
+    fclose(fp);
+    return buf;
+}
+
+// 解码整个文件，单声道按播放器的做法复制成立体声
+static int16_t *decode_stereo(const uint8_t *mp3, size_t len, size_t *frames, int *rate)
+{
+    HMP3Decoder dec = MP3InitDecoder();
+    int16_t pcm[MAX_NCHAN * MAX_NGRAN * MAX_NSAMP];
+    size_t cap = 1 << 20;
+    int16_t *out = malloc(cap * 2 * sizeof(int16_t));
+    unsigned char *p = (unsigned char *)mp3;
+    int left = (int)len;
+
+    *frames = 0;
+    while (left > 0) {
+        int off = MP3FindSyncWord(p, left);
+        if (off < 0) {
+            break;
+        }
+        p += off;
+        left -= off;
+        if (MP3Decode(dec, &p, &left, pcm, 0) != ERR_MP3_NONE) {
+            continue;
+        }
+        MP3FrameInfo info;
+        MP3GetLastFrameInfo(dec, &info);
+        int n = info.outputSamps / info.nChans;
+        if (*frames + n > cap) {
+            cap *= 2;
+            out = realloc(out, cap * 2 * sizeof(int16_t));
+        }
+        for (int i = 0; i < n; i++) {
+            out[(*frames + i) * 2] = pcm[i * info.nChans];
+            out[(*frames + i) * 2 + 1] = pcm[i * info.nChans + info.nChans - 1];
+        }
+        *frames += n;
+        *rate = info.samprate;
+    }
+    MP3FreeDecoder(dec);
+    return out;
+}
+
+int main(int argc, char **argv)
+{
+    if (argc < 2) {
+        fprintf(stderr, "usage: %s <file.mp3>\n", argv[0]);
+        return 2;
+    }
+    size_t len;
+    uint8_t *mp3 = read_file(argv[1], &len);
+    if (mp3 == NULL) {
+        fprintf(stderr, "cannot read %s\n", argv[1]);
+        return 2;
+    }
+    size_t frames;
+    int rate = 0;
+    int16_t *pcm = decode_stereo(mp3, len, &frames, &rate);
+    if (frames == 0) {
+        fprintf(stderr, "no audio decoded\n");
+        return 1;
+    }
+
+    audio_analysis_set_format((uint32_t)rate, 16, 2);
+    int64_t t0 = esp_timer_get_time();
+    for (int r = 0; r < REPEAT; r++) {
+        for (size_t f = 0; f < frames; f += BLOCK_FRAMES) {
+            size_t n = frames - f < BLOCK_FRAMES ? frames - f : BLOCK_FRAMES;
+            audio_analysis_feed(pcm + f * 2, n * 2 * sizeof(int16_t));
+        }
+    }
+    int64_t us = esp_timer_get_time() - t0;
+
+    audio_features_t feat;
+    audio_analysis_get(&feat);
+    double audio_s = (double)frames * REPEAT / rate;
+    double pct = us / 1e4 / audio_s;
+    printf("%zu frames (%.1f s) x %d, %u blocks, %u beats per pass\n", frames, (double)frames / rate, REPEAT,
+           (unsigned)feat.seq, (unsigned)(feat.beat_count / REPEAT));
+    printf("%.2f ns/frame, %.4f %% of one host core in real time\n", us * 1e3 / ((double)frames * REPEAT), pct);
+
+    free(pcm);
+    free(mp3);
+    return pct < MAX_CORE_PCT ? 0 : 1;
+}
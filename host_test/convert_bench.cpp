@@ -0,0 +1,252 @@
+// host_test/convert_bench.cpp
+// user-030: audio_convert.h 中每个转换内核与原来 audio_player.cpp 里的 mono_to_stereo() 标量循环对比
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <vector>
+
+#include "esp_timer.h"
+#include "audio_convert.h"
+
+using namespace audio_convert;
+
+#define BLOCK_FRAMES    1152    // mp3 每帧的采样数，也是 decode 每次交给转换的量
+#define REPEAT          4000
+#define ROUNDS          7
+#define MAX_IN_CH       6
+
+// 原来的实现，只保留转换部分 (容量检查在调用前就能确定不会失败)
+static void old_mono_to_stereo(decode_data &adata)
+{
+    size_t new_sample_count = adata.frame_count * 2;
+    int16_t *out = reinterpret_cast<int16_t*>(adata.samples) + (new_sample_count - 1);
+    int16_t *in = reinterpret_cast<int16_t*>(adata.samples) + (adata.frame_count - 1);
+    size_t samples = adata.frame_count;
+    while(samples) {
+        *out = *in;
+        out--;
+        *out = *in;
+        out--;
+        in--;
+        samples--;
+    }
+    adata.fmt.channels = 2;
+}
+
+typedef void (*kernel_fn)(decode_data *pData, audio_convert_state *pState);
+
+static void old_kernel(decode_data *pData, audio_convert_state *)
+{
+    old_mono_to_stereo(*pData);
+}
+
+struct kernel_case {
+    const char *name;
+    format fmt;
+    kernel_fn fn;
+    bool wide;                  // 输出 int32_t
+    bool downmix;
+};
+
+static const kernel_case cases[] = {
+    { "old mono_to_stereo  ", { 44100, 16, 1, SAMPLE_FORMAT_INT },   old_kernel,                              false, false },
+    { "s16 mono            ", { 44100, 16, 1, SAMPLE_FORMAT_INT },   convert<pcm_s16, int16_t, 1, false>,     false, false },
+    { "s16 stereo downmix  ", { 44100, 16, 2, SAMPLE_FORMAT_INT },   convert<pcm_s16, int16_t, 2, true>,      false, true },
+    { "s16 6ch -> stereo   ", { 48000, 16, 6, SAMPLE_FORMAT_INT },   convert<pcm_s16, int16_t, 0, false>,     false, false },
+    { "u8 mono             ", { 22050, 8, 1, SAMPLE_FORMAT_INT },    convert<pcm_u8, int16_t, 1, false>,      false, false },
+    { "u8 stereo           ", { 22050, 8, 2, SAMPLE_FORMAT_INT },    convert<pcm_u8, int16_t, 2, false>,      false, false },
+    { "s24 mono -> s32     ", { 48000, 24, 1, SAMPLE_FORMAT_INT },   convert<pcm_s24, int32_t, 1, false>,     true,  false },
+    { "s24 stereo -> s32   ", { 48000, 24, 2, SAMPLE_FORMAT_INT },   convert<pcm_s24, int32_t, 2, false>,     true,  false },
+    { "s32 mono            ", { 48000, 32, 1, SAMPLE_FORMAT_INT },   convert<pcm_s32, int32_t, 1, false>,     true,  false },
+    { "f32 mono dither     ", { 44100, 32, 1, SAMPLE_FORMAT_FLOAT }, convert<pcm_f32, int16_t, 1, false>,     false, false },
+    { "f32 stereo dither   ", { 44100, 32, 2, SAMPLE_FORMAT_FLOAT }, convert<pcm_f32, int16_t, 2, false>,     false, false },
+};
+
+static size_t in_bytes(const format &fmt)
+{
+    return (size_t)fmt.bits_per_sample / BITS_PER_BYTE * fmt.channels;
+}
+
+// 第 n 帧第 ch 声道的测试信号，满幅的一半左右，各声道不同
+static double signal(size_t n, uint32_t ch)
+{
+    return 0.45 * sin((double)n * (0.031 + 0.007 * ch)) + 0.05 * sin((double)n * 0.29);
+}
+
+static void fill_input(const format &fmt, uint8_t *buf, size_t frames)
+{
+    for(size_t n = 0; n < frames; n++) {
+        for(uint32_t ch = 0; ch < fmt.channels; ch++) {
+            double s = signal(n, ch);
+            uint8_t *p = buf + (n * fmt.channels + ch) * (fmt.bits_per_sample / BITS_PER_BYTE);
+            if(fmt.sample_format == SAMPLE_FORMAT_FLOAT) {
+                float f = (float)s;
+                memcpy(p, &f, sizeof(f));
+                continue;
+            }
+            int32_t v = (int32_t)lrint(s * 2147483647.0);
+            switch(fmt.bits_per_sample) {
+                case 8:
+                    p[0] = (uint8_t)((v >> 24) ^ 0x80);
+                    break;
+                case 16: {
+                    int16_t s16 = (int16_t)(v >> 16);
+                    memcpy(p, &s16, sizeof(s16));
+                    break;
+                }
+                case 24:
+                    p[0] = (uint8_t)(v >> 8);
+                    p[1] = (uint8_t)(v >> 16);
+                    p[2] = (uint8_t)(v >> 24);
+                    break;
+                default:
+                    memcpy(p, &v, sizeof(v));
+                    break;
+            }
+        }
+    }
+}
+
+// 用逐帧的直接写法算出期望输出，和内核结果比较；浮点经过抖动，允许 1 LSB 的误差
+static bool verify(const kernel_case &c, const uint8_t *input, const uint8_t *output, size_t frames)
+{
+    size_t sample_bytes = c.fmt.bits_per_sample / BITS_PER_BYTE;
+    for(size_t n = 0; n < frames; n++) {
+        int64_t in[2];
+        for(uint32_t ch = 0; ch < 2; ch++) {
+            const uint8_t *p = input + (n * c.fmt.channels + (c.fmt.channels == 1 ? 0 : ch)) * sample_bytes;
+            int32_t v;
+            if(c.fmt.sample_format == SAMPLE_FORMAT_FLOAT) {
+                float f;
+                memcpy(&f, p, sizeof(f));
+                v = (int32_t)lrintf(f * 32768.0f) * 65536;
+            } else if(c.fmt.bits_per_sample == 8) {
+                v = (int32_t)((uint32_t)(p[0] ^ 0x80) << 24);
+            } else if(c.fmt.bits_per_sample == 16) {
+                int16_t s16;
+                memcpy(&s16, p, sizeof(s16));
+                v = (int32_t)((uint32_t)(uint16_t)s16 << 16);
+            } else if(c.fmt.bits_per_sample == 24) {
+                v = (int32_t)(((uint32_t)p[0] << 8) | ((uint32_t)p[1] << 16) | ((uint32_t)p[2] << 24));
+            } else {
+                memcpy(&v, p, sizeof(v));
+            }
+            in[ch] = v;
+        }
+        if(c.downmix) {
+            in[0] = in[1] = (in[0] >> 1) + (in[1] >> 1);
+        }
+        for(uint32_t ch = 0; ch < 2; ch++) {
+            int64_t got;
+            int64_t want;
+            if(c.wide) {
+                int32_t o;
+                memcpy(&o, output + (n * 2 + ch) * sizeof(o), sizeof(o));
+                got = o;
+                want = in[ch];
+            } else {
+                int16_t o;
+                memcpy(&o, output + (n * 2 + ch) * sizeof(o), sizeof(o));
+                got = o;
+                want = in[ch] >> 16;
+            }
+            int64_t tolerance = c.fmt.sample_format == SAMPLE_FORMAT_FLOAT ? 1 : 0;
+            if(llabs(got - want) > tolerance) {
+                fprintf(stderr, "%s: frame %zu ch %u: got %lld want %lld\n",
+                    c.name, n, ch, (long long)got, (long long)want);
+                return false;
+            }
+        }
+    }
+    return true;
+}
+
+int main()
+{
+    // 与 audio_player_new() 一样，samples_capacity_max 是解码输出的两倍
+    std::vector<uint8_t> input(BLOCK_FRAMES * MAX_IN_CH * sizeof(int32_t));
+    std::vector<uint8_t> work(BLOCK_FRAMES * MAX_IN_CH * sizeof(int32_t) * 2);
+    decode_data d;
+    memset(&d, 0, sizeof(d));
+    d.samples = work.data();
+    d.samples_capacity = input.size();
+    d.samples_capacity_max = work.size();
+    audio_convert_state st = { 1, 0 };
+    int failures = 0;
+
+    double old_ns = 0;
+    printf("%d frames per block, best of %d x %d blocks, ns per frame (input copy subtracted)\n", BLOCK_FRAMES, ROUNDS, REPEAT);
+    for(const kernel_case &c : cases) {
+        size_t bytes = BLOCK_FRAMES * in_bytes(c.fmt);
+        fill_input(c.fmt, input.data(), BLOCK_FRAMES);
+
+        memcpy(work.data(), input.data(), bytes);
+        d.fmt = c.fmt;
+        d.frame_count = BLOCK_FRAMES;
+        st.channels = c.fmt.channels;
+        c.fn(&d, &st);
+        if(d.fmt.channels != 2 || !verify(c, input.data(), work.data(), BLOCK_FRAMES)) {
+            failures++;
+            continue;
+        }
+
+        // 每次都要先把原始输入拷回工作区，拷贝的耗时单独量出来再减掉；各取几轮中最快的一轮
+        double copy_us = 1e30;
+        double run_us = 1e30;
+        for(int round = 0; round < ROUNDS; round++) {
+            int64_t t0 = esp_timer_get_time();
+            for(int r = 0; r < REPEAT; r++) {
+                memcpy(work.data(), input.data(), bytes);
+                asm volatile("" : : "r"(work.data()) : "memory");
+            }
+            int64_t t1 = esp_timer_get_time();
+            for(int r = 0; r < REPEAT; r++) {
+                memcpy(work.data(), input.data(), bytes);
+                d.fmt = c.fmt;
+                d.frame_count = BLOCK_FRAMES;
+                c.fn(&d, &st);
+                asm volatile("" : : "r"(work.data()) : "memory");
+            }
+            int64_t t2 = esp_timer_get_time();
+            copy_us = fmin(copy_us, (double)(t1 - t0));
+            run_us = fmin(run_us, (double)(t2 - t1));
+        }
+        double ns = (run_us - copy_us) * 1000.0 / REPEAT;
+        ns /= BLOCK_FRAMES;
+        if(c.fn == old_kernel) {
+            old_ns = ns;
+        }
+        printf("  %s %6.2f ns/frame  %5.2fx old\n", c.name, ns, old_ns > 0 ? ns / old_ns : 1.0);
+    }
+
+    // audio_convert_select() 的结果与原来的循环逐字节一致；16 位立体声不经过转换
+    format stereo16 = { 44100, 16, 2, SAMPLE_FORMAT_INT };
+    format mono16 = { 44100, 16, 1, SAMPLE_FORMAT_INT };
+    std::vector<uint8_t> old_out(work.size());
+    fill_input(mono16, input.data(), BLOCK_FRAMES);
+    memcpy(old_out.data(), input.data(), BLOCK_FRAMES * in_bytes(mono16));
+    d.samples = old_out.data();
+    d.fmt = mono16;
+    d.frame_count = BLOCK_FRAMES;
+    old_mono_to_stereo(d);
+    memcpy(work.data(), input.data(), BLOCK_FRAMES * in_bytes(mono16));
+    d.samples = work.data();
+    d.fmt = mono16;
+    audio_convert_fn selected = audio_convert_select(mono16);
+    if(selected) {
+        st.channels = 1;
+        selected(&d, &st);
+    }
+    if(audio_convert_select(stereo16) != NULL || selected == NULL ||
+            memcmp(old_out.data(), work.data(), BLOCK_FRAMES * 2 * sizeof(int16_t)) != 0) {
+        fprintf(stderr, "audio_convert_select() output differs from mono_to_stereo()\n");
+        failures++;
+    }
+
+    if(failures) {
+        fprintf(stderr, "FAIL: %d kernels\n", failures);
+        return 1;
+    }
+    return 0;
+}
@@ -0,0 +1,357 @@
+// host_test/decode_bench.cpp
+// user-028: 同一段音频用 FLAC 和 MP3 解码的开销对比，以及 seek_mp3() 在解码第一帧之前的定位精度
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <vector>
+
+#include "esp_timer.h"
+#include "audio_mp3.h"
+#include "audio_flac.h"
+
+#define FLAC_BLOCK      4096
+#define REPEAT          5
+#define SEEK_TARGET_MS  8000
+#define SEEK_TOLERANCE_MS 100     // 估算误差加上比特池不足时跳过的一两帧 (每帧 26 ms)
+
+static std::vector<uint8_t> read_file(const char *path)
+{
+    std::vector<uint8_t> buf;
+    FILE *fp = fopen(path, "rb");
+    if (fp == NULL) {
+        return buf;
+    }
+    fseek(fp, 0, SEEK_END);
+    buf.resize((size_t)ftell(fp));
+    fseek(fp, 0, SEEK_SET);
+    if (fread(buf.data(), 1, buf.size(), fp) != buf.size()) {
+        buf.clear();
+    }
+    fclose(fp);
+    return buf;
+}
+
+/* =========================== 最小 FLAC 编码器 =========================== */
+// 固定预测 0-4 阶取残差最小者，单分区 Rice 编码，足够生成有代表性的测试流
+
+class bit_writer {
+public:
+    std::vector<uint8_t> out;
+
+    void put(uint64_t v, int n)
+    {
+        while (n--) {
+            acc = (acc << 1) | ((v >> n) & 1);
+            if (++bits == 8) {
+                out.push_back((uint8_t)acc);
+                acc = 0;
+                bits = 0;
+            }
+        }
+    }
+    void put_signed(int64_t v, int n) { put((uint64_t)v & ((1ull << n) - 1), n); }
+    void align() { while (bits) put(0, 1); }
+
+private:
+    uint32_t acc = 0;
+    int bits = 0;
+};
+
+static uint8_t crc8(const uint8_t *p, size_t n)
+{
+    uint8_t c = 0;
+    while (n--) {
+        c ^= *p++;
+        for (int k = 0; k < 8; k++) {
+            c = (c & 0x80) ? (uint8_t)((c << 1) ^ 0x07) : (uint8_t)(c << 1);
+        }
+    }
+    return c;
+}
+
+static uint16_t crc16(const uint8_t *p, size_t n)
+{
+    uint16_t c = 0;
+    while (n--) {
+        c ^= (uint16_t)(*p++ << 8);
+        for (int k = 0; k < 8; k++) {
+            c = (c & 0x8000) ? (uint16_t)((c << 1) ^ 0x8005) : (uint16_t)(c << 1);
+        }
+    }
+    return c;
+}
+
+static int32_t fixed_residual(const int16_t *x, int i, int order)
+{
+    switch (order) {
+    case 0: return x[i];
+    case 1: return x[i] - x[i - 1];
+    case 2: return x[i] - 2 * x[i - 1] + x[i - 2];
+    case 3: return x[i] - 3 * x[i - 1] + 3 * x[i - 2] - x[i - 3];
+    default: return x[i] - 4 * x[i - 1] + 6 * x[i - 2] - 4 * x[i - 3] + x[i - 4];
+    }
+}
+
+static void encode_subframe(bit_writer &bw, const int16_t *x, int n)
+{
+    int best = 0;
+    uint64_t best_sum = UINT64_MAX;
+    for (int order = 0; order <= 4 && order < n; order++) {
+        uint64_t sum = 0;
+        for (int i = order; i < n; i++) {
+            int32_t r = fixed_residual(x, i, order);
+            sum += (uint64_t)(r < 0 ? -r : r);
+        }
+        if (sum < best_sum) {
+            best_sum = sum;
+            best = order;
+        }
+    }
+    int count = n - best;
+    uint64_t mean = count ? best_sum / count : 0;
+    int k = 0;
+    while (k < 14 && (2ull << k) <= mean) {
+        k++;
+    }
+
+    bw.put(0, 1);
+    bw.put(8 + best, 6);    // SUBFRAME_FIXED
+    bw.put(0, 1);
+    for (int i = 0; i < best; i++) {
+        bw.put_signed(x[i], 16);
+    }
+    bw.put(0, 2);           // Rice, 4 bit parameter
+    bw.put(0, 4);           // partition order 0
+    bw.put(k, 4);
+    for (int i = best; i < n; i++) {
+        int32_t r = fixed_residual(x, i, best);
+        uint32_t u = r >= 0 ? (uint32_t)r << 1 : ((uint32_t)-r << 1) - 1;
+        for (uint32_t q = u >> k; q; q--) {
+            bw.put(0, 1);
+        }
+        bw.put(1, 1);
+        bw.put(u & ((1u << k) - 1), k);
+    }
+}
+
+// 单声道 16 位，没有 SEEKTABLE
+static std::vector<uint8_t> flac_encode(const std::vector<int16_t> &pcm, int sample_rate)
+{
+    bit_writer bw;
+    bw.put(0x664C6143, 32);     // "fLaC"
+    bw.put(1, 1);               // last metadata block
+    bw.put(0, 7);               // STREAMINFO
+    bw.put(34, 24);
+    bw.put(FLAC_BLOCK, 16);
+    bw.put(FLAC_BLOCK, 16);
+    bw.put(0, 24);
+    bw.put(0, 24);
+    bw.put(sample_rate, 20);
+    bw.put(0, 3);               // channels - 1
+    bw.put(15, 5);              // bits per sample - 1
+    bw.put(pcm.size(), 36);
+    bw.put(0, 64);              // MD5
+    bw.put(0, 64);
+
+    uint32_t frame = 0;
+    for (size_t pos = 0; pos < pcm.size(); pos += FLAC_BLOCK, frame++) {
+        int n = (int)(pcm.size() - pos < FLAC_BLOCK ? pcm.size() - pos : FLAC_BLOCK);
+        size_t start = bw.out.size();
+        bw.put(0xFFF8, 16);
+        bw.put(n == FLAC_BLOCK ? 12 : 7, 4);    // 4096, else 16 bit size at the end of the header
+        bw.put(0, 4);                           // sample rate from STREAMINFO
+        bw.put(0, 4);                           // mono
+        bw.put(4, 3);                           // 16 bit
+        bw.put(0, 1);
+        // frame number, UTF-8 style
+        if (frame < 0x80) {
+            bw.put(frame, 8);
+        } else if (frame < 0x800) {
+            bw.put(0xC0 | (frame >> 6), 8);
+            bw.put(0x80 | (frame & 0x3F), 8);
+        } else {
+            bw.put(0xE0 | (frame >> 12), 8);
+            bw.put(0x80 | ((frame >> 6) & 0x3F), 8);
+            bw.put(0x80 | (frame & 0x3F), 8);
+        }
+        if (n != FLAC_BLOCK) {
+            bw.put(n - 1, 16);
+        }
+        bw.put(crc8(bw.out.data() + start, bw.out.size() - start), 8);
+        encode_subframe(bw, pcm.data() + pos, n);
+        bw.align();
+        bw.put(crc16(bw.out.data() + start, bw.out.size() - start), 16);
+    }
+    return bw.out;
+}
+
+/* =========================== 解码 =========================== */
+
+static double now_us() { return (double)esp_timer_get_time(); }
+
+struct decode_buffers {
+    std::vector<uint8_t> samples;
+    decode_data out;
+
+    decode_buffers() : samples(MAX_NCHAN * MAX_NGRAN * MAX_NSAMP * 2)
+    {
+        memset(&out, 0, sizeof(out));
+        out.samples = samples.data();
+        out.samples_capacity = MAX_NCHAN * MAX_NGRAN * MAX_NSAMP;   // 与 audio_player_new() 相同
+        out.samples_capacity_max = out.samples_capacity * 2;
+    }
+};
+
+struct mp3_frame_end {
+    long offset;            // 这一帧之后的源位置
+    size_t first_sample;    // 这一帧输出的第一个采样
+};
+
+// ends 不为空时记录每帧在内存源中的结束位置，用来核对跳转落在哪一帧
+static std::vector<int16_t> decode_mp3_all(const std::vector<uint8_t> &file, int *rate, std::vector<mp3_frame_end> *ends)
+{
+    std::vector<int16_t> pcm;
+    audio_source_t src;
+    audio_source_from_memory(&src, file.data(), file.size());
+    mp3_instance inst = {};
+    std::vector<uint8_t> buf(MAINBUF_SIZE * 3);
+    inst.data_buf = buf.data();
+    inst.data_buf_size = buf.size();
+    HMP3Decoder dec = MP3InitDecoder();
+    decode_buffers b;
+
+    if (is_mp3(&src, &inst)) {
+        inst.read_ptr = inst.data_buf;
+        for (;;) {
+            DECODE_STATUS s = decode_mp3(dec, &src, &b.out, &inst);
+            if (s == DECODE_STATUS_DONE || s == DECODE_STATUS_ERROR) {
+                break;
+            }
+            if (s == DECODE_STATUS_CONTINUE && b.out.frame_count) {
+                if (ends) {
+                    ends->push_back({ audio_source_tell(&src), pcm.size() });
+                }
+                const int16_t *p = (const int16_t *)b.out.samples;
+                pcm.insert(pcm.end(), p, p + b.out.frame_count * b.out.fmt.channels);
+                *rate = b.out.fmt.sample_rate;
+            }
+        }
+    }
+    MP3FreeDecoder(dec);
+    audio_source_close(&src);
+    return pcm;
+}
+
+static std::vector<int16_t> decode_flac_all(const std::vector<uint8_t> &file)
+{
+    std::vector<int16_t> pcm;
+    audio_source_t src;
+    audio_source_from_memory(&src, file.data(), file.size());
+    static flac_instance inst;
+    memset(&inst, 0, sizeof(inst));
+    decode_buffers b;
+
+    if (is_flac(&src, &inst)) {
+        for (;;) {
+            DECODE_STATUS s = decode_flac(&src, &b.out, &inst);
+            if (s == DECODE_STATUS_DONE || s == DECODE_STATUS_ERROR) {
+                break;
+            }
+            if (s == DECODE_STATUS_CONTINUE) {
+                const int16_t *p = (const int16_t *)b.out.samples;
+                pcm.insert(pcm.end(), p, p + b.out.frame_count * b.out.fmt.channels);
+            }
+        }
+    }
+    flac_instance_free(&inst);
+    audio_source_close(&src);
+    return pcm;
+}
+
+// 新建解码器后立即跳转 (还没有任何帧信息)，返回跳转后第一帧输出的起始时间
+static long seek_before_first_frame(const std::vector<uint8_t> &file, const std::vector<mp3_frame_end> &ends, int rate)
+{
+    audio_source_t src;
+    audio_source_from_memory(&src, file.data(), file.size());
+    mp3_instance inst = {};
+    std::vector<uint8_t> buf(MAINBUF_SIZE * 3);
+    inst.data_buf = buf.data();
+    inst.data_buf_size = buf.size();
+    HMP3Decoder dec = MP3InitDecoder();
+    decode_buffers b;
+    long result = -1;
+
+    if (is_mp3(&src, &inst) && seek_mp3(&src, &inst, SEEK_TARGET_MS)) {
+        for (int calls = 0; calls < 64 && result < 0; calls++) {
+            DECODE_STATUS s = decode_mp3(dec, &src, &b.out, &inst);
+            if (s == DECODE_STATUS_DONE || s == DECODE_STATUS_ERROR) {
+                break;
+            }
+            if (s != DECODE_STATUS_CONTINUE || b.out.frame_count == 0) {
+                continue;
+            }
+            for (const mp3_frame_end &e : ends) {
+                if (e.offset == audio_source_tell(&src)) {
+                    result = (long)((uint64_t)e.first_sample * 1000 / rate);
+                    break;
+                }
+            }
+        }
+    }
+    MP3FreeDecoder(dec);
+    audio_source_close(&src);
+    return result;
+}
+
+int main(int argc, char **argv)
+{
+    if (argc < 2) {
+        fprintf(stderr, "usage: %s <file.mp3>\n", argv[0]);
+        return 2;
+    }
+    std::vector<uint8_t> mp3 = read_file(argv[1]);
+    if (mp3.empty()) {
+        fprintf(stderr, "cannot read %s\n", argv[1]);
+        return 2;
+    }
+
+    int rate = 0;
+    std::vector<mp3_frame_end> ends;
+    std::vector<int16_t> pcm = decode_mp3_all(mp3, &rate, &ends);
+    if (pcm.empty() || rate == 0) {
+        fprintf(stderr, "mp3 decode failed\n");
+        return 1;
+    }
+    // 测试文件是单声道，FLAC 编码同样的 PCM 才能比较解码开销
+    std::vector<uint8_t> flac = flac_encode(pcm, rate);
+    double audio_s = (double)pcm.size() / rate;
+
+    double t0 = now_us();
+    for (int r = 0; r < REPEAT; r++) {
+        decode_mp3_all(mp3, &rate, NULL);
+    }
+    double mp3_us = (now_us() - t0) / REPEAT;
+
+    std::vector<int16_t> flac_pcm;
+    t0 = now_us();
+    for (int r = 0; r < REPEAT; r++) {
+        flac_pcm = decode_flac_all(flac);
+    }
+    double flac_us = (now_us() - t0) / REPEAT;
+
+    int fail = 0;
+    if (flac_pcm != pcm) {
+        fprintf(stderr, "FLAC round trip mismatch: %zu vs %zu samples\n", flac_pcm.size(), pcm.size());
+        fail = 1;
+    }
+    printf("%.1f s mono %d Hz: mp3 %zu bytes, flac %zu bytes\n", audio_s, rate, mp3.size(), flac.size());
+    printf("decode per second of audio: mp3 %.0f us (%.3f %% core), flac %.0f us (%.3f %% core), flac/mp3 %.2f\n",
+           mp3_us / audio_s, mp3_us / audio_s / 1e4, flac_us / audio_s, flac_us / audio_s / 1e4, flac_us / mp3_us);
+
+    long landed = seek_before_first_frame(mp3, ends, rate);
+    printf("seek to %d ms before the first decoded frame: first output at %ld ms\n", SEEK_TARGET_MS, landed);
+    if (landed < 0 || labs(landed - SEEK_TARGET_MS) > SEEK_TOLERANCE_MS) {
+        fail = 1;
+    }
+    return fail;
+}
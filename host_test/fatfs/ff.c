@@ -0,0 +1,1010 @@
+// host_test/fatfs/ff.c
+// FatFs R0.15 读写路径的主机实现，只用于 fatfs_bench (接口见 ff.h)。
+// 与 ff.c 保持一致、影响读命令统计的几点:
+//   - f_read 在扇区边界上把整扇区直接读进调用者的缓冲，一次 disk_read 最多读到簇尾；
+//     不足一扇区的部分经 FIL 的扇区缓冲，跨扇区时才读新扇区
+//   - f_lseek 落在扇区中间时立即把该扇区读进 FIL 的缓冲
+//   - FAT 和目录经 FATFS.win 一个扇区的窗口访问，换扇区前写回
+//   - create_chain 从上次分配的簇之后找空闲簇
+// 不支持: FAT12/FAT32/exFAT、子目录、长文件名、分区表 (f_mkfs 总是按 FM_SFD 格式化)
+#include <stdbool.h>
+#include <string.h>
+
+#include "ff.h"
+#include "diskio.h"
+
+#define SS              FF_MAX_SS
+#define DIR_ENTRY       32
+#define FA_MODIFIED     0x40
+#define FA_DIRTY        0x80
+
+#define MIN_FAT16       4086    // FAT16 的最少簇数 + 1
+#define MAX_FAT16       65526   // FAT16 的最多簇数 + 1
+
+/* 引导扇区 (BPB) 和目录项中的偏移 */
+#define BS_JMPBOOT      0
+#define BPB_BYTSPERSEC  11
+#define BPB_SECPERCLUS  13
+#define BPB_RSVDSECCNT  14
+#define BPB_NUMFATS     16
+#define BPB_ROOTENTCNT  17
+#define BPB_TOTSEC16    19
+#define BPB_MEDIA       21
+#define BPB_FATSZ16     22
+#define BPB_SECPERTRK   24
+#define BPB_NUMHEADS    26
+#define BPB_TOTSEC32    32
+#define BS_DRVNUM       36
+#define BS_BOOTSIG      38
+#define BS_VOLID        39
+#define BS_VOLLAB       43
+#define BS_FILSYSTYPE   54
+#define BS_55AA         510
+
+#define DIR_NAME        0
+#define DIR_ATTR        11
+#define DIR_WRTTIME     22
+#define DIR_FSTCLUSLO   26
+#define DIR_FILESIZE    28
+
+static FATFS *FatFs[FF_VOLUMES];
+static WORD Fsid;
+
+static WORD ld_word(const BYTE *p)
+{
+    return (WORD)(p[0] | (p[1] << 8));
+}
+
+static DWORD ld_dword(const BYTE *p)
+{
+    return (DWORD)p[0] | ((DWORD)p[1] << 8) | ((DWORD)p[2] << 16) | ((DWORD)p[3] << 24);
+}
+
+static void st_word(BYTE *p, WORD v)
+{
+    p[0] = (BYTE)v;
+    p[1] = (BYTE)(v >> 8);
+}
+
+static void st_dword(BYTE *p, DWORD v)
+{
+    p[0] = (BYTE)v;
+    p[1] = (BYTE)(v >> 8);
+    p[2] = (BYTE)(v >> 16);
+    p[3] = (BYTE)(v >> 24);
+}
+
+/* =========================== 扇区窗口 =========================== */
+static FRESULT sync_window(FATFS *fs)
+{
+    if (!fs->wflag) {
+        return FR_OK;
+    }
+    if (disk_write(fs->pdrv, fs->win, fs->winsect, 1) != RES_OK) {
+        return FR_DISK_ERR;
+    }
+    fs->wflag = 0;
+    // FAT 区的扇区同时写到第二份 FAT
+    if (fs->winsect - fs->fatbase < fs->fsize) {
+        for (BYTE n = 1; n < fs->n_fats; n++) {
+            if (disk_write(fs->pdrv, fs->win, fs->winsect + fs->fsize * n, 1) != RES_OK) {
+                return FR_DISK_ERR;
+            }
+        }
+    }
+    return FR_OK;
+}
+
+static FRESULT move_window(FATFS *fs, LBA_t sect)
+{
+    if (sect == fs->winsect) {
+        return FR_OK;
+    }
+    FRESULT res = sync_window(fs);
+    if (res != FR_OK) {
+        return res;
+    }
+    if (disk_read(fs->pdrv, fs->win, sect, 1) != RES_OK) {
+        fs->winsect = (LBA_t)0 - 1;
+        return FR_DISK_ERR;
+    }
+    fs->winsect = sect;
+    return FR_OK;
+}
+
+/* =========================== FAT =========================== */
+static LBA_t clst2sect(const FATFS *fs, DWORD clst)
+{
+    return fs->database + (LBA_t)fs->csize * (clst - 2);
+}
+
+// 返回簇 clst 的 FAT 表项；0xFFFFFFFF 为磁盘错误，1 为簇号无效
+static DWORD get_fat(FATFS *fs, DWORD clst)
+{
+    if (clst < 2 || clst >= fs->n_fatent) {
+        return 1;
+    }
+    if (move_window(fs, fs->fatbase + clst / (SS / 2)) != FR_OK) {
+        return 0xFFFFFFFF;
+    }
+    return ld_word(fs->win + clst * 2 % SS);
+}
+
+static FRESULT put_fat(FATFS *fs, DWORD clst, DWORD val)
+{
+    if (clst < 2 || clst >= fs->n_fatent) {
+        return FR_INT_ERR;
+    }
+    FRESULT res = move_window(fs, fs->fatbase + clst / (SS / 2));
+    if (res == FR_OK) {
+        st_word(fs->win + clst * 2 % SS, (WORD)val);
+        fs->wflag = 1;
+    }
+    return res;
+}
+
+// 释放从 clst 开始的簇链
+static FRESULT remove_chain(FATFS *fs, DWORD clst)
+{
+    while (clst >= 2 && clst < fs->n_fatent) {
+        DWORD nxt = get_fat(fs, clst);
+        if (nxt == 0xFFFFFFFF) {
+            return FR_DISK_ERR;
+        }
+        if (nxt == 1) {
+            return FR_INT_ERR;
+        }
+        FRESULT res = put_fat(fs, clst, 0);
+        if (res != FR_OK) {
+            return res;
+        }
+        clst = nxt;
+    }
+    return FR_OK;
+}
+
+/**
+ * 在 clst 之后接一个簇 (clst 为 0 时新建簇链)，返回新簇号；
+ * 0 为没有空闲簇，1 为内部错误，0xFFFFFFFF 为磁盘错误。
+ * clst 后面已经有簇时直接返回它 (覆盖写不重新分配)。
+ */
+static DWORD create_chain(FATFS *fs, DWORD clst)
+{
+    DWORD scl;
+
+    if (clst == 0) {
+        scl = fs->last_clst;
+        if (scl == 0 || scl >= fs->n_fatent) {
+            scl = 1;
+        }
+    } else {
+        DWORD cs = get_fat(fs, clst);
+        if (cs < 2) {
+            return 1;
+        }
+        if (cs == 0xFFFFFFFF || cs < fs->n_fatent) {
+            return cs;
+        }
+        scl = clst;
+    }
+
+    DWORD ncl = scl;
+    for (;;) {
+        ncl++;
+        if (ncl >= fs->n_fatent) {
+            ncl = 2;
+            if (ncl > scl) {
+                return 0;
+            }
+        }
+        DWORD cs = get_fat(fs, ncl);
+        if (cs == 0) {
+            break;
+        }
+        if (cs == 1 || cs == 0xFFFFFFFF) {
+            return cs;
+        }
+        if (ncl == scl) {
+            return 0;
+        }
+    }
+
+    FRESULT res = put_fat(fs, ncl, 0xFFFF);
+    if (res == FR_OK && clst != 0) {
+        res = put_fat(fs, clst, ncl);
+    }
+    if (res != FR_OK) {
+        return res == FR_DISK_ERR ? 0xFFFFFFFF : 1;
+    }
+    fs->last_clst = ncl;
+    return ncl;
+}
+
+#if FF_USE_FASTSEEK
+// 由簇链表求文件偏移 ofs 所在的簇，与 ff.c 的 clmt_clust 相同
+static DWORD clmt_clust(const FIL *fp, FSIZE_t ofs)
+{
+    const DWORD *tbl = fp->cltbl + 1;
+    DWORD cl = (DWORD)(ofs / SS / fp->obj.fs->csize);
+    for (;;) {
+        DWORD ncl = *tbl++;
+        if (ncl == 0) {
+            return 0;
+        }
+        if (cl < ncl) {
+            break;
+        }
+        cl -= ncl;
+        tbl++;
+    }
+    return cl + *tbl;
+}
+#endif
+
+/* =========================== 卷和路径 =========================== */
+// 只接受 "0:" 开头或不带驱动器号的路径，返回驱动器号后面的部分
+static const TCHAR *get_ldnumber(const TCHAR *path, int *vol)
+{
+    *vol = -1;
+    if (path == NULL) {
+        return NULL;
+    }
+    if (path[0] >= '0' && path[0] < '0' + FF_VOLUMES && path[1] == ':') {
+        *vol = path[0] - '0';
+        return path + 2;
+    }
+    if (strchr(path, ':') != NULL) {
+        return NULL;
+    }
+    *vol = 0;
+    return path;
+}
+
+static FRESULT mount_volume(FATFS *fs)
+{
+    if (fs->fs_type != 0 && !(disk_status(fs->pdrv) & STA_NOINIT)) {
+        return FR_OK;
+    }
+    fs->fs_type = 0;
+    if (disk_initialize(fs->pdrv) & STA_NOINIT) {
+        return FR_NOT_READY;
+    }
+
+    fs->wflag = 0;
+    fs->winsect = (LBA_t)0 - 1;
+    if (move_window(fs, 0) != FR_OK) {
+        return FR_DISK_ERR;
+    }
+    const BYTE *bs = fs->win;
+    if (ld_word(bs + BS_55AA) != 0xAA55 || ld_word(bs + BPB_BYTSPERSEC) != SS) {
+        return FR_NO_FILESYSTEM;
+    }
+    DWORD fasize = ld_word(bs + BPB_FATSZ16);
+    BYTE n_fats = bs[BPB_NUMFATS];
+    WORD csize = bs[BPB_SECPERCLUS];
+    WORD n_rootdir = ld_word(bs + BPB_ROOTENTCNT);
+    WORD nrsv = ld_word(bs + BPB_RSVDSECCNT);
+    DWORD tsect = ld_word(bs + BPB_TOTSEC16);
+    if (tsect == 0) {
+        tsect = ld_dword(bs + BPB_TOTSEC32);
+    }
+    if (fasize == 0 || (n_fats != 1 && n_fats != 2) || csize == 0 || (csize & (csize - 1)) ||
+        n_rootdir == 0 || n_rootdir % (SS / DIR_ENTRY) || nrsv == 0) {
+        return FR_NO_FILESYSTEM;
+    }
+    DWORD sysect = nrsv + fasize * n_fats + n_rootdir / (SS / DIR_ENTRY);
+    if (tsect < sysect) {
+        return FR_NO_FILESYSTEM;
+    }
+    DWORD nclst = (tsect - sysect) / csize;
+    if (nclst < MIN_FAT16 - 1 || nclst > MAX_FAT16 - 1) {
+        return FR_NO_FILESYSTEM;
+    }
+
+    fs->n_fats = n_fats;
+    fs->csize = csize;
+    fs->n_rootdir = n_rootdir;
+    fs->fsize = fasize;
+    fs->n_fatent = nclst + 2;
+    fs->volbase = 0;
+    fs->fatbase = nrsv;
+    fs->dirbase = nrsv + fasize * n_fats;
+    fs->database = sysect;
+    fs->last_clst = 0xFFFFFFFF;
+    fs->id = ++Fsid;
+    fs->fs_type = FS_FAT16;
+    return FR_OK;
+}
+
+static FRESULT find_volume(const TCHAR **path, FATFS **rfs)
+{
+    int vol;
+    *path = get_ldnumber(*path, &vol);
+    if (*path == NULL || vol < 0) {
+        return FR_INVALID_DRIVE;
+    }
+    FATFS *fs = FatFs[vol];
+    if (fs == NULL) {
+        return FR_NOT_ENABLED;
+    }
+    *rfs = fs;
+    return mount_volume(fs);
+}
+
+static FRESULT validate(const FIL *fp, FATFS **rfs)
+{
+    if (fp == NULL || fp->obj.fs == NULL || fp->obj.fs->fs_type == 0 || fp->obj.id != fp->obj.fs->id ||
+        (disk_status(fp->obj.fs->pdrv) & STA_NOINIT)) {
+        *rfs = NULL;
+        return FR_INVALID_OBJECT;
+    }
+    *rfs = fp->obj.fs;
+    return FR_OK;
+}
+
+// 把根目录下的 8.3 文件名转成目录项中的 11 字节格式
+static FRESULT create_name(const TCHAR *path, BYTE sfn[11])
+{
+    while (*path == '/' || *path == '\\') {
+        path++;
+    }
+    memset(sfn, ' ', 11);
+    UINT i = 0;
+    UINT ni = 8;
+    for (; *path; path++) {
+        BYTE c = (BYTE)*path;
+        if (c == '/' || c == '\\') {
+            return FR_NO_PATH;
+        }
+        if (c == '.') {
+            if (ni == 11 || i == 0) {
+                return FR_INVALID_NAME;
+            }
+            i = 8;
+            ni = 11;
+            continue;
+        }
+        if (i >= ni || c <= ' ' || strchr("\"*+,:;<=>?[]|\x7F", c)) {
+            return FR_INVALID_NAME;
+        }
+        sfn[i++] = (c >= 'a' && c <= 'z') ? (BYTE)(c - 0x20) : c;
+    }
+    return sfn[0] == ' ' ? FR_INVALID_NAME : FR_OK;
+}
+
+/**
+ * 在根目录中找 sfn。找到时 *sect/*ofs 指向该目录项 (返回 FR_OK)；
+ * 找不到时指向第一个空闲项 (返回 FR_NO_FILE)，没有空闲项时 *sect 为 0。
+ */
+static FRESULT dir_find(FATFS *fs, const BYTE sfn[11], LBA_t *sect, UINT *ofs)
+{
+    *sect = 0;
+    for (UINT i = 0; i < fs->n_rootdir; i++) {
+        LBA_t s = fs->dirbase + i / (SS / DIR_ENTRY);
+        UINT o = i % (SS / DIR_ENTRY) * DIR_ENTRY;
+        FRESULT res = move_window(fs, s);
+        if (res != FR_OK) {
+            return res;
+        }
+        const BYTE *ent = fs->win + o;
+        if (ent[DIR_NAME] == 0 || ent[DIR_NAME] == 0xE5) {
+            if (*sect == 0) {
+                *sect = s;
+                *ofs = o;
+            }
+            if (ent[DIR_NAME] == 0) {
+                break;
+            }
+            continue;
+        }
+        if (memcmp(ent + DIR_NAME, sfn, 11) == 0) {
+            *sect = s;
+            *ofs = o;
+            return FR_OK;
+        }
+    }
+    return FR_NO_FILE;
+}
+
+/* =========================== 对外接口 =========================== */
+FRESULT f_mount(FATFS *fs, const TCHAR *path, BYTE opt)
+{
+    int vol;
+    if (get_ldnumber(path, &vol) == NULL || vol < 0) {
+        return FR_INVALID_DRIVE;
+    }
+    if (FatFs[vol]) {
+        FatFs[vol]->fs_type = 0;
+    }
+    FatFs[vol] = fs;
+    if (fs == NULL) {
+        return FR_OK;
+    }
+    fs->fs_type = 0;
+    fs->pdrv = (BYTE)vol;
+    return opt == 1 ? mount_volume(fs) : FR_OK;
+}
+
+FRESULT f_mkfs(const TCHAR *path, const MKFS_PARM *opt, void *work, UINT len)
+{
+    static const MKFS_PARM defopt = { FM_ANY, 0, 0, 0, 0 };
+    BYTE *buf = (BYTE *)work;
+    int vol;
+
+    if (get_ldnumber(path, &vol) == NULL || vol < 0) {
+        return FR_INVALID_DRIVE;
+    }
+    if (FatFs[vol]) {
+        FatFs[vol]->fs_type = 0;
+    }
+    if (opt == NULL) {
+        opt = &defopt;
+    }
+    BYTE pdrv = (BYTE)vol;
+    if (disk_initialize(pdrv) & STA_NOINIT) {
+        return FR_NOT_READY;
+    }
+    if (!(opt->fmt & FM_FAT) || buf == NULL || len < SS) {
+        return FR_INVALID_PARAMETER;
+    }
+
+    WORD ss;
+    LBA_t sz_vol;
+    if (disk_ioctl(pdrv, GET_SECTOR_SIZE, &ss) != RES_OK || ss != SS ||
+        disk_ioctl(pdrv, GET_SECTOR_COUNT, &sz_vol) != RES_OK) {
+        return FR_DISK_ERR;
+    }
+    BYTE n_fat = opt->n_fat ? opt->n_fat : 1;
+    UINT n_root = opt->n_root ? opt->n_root : 512;
+    DWORD pau = (opt->au_size ? opt->au_size : 4096) / SS;
+    if (n_fat > 2 || pau == 0 || pau > 128 || (pau & (pau - 1)) || n_root % (SS / DIR_ENTRY)) {
+        return FR_INVALID_PARAMETER;
+    }
+
+    // FAT 大小取决于簇数，簇数又取决于 FAT 大小，从上界开始收敛
+    DWORD sz_rsv = 1;
+    DWORD sz_dir = n_root * DIR_ENTRY / SS;
+    DWORD sz_fat = ((sz_vol / pau + 2) * 2 + SS - 1) / SS;
+    DWORD n_clst;
+    for (;;) {
+        if (sz_vol < sz_rsv + sz_fat * n_fat + sz_dir + pau) {
+            return FR_MKFS_ABORTED;
+        }
+        n_clst = (sz_vol - sz_rsv - sz_fat * n_fat - sz_dir) / pau;
+        DWORD need = ((n_clst + 2) * 2 + SS - 1) / SS;
+        if (need >= sz_fat) {
+            break;
+        }
+        sz_fat = need;
+    }
+    if (n_clst < MIN_FAT16 - 1 || n_clst > MAX_FAT16 - 1) {
+        return FR_MKFS_ABORTED;
+    }
+
+    // 引导扇区
+    memset(buf, 0, SS);
+    memcpy(buf + BS_JMPBOOT, "\xEB\xFE\x90" "MSDOS5.0", 11);
+    st_word(buf + BPB_BYTSPERSEC, SS);
+    buf[BPB_SECPERCLUS] = (BYTE)pau;
+    st_word(buf + BPB_RSVDSECCNT, (WORD)sz_rsv);
+    buf[BPB_NUMFATS] = n_fat;
+    st_word(buf + BPB_ROOTENTCNT, (WORD)n_root);
+    if (sz_vol < 0x10000) {
+        st_word(buf + BPB_TOTSEC16, (WORD)sz_vol);
+    } else {
+        st_dword(buf + BPB_TOTSEC32, sz_vol);
+    }
+    buf[BPB_MEDIA] = 0xF8;
+    st_word(buf + BPB_FATSZ16, (WORD)sz_fat);
+    st_word(buf + BPB_SECPERTRK, 63);
+    st_word(buf + BPB_NUMHEADS, 255);
+    buf[BS_DRVNUM] = 0x80;
+    buf[BS_BOOTSIG] = 0x29;
+    st_dword(buf + BS_VOLID, 0x20240101);
+    memcpy(buf + BS_VOLLAB, "NO NAME    " "FAT16   ", 19);
+    st_word(buf + BS_55AA, 0xAA55);
+    if (disk_write(pdrv, buf, 0, 1) != RES_OK) {
+        return FR_DISK_ERR;
+    }
+
+    // 各份 FAT (头两个表项保留) 和根目录
+    LBA_t sect = sz_rsv;
+    for (BYTE n = 0; n < n_fat; n++) {
+        for (DWORD i = 0; i < sz_fat; i++) {
+            memset(buf, 0, SS);
+            if (i == 0) {
+                st_dword(buf, 0xFFFFFFF8);
+            }
+            if (disk_write(pdrv, buf, sect++, 1) != RES_OK) {
+                return FR_DISK_ERR;
+            }
+        }
+    }
+    memset(buf, 0, SS);
+    for (DWORD i = 0; i < sz_dir; i++) {
+        if (disk_write(pdrv, buf, sect++, 1) != RES_OK) {
+            return FR_DISK_ERR;
+        }
+    }
+    return disk_ioctl(pdrv, CTRL_SYNC, NULL) == RES_OK ? FR_OK : FR_DISK_ERR;
+}
+
+FRESULT f_open(FIL *fp, const TCHAR *path, BYTE mode)
+{
+    FATFS *fs;
+    BYTE sfn[11];
+    LBA_t dsect;
+    UINT dofs;
+
+    if (fp == NULL) {
+        return FR_INVALID_OBJECT;
+    }
+    fp->obj.fs = NULL;
+    mode &= FA_READ | FA_WRITE | FA_CREATE_ALWAYS | FA_CREATE_NEW | FA_OPEN_ALWAYS;
+    FRESULT res = find_volume(&path, &fs);
+    if (res == FR_OK) {
+        res = create_name(path, sfn);
+    }
+    if (res == FR_OK) {
+        res = dir_find(fs, sfn, &dsect, &dofs);
+    }
+
+    if (res == FR_OK || res == FR_NO_FILE) {
+        bool found = (res == FR_OK);
+        if (mode & (FA_CREATE_ALWAYS | FA_OPEN_ALWAYS | FA_CREATE_NEW)) {
+            if (!found) {
+                // 新建目录项
+                if (dsect == 0) {
+                    return FR_DENIED;
+                }
+                res = move_window(fs, dsect);
+                if (res != FR_OK) {
+                    return res;
+                }
+                BYTE *ent = fs->win + dofs;
+                memset(ent, 0, DIR_ENTRY);
+                memcpy(ent + DIR_NAME, sfn, 11);
+                ent[DIR_ATTR] = AM_ARC;
+                fs->wflag = 1;
+                mode |= FA_CREATE_ALWAYS;
+            } else if (mode & FA_CREATE_NEW) {
+                return FR_EXIST;
+            }
+            res = FR_OK;
+        }
+        if (res != FR_OK) {
+            return res;
+        }
+
+        res = move_window(fs, dsect);
+        if (res != FR_OK) {
+            return res;
+        }
+        BYTE *ent = fs->win + dofs;
+        if (ent[DIR_ATTR] & AM_DIR) {
+            return FR_NO_FILE;
+        }
+        if ((mode & FA_WRITE) && (ent[DIR_ATTR] & AM_RDO)) {
+            return FR_DENIED;
+        }
+        DWORD sclust = ld_word(ent + DIR_FSTCLUSLO);
+        DWORD size = ld_dword(ent + DIR_FILESIZE);
+        if (found && (mode & FA_CREATE_ALWAYS)) {
+            // 截断为空文件
+            st_word(ent + DIR_FSTCLUSLO, 0);
+            st_dword(ent + DIR_FILESIZE, 0);
+            fs->wflag = 1;
+            if (sclust != 0) {
+                res = remove_chain(fs, sclust);
+                if (res != FR_OK) {
+                    return res;
+                }
+                fs->last_clst = sclust - 1;
+            }
+            sclust = 0;
+            size = 0;
+        }
+        if (mode & FA_CREATE_ALWAYS) {
+            res = sync_window(fs);
+            if (res != FR_OK) {
+                return res;
+            }
+            mode |= FA_MODIFIED;
+        }
+
+        fp->obj.fs = fs;
+        fp->obj.id = fs->id;
+        fp->obj.attr = AM_ARC;
+        fp->obj.stat = 0;
+        fp->obj.sclust = sclust;
+        fp->obj.objsize = size;
+        fp->flag = mode;
+        fp->err = 0;
+        fp->fptr = 0;
+        fp->clust = 0;
+        fp->sect = 0;
+        fp->dir_sect = dsect;
+        fp->dir_ofs = dofs;
+#if FF_USE_FASTSEEK
+        fp->cltbl = NULL;
+#endif
+        memset(fp->buf, 0, sizeof(fp->buf));
+    }
+    return res;
+}
+
+FRESULT f_read(FIL *fp, void *buff, UINT btr, UINT *br)
+{
+    FATFS *fs;
+    BYTE *rbuff = (BYTE *)buff;
+    UINT rcnt;
+
+    *br = 0;
+    FRESULT res = validate(fp, &fs);
+    if (res != FR_OK || (res = (FRESULT)fp->err) != FR_OK) {
+        return res;
+    }
+    if (!(fp->flag & FA_READ)) {
+        return FR_DENIED;
+    }
+    FSIZE_t remain = fp->obj.objsize - fp->fptr;
+    if (btr > remain) {
+        btr = (UINT)remain;
+    }
+
+    for (; btr > 0; btr -= rcnt, *br += rcnt, rbuff += rcnt, fp->fptr += rcnt) {
+        if (fp->fptr % SS == 0) {
+            UINT csect = (UINT)(fp->fptr / SS & (fs->csize - 1));
+            if (csect == 0) {
+                DWORD clst;
+                if (fp->fptr == 0) {
+                    clst = fp->obj.sclust;
+                } else {
+#if FF_USE_FASTSEEK
+                    clst = fp->cltbl ? clmt_clust(fp, fp->fptr) : get_fat(fs, fp->clust);
+#else
+                    clst = get_fat(fs, fp->clust);
+#endif
+                }
+                if (clst < 2) {
+                    fp->err = FR_INT_ERR;
+                    return FR_INT_ERR;
+                }
+                if (clst == 0xFFFFFFFF) {
+                    fp->err = FR_DISK_ERR;
+                    return FR_DISK_ERR;
+                }
+                fp->clust = clst;
+            }
+            LBA_t sect = clst2sect(fs, fp->clust) + csect;
+            UINT cc = btr / SS;
+            if (cc > 0) {
+                // 整扇区直接读进调用者的缓冲，最多到簇尾
+                if (csect + cc > fs->csize) {
+                    cc = fs->csize - csect;
+                }
+                if (disk_read(fs->pdrv, rbuff, sect, cc) != RES_OK) {
+                    fp->err = FR_DISK_ERR;
+                    return FR_DISK_ERR;
+                }
+                if ((fp->flag & FA_DIRTY) && fp->sect - sect < cc) {
+                    memcpy(rbuff + (fp->sect - sect) * SS, fp->buf, SS);
+                }
+                rcnt = SS * cc;
+                continue;
+            }
+            if (fp->sect != sect) {
+                if (fp->flag & FA_DIRTY) {
+                    if (disk_write(fs->pdrv, fp->buf, fp->sect, 1) != RES_OK) {
+                        fp->err = FR_DISK_ERR;
+                        return FR_DISK_ERR;
+                    }
+                    fp->flag &= (BYTE)~FA_DIRTY;
+                }
+                if (disk_read(fs->pdrv, fp->buf, sect, 1) != RES_OK) {
+                    fp->err = FR_DISK_ERR;
+                    return FR_DISK_ERR;
+                }
+            }
+            fp->sect = sect;
+        }
+        rcnt = SS - (UINT)(fp->fptr % SS);
+        if (rcnt > btr) {
+            rcnt = btr;
+        }
+        memcpy(rbuff, fp->buf + fp->fptr % SS, rcnt);
+    }
+    return FR_OK;
+}
+
+FRESULT f_write(FIL *fp, const void *buff, UINT btw, UINT *bw)
+{
+    FATFS *fs;
+    const BYTE *wbuff = (const BYTE *)buff;
+    UINT wcnt;
+
+    *bw = 0;
+    FRESULT res = validate(fp, &fs);
+    if (res != FR_OK || (res = (FRESULT)fp->err) != FR_OK) {
+        return res;
+    }
+    if (!(fp->flag & FA_WRITE)) {
+        return FR_DENIED;
+    }
+    if ((DWORD)(fp->fptr + btw) < (DWORD)fp->fptr) {
+        btw = (UINT)(0xFFFFFFFF - (DWORD)fp->fptr);
+    }
+
+    for (; btw > 0; btw -= wcnt, *bw += wcnt, wbuff += wcnt, fp->fptr += wcnt,
+         fp->obj.objsize = (fp->fptr > fp->obj.objsize) ? fp->fptr : fp->obj.objsize) {
+        if (fp->fptr % SS == 0) {
+            UINT csect = (UINT)(fp->fptr / SS & (fs->csize - 1));
+            if (csect == 0) {
+                DWORD clst;
+                if (fp->fptr == 0) {
+                    clst = fp->obj.sclust;
+                    if (clst == 0) {
+                        clst = create_chain(fs, 0);
+                    }
+                } else {
+                    clst = create_chain(fs, fp->clust);
+                }
+                if (clst == 0) {
+                    break;  // 卷已满
+                }
+                if (clst == 1) {
+                    fp->err = FR_INT_ERR;
+                    return FR_INT_ERR;
+                }
+                if (clst == 0xFFFFFFFF) {
+                    fp->err = FR_DISK_ERR;
+                    return FR_DISK_ERR;
+                }
+                fp->clust = clst;
+                if (fp->obj.sclust == 0) {
+                    fp->obj.sclust = clst;
+                }
+            }
+            if (fp->flag & FA_DIRTY) {
+                if (disk_write(fs->pdrv, fp->buf, fp->sect, 1) != RES_OK) {
+                    fp->err = FR_DISK_ERR;
+                    return FR_DISK_ERR;
+                }
+                fp->flag &= (BYTE)~FA_DIRTY;
+            }
+            LBA_t sect = clst2sect(fs, fp->clust) + csect;
+            UINT cc = btw / SS;
+            if (cc > 0) {
+                if (csect + cc > fs->csize) {
+                    cc = fs->csize - csect;
+                }
+                if (disk_write(fs->pdrv, wbuff, sect, cc) != RES_OK) {
+                    fp->err = FR_DISK_ERR;
+                    return FR_DISK_ERR;
+                }
+                if (fp->sect - sect < cc) {
+                    memcpy(fp->buf, wbuff + (fp->sect - sect) * SS, SS);
+                }
+                wcnt = SS * cc;
+                continue;
+            }
+            // 部分写入一个已有数据的扇区，先读出原内容
+            if (fp->sect != sect && fp->fptr < fp->obj.objsize &&
+                disk_read(fs->pdrv, fp->buf, sect, 1) != RES_OK) {
+                fp->err = FR_DISK_ERR;
+                return FR_DISK_ERR;
+            }
+            fp->sect = sect;
+        }
+        wcnt = SS - (UINT)(fp->fptr % SS);
+        if (wcnt > btw) {
+            wcnt = btw;
+        }
+        memcpy(fp->buf + fp->fptr % SS, wbuff, wcnt);
+        fp->flag |= FA_DIRTY;
+    }
+    fp->flag |= FA_MODIFIED;
+    return FR_OK;
+}
+
+FRESULT f_sync(FIL *fp)
+{
+    FATFS *fs;
+    FRESULT res = validate(fp, &fs);
+    if (res != FR_OK || !(fp->flag & FA_MODIFIED)) {
+        return res;
+    }
+    if (fp->flag & FA_DIRTY) {
+        if (disk_write(fs->pdrv, fp->buf, fp->sect, 1) != RES_OK) {
+            return FR_DISK_ERR;
+        }
+        fp->flag &= (BYTE)~FA_DIRTY;
+    }
+    res = move_window(fs, fp->dir_sect);
+    if (res == FR_OK) {
+        BYTE *ent = fs->win + fp->dir_ofs;
+        ent[DIR_ATTR] |= AM_ARC;
+        st_word(ent + DIR_FSTCLUSLO, (WORD)fp->obj.sclust);
+        st_dword(ent + DIR_FILESIZE, (DWORD)fp->obj.objsize);
+        st_dword(ent + DIR_WRTTIME, ((DWORD)(FF_NORTC_YEAR - 1980) << 25) | ((DWORD)FF_NORTC_MON << 21) |
+                 ((DWORD)FF_NORTC_MDAY << 16));
+        fs->wflag = 1;
+        res = sync_window(fs);
+    }
+    if (res == FR_OK && disk_ioctl(fs->pdrv, CTRL_SYNC, NULL) != RES_OK) {
+        res = FR_DISK_ERR;
+    }
+    if (res == FR_OK) {
+        fp->flag &= (BYTE)~FA_MODIFIED;
+    }
+    return res;
+}
+
+FRESULT f_close(FIL *fp)
+{
+    FRESULT res = f_sync(fp);
+    if (res == FR_OK) {
+        fp->obj.fs = NULL;
+    }
+    return res;
+}
+
+FRESULT f_lseek(FIL *fp, FSIZE_t ofs)
+{
+    FATFS *fs;
+    LBA_t nsect = 0;
+
+    FRESULT res = validate(fp, &fs);
+    if (res == FR_OK) {
+        res = (FRESULT)fp->err;
+    }
+    if (res != FR_OK) {
+        return res;
+    }
+
+#if FF_USE_FASTSEEK
+    if (fp->cltbl) {
+        if (ofs == CREATE_LINKMAP) {
+            // 簇链表: 表长，然后是 (连续簇数, 起始簇) 对，以 0 结尾
+            DWORD *tbl = fp->cltbl;
+            DWORD tlen = *tbl++;
+            DWORD ulen = 2;
+            DWORD cl = fp->obj.sclust;
+            if (cl != 0) {
+                do {
+                    DWORD tcl = cl;
+                    DWORD ncl = 0;
+                    DWORD pcl;
+                    ulen += 2;
+                    do {
+                        pcl = cl;
+                        ncl++;
+                        cl = get_fat(fs, cl);
+                        if (cl <= 1) {
+                            fp->err = FR_INT_ERR;
+                            return FR_INT_ERR;
+                        }
+                        if (cl == 0xFFFFFFFF) {
+                            fp->err = FR_DISK_ERR;
+                            return FR_DISK_ERR;
+                        }
+                    } while (cl == pcl + 1);
+                    if (ulen <= tlen) {
+                        *tbl++ = ncl;
+                        *tbl++ = tcl;
+                    }
+                } while (cl < fs->n_fatent);
+            }
+            *fp->cltbl = ulen;
+            if (ulen <= tlen) {
+                *tbl = 0;
+                return FR_OK;
+            }
+            return FR_NOT_ENOUGH_CORE;
+        }
+
+        if (ofs > fp->obj.objsize) {
+            ofs = fp->obj.objsize;
+        }
+        fp->fptr = ofs;
+        if (ofs > 0) {
+            fp->clust = clmt_clust(fp, ofs - 1);
+            LBA_t dsc = clst2sect(fs, fp->clust) + (LBA_t)((ofs - 1) / SS & (fs->csize - 1));
+            if (fp->fptr % SS && dsc != fp->sect) {
+                if (fp->flag & FA_DIRTY) {
+                    if (disk_write(fs->pdrv, fp->buf, fp->sect, 1) != RES_OK) {
+                        fp->err = FR_DISK_ERR;
+                        return FR_DISK_ERR;
+                    }
+                    fp->flag &= (BYTE)~FA_DIRTY;
+                }
+                if (disk_read(fs->pdrv, fp->buf, dsc, 1) != RES_OK) {
+                    fp->err = FR_DISK_ERR;
+                    return FR_DISK_ERR;
+                }
+                fp->sect = dsc;
+            }
+        }
+        return FR_OK;
+    }
+#endif
+
+    if (ofs > fp->obj.objsize && !(fp->flag & FA_WRITE)) {
+        ofs = fp->obj.objsize;
+    }
+    FSIZE_t ifptr = fp->fptr;
+    fp->fptr = 0;
+    if (ofs > 0) {
+        DWORD bcs = (DWORD)fs->csize * SS;
+        DWORD clst;
+        if (ifptr > 0 && (ofs - 1) / bcs >= (ifptr - 1) / bcs) {
+            // 向后跳时从当前簇开始走
+            fp->fptr = (ifptr - 1) & ~(FSIZE_t)(bcs - 1);
+            ofs -= fp->fptr;
+            clst = fp->clust;
+        } else {
+            clst = fp->obj.sclust;
+            if (clst == 0) {
+                clst = create_chain(fs, 0);
+                if (clst == 1) {
+                    fp->err = FR_INT_ERR;
+                    return FR_INT_ERR;
+                }
+                if (clst == 0xFFFFFFFF) {
+                    fp->err = FR_DISK_ERR;
+                    return FR_DISK_ERR;
+                }
+                fp->obj.sclust = clst;
+            }
+            fp->clust = clst;
+        }
+        if (clst != 0) {
+            while (ofs > bcs) {
+                ofs -= bcs;
+                fp->fptr += bcs;
+                if (fp->flag & FA_WRITE) {
+                    clst = create_chain(fs, clst);
+                    if (clst == 0) {
+                        ofs = 0;
+                        break;
+                    }
+                } else {
+                    clst = get_fat(fs, clst);
+                }
+                if (clst == 0xFFFFFFFF) {
+                    fp->err = FR_DISK_ERR;
+                    return FR_DISK_ERR;
+                }
+                if (clst <= 1 || clst >= fs->n_fatent) {
+                    fp->err = FR_INT_ERR;
+                    return FR_INT_ERR;
+                }
+                fp->clust = clst;
+            }
+            fp->fptr += ofs;
+            if (ofs % SS) {
+                nsect = clst2sect(fs, clst) + (LBA_t)(ofs / SS);
+            }
+        }
+    }
+    if (fp->fptr > fp->obj.objsize) {
+        fp->obj.objsize = fp->fptr;
+        fp->flag |= FA_MODIFIED;
+    }
+    // 落在扇区中间时读入该扇区，与 ff.c 相同
+    if (fp->fptr % SS && nsect != fp->sect) {
+        if (fp->flag & FA_DIRTY) {
+            if (disk_write(fs->pdrv, fp->buf, fp->sect, 1) != RES_OK) {
+                fp->err = FR_DISK_ERR;
+                return FR_DISK_ERR;
+            }
+            fp->flag &= (BYTE)~FA_DIRTY;
+        }
+        if (disk_read(fs->pdrv, fp->buf, nsect, 1) != RES_OK) {
+            fp->err = FR_DISK_ERR;
+            return FR_DISK_ERR;
+        }
+        fp->sect = nsect;
+    }
+    return FR_OK;
+}
@@ -0,0 +1,151 @@
+// host_test/fatfs/ff.h
+// fatfs_bench 用的 FatFs 主机实现，接口与 FatFs R0.15 的 ff.h 一致，只包含基准用到的部分:
+// 单卷 FAT16、根目录、8.3 文件名，f_mount/f_mkfs/f_open/f_read/f_write/f_lseek (含快速定位)/f_sync/f_close。
+// 读写路径按 ff.c 的做法实现，磁盘读命令的条数和长度与真正的 FatFs 相同，见 ff.c 开头的说明。
+// 指定 FATFS_DIR 时改用真正的 FatFs 源码，这几个文件不参与编译
+#ifndef FF_DEFINED
+#define FF_DEFINED      80286   // 对应的 FatFs 版本 (R0.15)
+
+#include <stdint.h>
+#include "ffconf.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#if FF_MIN_SS != FF_MAX_SS
+#error "host FatFs supports a fixed sector size only"
+#endif
+
+typedef unsigned int    UINT;
+typedef unsigned char   BYTE;
+typedef uint16_t        WORD;
+typedef uint32_t        DWORD;
+typedef uint64_t        QWORD;
+typedef char            TCHAR;
+typedef DWORD           FSIZE_t;
+typedef DWORD           LBA_t;
+
+/* 文件系统对象 */
+typedef struct {
+    BYTE    fs_type;        // 0: 未挂载，2: FAT16
+    BYTE    pdrv;
+    BYTE    n_fats;
+    BYTE    wflag;          // win[] 有改动
+    WORD    id;             // 挂载序号，用于判断文件对象是否过期
+    WORD    n_rootdir;
+    WORD    csize;          // 每簇扇区数
+    DWORD   last_clst;      // 最近分配的簇
+    DWORD   n_fatent;       // 簇数 + 2
+    DWORD   fsize;          // 每份 FAT 的扇区数
+    LBA_t   volbase;
+    LBA_t   fatbase;
+    LBA_t   dirbase;
+    LBA_t   database;
+    LBA_t   winsect;        // win[] 中是哪个扇区
+    BYTE    win[FF_MAX_SS]; // 目录和 FAT 共用的扇区窗口
+} FATFS;
+
+typedef struct {
+    FATFS   *fs;
+    WORD    id;
+    BYTE    attr;
+    BYTE    stat;
+    DWORD   sclust;         // 起始簇，0 为空文件
+    FSIZE_t objsize;
+} FFOBJID;
+
+/* 文件对象 */
+typedef struct {
+    FFOBJID obj;
+    BYTE    flag;           // FA_* 与 FA_MODIFIED/FA_DIRTY
+    BYTE    err;
+    FSIZE_t fptr;
+    DWORD   clust;          // fptr 所在的簇
+    LBA_t   sect;           // buf[] 中是哪个扇区
+    LBA_t   dir_sect;       // 目录项所在的扇区
+    UINT    dir_ofs;        // 目录项在扇区内的偏移
+#if FF_USE_FASTSEEK
+    DWORD   *cltbl;         // 快速定位用的簇链表
+#endif
+    BYTE    buf[FF_MAX_SS]; // 文件私有的扇区缓冲 (非 TINY)
+} FIL;
+
+typedef enum {
+    FR_OK = 0,
+    FR_DISK_ERR,
+    FR_INT_ERR,
+    FR_NOT_READY,
+    FR_NO_FILE,
+    FR_NO_PATH,
+    FR_INVALID_NAME,
+    FR_DENIED,
+    FR_EXIST,
+    FR_INVALID_OBJECT,
+    FR_WRITE_PROTECTED,
+    FR_INVALID_DRIVE,
+    FR_NOT_ENABLED,
+    FR_NO_FILESYSTEM,
+    FR_MKFS_ABORTED,
+    FR_TIMEOUT,
+    FR_LOCKED,
+    FR_NOT_ENOUGH_CORE,
+    FR_TOO_MANY_OPEN_FILES,
+    FR_INVALID_PARAMETER
+} FRESULT;
+
+/* f_mkfs 的格式参数 */
+typedef struct {
+    BYTE fmt;               // FM_*，这里只支持 FM_FAT
+    BYTE n_fat;             // FAT 份数，0 为 1
+    UINT align;             // 未使用
+    UINT n_root;            // 根目录项数，0 为 512
+    DWORD au_size;          // 簇大小 (字节)，0 为 4 KB
+} MKFS_PARM;
+
+FRESULT f_mount(FATFS *fs, const TCHAR *path, BYTE opt);
+FRESULT f_mkfs(const TCHAR *path, const MKFS_PARM *opt, void *work, UINT len);
+FRESULT f_open(FIL *fp, const TCHAR *path, BYTE mode);
+FRESULT f_close(FIL *fp);
+FRESULT f_read(FIL *fp, void *buff, UINT btr, UINT *br);
+FRESULT f_write(FIL *fp, const void *buff, UINT btw, UINT *bw);
+FRESULT f_lseek(FIL *fp, FSIZE_t ofs);
+FRESULT f_sync(FIL *fp);
+
+#define f_tell(fp)      ((fp)->fptr)
+#define f_size(fp)      ((fp)->obj.objsize)
+#define f_eof(fp)       ((int)((fp)->fptr == (fp)->obj.objsize))
+#define f_error(fp)     ((fp)->err)
+
+#define CREATE_LINKMAP  ((FSIZE_t)0 - 1)
+
+#define FA_READ             0x01
+#define FA_WRITE            0x02
+#define FA_OPEN_EXISTING    0x00
+#define FA_CREATE_NEW       0x04
+#define FA_CREATE_ALWAYS    0x08
+#define FA_OPEN_ALWAYS      0x10
+#define FA_OPEN_APPEND      0x30
+
+#define FM_FAT      0x01
+#define FM_FAT32    0x02
+#define FM_EXFAT    0x04
+#define FM_ANY      0x07
+#define FM_SFD      0x08
+
+#define FS_FAT12    1
+#define FS_FAT16    2
+#define FS_FAT32    3
+#define FS_EXFAT    4
+
+#define AM_RDO      0x01
+#define AM_HID      0x02
+#define AM_SYS      0x04
+#define AM_DIR      0x10
+#define AM_ARC      0x20
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // FF_DEFINED
@@ -0,0 +1,47 @@
+// host_test/fatfs/ffconf.h
+// fatfs_bench 用的 FatFs 配置 (R0.14/R0.15 的选项)，与设备上读取相关的部分保持一致:
+// 512 字节扇区、非 TINY (每个 FIL 有自己的扇区缓冲)、打开快速定位
+#define FFCONF_DEF      FF_DEFINED
+
+#define FF_FS_READONLY  0
+#define FF_FS_MINIMIZE  0
+#define FF_USE_FIND     0
+#define FF_USE_MKFS     1       // 基准自己格式化镜像
+#define FF_USE_FASTSEEK 1
+#define FF_USE_EXPAND   0
+#define FF_USE_CHMOD    0
+#define FF_USE_LABEL    0
+#define FF_USE_FORWARD  0
+#define FF_USE_STRFUNC  0
+#define FF_PRINT_LLI    0
+#define FF_PRINT_FLOAT  0
+#define FF_STRF_ENCODE  3
+
+#define FF_CODE_PAGE    437
+#define FF_USE_LFN      0       // 文件名都是 8.3，不需要 ffunicode.c
+#define FF_MAX_LFN      255
+#define FF_LFN_UNICODE  0
+#define FF_LFN_BUF      255
+#define FF_SFN_BUF      12
+#define FF_FS_RPATH     0
+
+#define FF_VOLUMES      1
+#define FF_STR_VOLUME_ID 0
+#define FF_VOLUME_STRS  "RAM"
+#define FF_MULTI_PARTITION 0
+#define FF_MIN_SS       512
+#define FF_MAX_SS       512
+#define FF_LBA64        0
+#define FF_MIN_GPT      0x10000000
+#define FF_USE_TRIM     0
+
+#define FF_FS_TINY      0
+#define FF_FS_EXFAT     0
+#define FF_FS_NORTC     1
+#define FF_NORTC_MON    1
+#define FF_NORTC_MDAY   1
+#define FF_NORTC_YEAR   2024
+#define FF_FS_NOFSINFO  0
+#define FF_FS_LOCK      0
+#define FF_FS_REENTRANT 0
+#define FF_FS_TIMEOUT   1000
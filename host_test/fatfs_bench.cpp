@@ -0,0 +1,320 @@
+// host_test/fatfs_bench.cpp
+// user-041: 在 FAT 镜像上比较两条读取路径: 原来经 newlib stdio (128 字节缓冲) 到 FatFs，
+// 与 audio_source_fatfs 直接按簇读入对齐缓冲。FatFs 默认用 fatfs/ 下的主机实现，也可以指定本地源码；
+// 扇区读写落到镜像文件上并计数，每次 disk_read 对应设备上一条 SD 读命令
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <vector>
+
+#include "ff.h"
+#include "diskio.h"
+#include "esp_timer.h"
+#include "audio_source.h"
+
+#define SECTOR          512
+#define IMAGE_BYTES     (128u * 1024 * 1024)
+#define CLUSTER         16384       // SD 卡格式化时常见的簇大小
+#define FILE_BYTES      (4 * 1024 * 1024)
+#define STDIO_BUF       128         // newlib 默认的 FILE 缓冲
+#define DECODE_CHUNK    1940        // MAINBUF_SIZE，MP3 解码器每次补充的上限
+#define SEEKS           200
+
+static int s_img = -1;
+static uint32_t s_reads;
+static uint64_t s_read_sectors;
+
+/* ---------------- 镜像文件上的磁盘驱动 ---------------- */
+
+DSTATUS disk_status(BYTE pdrv)
+{
+    return (pdrv == 0 && s_img >= 0) ? 0 : STA_NOINIT;
+}
+
+DSTATUS disk_initialize(BYTE pdrv)
+{
+    return disk_status(pdrv);
+}
+
+DRESULT disk_read(BYTE pdrv, BYTE *buff, LBA_t sector, UINT count)
+{
+    (void)pdrv;
+    s_reads++;
+    s_read_sectors += count;
+    ssize_t n = pread(s_img, buff, (size_t)count * SECTOR, (off_t)sector * SECTOR);
+    return n == (ssize_t)count * SECTOR ? RES_OK : RES_ERROR;
+}
+
+DRESULT disk_write(BYTE pdrv, const BYTE *buff, LBA_t sector, UINT count)
+{
+    (void)pdrv;
+    ssize_t n = pwrite(s_img, buff, (size_t)count * SECTOR, (off_t)sector * SECTOR);
+    return n == (ssize_t)count * SECTOR ? RES_OK : RES_ERROR;
+}
+
+DRESULT disk_ioctl(BYTE pdrv, BYTE cmd, void *buff)
+{
+    (void)pdrv;
+    switch(cmd) {
+        case CTRL_SYNC:
+            return RES_OK;
+        case GET_SECTOR_COUNT:
+            *(LBA_t *)buff = IMAGE_BYTES / SECTOR;
+            return RES_OK;
+        case GET_SECTOR_SIZE:
+            *(WORD *)buff = SECTOR;
+            return RES_OK;
+        case GET_BLOCK_SIZE:
+            *(DWORD *)buff = 1;
+            return RES_OK;
+        default:
+            return RES_PARERR;
+    }
+}
+
+/* ---------------- 测试文件 ---------------- */
+
+// 第 id 个文件偏移 off 处的内容
+static uint8_t pattern(int id, uint32_t off)
+{
+    uint32_t x = (off / 4 + 1) * 2654435761u + (uint32_t)id * 40503u;
+    return (uint8_t)(x >> (8 * (off % 4)));
+}
+
+static void fill(uint8_t *buf, int id, uint32_t off, size_t len)
+{
+    for(size_t k = 0; k < len; k++) {
+        buf[k] = pattern(id, off + (uint32_t)k);
+    }
+}
+
+static const char *const names[] = { "0:/FRAG_A.BIN", "0:/FRAG_B.BIN", "0:/CONTIG.BIN" };
+
+static bool make_files(void)
+{
+    static uint8_t buf[CLUSTER];
+    FIL f[3];
+    UINT bw;
+
+    for(int id = 0; id < 3; id++) {
+        if(f_open(&f[id], names[id], FA_CREATE_ALWAYS | FA_WRITE) != FR_OK) {
+            return false;
+        }
+    }
+    // A 和 B 每次各写一个簇，两个文件的簇交替排列，每个簇都是一个碎片
+    for(uint32_t off = 0; off < FILE_BYTES; off += CLUSTER) {
+        for(int id = 0; id < 2; id++) {
+            fill(buf, id, off, CLUSTER);
+            if(f_write(&f[id], buf, CLUSTER, &bw) != FR_OK || bw != CLUSTER) {
+                return false;
+            }
+        }
+    }
+    // C 在 A、B 之后一次写完，簇连续
+    for(uint32_t off = 0; off < FILE_BYTES; off += CLUSTER) {
+        fill(buf, 2, off, CLUSTER);
+        if(f_write(&f[2], buf, CLUSTER, &bw) != FR_OK || bw != CLUSTER) {
+            return false;
+        }
+    }
+    for(int id = 0; id < 3; id++) {
+        f_close(&f[id]);
+    }
+    return true;
+}
+
+/* ---------------- 原来的路径: VFS 上的 FILE，newlib 128 字节缓冲 ---------------- */
+
+// 按 newlib 的行为建模: fread 每次用 f_read 补满 128 字节的缓冲再拷出，
+// 不会像 glibc 那样把大块请求直接交给底层；fseek 落在缓冲内时不读卡
+struct newlib_file {
+    FIL fil;
+    uint8_t buf[STDIO_BUF];
+    FSIZE_t buf_start;      // buf[0] 的文件偏移
+    UINT fill;
+    FSIZE_t pos;
+};
+
+static size_t newlib_read(void *ctx, void *dst, size_t len)
+{
+    newlib_file *f = (newlib_file *)ctx;
+    uint8_t *out = (uint8_t *)dst;
+    size_t done = 0;
+    while(done < len) {
+        if(f->pos < f->buf_start || f->pos >= f->buf_start + f->fill) {
+            if(f_tell(&f->fil) != f->pos && f_lseek(&f->fil, f->pos) != FR_OK) {
+                break;
+            }
+            f->buf_start = f->pos;
+            if(f_read(&f->fil, f->buf, STDIO_BUF, &f->fill) != FR_OK || f->fill == 0) {
+                f->fill = 0;
+                break;
+            }
+        }
+        size_t off = (size_t)(f->pos - f->buf_start);
+        size_t n = f->fill - off < len - done ? f->fill - off : len - done;
+        memcpy(out + done, f->buf + off, n);
+        done += n;
+        f->pos += n;
+    }
+    return done;
+}
+
+static int newlib_seek(void *ctx, long offset)
+{
+    ((newlib_file *)ctx)->pos = (FSIZE_t)offset;
+    return 0;
+}
+
+static long newlib_size(void *ctx)
+{
+    return (long)f_size(&((newlib_file *)ctx)->fil);
+}
+
+static void newlib_close(void *ctx)
+{
+    newlib_file *f = (newlib_file *)ctx;
+    f_close(&f->fil);
+    delete f;
+}
+
+static const audio_player_source_ops_t newlib_ops = { newlib_read, newlib_seek, newlib_size, newlib_close };
+
+enum { PATH_STDIO, PATH_FATFS, PATH_COUNT };
+static const char *const path_names[] = { "stdio 128 B", "fatfs direct" };
+
+static bool open_source(int path, const char *name, audio_source_t *src)
+{
+    if(path == PATH_FATFS) {
+        return audio_source_open_fatfs(src, name) == ESP_OK;
+    }
+    newlib_file *f = new newlib_file();
+    if(f_open(&f->fil, name, FA_READ) != FR_OK) {
+        delete f;
+        return false;
+    }
+    audio_player_source_t source = { &newlib_ops, f, NULL, 0 };
+    if(audio_source_from_user(src, &source) != ESP_OK) {
+        newlib_close(f);
+        return false;
+    }
+    return true;
+}
+
+struct result {
+    double ms;
+    uint32_t reads;
+    uint64_t sectors;
+};
+
+static bool check(const uint8_t *data, int id, uint32_t off, size_t len)
+{
+    for(size_t k = 0; k < len; k++) {
+        if(data[k] != pattern(id, off + (uint32_t)k)) {
+            fprintf(stderr, "%s: wrong byte at %u\n", names[id], (unsigned)(off + k));
+            return false;
+        }
+    }
+    return true;
+}
+
+// 按解码器的补充粒度从头读到尾
+static bool stream(int path, int id, std::vector<uint8_t> &data, result &r)
+{
+    audio_source_t src;
+    if(!open_source(path, names[id], &src)) {
+        return false;
+    }
+    s_reads = 0;
+    s_read_sectors = 0;
+    size_t done = 0;
+    int64_t t0 = esp_timer_get_time();
+    size_t n;
+    while(done < data.size() && (n = audio_source_read(&src, data.data() + done, DECODE_CHUNK)) > 0) {
+        done += n;
+    }
+    r.ms = (esp_timer_get_time() - t0) / 1000.0;
+    r.reads = s_reads;
+    r.sectors = s_read_sectors;
+    audio_source_close(&src);
+    return done == FILE_BYTES && check(data.data(), id, 0, FILE_BYTES);
+}
+
+// 随机跳转后读一块，对应拖动进度条和续播
+static bool seeks(int path, int id, result &r)
+{
+    static uint8_t buf[DECODE_CHUNK];
+    audio_source_t src;
+    if(!open_source(path, names[id], &src)) {
+        return false;
+    }
+    s_reads = 0;
+    s_read_sectors = 0;
+    uint32_t x = 12345;
+    bool ok = true;
+    int64_t t0 = esp_timer_get_time();
+    for(int k = 0; k < SEEKS && ok; k++) {
+        x = x * 1664525u + 1013904223u;
+        uint32_t off = x % (FILE_BYTES - DECODE_CHUNK);
+        ok = audio_source_seek(&src, (long)off, SEEK_SET) == 0 &&
+             audio_source_read(&src, buf, DECODE_CHUNK) == DECODE_CHUNK &&
+             check(buf, id, off, DECODE_CHUNK);
+    }
+    r.ms = (esp_timer_get_time() - t0) / 1000.0;
+    r.reads = s_reads;
+    r.sectors = s_read_sectors;
+    audio_source_close(&src);
+    return ok;
+}
+
+int main()
+{
+    static FATFS fs;
+    static BYTE work[FF_MAX_SS];
+    char image[] = "/tmp/fatfs_bench_XXXXXX";
+    int fail = 0;
+
+    s_img = mkstemp(image);
+    if(s_img < 0 || ftruncate(s_img, IMAGE_BYTES) != 0) {
+        perror("image");
+        return 1;
+    }
+    unlink(image);
+
+    MKFS_PARM opt = { FM_FAT, 1, 0, 0, CLUSTER };
+    if(f_mkfs("0:", &opt, work, sizeof(work)) != FR_OK || f_mount(&fs, "0:", 1) != FR_OK || !make_files()) {
+        fprintf(stderr, "cannot prepare the FAT image\n");
+        return 1;
+    }
+    printf("FAT image %u MB, cluster %u B, files of %u KB, read size %d\n",
+           IMAGE_BYTES >> 20, CLUSTER, FILE_BYTES >> 10, CONFIG_AUDIO_PLAYER_FATFS_READ_SIZE);
+
+    std::vector<uint8_t> data(FILE_BYTES);
+    for(int id = 0; id < 3; id++) {
+        result seq[PATH_COUNT];
+        result rnd[PATH_COUNT];
+        for(int path = 0; path < PATH_COUNT; path++) {
+            if(!stream(path, id, data, seq[path]) || !seeks(path, id, rnd[path])) {
+                fprintf(stderr, "%s via %s failed\n", names[id], path_names[path]);
+                return 1;
+            }
+            printf("  %s %-12s sequential %7.1f ms %6.1f MB/s %6u reads (%4.1f sectors each), "
+                   "%d seeks %6u reads %6.2f ms\n",
+                   names[id] + 3, path_names[path], seq[path].ms, FILE_BYTES / 1048.576 / seq[path].ms,
+                   (unsigned)seq[path].reads, (double)seq[path].sectors / seq[path].reads,
+                   SEEKS, (unsigned)rnd[path].reads, rnd[path].ms);
+        }
+        // 顺序读取时每条读命令应至少带一整簇 (碎片文件) 或一整个读取缓冲
+        if(seq[PATH_FATFS].reads * 4 > seq[PATH_STDIO].reads) {
+            fprintf(stderr, "%s: %u reads through FatFs vs %u through stdio\n", names[id],
+                    (unsigned)seq[PATH_FATFS].reads, (unsigned)seq[PATH_STDIO].reads);
+            fail = 1;
+        }
+    }
+
+    f_mount(NULL, "0:", 0);
+    close(s_img);
+    return fail;
+}
@@ -0,0 +1,397 @@
+// host_test/m4a_bench.cpp
+// user-029: 长 M4A 文件的启动耗时与内存: MP4 解复用只建每块 8 字节的块索引，
+// 与把 stsz/stco/stsc 整表读入内存相比。同时检查顺序读取和随机定位取到的每个 AAC 访问单元
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <vector>
+
+#include "esp_timer.h"
+#include "audio_m4a.h"
+
+#define SAMPLE_RATE     44100
+#define AU_FRAMES       1024        // 每个 AAC 访问单元的帧数
+#define CHUNK_SAMPLES   22          // 每块约 0.5 秒，与常见编码器一致
+#define SEEKS           1000
+
+/* ---------------- 合成的 M4A: moov 在前，mdat 的内容按偏移生成，不占内存 ---------------- */
+
+struct m4a_file {
+    std::vector<uint8_t> head;      // ftyp + moov + mdat 头
+    std::vector<uint32_t> offsets;  // 每个访问单元的文件偏移
+    std::vector<uint16_t> sizes;
+    long size;
+};
+
+static uint8_t content(long off)
+{
+    return (uint8_t)(((uint32_t)off * 2654435761u) >> 24);
+}
+
+static void put32(std::vector<uint8_t> &v, uint32_t x)
+{
+    v.push_back((uint8_t)(x >> 24));
+    v.push_back((uint8_t)(x >> 16));
+    v.push_back((uint8_t)(x >> 8));
+    v.push_back((uint8_t)x);
+}
+
+static void put16(std::vector<uint8_t> &v, uint16_t x)
+{
+    v.push_back((uint8_t)(x >> 8));
+    v.push_back((uint8_t)x);
+}
+
+static size_t box_begin(std::vector<uint8_t> &v, const char *type)
+{
+    size_t at = v.size();
+    put32(v, 0);
+    v.insert(v.end(), type, type + 4);
+    return at;
+}
+
+static void box_end(std::vector<uint8_t> &v, size_t at)
+{
+    uint32_t size = (uint32_t)(v.size() - at);
+    v[at] = (uint8_t)(size >> 24);
+    v[at + 1] = (uint8_t)(size >> 16);
+    v[at + 2] = (uint8_t)(size >> 8);
+    v[at + 3] = (uint8_t)size;
+}
+
+static void build_moov(std::vector<uint8_t> &v, const m4a_file &f, const std::vector<uint32_t> &chunk_offsets)
+{
+    uint32_t n = (uint32_t)f.sizes.size();
+    uint32_t chunks = (uint32_t)chunk_offsets.size();
+
+    size_t moov = box_begin(v, "moov");
+    size_t trak = box_begin(v, "trak");
+    size_t mdia = box_begin(v, "mdia");
+
+    size_t b = box_begin(v, "mdhd");
+    put32(v, 0);
+    put32(v, 0);
+    put32(v, 0);
+    put32(v, SAMPLE_RATE);
+    put32(v, n * AU_FRAMES);
+    put32(v, 0);
+    box_end(v, b);
+
+    b = box_begin(v, "hdlr");
+    put32(v, 0);
+    put32(v, 0);
+    v.insert(v.end(), { 's', 'o', 'u', 'n' });
+    for (int k = 0; k < 13; k++) {
+        v.push_back(0);
+    }
+    box_end(v, b);
+
+    size_t minf = box_begin(v, "minf");
+    size_t stbl = box_begin(v, "stbl");
+
+    size_t stsd = box_begin(v, "stsd");
+    put32(v, 0);
+    put32(v, 1);
+    size_t mp4a = box_begin(v, "mp4a");
+    for (int k = 0; k < 6; k++) {
+        v.push_back(0);
+    }
+    put16(v, 1);            // data_reference_index
+    put32(v, 0);            // version, revision
+    put32(v, 0);            // vendor
+    put16(v, 2);            // channels
+    put16(v, 16);
+    put32(v, 0);
+    put32(v, SAMPLE_RATE << 16);
+    size_t esds = box_begin(v, "esds");
+    put32(v, 0);
+    v.insert(v.end(), { 0x03, 25, 0, 1, 0 });                   // ES_Descriptor
+    v.insert(v.end(), { 0x04, 17, 0x40, 0x15, 0, 0x18, 0 });    // DecoderConfigDescriptor, MPEG-4 audio
+    put32(v, 128000);
+    put32(v, 128000);
+    v.insert(v.end(), { 0x05, 2, 0x12, 0x10 });                 // AAC-LC, 44100 Hz, 2 channels
+    v.insert(v.end(), { 0x06, 1, 0x02 });
+    box_end(v, esds);
+    box_end(v, mp4a);
+    box_end(v, stsd);
+
+    b = box_begin(v, "stts");
+    put32(v, 0);
+    put32(v, 1);
+    put32(v, n);
+    put32(v, AU_FRAMES);
+    box_end(v, b);
+
+    uint32_t last = n - (chunks - 1) * CHUNK_SAMPLES;
+    b = box_begin(v, "stsc");
+    put32(v, 0);
+    put32(v, last == CHUNK_SAMPLES ? 1 : 2);
+    put32(v, 1);
+    put32(v, CHUNK_SAMPLES);
+    put32(v, 1);
+    if (last != CHUNK_SAMPLES) {
+        put32(v, chunks);
+        put32(v, last);
+        put32(v, 1);
+    }
+    box_end(v, b);
+
+    b = box_begin(v, "stsz");
+    put32(v, 0);
+    put32(v, 0);
+    put32(v, n);
+    for (uint16_t s : f.sizes) {
+        put32(v, s);
+    }
+    box_end(v, b);
+
+    b = box_begin(v, "stco");
+    put32(v, 0);
+    put32(v, chunks);
+    for (uint32_t o : chunk_offsets) {
+        put32(v, o);
+    }
+    box_end(v, b);
+
+    box_end(v, stbl);
+    box_end(v, minf);
+    box_end(v, mdia);
+    box_end(v, trak);
+    box_end(v, moov);
+}
+
+static void make_file(m4a_file &f, uint32_t seconds)
+{
+    uint32_t n = (uint32_t)((uint64_t)seconds * SAMPLE_RATE / AU_FRAMES);
+    uint32_t chunks = (n + CHUNK_SAMPLES - 1) / CHUNK_SAMPLES;
+    uint32_t x = seconds;
+
+    f.sizes.resize(n);
+    for (uint32_t k = 0; k < n; k++) {
+        x = x * 1664525u + 1013904223u;
+        f.sizes[k] = (uint16_t)(250 + (x >> 16) % 200);    // 平均约 120 kbps
+    }
+
+    // 先用全零的块偏移得出 moov 的大小，块偏移的个数不变，第二遍填入真实值
+    std::vector<uint32_t> chunk_offsets(chunks);
+    std::vector<uint8_t> v;
+    size_t ftyp = box_begin(v, "ftyp");
+    v.insert(v.end(), { 'M', '4', 'A', ' ' });
+    put32(v, 0);
+    box_end(v, ftyp);
+    size_t ftyp_end = v.size();
+    build_moov(v, f, chunk_offsets);
+    uint32_t data = (uint32_t)v.size() + 8;
+
+    f.offsets.resize(n);
+    uint32_t off = data;
+    for (uint32_t k = 0; k < n; k++) {
+        if (k % CHUNK_SAMPLES == 0) {
+            chunk_offsets[k / CHUNK_SAMPLES] = off;
+        }
+        f.offsets[k] = off;
+        off += f.sizes[k];
+    }
+    v.resize(ftyp_end);
+    build_moov(v, f, chunk_offsets);
+    put32(v, off - data + 8);
+    v.insert(v.end(), { 'm', 'd', 'a', 't' });
+    f.head = v;
+    f.size = off;
+}
+
+/* ---------------- 回调源: 统计读取次数和字节数 ---------------- */
+
+struct file_ctx {
+    const m4a_file *f;
+    long pos;
+    uint32_t reads;
+    uint64_t bytes;
+};
+
+static size_t cb_read(void *ctx, void *buf, size_t len)
+{
+    file_ctx *c = (file_ctx *)ctx;
+    uint8_t *out = (uint8_t *)buf;
+    size_t n = c->pos < c->f->size ? (size_t)(c->f->size - c->pos) : 0;
+    if (n > len) {
+        n = len;
+    }
+    for (size_t k = 0; k < n; k++) {
+        long off = c->pos + (long)k;
+        out[k] = off < (long)c->f->head.size() ? c->f->head[off] : content(off);
+    }
+    c->pos += (long)n;
+    c->reads++;
+    c->bytes += n;
+    return n;
+}
+
+static int cb_seek(void *ctx, long offset)
+{
+    ((file_ctx *)ctx)->pos = offset;
+    return 0;
+}
+
+static long cb_size(void *ctx)
+{
+    return ((file_ctx *)ctx)->f->size;
+}
+
+static const audio_player_source_ops_t cb_ops = { cb_read, cb_seek, cb_size, NULL };
+
+/* ---------------- 对照: 整表读入内存，每个访问单元一个偏移 ---------------- */
+
+static uint32_t be32(const uint8_t *p)
+{
+    return ((uint32_t)p[0] << 24) | ((uint32_t)p[1] << 16) | ((uint32_t)p[2] << 8) | p[3];
+}
+
+// 合成文件的表紧挨着排列，直接按 FOURCC 找到位置后整表读入
+static size_t load_full_tables(audio_source_t *src, const m4a_file &f, std::vector<uint32_t> &offsets)
+{
+    const std::vector<uint8_t> &h = f.head;
+    long stsz = -1;
+    long stco = -1;
+    for (size_t k = 4; k + 4 <= h.size(); k++) {
+        if (memcmp(&h[k], "stsz", 4) == 0) stsz = (long)k + 4;
+        if (memcmp(&h[k], "stco", 4) == 0) stco = (long)k + 4;
+    }
+    uint32_t n = be32(&h[stsz + 8]);
+    uint32_t chunks = be32(&h[stco + 4]);
+    std::vector<uint8_t> sizes((size_t)n * 4);
+    std::vector<uint8_t> chunk_offsets((size_t)chunks * 4);
+    audio_source_seek(src, stsz + 12, SEEK_SET);
+    audio_source_read(src, sizes.data(), sizes.size());
+    audio_source_seek(src, stco + 8, SEEK_SET);
+    audio_source_read(src, chunk_offsets.data(), chunk_offsets.size());
+
+    offsets.resize(n);
+    uint32_t off = 0;
+    for (uint32_t k = 0; k < n; k++) {
+        if (k % CHUNK_SAMPLES == 0) {
+            off = be32(&chunk_offsets[k / CHUNK_SAMPLES * 4]);
+        }
+        offsets[k] = off;
+        off += be32(&sizes[k * 4]);
+    }
+    return sizes.size() + chunk_offsets.size() + offsets.size() * sizeof(uint32_t);
+}
+
+/* ---------------- 检查 ---------------- */
+
+static bool check_sample(const m4a_file &f, uint32_t k, const uint8_t *data, uint32_t size)
+{
+    if (size != f.sizes[k]) {
+        fprintf(stderr, "sample %u: %u bytes, expected %u\n", (unsigned)k, (unsigned)size, (unsigned)f.sizes[k]);
+        return false;
+    }
+    for (uint32_t b = 0; b < size; b++) {
+        if (data[b] != content((long)f.offsets[k] + b)) {
+            fprintf(stderr, "sample %u: wrong byte %u\n", (unsigned)k, (unsigned)b);
+            return false;
+        }
+    }
+    return true;
+}
+
+static int run(uint32_t seconds)
+{
+    m4a_file f;
+    make_file(f, seconds);
+    uint32_t n = (uint32_t)f.sizes.size();
+
+    file_ctx ctx = { &f, 0, 0, 0 };
+    audio_player_source_t user = { &cb_ops, &ctx, NULL, 0 };
+    audio_source_t src;
+    audio_source_from_user(&src, &user);
+
+    m4a_instance m;
+    memset(&m, 0, sizeof(m));
+    int64_t t0 = esp_timer_get_time();
+    if (!is_m4a(&src, &m)) {
+        fprintf(stderr, "%u s: not recognised as m4a\n", (unsigned)seconds);
+        return 1;
+    }
+    double start_ms = (esp_timer_get_time() - t0) / 1000.0;
+    uint32_t start_reads = ctx.reads;
+    uint64_t start_bytes = ctx.bytes;
+    size_t index_bytes = m.chunk_count * sizeof(m4a_chunk) + 2 * M4A_TABLE_WINDOW * 12 + M4A_MAX_SAMPLE_SIZE;
+
+    // 对照的整表读入
+    ctx.reads = 0;
+    ctx.bytes = 0;
+    std::vector<uint32_t> full_offsets;
+    t0 = esp_timer_get_time();
+    size_t full_bytes = load_full_tables(&src, f, full_offsets);
+    double full_ms = (esp_timer_get_time() - t0) / 1000.0;
+    uint64_t full_read = ctx.bytes;
+
+    printf("%3u min, %6u AUs, %5u chunks, %6.1f MB file\n", (unsigned)seconds / 60, (unsigned)n,
+           (unsigned)m.chunk_count, f.size / 1048576.0);
+    printf("    chunk index: start %6.2f ms, %4u reads, %7llu bytes read, %6zu bytes RAM\n",
+           start_ms, (unsigned)start_reads, (unsigned long long)start_bytes, index_bytes);
+    printf("    full tables: start %6.2f ms,              %7llu bytes read, %6zu bytes RAM\n",
+           full_ms, (unsigned long long)full_read, full_bytes);
+
+    int fail = 0;
+    if (full_offsets != f.offsets) {
+        fprintf(stderr, "full table reference is wrong\n");
+        fail = 1;
+    }
+    if (index_bytes * 4 > full_bytes && seconds >= 3600) {
+        fprintf(stderr, "index uses %zu of %zu bytes\n", index_bytes, full_bytes);
+        fail = 1;
+    }
+
+    // 顺序读出所有访问单元
+    const uint8_t *data;
+    uint32_t size;
+    uint32_t k = 0;
+    ctx.reads = 0;
+    t0 = esp_timer_get_time();
+    while (!fail && m4a_next_sample(&src, &m, &data, &size) == DECODE_STATUS_CONTINUE) {
+        if (k >= n || !check_sample(f, k, data, size)) {
+            fail = 1;
+        }
+        k++;
+    }
+    double seq_ms = (esp_timer_get_time() - t0) / 1000.0;
+    if (!fail && k != n) {
+        fprintf(stderr, "%u of %u samples demuxed\n", (unsigned)k, (unsigned)n);
+        fail = 1;
+    }
+    printf("    sequential: %u AUs in %.1f ms, %.2f us each\n", (unsigned)k, seq_ms, seq_ms * 1000 / (k ? k : 1));
+
+    // 随机定位，下一个访问单元应是目标时间所在的那一个
+    uint32_t x = seconds;
+    ctx.reads = 0;
+    ctx.bytes = 0;
+    t0 = esp_timer_get_time();
+    for (int s = 0; s < SEEKS && !fail; s++) {
+        x = x * 1664525u + 1013904223u;
+        uint32_t ms = (uint32_t)((uint64_t)x * (seconds * 1000u - 100) >> 32);
+        uint32_t want = (uint32_t)((uint64_t)ms * SAMPLE_RATE / 1000 / AU_FRAMES);
+        if (!seek_m4a(&src, &m, ms) || m4a_next_sample(&src, &m, &data, &size) != DECODE_STATUS_CONTINUE ||
+            !check_sample(f, want, data, size)) {
+            fprintf(stderr, "seek to %u ms failed\n", (unsigned)ms);
+            fail = 1;
+        }
+    }
+    double seek_us = (esp_timer_get_time() - t0) / (double)SEEKS;
+    printf("    %d seeks: %.2f us, %.1f reads, %.0f bytes read each\n", SEEKS, seek_us,
+           (double)ctx.reads / SEEKS, (double)ctx.bytes / SEEKS);
+
+    m4a_instance_free(&m);
+    return fail;
+}
+
+int main()
+{
+    static const uint32_t lengths[] = { 10 * 60, 60 * 60, 3 * 60 * 60 };
+    int fail = 0;
+    for (uint32_t seconds : lengths) {
+        fail |= run(seconds);
+    }
+    return fail;
+}
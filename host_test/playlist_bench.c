@@ -0,0 +1,91 @@
+// host_test/playlist_bench.c
+// user-032: 10k/50k/100k 个合成路径时播放列表的内存占用与构建耗时
+#include <stdio.h>
+#include <string.h>
+
+#include "esp_timer.h"
+#include "playlist.h"
+
+#define LOOKUPS         1000000
+#define OLD_ENTRY_BYTES (256 + 8 + sizeof(char *))  // 原方案: 每条 malloc(256) 加堆头和指针表
+
+static int make_path(char *buf, size_t len, uint32_t i)
+{
+    return snprintf(buf, len, "/sdcard/Artist %03u/Album %02u/%02u Some Track Title.mp3",
+                    (unsigned)(i / 100), (unsigned)((i / 10) % 10), (unsigned)(i % 10));
+}
+
+static int run(uint32_t n)
+{
+    playlist_t pl;
+    char path[128];
+    size_t raw = 0;
+
+    playlist_init(&pl);
+    int64_t t0 = esp_timer_get_time();
+    for (uint32_t i = 0; i < n; i++) {
+        raw += (size_t)make_path(path, sizeof(path), i);
+        if (playlist_add(&pl, path) != ESP_OK) {
+            fprintf(stderr, "%u: playlist_add failed at %u\n", (unsigned)n, (unsigned)i);
+            return 1;
+        }
+    }
+    int64_t t1 = esp_timer_get_time();
+
+    for (uint32_t i = 0; i < n; i++) {
+        make_path(path, sizeof(path), i);
+        const char *got = playlist_get(&pl, i);
+        if (got == NULL || strcmp(got, path) != 0) {
+            fprintf(stderr, "%u: entry %u is wrong\n", (unsigned)n, (unsigned)i);
+            return 1;
+        }
+    }
+
+    // 乱序访问，对应浏览列表时的随机跳转
+    uint32_t x = 12345;
+    size_t sum = 0;
+    int64_t t2 = esp_timer_get_time();
+    for (int k = 0; k < LOOKUPS; k++) {
+        x = x * 1664525u + 1013904223u;
+        sum += (size_t)playlist_get(&pl, x % n)[8];
+    }
+    int64_t t3 = esp_timer_get_time();
+    if (sum == 0) {     // 防止查找循环被优化掉
+        playlist_free(&pl);
+        return 1;
+    }
+
+    size_t used = pl.pool_size + (size_t)pl.count * sizeof(uint32_t);
+    size_t mem = playlist_memory_usage(&pl);
+    double overhead = (double)(used - raw) / n;
+    printf("%6u entries: build %6.2f ms, get %4.1f ns, memory %8zu bytes (%5.1f B/entry, "
+           "%.1f B/entry over the path, %4.1f %% slack), old scheme %9zu bytes\n",
+           (unsigned)n, (t1 - t0) / 1000.0, (double)(t3 - t2) * 1000.0 / LOOKUPS,
+           mem, (double)mem / n, overhead, 100.0 * (double)(mem - used) / used,
+           (size_t)n * OLD_ENTRY_BYTES);
+
+    int fail = 0;
+    // 4 字节偏移加 1 字节结束符
+    if (overhead > sizeof(uint32_t) + 1) {
+        fprintf(stderr, "%u: %.1f bytes per entry over the path\n", (unsigned)n, overhead);
+        fail = 1;
+    }
+    // 1.5 倍扩容，空闲尾部不会超过已用的一半
+    if (mem > used + used / 2 + 8192) {
+        fprintf(stderr, "%u: %zu bytes allocated for %zu used\n", (unsigned)n, mem, used);
+        fail = 1;
+    }
+    playlist_free(&pl);
+    return fail;
+}
+
+int main(void)
+{
+    static const uint32_t sizes[] = { 10000, 50000, 100000 };
+    int fail = 0;
+
+    for (size_t i = 0; i < sizeof(sizes) / sizeof(sizes[0]); i++) {
+        fail |= run(sizes[i]);
+    }
+    return fail;
+}
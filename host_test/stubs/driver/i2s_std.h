@@ -0,0 +1,9 @@
+// host_test/stubs/driver/i2s_std.h
+#pragma once
+#include "esp_err.h"
+
+typedef void *i2s_chan_handle_t;
+typedef enum {
+    I2S_SLOT_MODE_MONO = 1,
+    I2S_SLOT_MODE_STEREO = 2,
+} i2s_slot_mode_t;
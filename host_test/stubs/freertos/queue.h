@@ -0,0 +1,5 @@
+// host_test/stubs/freertos/queue.h
+#pragma once
+#include "FreeRTOS.h"
+
+// 只提供类型，基准中不启用用到队列的功能 (如 FatFs 链接表任务)
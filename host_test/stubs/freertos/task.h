@@ -0,0 +1,14 @@
+// host_test/stubs/freertos/task.h
+#pragma once
+#include "FreeRTOS.h"
+
+#define taskENTER_CRITICAL(mux) vPortEnterCritical(mux)
+#define taskEXIT_CRITICAL(mux)  vPortExitCritical(mux)
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+void vTaskDelay(TickType_t ticks);
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,13 @@
+// host_test/stubs/helix_host.h
+// libhelix 的 assembly.h 只支持 ARM / Xtensa / RISC-V，主机编译时用 -include 预先提供通用 C 实现
+#pragma once
+#define _ASSEMBLY_H
+
+typedef long long Word64;
+
+static inline int MULSHIFT32(int x, int y) { return (int)(((long long)x * y) >> 32); }
+static inline int FASTABS(int x) { return x < 0 ? -x : x; }
+static inline int CLZ(int x) { return x ? __builtin_clz((unsigned)x) : 32; }
+static inline Word64 MADD64(Word64 sum, int x, int y) { return sum + (long long)x * y; }
+static inline Word64 SHL64(Word64 x, int n) { return x << n; }
+static inline Word64 SAR64(Word64 x, int n) { return x >> n; }
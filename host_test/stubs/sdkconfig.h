@@ -0,0 +1,8 @@
+// host_test/stubs/sdkconfig.h
+#pragma once
+// 与工程 sdkconfig 中音频播放器相关的选项保持一致
+#define CONFIG_AUDIO_PLAYER_ENABLE_MP3 1
+#define CONFIG_AUDIO_PLAYER_ENABLE_WAV 1
+#define CONFIG_AUDIO_PLAYER_ENABLE_FLAC 1
+#define CONFIG_AUDIO_PLAYER_ENABLE_SPECTRUM 1
+#define CONFIG_AUDIO_PLAYER_LOG_LEVEL 0
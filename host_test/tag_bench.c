@@ -0,0 +1,411 @@
+// host_test/tag_bench.c
+// user-034: 标签解析的吞吐量，以及解析结果写入 struct-of-arrays 元数据缓存的开销
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/stat.h>
+
+#include "esp_timer.h"
+#include "media_tags.h"
+#include "media_meta.h"
+
+#define AUDIO_BYTES     200000
+#define APIC_BYTES      300000
+#define APE_COVER_BYTES 50000
+#define REPEAT          5000
+#define META_TRACKS     20000
+#define META_ARTISTS    200
+#define META_ALBUMS     1000
+
+typedef struct {
+    uint8_t *data;
+    size_t len;
+    size_t cap;
+} buf_t;
+
+static void put(buf_t *b, const void *p, size_t n)
+{
+    if (b->len + n > b->cap) {
+        b->cap = (b->len + n) * 2;
+        b->data = realloc(b->data, b->cap);
+    }
+    memcpy(b->data + b->len, p, n);
+    b->len += n;
+}
+
+static void put_byte(buf_t *b, uint8_t v)
+{
+    put(b, &v, 1);
+}
+
+static void put_be32(buf_t *b, uint32_t v)
+{
+    uint8_t p[4] = { (uint8_t)(v >> 24), (uint8_t)(v >> 16), (uint8_t)(v >> 8), (uint8_t)v };
+    put(b, p, 4);
+}
+
+static void put_le32(buf_t *b, uint32_t v)
+{
+    uint8_t p[4] = { (uint8_t)v, (uint8_t)(v >> 8), (uint8_t)(v >> 16), (uint8_t)(v >> 24) };
+    put(b, p, 4);
+}
+
+static void put_syncsafe(buf_t *b, uint32_t v)
+{
+    uint8_t p[4] = { (v >> 21) & 0x7F, (v >> 14) & 0x7F, (v >> 7) & 0x7F, v & 0x7F };
+    put(b, p, 4);
+}
+
+static void put_noise(buf_t *b, size_t n, uint32_t seed)
+{
+    for (size_t i = 0; i < n; i++) {
+        seed = seed * 1664525u + 1013904223u;
+        put_byte(b, (uint8_t)(seed >> 24));
+    }
+}
+
+// ID3v2 文本帧: 编码字节 + 内容，v2.3 的帧长是普通整数，v2.4 是 syncsafe
+static void put_id3_frame(buf_t *b, int version, const char *id, uint8_t enc, const void *text, size_t len)
+{
+    put(b, id, 4);
+    if (version == 3) {
+        put_be32(b, (uint32_t)len + 1);
+    } else {
+        put_syncsafe(b, (uint32_t)len + 1);
+    }
+    put_byte(b, 0);
+    put_byte(b, 0);
+    put_byte(b, enc);
+    put(b, text, len);
+}
+
+// ASCII 文本转成带 BOM 的 UTF-16LE
+static size_t utf16(const char *s, uint8_t *out)
+{
+    size_t n = 0;
+    out[n++] = 0xFF;
+    out[n++] = 0xFE;
+    while (*s) {
+        out[n++] = (uint8_t)*s++;
+        out[n++] = 0;
+    }
+    return n;
+}
+
+static void id3v2_header(buf_t *b, int version, uint32_t size)
+{
+    put(b, "ID3", 3);
+    put_byte(b, (uint8_t)version);
+    put_byte(b, 0);
+    put_byte(b, 0);
+    put_syncsafe(b, size);
+}
+
+// v2.3，UTF-16 文本，300 KB 的封面帧排在中间，后面还有填充
+static void make_id3v23(buf_t *out)
+{
+    buf_t f = { 0 };
+    uint8_t u16[64];
+    static const uint8_t apic_head[] = "\0image/jpeg\0\x03";
+
+    put_id3_frame(&f, 3, "TIT2", 1, u16, utf16("Title One", u16));
+    put_id3_frame(&f, 3, "TPE1", 1, u16, utf16("Artist A", u16));
+    put(&f, "APIC", 4);
+    put_be32(&f, (uint32_t)(sizeof(apic_head) + APIC_BYTES));
+    put_byte(&f, 0);
+    put_byte(&f, 0);
+    put(&f, apic_head, sizeof(apic_head));
+    put_noise(&f, APIC_BYTES, 1);
+    put_id3_frame(&f, 3, "TALB", 0, "Album \xe9", 7);
+    put_id3_frame(&f, 3, "TRCK", 0, "3/12", 4);
+    put_id3_frame(&f, 3, "TLEN", 0, "123456", 6);
+
+    id3v2_header(out, 3, (uint32_t)f.len + 100);
+    put(out, f.data, f.len);
+    for (int i = 0; i < 100; i++) {
+        put_byte(out, 0);
+    }
+    put_noise(out, AUDIO_BYTES, 2);
+    free(f.data);
+}
+
+// v2.4，UTF-8，只有几个短文本帧
+static void make_id3v24(buf_t *out)
+{
+    buf_t f = { 0 };
+
+    put_id3_frame(&f, 4, "TIT2", 3, "Song 2", 6);
+    put_id3_frame(&f, 4, "TPE1", 3, "Artist B", 8);
+    put_id3_frame(&f, 4, "TRCK", 3, "7", 1);
+    id3v2_header(out, 4, (uint32_t)f.len);
+    put(out, f.data, f.len);
+    put_noise(out, AUDIO_BYTES, 3);
+    free(f.data);
+}
+
+static void put_ape_item(buf_t *b, const char *key, const void *value, uint32_t len, uint32_t flags)
+{
+    put_le32(b, len);
+    put_le32(b, flags);
+    put(b, key, strlen(key) + 1);
+    put(b, value, len);
+}
+
+static void put_v1_field(buf_t *b, const char *s, size_t width)
+{
+    size_t n = strlen(s);
+    put(b, s, n);
+    for (; n < width; n++) {
+        put_byte(b, 0);
+    }
+}
+
+// 文件末尾的 APEv2 (带二进制封面) 加 ID3v1.1
+static void make_ape_id3v1(buf_t *out)
+{
+    buf_t items = { 0 };
+    buf_t cover = { 0 };
+
+    put_noise(out, AUDIO_BYTES, 4);
+    put_noise(&cover, APE_COVER_BYTES, 5);
+    put_ape_item(&items, "Cover Art (Front)", cover.data, (uint32_t)cover.len, 2);
+    put_ape_item(&items, "title", "Ape Title", 9, 0);
+    put_ape_item(&items, "Artist", "Ape Artist", 10, 0);
+    put(out, items.data, items.len);
+    put(out, "APETAGEX", 8);
+    put_le32(out, 2000);
+    put_le32(out, (uint32_t)items.len + 32);
+    put_le32(out, 3);
+    put_le32(out, 0);
+    put_le32(out, 0);
+    put_le32(out, 0);
+
+    put(out, "TAG", 3);
+    put_v1_field(out, "V1 Title", 30);
+    put_v1_field(out, "V1 Artist", 30);
+    put_v1_field(out, "V1 Album", 30);
+    put(out, "2001", 4);
+    put_v1_field(out, "", 28);
+    put_byte(out, 0);
+    put_byte(out, 5);       // ID3v1.1 音轨号
+    put_byte(out, 12);
+    free(items.data);
+    free(cover.data);
+}
+
+static void make_untagged(buf_t *out)
+{
+    put_noise(out, AUDIO_BYTES, 6);
+}
+
+typedef struct {
+    const char *name;
+    void (*make)(buf_t *out);
+    esp_err_t ret;
+    uint8_t sources;
+    const char *title;
+    const char *artist;
+    const char *album;
+    uint16_t track_no;
+    uint32_t duration_ms;
+} tag_case_t;
+
+static const tag_case_t cases[] = {
+    { "id3v23_apic.mp3", make_id3v23, ESP_OK, MEDIA_TAGS_F_ID3V2,
+      "Title One", "Artist A", "Album \xc3\xa9", 3, 123456 },
+    { "id3v24.mp3", make_id3v24, ESP_OK, MEDIA_TAGS_F_ID3V2,
+      "Song 2", "Artist B", "", 7, 0 },
+    { "ape_id3v1.mp3", make_ape_id3v1, ESP_OK, MEDIA_TAGS_F_APE | MEDIA_TAGS_F_ID3V1,
+      "Ape Title", "Ape Artist", "V1 Album", 5, 0 },
+    { "untagged.mp3", make_untagged, ESP_ERR_NOT_FOUND, 0,
+      "", "", "", 0, 0 },
+};
+
+#define CASE_COUNT (sizeof(cases) / sizeof(cases[0]))
+
+static bool check(const tag_case_t *c, esp_err_t ret, const media_tags_t *t)
+{
+    if (ret != c->ret || t->sources != c->sources || strcmp(t->title, c->title) != 0 ||
+            strcmp(t->artist, c->artist) != 0 || strcmp(t->album, c->album) != 0 ||
+            t->track_no != c->track_no || t->duration_ms != c->duration_ms) {
+        fprintf(stderr, "%s: ret %d sources %x title [%s] artist [%s] album [%s] track %u len %u\n",
+                c->name, ret, t->sources, t->title, t->artist, t->album,
+                (unsigned)t->track_no, (unsigned)t->duration_ms);
+        return false;
+    }
+    return true;
+}
+
+// 元数据缓存: 2 万首曲目，艺术家和专辑名大量重复
+static int bench_meta(void)
+{
+    media_tags_t tags;
+
+    if (media_meta_init() != ESP_OK || media_meta_reset(META_TRACKS) != ESP_OK) {
+        fprintf(stderr, "media_meta init failed\n");
+        return 1;
+    }
+    int64_t t0 = esp_timer_get_time();
+    for (uint32_t i = 0; i < META_TRACKS; i++) {
+        memset(&tags, 0, sizeof(tags));
+        snprintf(tags.title, sizeof(tags.title), "Track title number %u", (unsigned)i);
+        snprintf(tags.artist, sizeof(tags.artist), "Artist %u", (unsigned)(i % META_ARTISTS));
+        snprintf(tags.album, sizeof(tags.album), "Album %u", (unsigned)(i % META_ALBUMS));
+        tags.track_no = (uint16_t)(i % 20 + 1);
+        tags.sources = MEDIA_TAGS_F_ID3V2;
+        if (media_meta_set(i, &tags) != ESP_OK) {
+            fprintf(stderr, "media_meta_set failed at %u\n", (unsigned)i);
+            return 1;
+        }
+    }
+    int64_t t1 = esp_timer_get_time();
+
+    const media_meta_t *m = media_meta_lock();
+    uint32_t strings = m->string_count;
+    bool ok = strcmp(media_meta_string(m, m->artist[META_ARTISTS + 7]), "Artist 7") == 0 &&
+              m->artist[7] == m->artist[META_ARTISTS + 7];
+    media_meta_unlock();
+
+    printf("meta cache: %u tracks in %.2f ms (%.0f ns/track), %u interned strings, %zu bytes\n",
+           (unsigned)META_TRACKS, (t1 - t0) / 1000.0, (double)(t1 - t0) * 1000.0 / META_TRACKS,
+           (unsigned)strings, media_meta_memory_usage());
+    // 空串 + 艺术家 + 专辑
+    if (!ok || strings != 1 + META_ARTISTS + META_ALBUMS) {
+        fprintf(stderr, "interning failed: %u strings\n", (unsigned)strings);
+        return 1;
+    }
+    return 0;
+}
+
+// 元数据缓存文件的保存/加载，以及曲库变化后按新序号重排 (接在 bench_meta 之后)
+static int bench_meta_file(const char *dir)
+{
+    const uint32_t key = 0x1234ABCD;
+    const uint32_t probe = 12345;
+    char path[96];
+    char before[160];
+    char after[160];
+    struct stat st;
+
+    snprintf(path, sizeof(path), "%s/library.meta", dir);
+    media_meta_set_stream(probe, 215000, 320, 44100);
+    media_meta_display_name(probe, before, sizeof(before));
+
+    int64_t t0 = esp_timer_get_time();
+    if (media_meta_save(path, key) != ESP_OK || stat(path, &st) != 0) {
+        fprintf(stderr, "media_meta_save failed\n");
+        return 1;
+    }
+    int64_t t1 = esp_timer_get_time();
+    media_meta_reset(0);
+    if (media_meta_load(path, key + 1, META_TRACKS) != ESP_ERR_INVALID_STATE) {
+        fprintf(stderr, "cache with a stale key was accepted\n");
+        return 1;
+    }
+    int64_t t2 = esp_timer_get_time();
+    if (media_meta_load(path, key, META_TRACKS) != ESP_OK) {
+        fprintf(stderr, "media_meta_load failed\n");
+        return 1;
+    }
+    int64_t t3 = esp_timer_get_time();
+
+    uint32_t duration;
+    uint16_t kbps;
+    uint32_t rate;
+    media_meta_display_name(probe, after, sizeof(after));
+    if (strcmp(before, after) != 0 || !media_meta_tags_read(probe) ||
+        !media_meta_get_stream(probe, &duration, &kbps, &rate) || duration != 215000 || kbps != 320) {
+        fprintf(stderr, "reloaded cache differs: [%s] vs [%s]\n", before, after);
+        return 1;
+    }
+    printf("meta file: %ld bytes, save %.2f ms, load %.2f ms\n",
+           (long)st.st_size, (t1 - t0) / 1000.0, (t3 - t2) / 1000.0);
+
+    // 删掉每第 10 首，末尾新增 100 首：沿用的曲目保留标签，新增的需要读取
+    uint32_t kept = META_TRACKS - META_TRACKS / 10;
+    uint32_t count = kept + 100;
+    uint32_t *from = malloc(count * sizeof(uint32_t));
+    uint32_t n = 0;
+    for (uint32_t i = 0; i < META_TRACKS; i++) {
+        if (i % 10 != 0) {
+            from[n++] = i;
+        }
+    }
+    while (n < count) {
+        from[n++] = MEDIA_META_NO_ENTRY;
+    }
+    uint32_t moved = probe - probe / 10 - 1;
+    t0 = esp_timer_get_time();
+    esp_err_t ret = media_meta_remap(count, from);
+    t1 = esp_timer_get_time();
+    free(from);
+    media_meta_display_name(moved, after, sizeof(after));
+    if (ret != ESP_OK || strcmp(before, after) != 0 || media_meta_tags_read(kept) ||
+        media_meta_display_name(kept, after, sizeof(after)) != -1 || media_meta_count() != count) {
+        fprintf(stderr, "remap failed: [%s] vs [%s]\n", before, after);
+        return 1;
+    }
+    printf("meta remap: %u -> %u tracks (%u to read) in %.2f ms\n",
+           (unsigned)META_TRACKS, (unsigned)count, (unsigned)(count - kept), (t1 - t0) / 1000.0);
+    unlink(path);
+    return 0;
+}
+
+int main(void)
+{
+    char dir[] = "/tmp/tag_bench_XXXXXX";
+    char paths[CASE_COUNT][64];
+    int fail = 0;
+
+    if (mkdtemp(dir) == NULL) {
+        perror("mkdtemp");
+        return 2;
+    }
+    for (size_t i = 0; i < CASE_COUNT; i++) {
+        buf_t b = { 0 };
+        cases[i].make(&b);
+        snprintf(paths[i], sizeof(paths[i]), "%s/%s", dir, cases[i].name);
+        FILE *fp = fopen(paths[i], "wb");
+        if (fp == NULL || fwrite(b.data, 1, b.len, fp) != b.len) {
+            perror(paths[i]);
+            return 2;
+        }
+        fclose(fp);
+        free(b.data);
+    }
+
+    media_tags_t t;
+    for (size_t i = 0; i < CASE_COUNT; i++) {
+        memset(&t, 0xA5, sizeof(t));
+        esp_err_t ret = media_tags_read_file(paths[i], &t);
+        if (!check(&cases[i], ret, &t)) {
+            fail = 1;
+        }
+    }
+
+    // 文件在页缓存里，这里测的是解析本身的开销，卡上读取的时间另算
+    printf("tag parse, per file (open + parse + close, average of %d):\n", REPEAT);
+    double total = 0;
+    for (size_t i = 0; i < CASE_COUNT; i++) {
+        int64_t t0 = esp_timer_get_time();
+        for (int r = 0; r < REPEAT; r++) {
+            media_tags_read_file(paths[i], &t);
+        }
+        double us = (double)(esp_timer_get_time() - t0) / REPEAT;
+        total += us;
+        printf("  %-16s %6.1f us\n", cases[i].name, us);
+    }
+    printf("  mixed            %6.1f us (%.0f files/s)\n", total / CASE_COUNT, CASE_COUNT * 1e6 / total);
+
+    fail |= bench_meta();
+    if (!fail) {
+        fail |= bench_meta_file(dir);
+    }
+
+    for (size_t i = 0; i < CASE_COUNT; i++) {
+        unlink(paths[i]);
+    }
+    rmdir(dir);
+    return fail;
+}
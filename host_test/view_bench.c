@@ -0,0 +1,199 @@
+// host_test/view_bench.c
+// user-035: 2 万首曲目时排序视图的建立与增量搜索耗时，以及建立期间曲库锁的最长持有时间
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+
+#include "freertos/FreeRTOS.h"
+#include "freertos/semphr.h"
+#include "esp_timer.h"
+#include "media_library.h"
+#include "media_meta.h"
+#include "media_views.h"
+
+#define TRACKS          20000
+#define DIRS            500
+#define SEARCH_ROUNDS   20000
+#define FRAME_US        16667   // 60 fps 的一帧
+
+/* ---------------- 曲库: 只实现视图用到的读取接口 ---------------- */
+
+static media_dir_t s_dirs[DIRS];
+static media_track_t s_tracks[TRACKS];
+static char s_pool[2 * 1024 * 1024];
+static uint32_t s_pool_size = 1;    // 偏移 0 为空串
+static SemaphoreHandle_t s_lib_lock;
+static int64_t s_lock_at;
+static int64_t s_lock_max_us;   // 最长一次持锁，界面取曲目名称最多要等这么久
+
+static uint32_t pool_add(const char *s)
+{
+    uint32_t off = s_pool_size;
+    strcpy(s_pool + off, s);
+    s_pool_size += (uint32_t)strlen(s) + 1;
+    return off;
+}
+
+void media_library_lock(media_library_view_t *view)
+{
+    xSemaphoreTake(s_lib_lock, portMAX_DELAY);
+    s_lock_at = esp_timer_get_time();
+    view->dirs = s_dirs;
+    view->dir_count = DIRS;
+    view->tracks = s_tracks;
+    view->track_count = TRACKS;
+    view->pool = s_pool;
+    view->pool_size = s_pool_size;
+}
+
+void media_library_unlock(void)
+{
+    int64_t held = esp_timer_get_time() - s_lock_at;
+    if (held > s_lock_max_us) {
+        s_lock_max_us = held;
+    }
+    xSemaphoreGive(s_lib_lock);
+}
+
+uint32_t media_library_track_count(void)
+{
+    return TRACKS;
+}
+
+static const char *const words[] = {
+    "love", "night", "blue", "the", "song", "river", "fire", "dream",
+    "heart", "rain", "Star", "Moon", "Dance", "Road", "Home", "Light",
+};
+
+static const char *word(void)
+{
+    return words[rand() % (sizeof(words) / sizeof(words[0]))];
+}
+
+static void make_library(void)
+{
+    char buf[160];
+    media_tags_t t;
+
+    srand(1);
+    for (int d = 0; d < DIRS; d++) {
+        snprintf(buf, sizeof(buf), "Artist%03d/Album%d", d % 97, d);
+        s_dirs[d].path_off = pool_add(buf);
+    }
+    media_meta_reset(TRACKS);
+    for (uint32_t i = 0; i < TRACKS; i++) {
+        snprintf(buf, sizeof(buf), "%02u %s %s.mp3", (unsigned)(i % 20), word(), word());
+        s_tracks[i].name_off = pool_add(buf);
+        s_tracks[i].dir = (uint16_t)(i % DIRS);
+
+        memset(&t, 0, sizeof(t));
+        snprintf(t.title, sizeof(t.title), "%s %s %u", word(), word(), (unsigned)i);
+        snprintf(t.artist, sizeof(t.artist), "Artist %d", rand() % 900);
+        snprintf(t.album, sizeof(t.album), "Album %d", rand() % 2000);
+        t.track_no = (uint16_t)(i % 20);
+        t.sources = MEDIA_TAGS_F_ID3V2;
+        // 每 10 首有一首没有标签，标题视图用文件名
+        if (i % 10) {
+            media_meta_set(i, &t);
+        }
+    }
+}
+
+static const char *title_of(const media_meta_t *m, uint32_t t)
+{
+    return m->title[t] != MEDIA_META_NO_TAGS ? m->pool + m->title[t] : s_pool + s_tracks[t].name_off;
+}
+
+static int check_views(void)
+{
+    int fail = 0;
+    uint32_t t;
+    const char *last = "";
+
+    // 标题视图有序
+    const media_meta_t *m = media_meta_lock();
+    for (uint32_t p = 0; p < TRACKS; p++) {
+        media_views_track(MEDIA_VIEW_TITLE, p, &t);
+        const char *x = title_of(m, t);
+        if (strcasecmp(last, x) > 0) {
+            fprintf(stderr, "title view out of order at %u\n", (unsigned)p);
+            fail = 1;
+            break;
+        }
+        last = x;
+    }
+
+    // 前缀搜索的结果与逐条比较一致
+    uint32_t brute = 0;
+    for (uint32_t i = 0; i < TRACKS; i++) {
+        if (strncasecmp(media_meta_string(m, m->artist[i]), "artist 1", 8) == 0) {
+            brute++;
+        }
+    }
+    media_meta_unlock();
+
+    media_search_t s;
+    media_search_begin(&s, MEDIA_VIEW_ARTIST);
+    media_search_update(&s, "artist 1");
+    if (s.count != brute) {
+        fprintf(stderr, "artist prefix: %u matches, brute force %u\n", (unsigned)s.count, (unsigned)brute);
+        fail = 1;
+    }
+    media_search_begin(&s, MEDIA_VIEW_PATH);
+    media_search_update(&s, "ARTIST005/album5/0");
+    if (s.count == 0) {
+        fprintf(stderr, "path prefix found nothing\n");
+        fail = 1;
+    }
+    return fail;
+}
+
+int main(void)
+{
+    static const char *const typing[] = { "l", "lo", "lov", "love", "love ", "love n", "love", "lo", "r" };
+    const int steps = sizeof(typing) / sizeof(typing[0]);
+    int fail = 0;
+
+    s_lib_lock = xSemaphoreCreateMutex();
+    media_meta_init();
+    media_views_init();
+    make_library();
+
+    int64_t t0 = esp_timer_get_time();
+    media_views_build();
+    double build_ms = (esp_timer_get_time() - t0) / 1000.0;
+    printf("build 4 views for %d tracks: %.1f ms, meta cache %zu bytes\n",
+           TRACKS, build_ms, media_meta_memory_usage());
+
+    // 曲目名称 (mp3_player_track_name -> media_meta_display_name) 与视图建立共用曲库和元数据的锁，
+    // 排序在副本上进行，持锁只限于拷贝，应远小于整个建立过程
+    printf("longest library/meta lock hold during the build: %lld us\n", (long long)s_lock_max_us);
+    if (s_lock_max_us * 10 > (int64_t)(build_ms * 1000)) {
+        fprintf(stderr, "lock held for %lld us of a %.1f ms build\n", (long long)s_lock_max_us, build_ms);
+        fail = 1;
+    }
+
+    media_search_t s;
+    t0 = esp_timer_get_time();
+    for (int k = 0; k < SEARCH_ROUNDS; k++) {
+        media_search_begin(&s, MEDIA_VIEW_TITLE);
+        for (int j = 0; j < steps; j++) {
+            media_search_update(&s, typing[j]);
+        }
+    }
+    double us = (double)(esp_timer_get_time() - t0) / ((double)SEARCH_ROUNDS * steps);
+    printf("search-as-you-type update: %.2f us average (frame %d us)\n", us, FRAME_US);
+    media_search_begin(&s, MEDIA_VIEW_TITLE);
+    for (int j = 0; j < steps; j++) {
+        media_search_update(&s, typing[j]);
+        printf("  '%s' -> %u\n", typing[j], (unsigned)s.count);
+    }
+    if (us > FRAME_US / 10) {
+        fprintf(stderr, "search update takes %.1f us\n", us);
+        fail = 1;
+    }
+
+    fail |= check_views();
+    return fail;
+}
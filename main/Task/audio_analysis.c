@@ -0,0 +1,153 @@
+// main/task/audio_analysis.c
+#include <string.h>
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+
+#include "audio_analysis.h"
+
+#define LOW_CUTOFF_HZ       200
+#define MID_CUTOFF_HZ       2000
+#define AVG_SHIFT           3       // 慢速平均约 8 个数据块 (~200ms)
+#define BEAT_MIN_GAP_MS     280     // 两次节拍的最小间隔，约 214 BPM
+#define BEAT_FLOOR          1500    // 低于此电平不判定节拍，避免静音段误触发
+
+/* 分析状态只在音频任务中修改，无需加锁 */
+static uint32_t s_sample_rate = 44100;
+static uint32_t s_bits = 16;
+static uint32_t s_channels = 2;
+static int s_low_shift = 5;
+static int s_mid_shift = 2;
+static int32_t s_lp_low;
+static int32_t s_lp_mid;
+static uint32_t s_rms_avg;
+static uint32_t s_bass_avg;
+static uint32_t s_frames_since_beat;
+
+/* 对外快照，由自旋锁保护，拷贝只有十几个字节 */
+static portMUX_TYPE s_lock = portMUX_INITIALIZER_UNLOCKED;
+static audio_features_t s_features;
+
+// 一阶低通 y += (x - y) >> k 的截止频率约为 fs / (2π·2^k)，取最接近 fc 的 k
+static int shift_for_cutoff(uint32_t sample_rate, uint32_t cutoff_hz)
+{
+    uint32_t ratio = sample_rate * 10 / (cutoff_hz * 63);   // fs / (2π·fc)
+    int k = 0;
+    while (k < 15 && ((1u << (k + 1)) + (1u << k)) / 2 <= ratio) {
+        k++;
+    }
+    return k;
+}
+
+static uint32_t isqrt32(uint32_t x)
+{
+    uint32_t res = 0;
+    uint32_t bit = 1u << 30;
+    while (bit > x) bit >>= 2;
+    while (bit) {
+        if (x >= res + bit) {
+            x -= res + bit;
+            res = (res >> 1) + bit;
+        } else {
+            res >>= 1;
+        }
+        bit >>= 2;
+    }
+    return res;
+}
+
+static inline uint16_t clamp_u16(uint32_t v)
+{
+    return v > 0xFFFF ? 0xFFFF : (uint16_t)v;
+}
+
+void audio_analysis_set_format(uint32_t sample_rate, uint32_t bits_per_sample, uint32_t channels)
+{
+    s_sample_rate = sample_rate ? sample_rate : 44100;
+    s_bits = bits_per_sample;
+    s_channels = channels ? channels : 2;
+    s_low_shift = shift_for_cutoff(s_sample_rate, LOW_CUTOFF_HZ);
+    s_mid_shift = shift_for_cutoff(s_sample_rate, MID_CUTOFF_HZ);
+    s_lp_low = 0;
+    s_lp_mid = 0;
+}
+
+void audio_analysis_feed(const void *pcm, size_t len)
+{
+    if (s_bits != 16 || pcm == NULL) {
+        return;
+    }
+
+    const int16_t *in = (const int16_t *)pcm;
+    size_t frames = len / (sizeof(int16_t) * s_channels);
+    if (frames == 0) {
+        return;
+    }
+
+    uint64_t sum_sq = 0;
+    uint32_t sum_abs[AUDIO_ANALYSIS_BANDS] = {0};
+    int32_t lp_low = s_lp_low;
+    int32_t lp_mid = s_lp_mid;
+
+    // 用两个一阶低通把单声道混音拆成低/中/高三段，每个采样只有加减和移位
+    for (size_t i = 0; i < frames; i++) {
+        int32_t m = (s_channels == 2) ? ((int32_t)in[0] + in[1]) >> 1 : in[0];
+        in += s_channels;
+
+        lp_low += (m - lp_low) >> s_low_shift;
+        lp_mid += (m - lp_mid) >> s_mid_shift;
+
+        int32_t low = lp_low;
+        int32_t mid = lp_mid - lp_low;
+        int32_t high = m - lp_mid;
+
+        sum_sq += (uint32_t)(m * m);
+        sum_abs[0] += (uint32_t)(low < 0 ? -low : low);
+        sum_abs[1] += (uint32_t)(mid < 0 ? -mid : mid);
+        sum_abs[2] += (uint32_t)(high < 0 ? -high : high);
+    }
+    s_lp_low = lp_low;
+    s_lp_mid = lp_mid;
+
+    // 电平归一化到 0-65535 (16 位满幅 = 32768，左移一位)
+    uint32_t rms = isqrt32((uint32_t)(sum_sq / frames)) << 1;
+    uint32_t bass = (sum_abs[0] / frames) << 1;
+
+    // 起音检测：当前能量超过慢速平均的 1.5 倍即视为起音
+    uint32_t onset = 0;
+    if (rms * 2 > s_rms_avg * 3) {
+        onset = rms - s_rms_avg;
+    }
+    s_rms_avg = s_rms_avg + (((int32_t)rms - (int32_t)s_rms_avg) >> AVG_SHIFT);
+
+    // 节拍检测：低频能量突增，并限制最小间隔
+    s_frames_since_beat += frames;
+    bool beat = false;
+    if (bass > BEAT_FLOOR && bass * 2 > s_bass_avg * 3 &&
+        s_frames_since_beat >= s_sample_rate * BEAT_MIN_GAP_MS / 1000) {
+        beat = true;
+        s_frames_since_beat = 0;
+    }
+    s_bass_avg = s_bass_avg + (((int32_t)bass - (int32_t)s_bass_avg) >> AVG_SHIFT);
+
+    taskENTER_CRITICAL(&s_lock);
+    s_features.seq++;
+    s_features.rms = clamp_u16(rms);
+    for (int b = 0; b < AUDIO_ANALYSIS_BANDS; b++) {
+        s_features.band[b] = clamp_u16((sum_abs[b] / frames) << 1);
+    }
+    s_features.onset = clamp_u16(onset);
+    if (beat) {
+        s_features.beat_count++;
+    }
+    taskEXIT_CRITICAL(&s_lock);
+}
+
+void audio_analysis_get(audio_features_t *out)
+{
+    if (out == NULL) {
+        return;
+    }
+    taskENTER_CRITICAL(&s_lock);
+    memcpy(out, &s_features, sizeof(*out));
+    taskEXIT_CRITICAL(&s_lock);
+}
@@ -0,0 +1,49 @@
+// main/task/audio_analysis.h
+#ifndef AUDIO_ANALYSIS_H
+#define AUDIO_ANALYSIS_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define AUDIO_ANALYSIS_BANDS 3  // 低/中/高 三个频段
+
+/**
+ * @brief 播放中 PCM 的实时特征快照
+ *
+ * 所有电平均为 0-65535 的线性值，按 16 位满幅归一化
+ */
+typedef struct {
+    uint32_t seq;                           // 每分析一个数据块加 1，不变说明没有新数据
+    uint16_t rms;                           // 当前块的 RMS 电平
+    uint16_t band[AUDIO_ANALYSIS_BANDS];    // 各频段平均幅度 (低 < ~200Hz, 中 < ~2kHz, 高)
+    uint16_t onset;                         // 能量突增强度，0 表示没有起音
+    uint32_t beat_count;                    // 检测到的节拍总数，变化即表示新节拍
+} audio_features_t;
+
+/**
+ * @brief 设置后续送入 audio_analysis_feed() 的 PCM 格式
+ * @note  在 I2S 时钟重新配置时调用；非 16 位数据会被跳过
+ */
+void audio_analysis_set_format(uint32_t sample_rate, uint32_t bits_per_sample, uint32_t channels);
+
+/**
+ * @brief 分析一块即将送往 I2S 的交织 PCM 数据
+ * @note  在音频任务中调用，每个采样只做少量整数运算
+ */
+void audio_analysis_feed(const void *pcm, size_t len);
+
+/**
+ * @brief 获取最新的特征快照 (任意任务可调用)
+ */
+void audio_analysis_get(audio_features_t *out);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // AUDIO_ANALYSIS_H
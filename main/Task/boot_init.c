@@ -0,0 +1,165 @@
+// main/task/boot_init.c
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "freertos/event_groups.h"
+#include "esp_log.h"
+#include "esp_timer.h"
+
+#include "boot_init.h"
+
+static const char *TAG = "BOOT_INIT";
+
+#define STEP_TASK_STACK     6144    // 界面步骤会在本任务中渲染第一帧
+
+typedef struct {
+    const boot_init_step_t *step;
+    esp_err_t ret;
+    bool skipped;           // 依赖的必需步骤失败，没有执行
+    int core;               // 实际运行的核
+    int64_t start_us;       // 依赖全部结束、任务拿到 CPU 的时间
+    int64_t end_us;
+} step_run_t;
+
+static step_run_t s_runs[BOOT_INIT_MAX_STEPS];
+static int s_count;
+static int64_t s_t0;
+// 启动只执行一次，不删除，避免与刚置位后尚未退出的步骤任务竞争
+static EventGroupHandle_t s_done;
+
+static bool dep_failed(uint32_t deps)
+{
+    for (int i = 0; i < s_count; i++) {
+        if ((deps & BOOT_INIT_DEP(i)) && !s_runs[i].step->optional && s_runs[i].ret != ESP_OK) {
+            return true;
+        }
+    }
+    return false;
+}
+
+static void step_task(void *arg)
+{
+    step_run_t *run = arg;
+    const boot_init_step_t *step = run->step;
+
+    if (step->deps) {
+        xEventGroupWaitBits(s_done, step->deps, pdFALSE, pdTRUE, portMAX_DELAY);
+    }
+    run->start_us = esp_timer_get_time();
+    run->core = xPortGetCoreID();
+    if (dep_failed(step->deps)) {
+        run->skipped = true;
+        run->ret = ESP_ERR_INVALID_STATE;
+    } else {
+        run->ret = step->fn();
+    }
+    run->end_us = esp_timer_get_time();
+
+    if (run->ret != ESP_OK) {
+        ESP_LOGE(TAG, "%s %s: %s", step->name, run->skipped ? "跳过" : "失败", esp_err_to_name(run->ret));
+    }
+    xEventGroupSetBits(s_done, BOOT_INIT_DEP(run - s_runs));
+    vTaskDelete(NULL);
+}
+
+// 依赖中最晚结束的一个，即决定本步骤何时能开始的步骤
+static int gating_dep(int i)
+{
+    int gate = -1;
+    for (int d = 0; d < i; d++) {
+        if ((s_runs[i].step->deps & BOOT_INIT_DEP(d)) &&
+            (gate < 0 || s_runs[d].end_us > s_runs[gate].end_us)) {
+            gate = d;
+        }
+    }
+    return gate;
+}
+
+static void report(int64_t total_us)
+{
+    int64_t sum_us = 0;
+
+    ESP_LOGI(TAG, "%-12s %4s %8s %8s %8s", "步骤", "核", "开始", "等待", "耗时");
+    for (int i = 0; i < s_count; i++) {
+        const step_run_t *r = &s_runs[i];
+        int gate = gating_dep(i);
+        // 等待: 依赖都已结束但核被其他步骤占用的时间
+        int64_t ready = gate < 0 ? s_t0 : s_runs[gate].end_us;
+        sum_us += r->end_us - r->start_us;
+        ESP_LOGI(TAG, "%-12s %4d %5lld ms %5lld ms %5lld ms%s", r->step->name, r->core,
+                 (r->start_us - s_t0) / 1000, (r->start_us - ready) / 1000,
+                 (r->end_us - r->start_us) / 1000, r->skipped ? " (跳过)" : "");
+    }
+
+    // 从最后结束的步骤沿依赖往回找
+    int last = 0;
+    for (int i = 1; i < s_count; i++) {
+        if (s_runs[i].end_us > s_runs[last].end_us) {
+            last = i;
+        }
+    }
+    int path[BOOT_INIT_MAX_STEPS];
+    int len = 0;
+    for (int i = last; i >= 0; i = gating_dep(i)) {
+        path[len++] = i;
+    }
+
+    char buf[160];
+    int pos = 0;
+    for (int k = len - 1; k >= 0 && pos < (int)sizeof(buf); k--) {
+        const step_run_t *r = &s_runs[path[k]];
+        pos += snprintf(buf + pos, sizeof(buf) - pos, "%s%s(%lld)", k == len - 1 ? "" : " -> ",
+                        r->step->name, (r->end_us - r->start_us) / 1000);
+    }
+    ESP_LOGI(TAG, "关键路径: %s", buf);
+    ESP_LOGI(TAG, "总耗时 %lld ms, 各步骤合计 %lld ms", total_us / 1000, sum_us / 1000);
+}
+
+esp_err_t boot_init_run(const boot_init_step_t *steps, int count)
+{
+    if (count <= 0 || count > BOOT_INIT_MAX_STEPS || s_done != NULL) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    for (int i = 0; i < count; i++) {
+        // 只允许依赖前面的步骤，保证没有环
+        if (steps[i].deps & ~(BOOT_INIT_DEP(i) - 1)) {
+            ESP_LOGE(TAG, "%s 依赖了排在后面的步骤", steps[i].name);
+            return ESP_ERR_INVALID_ARG;
+        }
+    }
+
+    s_done = xEventGroupCreate();
+    if (s_done == NULL) {
+        return ESP_ERR_NO_MEM;
+    }
+    s_count = count;
+    s_t0 = esp_timer_get_time();
+
+    uint32_t all = 0;
+    for (int i = 0; i < count; i++) {
+        memset(&s_runs[i], 0, sizeof(s_runs[i]));
+        s_runs[i].step = &steps[i];
+        all |= BOOT_INIT_DEP(i);
+    }
+
+    UBaseType_t prio = uxTaskPriorityGet(NULL);
+    for (int i = 0; i < count; i++) {
+        BaseType_t core = steps[i].core == BOOT_INIT_ANY_CORE ? tskNO_AFFINITY : steps[i].core;
+        if (xTaskCreatePinnedToCore(step_task, steps[i].name, STEP_TASK_STACK, &s_runs[i], prio, NULL, core) != pdPASS) {
+            // 前面的步骤已经在执行，没法撤回，只能放弃启动
+            ESP_LOGE(TAG, "创建 %s 任务失败", steps[i].name);
+            abort();
+        }
+    }
+    xEventGroupWaitBits(s_done, all, pdFALSE, pdTRUE, portMAX_DELAY);
+    report(esp_timer_get_time() - s_t0);
+
+    for (int i = 0; i < count; i++) {
+        if (!steps[i].optional && s_runs[i].ret != ESP_OK) {
+            return s_runs[i].ret;
+        }
+    }
+    return ESP_OK;
+}
@@ -0,0 +1,42 @@
+// main/task/boot_init.h
+#ifndef BOOT_INIT_H
+#define BOOT_INIT_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "esp_err.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define BOOT_INIT_MAX_STEPS     16
+#define BOOT_INIT_ANY_CORE      (-1)
+#define BOOT_INIT_DEP(step)     (1u << (step))  // 依赖的步骤，按在数组中的下标
+
+typedef esp_err_t (*boot_init_fn_t)(void);
+
+typedef struct {
+    const char *name;
+    boot_init_fn_t fn;
+    uint32_t deps;          // BOOT_INIT_DEP() 的组合，只能依赖数组中排在前面的步骤
+    int core;               // 运行的核，中断会分配在初始化驱动的核上；BOOT_INIT_ANY_CORE 不绑定
+    bool optional;          // 失败时不影响启动结果，依赖它的步骤照常执行
+} boot_init_step_t;
+
+/**
+ * @brief 按依赖关系并行执行初始化步骤，全部结束后返回
+ *
+ * 每个步骤在独立的任务中运行，依赖的步骤都结束后才开始。
+ * 必需步骤失败时跳过依赖它的步骤。结束后打印每步的核、开始时间、
+ * 等待和执行耗时，以及决定总耗时的关键路径。
+ *
+ * @return 第一个失败的必需步骤的错误码；ESP_ERR_INVALID_ARG 依赖关系不合法
+ */
+esp_err_t boot_init_run(const boot_init_step_t *steps, int count);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // BOOT_INIT_H
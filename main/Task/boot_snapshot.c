@@ -0,0 +1,141 @@
+// main/task/boot_snapshot.c
+#include <stddef.h>
+#include <string.h>
+#include "freertos/FreeRTOS.h"
+#include "freertos/semphr.h"
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "nvs.h"
+
+#include "boot_snapshot.h"
+
+static const char *TAG = "BOOT_SNAPSHOT";
+
+#define SNAPSHOT_KEY        "snap"
+#define SNAPSHOT_VERSION    2   // 2: 播放位置移到 play_history
+#define SNAPSHOT_MIN_LEN    (offsetof(boot_snapshot_t, path) + 1)
+
+static boot_snapshot_t s_snap;      // 当前内容
+static bool s_dirty;                // s_snap 还没写入 flash
+static SemaphoreHandle_t s_lock;
+static bool s_marked[BOOT_MILESTONE_MAX];
+
+static const char *const s_milestone_names[BOOT_MILESTONE_MAX] = {
+    [BOOT_MILESTONE_FIRST_FRAME] = "首帧",
+    [BOOT_MILESTONE_FIRST_AUDIO] = "首次出声",
+};
+
+static void lock(void)
+{
+    if (s_lock == NULL) {
+        s_lock = xSemaphoreCreateMutex();
+    }
+    xSemaphoreTake(s_lock, portMAX_DELAY);
+}
+
+static void unlock(void)
+{
+    xSemaphoreGive(s_lock);
+}
+
+// 调用者需持有锁
+static void commit_locked(void)
+{
+    nvs_handle_t h;
+    esp_err_t ret = nvs_open(BOOT_SNAPSHOT_NAMESPACE, NVS_READWRITE, &h);
+    if (ret != ESP_OK) {
+        ESP_LOGW(TAG, "打开 NVS 失败: %s", esp_err_to_name(ret));
+        return;
+    }
+    size_t len = offsetof(boot_snapshot_t, path) + strlen(s_snap.path) + 1;
+    ret = nvs_set_blob(h, SNAPSHOT_KEY, &s_snap, len);
+    if (ret == ESP_OK) {
+        ret = nvs_commit(h);
+    }
+    nvs_close(h);
+    if (ret == ESP_OK) {
+        s_dirty = false;
+    }
+    if (ret != ESP_OK) {
+        ESP_LOGW(TAG, "保存快照失败: %s", esp_err_to_name(ret));
+    }
+}
+
+esp_err_t boot_snapshot_load(boot_snapshot_t *snap)
+{
+    nvs_handle_t h;
+    boot_snapshot_t loaded = { 0 };
+    size_t len = sizeof(loaded);
+
+    esp_err_t ret = nvs_open(BOOT_SNAPSHOT_NAMESPACE, NVS_READONLY, &h);
+    if (ret == ESP_OK) {
+        ret = nvs_get_blob(h, SNAPSHOT_KEY, &loaded, &len);
+        nvs_close(h);
+    }
+    if (ret == ESP_OK && (len < SNAPSHOT_MIN_LEN || loaded.version != SNAPSHOT_VERSION)) {
+        ret = ESP_ERR_NOT_FOUND;
+    }
+    if (ret != ESP_OK) {
+        memset(snap, 0, sizeof(*snap));
+        snap->version = SNAPSHOT_VERSION;
+        lock();
+        s_snap = *snap;
+        unlock();
+        return ESP_ERR_NOT_FOUND;
+    }
+
+    loaded.title[sizeof(loaded.title) - 1] = '\0';
+    loaded.path[len - offsetof(boot_snapshot_t, path) - 1] = '\0';
+    *snap = loaded;
+    lock();
+    s_snap = loaded;
+    unlock();
+    return ESP_OK;
+}
+
+void boot_snapshot_set_track(const char *path, const char *title)
+{
+    lock();
+    if (strcmp(s_snap.path, path) != 0 || strcmp(s_snap.title, title) != 0) {
+        strlcpy(s_snap.path, path, sizeof(s_snap.path));
+        strlcpy(s_snap.title, title, sizeof(s_snap.title));
+        s_dirty = true;
+    }
+    unlock();
+}
+
+void boot_snapshot_set_track_count(uint32_t count)
+{
+    lock();
+    if (s_snap.track_count != count) {
+        s_snap.track_count = count;
+        s_dirty = true;
+    }
+    unlock();
+}
+
+bool boot_snapshot_dirty(void)
+{
+    lock();
+    bool dirty = s_dirty;
+    unlock();
+    return dirty;
+}
+
+void boot_snapshot_flush(void)
+{
+    lock();
+    if (s_dirty) {
+        commit_locked();
+    }
+    unlock();
+}
+
+void boot_time_mark(boot_milestone_t milestone)
+{
+    if (milestone >= BOOT_MILESTONE_MAX || s_marked[milestone]) {
+        return;
+    }
+    s_marked[milestone] = true;
+    ESP_LOGI(TAG, "启动到%s: %lld ms", s_milestone_names[milestone], esp_timer_get_time() / 1000);
+}
@@ -0,0 +1,69 @@
+// main/task/boot_snapshot.h
+#ifndef BOOT_SNAPSHOT_H
+#define BOOT_SNAPSHOT_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "esp_err.h"
+#include "media_library.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define BOOT_SNAPSHOT_NAMESPACE "boot_ui"   // NVS 命名空间
+#define BOOT_SNAPSHOT_TITLE_MAX 64
+
+/*
+ * 上次运行时界面的最后状态，启动时在挂载 SD 卡之前先画出来。
+ * 以 NVS blob 保存，path 只写到结尾的 '\0' 为止。
+ */
+typedef struct {
+    uint32_t version;
+    uint32_t track_count;                   // 上次扫描完成时的曲目数
+    char title[BOOT_SNAPSHOT_TITLE_MAX];    // 界面上显示的曲名
+    char path[MEDIA_LIBRARY_PATH_LEN];      // 当前曲目的完整路径，曲库就绪后按路径找回
+} boot_snapshot_t;
+
+typedef enum {
+    BOOT_MILESTONE_FIRST_FRAME,             // 第一帧界面已送到屏幕
+    BOOT_MILESTONE_FIRST_AUDIO,             // 第一次开始出声
+    BOOT_MILESTONE_MAX,
+} boot_milestone_t;
+
+/**
+ * @brief 读取上次保存的快照，之后的 set 函数以它为基础
+ * @note  需要先初始化 NVS (nvs_flash_init)
+ * @return ESP_ERR_NOT_FOUND 没有快照或格式不符
+ */
+esp_err_t boot_snapshot_load(boot_snapshot_t *snap);
+
+/**
+ * @brief 记录开始播放的曲目，播放位置由 play_history 保存
+ * @note  以下 set 函数只改内存中的快照，可在任意任务中调用；
+ *        由 play_history 在写续播记录时一并调用 boot_snapshot_flush() 写入，连续切歌只写一次
+ */
+void boot_snapshot_set_track(const char *path, const char *title);
+
+void boot_snapshot_set_track_count(uint32_t count);
+
+/**
+ * @brief 快照是否有还没写入 flash 的变化
+ */
+bool boot_snapshot_dirty(void);
+
+/**
+ * @brief 有变化时把快照写入 NVS
+ */
+void boot_snapshot_flush(void);
+
+/**
+ * @brief 记录启动里程碑，每种只在第一次调用时打印自启动起的耗时
+ */
+void boot_time_mark(boot_milestone_t milestone);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // BOOT_SNAPSHOT_H
@@ -0,0 +1,379 @@
+// main/task/cover_art.c
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "freertos/queue.h"
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "esp_heap_caps.h"
+#include "lvgl.h"
+#include "extra/libs/sjpg/tjpgd.h"
+
+#include "esp32_s3_hpy.h"
+#include "media_library.h"
+#include "media_tags.h"
+#include "cover_art.h"
+#include "sd_hotplug.h"
+
+static const char *TAG = "COVER_ART";
+
+#define COVER_TASK_STACK    6144
+#define COVER_TASK_PRIORITY 2           // 低于音频和 LVGL 任务
+#define JD_POOL_SIZE        4096        // TJpgDec 推荐的工作区大小
+#define JPEG_MAX_PIXELS     (1024 * 1024)   // 缩放后的图像上限，防止异常尺寸耗尽 PSRAM
+#define THUMB_BYTES         (COVER_ART_SIZE * COVER_ART_SIZE * sizeof(uint16_t))
+
+#define FNV_OFFSET_BASIS    2166136261u
+#define FNV_PRIME           16777619u
+
+#if !LV_USE_SJPG
+#error "cover_art 需要 LVGL 自带的 TJpgDec，请在 menuconfig 中打开 LV_USE_SJPG"
+#endif
+
+typedef struct {
+    char path[MEDIA_LIBRARY_PATH_LEN];
+} cover_request_t;
+
+// JPEG 解码的输入输出状态
+typedef struct {
+    FILE *fp;
+    uint32_t remain;        // 剩余的 JPEG 数据
+    uint8_t *rgb;           // 缩小后的整幅 RGB888 图像
+    uint16_t w;
+    uint16_t h;
+} jpeg_io_t;
+
+static QueueHandle_t s_queue;
+static cover_art_cb_t s_cb;
+static void *s_cb_ctx;
+static uint16_t *s_pixels[2];      // 双缓冲: 界面显示一块，任务写另一块
+static int s_shown;
+static cover_request_t s_req;
+static char s_cache_path[64];
+
+// 命中/未命中的次数和累计耗时，用于评估缓存效果
+static uint32_t s_hits;
+static uint32_t s_misses;
+static int64_t s_hit_us;
+static int64_t s_miss_us;
+
+/* =========================== 缓存文件 =========================== */
+static uint32_t fnv1a(uint32_t h, const void *data, size_t len)
+{
+    const uint8_t *p = (const uint8_t *)data;
+    while (len--) {
+        h = (h ^ *p++) * FNV_PRIME;
+    }
+    return h;
+}
+
+// 缓存文件名由路径和文件大小/修改时间的哈希组成，文件被替换后自然失效
+static void cache_path_for(const char *path, char *out, size_t len)
+{
+    struct stat st;
+    uint32_t h1 = fnv1a(FNV_OFFSET_BASIS, path, strlen(path));
+    uint32_t h2 = FNV_OFFSET_BASIS;
+    if (stat(path, &st) == 0) {
+        uint32_t size = (uint32_t)st.st_size;
+        uint32_t mtime = (uint32_t)st.st_mtime;
+        h2 = fnv1a(h2, &size, sizeof(size));
+        h2 = fnv1a(h2, &mtime, sizeof(mtime));
+    }
+    snprintf(out, len, "%s/%s/%08lx%08lx.565", BSP_SD_MOUNT_POINT, COVER_ART_DIR,
+             (unsigned long)h1, (unsigned long)h2);
+}
+
+// ESP_OK 命中 (has_art 表示是否有封面)，ESP_ERR_NOT_FOUND 未缓存
+static esp_err_t cache_load(const char *cache, uint16_t *pixels, bool *has_art)
+{
+    FILE *fp = fopen(cache, "rb");
+    if (fp == NULL) {
+        return ESP_ERR_NOT_FOUND;
+    }
+    size_t n = fread(pixels, 1, THUMB_BYTES, fp);
+    fclose(fp);
+
+    if (n == 0) {
+        *has_art = false;       // 空文件: 已确认没有封面
+        return ESP_OK;
+    }
+    if (n != THUMB_BYTES) {
+        return ESP_ERR_NOT_FOUND;
+    }
+    *has_art = true;
+    return ESP_OK;
+}
+
+static void cache_save(const char *cache, const uint16_t *pixels)
+{
+    FILE *fp = fopen(cache, "wb");
+    if (fp == NULL) {
+        // 换过卡时新卡上还没有缓存目录
+        char dir[32];
+        snprintf(dir, sizeof(dir), "%s/%s", BSP_SD_MOUNT_POINT, COVER_ART_DIR);
+        mkdir(dir, 0775);
+        fp = fopen(cache, "wb");
+    }
+    if (fp == NULL) {
+        ESP_LOGW(TAG, "无法写入缓存 %s", cache);
+        return;
+    }
+    bool ok = (pixels == NULL) || fwrite(pixels, 1, THUMB_BYTES, fp) == THUMB_BYTES;
+    fclose(fp);
+    if (!ok) {
+        unlink(cache);
+    }
+}
+
+/* =========================== JPEG 解码 =========================== */
+static size_t jpeg_input(JDEC *jd, uint8_t *buf, size_t len)
+{
+    jpeg_io_t *io = (jpeg_io_t *)jd->device;
+    if (len > io->remain) {
+        len = io->remain;
+    }
+    if (buf) {
+        len = fread(buf, 1, len, io->fp);
+    } else if (fseek(io->fp, (long)len, SEEK_CUR) != 0) {
+        return 0;
+    }
+    io->remain -= (uint32_t)len;
+    return len;
+}
+
+// TJpgDec 按 MCU 输出 RGB888 块，拷贝到整幅图像中
+static int jpeg_output(JDEC *jd, void *bitmap, JRECT *rect)
+{
+    jpeg_io_t *io = (jpeg_io_t *)jd->device;
+    const uint8_t *src = (const uint8_t *)bitmap;
+    uint32_t bw = rect->right - rect->left + 1;
+
+    for (uint32_t y = rect->top; y <= rect->bottom; y++, src += bw * 3) {
+        if (y >= io->h || rect->left >= io->w) {
+            continue;
+        }
+        uint32_t n = (rect->right < io->w) ? bw : io->w - rect->left;
+        memcpy(io->rgb + ((size_t)y * io->w + rect->left) * 3, src, n * 3);
+    }
+    return 1;
+}
+
+// 取中间的正方形区域，按区域平均缩放到 COVER_ART_SIZE 见方
+static void downscale(const jpeg_io_t *io, uint16_t *out)
+{
+    uint32_t side = io->w < io->h ? io->w : io->h;
+    uint32_t x0 = (io->w - side) / 2;
+    uint32_t y0 = (io->h - side) / 2;
+
+    for (uint32_t oy = 0; oy < COVER_ART_SIZE; oy++) {
+        uint32_t sy0 = y0 + oy * side / COVER_ART_SIZE;
+        uint32_t sy1 = y0 + (oy + 1) * side / COVER_ART_SIZE;
+        if (sy1 == sy0) {
+            sy1 = sy0 + 1;
+        }
+        for (uint32_t ox = 0; ox < COVER_ART_SIZE; ox++) {
+            uint32_t sx0 = x0 + ox * side / COVER_ART_SIZE;
+            uint32_t sx1 = x0 + (ox + 1) * side / COVER_ART_SIZE;
+            if (sx1 == sx0) {
+                sx1 = sx0 + 1;
+            }
+            uint32_t r = 0, g = 0, b = 0;
+            for (uint32_t y = sy0; y < sy1; y++) {
+                const uint8_t *p = io->rgb + ((size_t)y * io->w + sx0) * 3;
+                for (uint32_t x = sx0; x < sx1; x++, p += 3) {
+                    r += p[0];
+                    g += p[1];
+                    b += p[2];
+                }
+            }
+            uint32_t n = (sy1 - sy0) * (sx1 - sx0);
+            out[oy * COVER_ART_SIZE + ox] = lv_color_make(r / n, g / n, b / n).full;
+        }
+    }
+}
+
+static esp_err_t decode_jpeg(FILE *fp, uint32_t offset, uint32_t size, uint16_t *out)
+{
+    jpeg_io_t io = { .fp = fp, .remain = size };
+    esp_err_t ret = ESP_FAIL;
+
+    if (fseek(fp, (long)offset, SEEK_SET) != 0) {
+        return ESP_FAIL;
+    }
+    void *pool = malloc(JD_POOL_SIZE);
+    if (pool == NULL) {
+        return ESP_ERR_NO_MEM;
+    }
+
+    JDEC jd;
+    JRESULT rc = jd_prepare(&jd, jpeg_input, pool, JD_POOL_SIZE, &io);
+    if (rc != JDR_OK) {
+        // 渐进式 JPEG 等格式 TJpgDec 不支持
+        ESP_LOGW(TAG, "JPEG 无法解码 (%d)", rc);
+        goto exit;
+    }
+
+    // 选择最大的缩小比例，使缩小后的短边仍不小于缩略图尺寸
+    uint8_t scale = 0;
+    uint32_t short_side = jd.width < jd.height ? jd.width : jd.height;
+    while (scale < 3 && (short_side >> (scale + 1)) >= COVER_ART_SIZE) {
+        scale++;
+    }
+    io.w = jd.width >> scale;
+    io.h = jd.height >> scale;
+    if (io.w == 0 || io.h == 0 || (uint32_t)io.w * io.h > JPEG_MAX_PIXELS) {
+        goto exit;
+    }
+
+    io.rgb = heap_caps_calloc((size_t)io.w * io.h, 3, MALLOC_CAP_SPIRAM | MALLOC_CAP_8BIT);
+    if (io.rgb == NULL) {
+        ret = ESP_ERR_NO_MEM;
+        goto exit;
+    }
+    rc = jd_decomp(&jd, jpeg_output, scale);
+    if (rc == JDR_OK) {
+        downscale(&io, out);
+        ret = ESP_OK;
+    } else {
+        ESP_LOGW(TAG, "JPEG 解码失败 (%d)", rc);
+    }
+
+exit:
+    free(io.rgb);
+    free(pool);
+    return ret;
+}
+
+// 先找内嵌封面，再找同目录下的常见封面文件
+static esp_err_t extract_cover(const char *path, uint16_t *out)
+{
+    static const char *const names[] = { "cover.jpg", "folder.jpg", "front.jpg" };
+    uint32_t offset, size;
+    esp_err_t ret = ESP_ERR_NOT_FOUND;
+
+    FILE *fp = fopen(path, "rb");
+    if (fp != NULL) {
+        if (media_tags_find_picture(fp, &offset, &size) == ESP_OK) {
+            ret = decode_jpeg(fp, offset, size, out);
+        }
+        fclose(fp);
+    }
+    if (ret == ESP_OK) {
+        return ret;
+    }
+
+    const char *slash = strrchr(path, '/');
+    int dir_len = slash ? (int)(slash - path) : 0;
+    for (int i = 0; i < sizeof(names) / sizeof(names[0]) && media_library_is_online(); i++) {
+        char image[MEDIA_LIBRARY_PATH_LEN];
+        snprintf(image, sizeof(image), "%.*s/%s", dir_len, path, names[i]);
+        fp = fopen(image, "rb");
+        if (fp == NULL) {
+            continue;
+        }
+        fseek(fp, 0, SEEK_END);
+        long len = ftell(fp);
+        ret = (len > 0) ? decode_jpeg(fp, 0, (uint32_t)len, out) : ESP_FAIL;
+        fclose(fp);
+        if (ret == ESP_OK) {
+            break;
+        }
+    }
+    return ret;
+}
+
+/* =========================== 封面任务 =========================== */
+static void cover_art_task(void *arg)
+{
+    for (;;) {
+        xQueueReceive(s_queue, &s_req, portMAX_DELAY);
+        // 正在卸载时丢弃请求，换卡后会随下一首重新请求
+        if (!sd_hotplug_io_begin()) {
+            continue;
+        }
+
+        int64_t t0 = esp_timer_get_time();
+        uint16_t *pixels = s_pixels[1 - s_shown];
+        bool has_art = false;
+
+        cache_path_for(s_req.path, s_cache_path, sizeof(s_cache_path));
+        bool hit = cache_load(s_cache_path, pixels, &has_art) == ESP_OK;
+        if (!hit) {
+            has_art = extract_cover(s_req.path, pixels) == ESP_OK;
+            // 拔卡导致的失败不能当成没有封面记下来
+            if (media_library_is_online()) {
+                cache_save(s_cache_path, has_art ? pixels : NULL);
+            }
+        }
+        sd_hotplug_io_end();
+
+        int64_t dt = esp_timer_get_time() - t0;
+        if (hit) {
+            s_hits++;
+            s_hit_us += dt;
+        } else {
+            s_misses++;
+            s_miss_us += dt;
+        }
+        ESP_LOGI(TAG, "%s %s: %lld ms (命中 %u 次 平均 %lld ms, 未命中 %u 次 平均 %lld ms)",
+                 hit ? "缓存命中" : "解码", has_art ? "" : "(无封面)", dt / 1000,
+                 (unsigned)s_hits, s_hits ? s_hit_us / s_hits / 1000 : 0,
+                 (unsigned)s_misses, s_misses ? s_miss_us / s_misses / 1000 : 0);
+
+        // 期间又切了歌，这一张已经过时
+        if (uxQueueMessagesWaiting(s_queue) > 0) {
+            continue;
+        }
+        if (has_art) {
+            s_shown = 1 - s_shown;
+        }
+        if (s_cb) {
+            s_cb(has_art ? pixels : NULL, s_cb_ctx);
+        }
+    }
+}
+
+esp_err_t cover_art_init(cover_art_cb_t cb, void *ctx)
+{
+    char dir[32];
+
+    for (int i = 0; i < 2; i++) {
+        s_pixels[i] = heap_caps_malloc(THUMB_BYTES, MALLOC_CAP_SPIRAM | MALLOC_CAP_8BIT);
+        if (s_pixels[i] == NULL) {
+            s_pixels[i] = malloc(THUMB_BYTES);
+        }
+        if (s_pixels[i] == NULL) {
+            return ESP_ERR_NO_MEM;
+        }
+    }
+    s_cb = cb;
+    s_cb_ctx = ctx;
+
+    snprintf(dir, sizeof(dir), "%s/%s", BSP_SD_MOUNT_POINT, COVER_ART_DIR);
+    mkdir(dir, 0775);   // 已存在时失败，忽略
+
+    s_queue = xQueueCreate(1, sizeof(cover_request_t));
+    if (s_queue == NULL) {
+        return ESP_ERR_NO_MEM;
+    }
+    if (xTaskCreate(cover_art_task, "cover_art", COVER_TASK_STACK, NULL, COVER_TASK_PRIORITY, NULL) != pdPASS) {
+        ESP_LOGE(TAG, "创建封面任务失败");
+        return ESP_FAIL;
+    }
+    return ESP_OK;
+}
+
+void cover_art_request(const char *path)
+{
+    static cover_request_t req;
+
+    if (s_queue == NULL) {
+        return;
+    }
+    strlcpy(req.path, path, sizeof(req.path));
+    xQueueOverwrite(s_queue, &req);
+}
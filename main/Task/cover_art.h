@@ -0,0 +1,42 @@
+// main/task/cover_art.h
+#ifndef COVER_ART_H
+#define COVER_ART_H
+
+#include <stdint.h>
+#include "esp_err.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define COVER_ART_SIZE      96              // 缩略图边长 (像素)，与界面上的图片控件一致
+#define COVER_ART_DIR       ".covers"       // 缩略图缓存目录，位于 SD 卡根目录
+
+/**
+ * @brief 封面就绪回调，在封面任务中调用
+ * @param pixels COVER_ART_SIZE * COVER_ART_SIZE 个 RGB565 像素 (lv_color_t 格式)，
+ *               在下一次回调之后仍然有效；没有封面时为 NULL
+ */
+typedef void (*cover_art_cb_t)(const uint16_t *pixels, void *ctx);
+
+/**
+ * @brief 创建封面任务
+ *
+ * 第一次播放某首曲目时，从 ID3v2 APIC 帧 (或同目录下的 cover.jpg / folder.jpg)
+ * 取出 JPEG，用 TJpgDec 的缩放 IDCT 以 1/2..1/8 解码，再按区域平均缩放到
+ * COVER_ART_SIZE 见方，以原始 RGB565 写入缓存目录。之后再播放时只需
+ * 一次读取即可显示。没有封面的曲目写入空文件，避免重复查找。
+ */
+esp_err_t cover_art_init(cover_art_cb_t cb, void *ctx);
+
+/**
+ * @brief 请求加载曲目的封面，立即返回
+ * @note  只保留最新的请求，快速切歌时中间的请求会被丢弃
+ */
+void cover_art_request(const char *path);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // COVER_ART_H
@@ -0,0 +1,106 @@
+// main/task/flash_audio.c
+#include <string.h>
+#include "esp_log.h"
+#include "esp_partition.h"
+#include "esp_rom_crc.h"
+
+#include "flash_audio.h"
+
+static const char *TAG = "FLASH_AUDIO";
+
+static const flash_audio_entry_t *s_entries;
+static const uint8_t *s_base;
+static uint32_t s_count;
+static esp_partition_mmap_handle_t s_mmap;
+
+esp_err_t flash_audio_init(void)
+{
+    if (s_base) {
+        return ESP_OK;
+    }
+
+    const esp_partition_t *part = esp_partition_find_first(ESP_PARTITION_TYPE_DATA, ESP_PARTITION_SUBTYPE_ANY,
+                                                           FLASH_AUDIO_PARTITION);
+    if (part == NULL) {
+        return ESP_ERR_NOT_FOUND;
+    }
+
+    // 先只读头部，空分区 (全 0xFF) 不必建立映射
+    flash_audio_header_t hdr;
+    esp_err_t ret = esp_partition_read(part, 0, &hdr, sizeof(hdr));
+    if (ret != ESP_OK) {
+        return ret;
+    }
+    size_t table_end = sizeof(hdr) + (size_t)hdr.count * sizeof(flash_audio_entry_t);
+    if (hdr.magic != FLASH_AUDIO_MAGIC || hdr.version != FLASH_AUDIO_VERSION ||
+        hdr.total_size > part->size || table_end > hdr.total_size) {
+        ESP_LOGI(TAG, "分区 %s 中没有音频镜像", FLASH_AUDIO_PARTITION);
+        return ESP_ERR_NOT_FOUND;
+    }
+
+    const void *ptr;
+    ret = esp_partition_mmap(part, 0, hdr.total_size, ESP_PARTITION_MMAP_DATA, &ptr, &s_mmap);
+    if (ret != ESP_OK) {
+        ESP_LOGE(TAG, "映射音频分区失败: %s", esp_err_to_name(ret));
+        return ret;
+    }
+
+    const uint8_t *base = ptr;
+    const flash_audio_entry_t *entries = (const flash_audio_entry_t *)(base + sizeof(hdr));
+    bool valid = esp_rom_crc32_le(0, (const uint8_t *)entries, table_end - sizeof(hdr)) == hdr.crc;
+    for (uint32_t i = 0; valid && i < hdr.count; i++) {
+        const flash_audio_entry_t *e = &entries[i];
+        valid = memchr(e->name, '\0', sizeof(e->name)) != NULL &&
+                e->offset >= table_end && e->offset <= hdr.total_size &&
+                e->size <= hdr.total_size - e->offset;
+    }
+    if (!valid) {
+        ESP_LOGE(TAG, "音频镜像条目表损坏");
+        esp_partition_munmap(s_mmap);
+        return ESP_ERR_INVALID_CRC;
+    }
+
+    s_base = base;
+    s_entries = entries;
+    s_count = hdr.count;
+    ESP_LOGI(TAG, "内置音频 %u 个，共 %u KB", (unsigned)s_count, (unsigned)(hdr.total_size / 1024));
+    return ESP_OK;
+}
+
+uint32_t flash_audio_count(void)
+{
+    return s_count;
+}
+
+const char *flash_audio_name(uint32_t index)
+{
+    return index < s_count ? s_entries[index].name : NULL;
+}
+
+bool flash_audio_get(uint32_t index, const void **data, size_t *len)
+{
+    if (index >= s_count) {
+        return false;
+    }
+    *data = s_base + s_entries[index].offset;
+    *len = s_entries[index].size;
+    return true;
+}
+
+int flash_audio_find(const char *name)
+{
+    uint32_t lo = 0, hi = s_count;
+    while (lo < hi) {
+        uint32_t mid = (lo + hi) / 2;
+        int cmp = strcmp(s_entries[mid].name, name);
+        if (cmp == 0) {
+            return (int)mid;
+        }
+        if (cmp < 0) {
+            lo = mid + 1;
+        } else {
+            hi = mid;
+        }
+    }
+    return -1;
+}
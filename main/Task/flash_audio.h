@@ -0,0 +1,72 @@
+// main/task/flash_audio.h
+#ifndef FLASH_AUDIO_H
+#define FLASH_AUDIO_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
+#include "esp_err.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define FLASH_AUDIO_PARTITION   "audio"         // partitions.csv 中的分区名
+#define FLASH_AUDIO_MAGIC       0x4B415041      // "APAK"
+#define FLASH_AUDIO_VERSION     1
+#define FLASH_AUDIO_NAME_MAX    56              // 含结尾的 '\0'
+#define FLASH_AUDIO_ALIGN       64              // 每个文件的起始偏移按此对齐
+
+/*
+ * 分区内容 (小端，由 tools/audio_pack.py 生成):
+ *   flash_audio_header_t
+ *   flash_audio_entry_t × count，按名称排序
+ *   各文件数据，起始偏移按 FLASH_AUDIO_ALIGN 对齐
+ * crc 为条目表的 CRC32，数据本身不校验 (映射后直接交给解码器)
+ */
+typedef struct {
+    uint32_t magic;
+    uint16_t version;
+    uint16_t count;
+    uint32_t total_size;    // 整个镜像的字节数
+    uint32_t crc;
+} flash_audio_header_t;
+
+typedef struct {
+    char name[FLASH_AUDIO_NAME_MAX];
+    uint32_t offset;        // 相对分区起始
+    uint32_t size;
+} flash_audio_entry_t;
+
+/**
+ * @brief 查找音频分区，校验后整体映射到数据地址空间
+ *
+ * 映射只占用 MMU 页表，不占 RAM；之后读取由 flash cache 完成，不经过 SD 卡。
+ *
+ * @return ESP_ERR_NOT_FOUND 没有分区或分区中没有有效镜像
+ */
+esp_err_t flash_audio_init(void);
+
+uint32_t flash_audio_count(void);
+
+/**
+ * @return 条目名称 (如 "demo/intro.mp3")，越界返回 NULL
+ */
+const char *flash_audio_name(uint32_t index);
+
+/**
+ * @brief 取得条目在映射中的地址和长度，指针在整个运行期间有效
+ */
+bool flash_audio_get(uint32_t index, const void **data, size_t *len);
+
+/**
+ * @brief 按名称查找条目 (二分查找)
+ * @return 条目序号，没有返回 -1
+ */
+int flash_audio_find(const char *name);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // FLASH_AUDIO_H
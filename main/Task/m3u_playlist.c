@@ -0,0 +1,256 @@
+// main/task/m3u_playlist.c
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include "esp_log.h"
+#include "esp_heap_caps.h"
+
+#include "m3u_playlist.h"
+
+static const char *TAG = "M3U";
+
+#define READ_CHUNK          512     // 扫描时的读缓冲区
+#define OFFSETS_MIN_CAP     64
+
+/* =========================== 扫描 =========================== */
+static bool add_offset(m3u_playlist_t *pl, uint32_t off)
+{
+    if (pl->count == pl->cap) {
+        uint32_t n = pl->cap ? pl->cap + pl->cap / 2 + 1 : OFFSETS_MIN_CAP;
+        uint32_t *p = heap_caps_realloc(pl->offsets, (size_t)n * sizeof(uint32_t), MALLOC_CAP_SPIRAM | MALLOC_CAP_8BIT);
+        if (p == NULL) {
+            p = realloc(pl->offsets, (size_t)n * sizeof(uint32_t));
+            if (p == NULL) {
+                return false;
+            }
+        }
+        pl->offsets = p;
+        pl->cap = n;
+    }
+    pl->offsets[pl->count++] = off;
+    return true;
+}
+
+esp_err_t m3u_playlist_open(m3u_playlist_t *pl, const char *path, const char *root)
+{
+    uint8_t buf[READ_CHUNK];
+
+    memset(pl, 0, sizeof(*pl));
+    if (strlen(path) >= sizeof(pl->path) || strlen(root) >= sizeof(pl->root)) {
+        return ESP_ERR_INVALID_SIZE;
+    }
+    strlcpy(pl->path, path, sizeof(pl->path));
+    strlcpy(pl->root, root, sizeof(pl->root));
+    strlcpy(pl->dir, path, sizeof(pl->dir));
+    char *slash = strrchr(pl->dir, '/');
+    if (slash) {
+        *slash = '\0';
+    } else {
+        strlcpy(pl->dir, ".", sizeof(pl->dir));
+    }
+
+    FILE *fp = fopen(path, "rb");
+    if (fp == NULL) {
+        ESP_LOGE(TAG, "无法打开播放列表 %s", path);
+        return ESP_FAIL;
+    }
+
+    // 逐块扫描，只记录非空、非注释 (#EXTM3U/#EXTINF 等) 行的起始偏移
+    uint32_t base = 0;
+    bool line_start = true;
+    esp_err_t ret = ESP_OK;
+    size_t n;
+    while ((n = fread(buf, 1, sizeof(buf), fp)) > 0 && ret == ESP_OK) {
+        size_t i = 0;
+        if (base == 0 && n >= 3 && buf[0] == 0xEF && buf[1] == 0xBB && buf[2] == 0xBF) {
+            i = 3;  // UTF-8 BOM
+        }
+        for (; i < n; i++) {
+            uint8_t c = buf[i];
+            if (c == '\n' || c == '\r') {
+                line_start = true;
+            } else if (line_start && c != ' ' && c != '\t') {
+                line_start = false;
+                if (c != '#' && !add_offset(pl, base + (uint32_t)i)) {
+                    ret = ESP_ERR_NO_MEM;
+                    break;
+                }
+            }
+        }
+        base += (uint32_t)n;
+    }
+    fclose(fp);
+
+    if (ret != ESP_OK) {
+        m3u_playlist_close(pl);
+        return ret;
+    }
+    ESP_LOGI(TAG, "%s: %u 个条目", path, (unsigned)pl->count);
+    return ESP_OK;
+}
+
+void m3u_playlist_close(m3u_playlist_t *pl)
+{
+    free(pl->offsets);
+    memset(pl, 0, sizeof(*pl));
+}
+
+/* =========================== 路径解析 =========================== */
+static int hex_value(char c)
+{
+    if (c >= '0' && c <= '9') return c - '0';
+    if (c >= 'a' && c <= 'f') return c - 'a' + 10;
+    if (c >= 'A' && c <= 'F') return c - 'A' + 10;
+    return -1;
+}
+
+// file:// URL 中的 %XX 转义
+static void url_decode(char *s)
+{
+    char *out = s;
+    for (; *s; s++) {
+        int hi, lo;
+        if (s[0] == '%' && (hi = hex_value(s[1])) >= 0 && (lo = hex_value(s[2])) >= 0) {
+            *out++ = (char)(hi << 4 | lo);
+            s += 2;
+        } else {
+            *out++ = *s;
+        }
+    }
+    *out = '\0';
+}
+
+static bool is_valid_utf8(const uint8_t *s)
+{
+    while (*s) {
+        int extra = (*s < 0x80) ? 0 : ((*s & 0xE0) == 0xC0) ? 1 : ((*s & 0xF0) == 0xE0) ? 2 : ((*s & 0xF8) == 0xF0) ? 3 : -1;
+        if (extra < 0) {
+            return false;
+        }
+        s++;
+        while (extra--) {
+            if ((*s++ & 0xC0) != 0x80) {
+                return false;
+            }
+        }
+    }
+    return true;
+}
+
+// 老式 .m3u 常用本地代码页保存，不是合法 UTF-8 时按 Latin-1 转换
+static void latin1_to_utf8(const char *src, char *dst, size_t len)
+{
+    size_t pos = 0;
+    for (const uint8_t *s = (const uint8_t *)src; *s && pos + 2 < len; s++) {
+        if (*s < 0x80) {
+            dst[pos++] = (char)*s;
+        } else {
+            dst[pos++] = (char)(0xC0 | (*s >> 6));
+            dst[pos++] = (char)(0x80 | (*s & 0x3F));
+        }
+    }
+    dst[pos] = '\0';
+}
+
+// 规整以 '/' 开头的路径: 合并重复的 '/'，去掉 "." 并回退 ".."
+static void normalize_path(char *path)
+{
+    char *src = path;
+    char *dst = path;
+
+    while (*src) {
+        while (*src == '/') {
+            src++;
+        }
+        if (*src == '\0') {
+            break;
+        }
+        char *seg = src;
+        while (*src && *src != '/') {
+            src++;
+        }
+        size_t n = (size_t)(src - seg);
+        if (n == 1 && seg[0] == '.') {
+            continue;
+        }
+        if (n == 2 && seg[0] == '.' && seg[1] == '.') {
+            while (dst > path && *--dst != '/') {
+            }
+            continue;
+        }
+        *dst++ = '/';
+        memmove(dst, seg, n);
+        dst += n;
+    }
+    if (dst == path) {
+        *dst++ = '/';
+    }
+    *dst = '\0';
+}
+
+int m3u_playlist_entry_path(const m3u_playlist_t *pl, uint32_t index, char *buf, size_t len)
+{
+    char line[M3U_LINE_MAX];
+    char conv[M3U_LINE_MAX];
+
+    if (index >= pl->count) {
+        return -1;
+    }
+
+    FILE *fp = fopen(pl->path, "rb");
+    if (fp == NULL) {
+        return -1;
+    }
+    bool ok = fseek(fp, (long)pl->offsets[index], SEEK_SET) == 0 && fgets(line, sizeof(line), fp) != NULL;
+    fclose(fp);
+    if (!ok) {
+        return -1;
+    }
+
+    size_t n = strcspn(line, "\r\n");
+    while (n > 0 && (line[n - 1] == ' ' || line[n - 1] == '\t')) {
+        n--;
+    }
+    line[n] = '\0';
+
+    char *entry = line;
+    if (!is_valid_utf8((const uint8_t *)line)) {
+        latin1_to_utf8(line, conv, sizeof(conv));
+        entry = conv;
+    }
+    for (char *p = entry; *p; p++) {
+        if (*p == '\\') {
+            *p = '/';
+        }
+    }
+    if (strncasecmp(entry, "file://", 7) == 0) {
+        entry += 7;
+        url_decode(entry);
+    }
+    if (((entry[0] | 0x20) >= 'a' && (entry[0] | 0x20) <= 'z') && entry[1] == ':' && entry[2] == '/') {
+        entry += 2;     // 盘符视为卡的根目录
+    }
+
+    size_t root_len = strlen(pl->root);
+    int r;
+    if (entry[0] == '/') {
+        bool has_root = strncmp(entry, pl->root, root_len) == 0 && (entry[root_len] == '/' || entry[root_len] == '\0');
+        r = snprintf(buf, len, "%s%s", has_root ? "" : pl->root, entry);
+    } else {
+        r = snprintf(buf, len, "%s/%s", pl->dir, entry);
+    }
+    if (r < 0 || (size_t)r >= len) {
+        return -1;
+    }
+    if (buf[0] == '/') {
+        normalize_path(buf);
+    }
+    return (int)strlen(buf);
+}
+
+bool m3u_playlist_is_playlist(const char *name)
+{
+    const char *dot = strrchr(name, '.');
+    return dot && (strcasecmp(dot, ".m3u") == 0 || strcasecmp(dot, ".m3u8") == 0);
+}
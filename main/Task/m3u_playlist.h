@@ -0,0 +1,66 @@
+// main/task/m3u_playlist.h
+#ifndef M3U_PLAYLIST_H
+#define M3U_PLAYLIST_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
+#include "esp_err.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define M3U_PATH_MAX        128     // 播放列表文件本身的路径长度上限
+#define M3U_LINE_MAX        512     // 单个条目的最大长度
+
+/**
+ * @brief 打开的 M3U/M3U8 播放列表
+ *
+ * 打开时只用固定大小的缓冲区顺序读一遍文件，记录每个条目所在行的文件偏移；
+ * 路径在播放到该条目时才重新读出并解析，每个条目只占 4 字节。
+ */
+typedef struct {
+    char path[M3U_PATH_MAX];    // 播放列表文件
+    char dir[M3U_PATH_MAX];     // 所在目录，用于解析相对路径
+    char root[16];              // 挂载点，用于解析以 '/' 开头的路径
+    uint32_t *offsets;          // 第 i 个条目在文件中的偏移
+    uint32_t count;
+    uint32_t cap;
+} m3u_playlist_t;
+
+/**
+ * @brief 扫描播放列表文件，记录所有条目的位置
+ * @param path 文件的 VFS 路径，如 "/sdcard/Lists/road.m3u8"
+ * @param root 挂载点，如 BSP_SD_MOUNT_POINT
+ */
+esp_err_t m3u_playlist_open(m3u_playlist_t *pl, const char *path, const char *root);
+
+void m3u_playlist_close(m3u_playlist_t *pl);
+
+static inline uint32_t m3u_playlist_count(const m3u_playlist_t *pl)
+{
+    return pl->count;
+}
+
+/**
+ * @brief 读出第 index 个条目并解析为完整的 VFS 路径
+ *
+ * 支持相对路径 (相对播放列表所在目录)、以 '/' 开头的卡内绝对路径、
+ * Windows 风格的 "X:\..." 和 file:// URL；'\' 视为目录分隔符，
+ * "." 和 ".." 会被规整掉。不检查文件是否存在。
+ *
+ * @return 路径长度，失败返回 -1
+ */
+int m3u_playlist_entry_path(const m3u_playlist_t *pl, uint32_t index, char *buf, size_t len);
+
+/**
+ * @brief 按扩展名判断是否为 M3U/M3U8 播放列表
+ */
+bool m3u_playlist_is_playlist(const char *name);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // M3U_PLAYLIST_H
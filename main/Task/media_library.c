@@ -0,0 +1,822 @@
+// main/task/media_library.c
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <unistd.h>
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "freertos/semphr.h"
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "esp_heap_caps.h"
+#include "esp_rom_crc.h"
+#include "ff.h"
+#include "sdkconfig.h"
+
+#include "esp32_s3_hpy.h"
+#include "media_library.h"
+#include "media_meta.h"
+#include "media_tags.h"
+#include "media_views.h"
+#include "media_probe.h"
+#include "sd_hotplug.h"
+
+static const char *TAG = "MEDIA_LIB";
+
+#define INDEX_MAGIC         0x42494C4D  // "MLIB"
+#define INDEX_VERSION       3
+#define INDEX_TMP_FILE      ".library.tmp"
+
+#define SCAN_TASK_STACK     4096
+#define SCAN_TASK_PRIORITY  1       // 低于 LVGL 和音频任务，只占用空闲时间
+
+#define FNV_OFFSET_BASIS    2166136261u
+#define FNV_PRIME           16777619u
+
+/*
+ * 索引文件格式 (小端):
+ *   index_header_t
+ *   media_dir_t   dirs[dir_count]
+ *   media_track_t tracks[track_count]
+ *   char          pool[pool_size]      以 '\0' 结尾的字符串，目录路径和文件名
+ * 各部分依次紧挨存放，整个文件一次顺序读入即可直接使用。
+ */
+typedef struct {
+    uint32_t magic;
+    uint16_t version;
+    uint16_t header_size;
+    uint32_t dir_count;
+    uint32_t track_count;
+    uint32_t pool_size;
+    uint32_t serial;        // 建立索引时卡的序列号
+    uint32_t crc;           // 头部之后所有数据的 CRC32
+} index_header_t;
+
+typedef struct {
+    void *blob;             // 从文件加载时三张表共用这一块内存，否则为 NULL
+    media_dir_t *dirs;
+    uint32_t dir_count;
+    uint32_t dir_cap;
+    media_track_t *tracks;
+    uint32_t track_count;
+    uint32_t track_cap;
+    char *pool;
+    uint32_t pool_size;
+    uint32_t pool_cap;
+    uint32_t serial;        // 所属卡的序列号 (bsp_sdcard_serial)
+    uint32_t crc;           // 最近一次加载或保存时的 CRC，作为元数据缓存文件的键
+} media_index_t;
+
+static char s_root[32];
+static media_index_t s_index;
+static TaskHandle_t s_task;
+static volatile bool s_online;  // 卡拔出后置为 false，进行中的扫描尽快结束
+static bool s_meta_complete;    // 标签、视图和码流信息已针对 s_index 完整建立
+
+/* s_index 只由扫描任务修改，修改和其他任务的读取都在 s_lock 下进行 */
+static SemaphoreHandle_t s_lock;
+static media_library_cb_t s_cb;
+static void *s_cb_ctx;
+
+/* 扫描用的暂存区：FILINFO 带 255 字节长文件名，不放在调用者的栈上 */
+static FILINFO s_fno;
+static char s_fs_path[MEDIA_LIBRARY_MAX_PATH + 4];
+static char s_dir_path[MEDIA_LIBRARY_MAX_PATH];
+static char s_child_path[MEDIA_LIBRARY_MAX_PATH];
+static char s_track_path[MEDIA_LIBRARY_PATH_LEN];
+static media_tags_t s_tags;
+
+/* =========================== 内存管理 =========================== */
+// 曲库可能有上万条记录，优先放在 PSRAM
+static void *lib_realloc(void *ptr, size_t size)
+{
+    void *p = heap_caps_realloc(ptr, size, MALLOC_CAP_SPIRAM | MALLOC_CAP_8BIT);
+    return p ? p : realloc(ptr, size);
+}
+
+static bool grow(void **array, uint32_t *cap, uint32_t need, size_t elem_size)
+{
+    if (need <= *cap) {
+        return true;
+    }
+    uint32_t n = *cap ? *cap : 64;
+    while (n < need) {
+        n *= 2;
+    }
+    void *p = lib_realloc(*array, (size_t)n * elem_size);
+    if (p == NULL) {
+        return false;
+    }
+    *array = p;
+    *cap = n;
+    return true;
+}
+
+static void index_free(media_index_t *idx)
+{
+    if (idx->blob) {
+        free(idx->blob);
+    } else {
+        free(idx->dirs);
+        free(idx->tracks);
+        free(idx->pool);
+    }
+    memset(idx, 0, sizeof(*idx));
+}
+
+static uint32_t pool_add(media_index_t *idx, const char *str)
+{
+    uint32_t len = strlen(str) + 1;
+    if (!grow((void **)&idx->pool, &idx->pool_cap, idx->pool_size + len, 1)) {
+        return UINT32_MAX;
+    }
+    uint32_t off = idx->pool_size;
+    memcpy(idx->pool + off, str, len);
+    idx->pool_size += len;
+    return off;
+}
+
+static int add_dir(media_index_t *idx, const char *rel_path)
+{
+    if (idx->dir_count >= MEDIA_LIBRARY_MAX_DIRS ||
+        !grow((void **)&idx->dirs, &idx->dir_cap, idx->dir_count + 1, sizeof(media_dir_t))) {
+        return -1;
+    }
+    uint32_t off = pool_add(idx, rel_path);
+    if (off == UINT32_MAX) {
+        return -1;
+    }
+    media_dir_t *dir = &idx->dirs[idx->dir_count];
+    memset(dir, 0, sizeof(*dir));
+    dir->path_off = off;
+    return idx->dir_count++;
+}
+
+static media_track_t *add_track(media_index_t *idx, const char *name, uint32_t dir)
+{
+    if (!grow((void **)&idx->tracks, &idx->track_cap, idx->track_count + 1, sizeof(media_track_t))) {
+        return NULL;
+    }
+    uint32_t off = pool_add(idx, name);
+    if (off == UINT32_MAX) {
+        return NULL;
+    }
+    media_track_t *t = &idx->tracks[idx->track_count++];
+    memset(t, 0, sizeof(*t));
+    t->name_off = off;
+    t->dir = (uint16_t)dir;
+    return t;
+}
+
+static uint32_t fnv1a(uint32_t h, const void *data, size_t len)
+{
+    const uint8_t *p = (const uint8_t *)data;
+    while (len--) {
+        h = (h ^ *p++) * FNV_PRIME;
+    }
+    return h;
+}
+
+static inline void lib_lock(void)
+{
+    xSemaphoreTake(s_lock, portMAX_DELAY);
+}
+
+static inline void lib_unlock(void)
+{
+    xSemaphoreGive(s_lock);
+}
+
+static void notify(media_library_event_t event, uint32_t first, uint32_t count)
+{
+    if (s_cb) {
+        s_cb(event, first, count, s_cb_ctx);
+    }
+}
+
+/* =========================== 索引文件 =========================== */
+static esp_err_t index_load(media_index_t *idx)
+{
+    char path[64];
+    snprintf(path, sizeof(path), "%s/%s", s_root, MEDIA_LIBRARY_INDEX_FILE);
+    FILE *fp = fopen(path, "rb");
+    if (fp == NULL) {
+        return ESP_ERR_NOT_FOUND;
+    }
+
+    esp_err_t ret = ESP_OK;
+    void *blob = NULL;
+    index_header_t hdr;
+    if (fread(&hdr, 1, sizeof(hdr), fp) != sizeof(hdr) ||
+        hdr.magic != INDEX_MAGIC || hdr.version != INDEX_VERSION ||
+        hdr.header_size != sizeof(hdr) || hdr.dir_count > MEDIA_LIBRARY_MAX_DIRS) {
+        ret = ESP_ERR_INVALID_VERSION;
+        goto out;
+    }
+
+    size_t dirs_bytes = (size_t)hdr.dir_count * sizeof(media_dir_t);
+    size_t tracks_bytes = (size_t)hdr.track_count * sizeof(media_track_t);
+    size_t total = dirs_bytes + tracks_bytes + hdr.pool_size;
+    blob = lib_realloc(NULL, total ? total : 1);
+    if (blob == NULL) {
+        ret = ESP_ERR_NO_MEM;
+        goto out;
+    }
+    if (fread(blob, 1, total, fp) != total) {
+        ret = ESP_ERR_INVALID_SIZE;
+        goto out;
+    }
+    if (esp_rom_crc32_le(0, blob, total) != hdr.crc) {
+        ret = ESP_ERR_INVALID_CRC;
+        goto out;
+    }
+
+    media_dir_t *dirs = (media_dir_t *)blob;
+    media_track_t *tracks = (media_track_t *)((uint8_t *)blob + dirs_bytes);
+    char *pool = (char *)blob + dirs_bytes + tracks_bytes;
+
+    // CRC 只能防止损坏，偏移越界仍需检查，避免后续访问时越界
+    if (hdr.pool_size == 0 || pool[hdr.pool_size - 1] != '\0') {
+        ret = ESP_ERR_INVALID_STATE;
+        goto out;
+    }
+    for (uint32_t i = 0; i < hdr.dir_count; i++) {
+        if (dirs[i].path_off >= hdr.pool_size ||
+            dirs[i].first_track + dirs[i].track_count > hdr.track_count) {
+            ret = ESP_ERR_INVALID_STATE;
+            goto out;
+        }
+    }
+    for (uint32_t i = 0; i < hdr.track_count; i++) {
+        if (tracks[i].name_off >= hdr.pool_size || tracks[i].dir >= hdr.dir_count) {
+            ret = ESP_ERR_INVALID_STATE;
+            goto out;
+        }
+    }
+
+    memset(idx, 0, sizeof(*idx));
+    idx->blob = blob;
+    idx->dirs = dirs;
+    idx->dir_count = hdr.dir_count;
+    idx->tracks = tracks;
+    idx->track_count = hdr.track_count;
+    idx->pool = pool;
+    idx->pool_size = hdr.pool_size;
+    idx->serial = hdr.serial;
+    idx->crc = hdr.crc;
+    blob = NULL;
+
+out:
+    free(blob);
+    fclose(fp);
+    return ret;
+}
+
+static esp_err_t index_save(media_index_t *idx)
+{
+    char tmp_path[64];
+    char path[64];
+    snprintf(tmp_path, sizeof(tmp_path), "%s/%s", s_root, INDEX_TMP_FILE);
+    snprintf(path, sizeof(path), "%s/%s", s_root, MEDIA_LIBRARY_INDEX_FILE);
+
+    index_header_t hdr = {
+        .magic = INDEX_MAGIC,
+        .version = INDEX_VERSION,
+        .header_size = sizeof(index_header_t),
+        .dir_count = idx->dir_count,
+        .track_count = idx->track_count,
+        .pool_size = idx->pool_size,
+        .serial = idx->serial,
+    };
+    size_t dirs_bytes = (size_t)idx->dir_count * sizeof(media_dir_t);
+    size_t tracks_bytes = (size_t)idx->track_count * sizeof(media_track_t);
+    hdr.crc = esp_rom_crc32_le(0, (const uint8_t *)idx->dirs, dirs_bytes);
+    hdr.crc = esp_rom_crc32_le(hdr.crc, (const uint8_t *)idx->tracks, tracks_bytes);
+    hdr.crc = esp_rom_crc32_le(hdr.crc, (const uint8_t *)idx->pool, idx->pool_size);
+    idx->crc = hdr.crc;
+
+    FILE *fp = fopen(tmp_path, "wb");
+    if (fp == NULL) {
+        return ESP_FAIL;
+    }
+    bool ok = fwrite(&hdr, 1, sizeof(hdr), fp) == sizeof(hdr) &&
+              fwrite(idx->dirs, 1, dirs_bytes, fp) == dirs_bytes &&
+              fwrite(idx->tracks, 1, tracks_bytes, fp) == tracks_bytes &&
+              fwrite(idx->pool, 1, idx->pool_size, fp) == idx->pool_size;
+    ok = (fclose(fp) == 0) && ok;
+
+    // 先写临时文件再替换，掉电时最多丢失新索引，下次启动重新扫描即可
+    if (ok) {
+        unlink(path);
+        ok = rename(tmp_path, path) == 0;
+    }
+    if (!ok) {
+        unlink(tmp_path);
+        return ESP_FAIL;
+    }
+    return ESP_OK;
+}
+
+/* =========================== 目录扫描 =========================== */
+static const media_dir_t *find_old_dir(const media_index_t *old, const char *rel_path, uint32_t hint)
+{
+    // 目录未增删时遍历顺序不变，先试同一序号
+    if (hint < old->dir_count && strcmp(old->pool + old->dirs[hint].path_off, rel_path) == 0) {
+        return &old->dirs[hint];
+    }
+    for (uint32_t i = 0; i < old->dir_count; i++) {
+        if (strcmp(old->pool + old->dirs[i].path_off, rel_path) == 0) {
+            return &old->dirs[i];
+        }
+    }
+    return NULL;
+}
+
+// 与旧索引中的同名目录比较，签名或曲目数不同即视为有变化
+static bool dir_changed(const media_index_t *old, const media_index_t *idx, uint32_t d)
+{
+    const media_dir_t *dir = &idx->dirs[d];
+    const media_dir_t *od = find_old_dir(old, idx->pool + dir->path_off, d);
+
+    return od == NULL || od->signature != dir->signature || od->track_count != dir->track_count;
+}
+
+/**
+ * 求出新索引中每首曲目在旧索引中的序号，没有对应曲目时为 MEDIA_META_NO_ENTRY。
+ * 目录没变时按位置对应；变化的目录只对名称、大小和修改时间都没变的文件沿用。
+ */
+static uint32_t *map_tracks(const media_index_t *old, const media_index_t *idx)
+{
+    uint32_t *from = lib_realloc(NULL, (size_t)(idx->track_count ? idx->track_count : 1) * sizeof(uint32_t));
+    if (from == NULL) {
+        return NULL;
+    }
+
+    for (uint32_t d = 0; d < idx->dir_count; d++) {
+        const media_dir_t *dir = &idx->dirs[d];
+        const media_dir_t *od = find_old_dir(old, idx->pool + dir->path_off, d);
+        bool same = !dir_changed(old, idx, d);
+
+        for (uint32_t i = 0; i < dir->track_count; i++) {
+            const media_track_t *t = &idx->tracks[dir->first_track + i];
+            uint32_t *f = &from[dir->first_track + i];
+            *f = same ? od->first_track + i : MEDIA_META_NO_ENTRY;
+            for (uint32_t j = 0; !same && od && j < od->track_count; j++) {
+                const media_track_t *o = &old->tracks[od->first_track + j];
+                if (o->size == t->size && o->mtime == t->mtime &&
+                    strcmp(old->pool + o->name_off, idx->pool + t->name_off) == 0) {
+                    *f = od->first_track + j;
+                    break;
+                }
+            }
+        }
+    }
+    return from;
+}
+
+/**
+ * 广度优先遍历目录树。直接使用 FatFs 的 f_readdir，
+ * 它在读目录项时就带出了大小和修改时间，不必对每个文件再 stat() 一次。
+ *
+ * publish 为 true 时 idx 就是 s_index：修改在锁内进行，
+ * 每凑满 MEDIA_LIBRARY_BATCH 首或读完一个目录就发出 TRACKS_ADDED。
+ */
+static esp_err_t scan_tree(const media_index_t *old, media_index_t *idx, bool publish, uint32_t *changed_dirs)
+{
+    const char *drive = bsp_sdcard_fatfs_drive();
+    uint32_t published = idx->track_count;
+    esp_err_t ret = ESP_OK;
+
+    if (publish) lib_lock();
+    int root = add_dir(idx, "");
+    if (publish) lib_unlock();
+    if (root < 0) {
+        return ESP_ERR_NO_MEM;
+    }
+
+    for (uint32_t d = 0; d < idx->dir_count && ret == ESP_OK; d++) {
+        // 添加记录会重新分配字符串池，先把路径拷出来
+        strlcpy(s_dir_path, idx->pool + idx->dirs[d].path_off, sizeof(s_dir_path));
+        snprintf(s_fs_path, sizeof(s_fs_path), "%s/%s", drive, s_dir_path);
+
+        FF_DIR dir;
+        if (f_opendir(&dir, s_fs_path) != FR_OK) {
+            if (d == 0) {
+                ESP_LOGE(TAG, "无法打开根目录 %s", s_fs_path);
+                return ESP_FAIL;
+            }
+            ESP_LOGW(TAG, "无法打开目录 %s", s_fs_path);
+            continue;
+        }
+
+        uint32_t first = idx->track_count;
+        uint32_t sig = FNV_OFFSET_BASIS;
+
+        // 拔卡后立即结束，卸载要等本任务关闭目录
+        while (s_online && f_readdir(&dir, &s_fno) == FR_OK && s_fno.fname[0] != '\0') {
+            if ((s_fno.fattrib & (AM_HID | AM_SYS)) || s_fno.fname[0] == '.') {
+                continue;
+            }
+            size_t name_len = strlen(s_fno.fname);
+
+            if (s_fno.fattrib & AM_DIR) {
+                int n = snprintf(s_child_path, sizeof(s_child_path), "%s%s%s",
+                                 s_dir_path, s_dir_path[0] ? "/" : "", s_fno.fname);
+                if (n < 0 || n >= (int)sizeof(s_child_path)) {
+                    ESP_LOGW(TAG, "路径过长，跳过目录: %s", s_fno.fname);
+                    continue;
+                }
+                sig = fnv1a(sig, s_fno.fname, name_len + 1);
+                sig = fnv1a(sig, "/", 1);
+
+                if (publish) lib_lock();
+                int added = add_dir(idx, s_child_path);
+                if (publish) lib_unlock();
+                if (added < 0) {
+                    ret = ESP_ERR_NO_MEM;
+                    break;
+                }
+            } else if (media_library_is_audio_file(s_fno.fname)) {
+                uint32_t size = (uint32_t)s_fno.fsize;
+                uint32_t mtime = ((uint32_t)s_fno.fdate << 16) | s_fno.ftime;
+                sig = fnv1a(sig, s_fno.fname, name_len + 1);
+                sig = fnv1a(sig, &size, sizeof(size));
+                sig = fnv1a(sig, &mtime, sizeof(mtime));
+
+                if (publish) lib_lock();
+                media_track_t *t = add_track(idx, s_fno.fname, d);
+                if (t) {
+                    t->size = size;
+                    t->mtime = mtime;
+                }
+                if (publish) lib_unlock();
+                if (t == NULL) {
+                    ret = ESP_ERR_NO_MEM;
+                    break;
+                }
+
+                if (publish && idx->track_count - published >= MEDIA_LIBRARY_BATCH) {
+                    notify(MEDIA_LIBRARY_EVENT_TRACKS_ADDED, published, idx->track_count - published);
+                    published = idx->track_count;
+                }
+            }
+        }
+        f_closedir(&dir);
+
+        // 记下这个目录已扫描的部分后结束，外层循环随之退出
+        if (ret == ESP_OK && !s_online) {
+            ret = ESP_ERR_INVALID_STATE;
+        } else if (ret != ESP_OK) {
+            ESP_LOGE(TAG, "内存不足，已扫描 %u 首曲目", (unsigned)idx->track_count);
+        }
+
+        if (publish) lib_lock();
+        idx->dirs[d].signature = sig;
+        idx->dirs[d].first_track = first;
+        idx->dirs[d].track_count = idx->track_count - first;
+        if (publish) lib_unlock();
+
+        if (dir_changed(old, idx, d)) {
+            (*changed_dirs)++;
+        }
+
+        if (publish && idx->track_count > published) {
+            notify(MEDIA_LIBRARY_EVENT_TRACKS_ADDED, published, idx->track_count - published);
+            published = idx->track_count;
+        }
+    }
+
+    return ret;
+}
+
+/* =========================== 对外接口 =========================== */
+bool media_library_is_audio_file(const char *name)
+{
+    // 解码器按文件头识别格式，这里只做初筛
+    const char *dot = strrchr(name, '.');
+    if (dot == NULL) {
+        return false;
+    }
+    return strcasecmp(dot, ".mp3") == 0 ||
+           strcasecmp(dot, ".flac") == 0 ||
+           strcasecmp(dot, ".wav") == 0
+#if CONFIG_AUDIO_PLAYER_ENABLE_AAC
+           || strcasecmp(dot, ".m4a") == 0
+#endif
+           ;
+}
+
+esp_err_t media_library_refresh(bool *changed)
+{
+    media_index_t empty;
+    media_index_t fresh;
+    memset(&empty, 0, sizeof(empty));
+    memset(&fresh, 0, sizeof(fresh));
+    uint32_t changed_dirs = 0;
+
+    // 没有可用的索引时直接在 s_index 上构建，边扫描边发布；
+    // 否则在副本上构建，结束后整体替换，扫描期间旧曲库一直可用
+    bool cold = (s_index.dir_count == 0);
+    media_index_t *target = cold ? &s_index : &fresh;
+
+    int64_t t0 = esp_timer_get_time();
+    target->serial = bsp_sdcard_serial();
+    esp_err_t ret = scan_tree(cold ? &empty : &s_index, target, cold, &changed_dirs);
+    if (!s_online) {
+        // 扫描途中卡被拔出，结果不完整
+        ret = ESP_ERR_INVALID_STATE;
+    }
+    if (ret != ESP_OK && !cold) {
+        index_free(&fresh);
+        return ret;
+    }
+
+    // 删除目录会改变父目录的签名，所以只需比较目录数
+    bool diff = cold || changed_dirs > 0 || fresh.dir_count != s_index.dir_count;
+    ESP_LOGI(TAG, "扫描完成: %u 个目录, %u 首曲目, %u 个目录有变化, 用时 %lld ms",
+             (unsigned)target->dir_count, (unsigned)target->track_count, (unsigned)changed_dirs,
+             (esp_timer_get_time() - t0) / 1000);
+
+    if (!cold) {
+        if (diff) {
+            // 元数据缓存随曲库一起换成新的序号，发出 RELOADED 时两者已经一致
+            uint32_t *from = map_tracks(&s_index, &fresh);
+            lib_lock();
+            index_free(&s_index);
+            s_index = fresh;
+            lib_unlock();
+            if (from == NULL || media_meta_remap(s_index.track_count, from) != ESP_OK) {
+                ESP_LOGW(TAG, "元数据缓存无法沿用，将重新读取全部标签");
+                media_meta_reset(0);
+            }
+            free(from);
+            notify(MEDIA_LIBRARY_EVENT_RELOADED, 0, s_index.track_count);
+        } else {
+            // 沿用从文件加载的紧凑副本
+            index_free(&fresh);
+        }
+    }
+
+    // 扫描不完整 (内存不足) 时不保存，下次启动重新扫描；crc 清零后也不会保存对应的元数据缓存
+    if (diff && (ret != ESP_OK || index_save(&s_index) != ESP_OK)) {
+        if (ret == ESP_OK) {
+            ESP_LOGW(TAG, "索引文件保存失败");
+        }
+        s_index.crc = 0;
+    }
+
+    if (changed) {
+        *changed = diff;
+    }
+    return ret;
+}
+
+// 读取尚未读取过标签的曲目，填充元数据缓存 (序号与曲库一致)
+static void scan_tags(void)
+{
+    uint32_t count = media_library_track_count();
+    uint32_t read = 0;
+    uint32_t tagged = 0;
+    int64_t t0 = esp_timer_get_time();
+
+    if (media_meta_count() != count && media_meta_reset(count) != ESP_OK) {
+        ESP_LOGE(TAG, "元数据缓存分配失败");
+        return;
+    }
+    for (uint32_t i = 0; i < count && s_online; i++) {
+        if (media_meta_tags_read(i) || media_library_track_path(i, s_track_path, sizeof(s_track_path)) < 0) {
+            continue;
+        }
+        esp_err_t ret = media_tags_read_file(s_track_path, &s_tags);
+        if (!s_online) {
+            break;
+        }
+        // 没有标签或无法解析的文件也记为已读取，下次不再重试
+        if (ret != ESP_OK) {
+            memset(&s_tags, 0, sizeof(s_tags));
+        }
+        if (media_meta_set(i, &s_tags) == ESP_OK) {
+            read++;
+            tagged += (ret == ESP_OK);
+        }
+    }
+    ESP_LOGI(TAG, "标签读取完成: 读取 %u/%u 首, 其中 %u 首有标签, 缓存 %u 字节, 用时 %lld ms",
+             (unsigned)read, (unsigned)count, (unsigned)tagged, (unsigned)media_meta_memory_usage(),
+             (esp_timer_get_time() - t0) / 1000);
+}
+
+static void meta_path(char *buf, size_t len)
+{
+    snprintf(buf, len, "%s/%s", s_root, MEDIA_LIBRARY_META_FILE);
+}
+
+// 载入与 s_index 对应的元数据缓存文件，成功时标签和码流信息都不必再从卡上读取
+static bool meta_load(void)
+{
+    char path[64];
+    meta_path(path, sizeof(path));
+    esp_err_t ret = media_meta_load(path, s_index.crc, s_index.track_count);
+    if (ret != ESP_OK) {
+        if (ret != ESP_ERR_NOT_FOUND) {
+            ESP_LOGW(TAG, "元数据缓存文件不可用 (%s)", esp_err_to_name(ret));
+        }
+        media_meta_reset(0);
+        return false;
+    }
+    if (media_views_build() != ESP_OK) {
+        ESP_LOGE(TAG, "排序视图内存不足");
+    }
+    return true;
+}
+
+/**
+ * 加载/刷新一遍曲库。内存中的曲库属于同一张卡时直接与它比较，
+ * 只有签名变化的目录才重建记录，也只为其中新增或修改过的曲目读取标签。
+ * 换了一张卡时丢弃旧曲库，改从新卡上的索引文件和元数据缓存文件加载。
+ */
+static void library_pass(void)
+{
+    int64_t t0 = esp_timer_get_time();
+    uint32_t serial = bsp_sdcard_serial();
+    bool same_card = s_index.dir_count > 0 && s_index.serial == serial;
+
+    if (!same_card) {
+        if (s_index.dir_count > 0) {
+            ESP_LOGI(TAG, "卡已更换 (%08lx -> %08lx)，重新加载曲库",
+                     (unsigned long)s_index.serial, (unsigned long)serial);
+            lib_lock();
+            index_free(&s_index);
+            lib_unlock();
+            notify(MEDIA_LIBRARY_EVENT_RELOADED, 0, 0);
+        }
+        s_meta_complete = false;
+
+        media_index_t loaded;
+        memset(&loaded, 0, sizeof(loaded));
+        esp_err_t ret = index_load(&loaded);
+        if (ret == ESP_OK && loaded.serial != serial) {
+            index_free(&loaded);
+            ret = ESP_ERR_INVALID_VERSION;
+        }
+        if (ret == ESP_OK) {
+            lib_lock();
+            s_index = loaded;
+            lib_unlock();
+            s_meta_complete = meta_load();
+            ESP_LOGI(TAG, "已加载索引: %u 个目录, %u 首曲目%s, 用时 %lld ms",
+                     (unsigned)s_index.dir_count, (unsigned)s_index.track_count,
+                     s_meta_complete ? " (含元数据)" : "", (esp_timer_get_time() - t0) / 1000);
+            notify(MEDIA_LIBRARY_EVENT_LOADED, 0, s_index.track_count);
+        } else {
+            if (ret != ESP_ERR_NOT_FOUND) {
+                ESP_LOGW(TAG, "索引文件无效 (%s)，将完整扫描", esp_err_to_name(ret));
+            }
+            media_meta_reset(0);
+        }
+    }
+
+    bool changed = false;
+    if (media_library_refresh(&changed) != ESP_OK) {
+        ESP_LOGE(TAG, "曲库扫描失败");
+    }
+    notify(MEDIA_LIBRARY_EVENT_DONE, 0, media_library_track_count());
+
+    if (!changed && s_meta_complete) {
+        ESP_LOGI(TAG, "曲库没有变化，沿用已有的标签和码流信息");
+        return;
+    }
+    scan_tags();
+    if (media_views_build() != ESP_OK) {
+        ESP_LOGE(TAG, "排序视图内存不足");
+    }
+    media_probe_scan(s_root);
+    s_meta_complete = s_online;
+
+    // 只在完整建立后保存，中途拔卡时下次启动重新读取
+    if (s_meta_complete && s_index.crc != 0) {
+        char path[64];
+        meta_path(path, sizeof(path));
+        if (media_meta_save(path, s_index.crc) != ESP_OK) {
+            ESP_LOGW(TAG, "元数据缓存文件保存失败");
+        }
+    }
+}
+
+static void media_library_task(void *arg)
+{
+    // 扫描、标签、码流探测和索引读写都在这一遍中，拔卡后各循环检查 s_online 尽快返回
+    for (;;) {
+        if (s_online && sd_hotplug_io_begin()) {
+            library_pass();
+            sd_hotplug_io_end();
+        }
+        ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+    }
+}
+
+esp_err_t media_library_start(const char *root, media_library_cb_t cb, void *ctx)
+{
+    if (s_lock == NULL) {
+        s_lock = xSemaphoreCreateMutex();
+        if (s_lock == NULL) {
+            return ESP_ERR_NO_MEM;
+        }
+    }
+    esp_err_t ret = media_meta_init();
+    if (ret == ESP_OK) {
+        ret = media_views_init();
+    }
+    if (ret != ESP_OK) {
+        return ret;
+    }
+    strlcpy(s_root, root, sizeof(s_root));
+    s_cb = cb;
+    s_cb_ctx = ctx;
+    s_online = bsp_sdcard_is_present();
+
+    BaseType_t ok = xTaskCreate(media_library_task, "media_lib", SCAN_TASK_STACK, NULL, SCAN_TASK_PRIORITY, &s_task);
+    if (ok != pdPASS) {
+        ESP_LOGE(TAG, "创建曲库扫描任务失败");
+        return ESP_FAIL;
+    }
+    return ESP_OK;
+}
+
+void media_library_set_online(bool online)
+{
+    s_online = online;
+}
+
+bool media_library_is_online(void)
+{
+    return s_online;
+}
+
+esp_err_t media_library_rescan(void)
+{
+    if (s_task == NULL) {
+        return ESP_ERR_INVALID_STATE;
+    }
+    xTaskNotifyGive(s_task);
+    return ESP_OK;
+}
+
+void media_library_lock(media_library_view_t *view)
+{
+    lib_lock();
+    view->dirs = s_index.dirs;
+    view->dir_count = s_index.dir_count;
+    view->tracks = s_index.tracks;
+    view->track_count = s_index.track_count;
+    view->pool = s_index.pool;
+    view->pool_size = s_index.pool_size;
+}
+
+void media_library_unlock(void)
+{
+    lib_unlock();
+}
+
+uint32_t media_library_track_count(void)
+{
+    lib_lock();
+    uint32_t count = s_index.track_count;
+    lib_unlock();
+    return count;
+}
+
+bool media_library_get_track(uint32_t index, media_track_t *out)
+{
+    lib_lock();
+    bool ok = index < s_index.track_count;
+    if (ok) {
+        *out = s_index.tracks[index];
+    }
+    lib_unlock();
+    return ok;
+}
+
+int media_library_track_name(uint32_t index, char *buf, size_t len)
+{
+    int n = -1;
+    lib_lock();
+    if (index < s_index.track_count) {
+        n = snprintf(buf, len, "%s", s_index.pool + s_index.tracks[index].name_off);
+    }
+    lib_unlock();
+    return (n < 0 || (size_t)n >= len) ? -1 : n;
+}
+
+int media_library_track_path(uint32_t index, char *buf, size_t len)
+{
+    int n = -1;
+    lib_lock();
+    if (index < s_index.track_count) {
+        const media_track_t *t = &s_index.tracks[index];
+        const char *dir = s_index.pool + s_index.dirs[t->dir].path_off;
+        n = snprintf(buf, len, "%s/%s%s%s", s_root, dir, dir[0] ? "/" : "", s_index.pool + t->name_off);
+    }
+    lib_unlock();
+    return (n < 0 || (size_t)n >= len) ? -1 : n;
+}
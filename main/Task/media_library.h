@@ -0,0 +1,139 @@
+// main/task/media_library.h
+#ifndef MEDIA_LIBRARY_H
+#define MEDIA_LIBRARY_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
+#include "esp_err.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define MEDIA_LIBRARY_INDEX_FILE    ".library.idx"  // 位于 SD 卡根目录
+#define MEDIA_LIBRARY_META_FILE     ".library.meta" // 与索引对应的标签和码流信息缓存，同在根目录
+#define MEDIA_LIBRARY_MAX_DIRS      65535
+#define MEDIA_LIBRARY_MAX_PATH      256
+#define MEDIA_LIBRARY_PATH_LEN      (MEDIA_LIBRARY_MAX_PATH + 272)  // 完整路径: 挂载点 + 目录 + 长文件名
+
+#define MEDIA_LIBRARY_BATCH         32              // 冷启动扫描时每批发布的曲目数
+
+/**
+ * @brief 曲目记录 (定长，与索引文件中的格式一致)
+ */
+typedef struct {
+    uint32_t name_off;      // 文件名在字符串池中的偏移
+    uint32_t size;          // 文件大小 (字节)
+    uint32_t mtime;         // FAT 修改时间: 日期 << 16 | 时间
+    uint16_t dir;           // 所在目录的序号
+    uint16_t reserved;      // 填充，写 0
+} media_track_t;
+
+/**
+ * @brief 目录记录，同一目录下的曲目在曲目表中连续存放
+ */
+typedef struct {
+    uint32_t path_off;      // 相对挂载点的路径在字符串池中的偏移 (根目录为 "")
+    uint32_t signature;     // 目录项 (名称/大小/修改时间) 的哈希，用于判断目录是否变化
+    uint32_t first_track;
+    uint32_t track_count;
+} media_dir_t;
+
+typedef enum {
+    MEDIA_LIBRARY_EVENT_LOADED,         // 已从索引文件加载曲库 [0, count)
+    MEDIA_LIBRARY_EVENT_TRACKS_ADDED,   // 无索引时边扫描边发布，新增曲目 [first, first + count)
+    MEDIA_LIBRARY_EVENT_RELOADED,       // 刷新发现变化，曲库已整体替换为 [0, count)
+    MEDIA_LIBRARY_EVENT_DONE,           // 扫描结束，count 为曲目总数
+} media_library_event_t;
+
+/**
+ * @brief 曲库事件回调
+ * @note  在扫描任务中调用，回调内可以调用 media_library_* 读取接口
+ */
+typedef void (*media_library_cb_t)(media_library_event_t event, uint32_t first, uint32_t count, void *ctx);
+
+/**
+ * @brief 判断文件名是否为播放器支持的音频格式 (按扩展名初筛)
+ */
+bool media_library_is_audio_file(const char *name);
+
+/**
+ * @brief 创建低优先级后台任务加载并刷新曲库，立即返回
+ *
+ * 索引文件有效时只需一次顺序读取即可得到完整曲库 (LOADED)；随后逐目录比较签名，
+ * 只有内容发生变化的目录才重新建立记录，其余目录沿用原有记录，
+ * 有变化时写回索引文件并发出 RELOADED。没有索引时边扫描边按批发布 (TRACKS_ADDED)。
+ * 与索引匹配的 MEDIA_LIBRARY_META_FILE 在 LOADED 时一并载入 media_meta，曲库没有变化就不再读卡。
+ * 否则 DONE 之后只读取新增或修改过的曲目的标签，再探测它们的时长和码率
+ * (见 media_probe_scan)，完成后写回元数据缓存文件。
+ *
+ * @param root 挂载点，如 BSP_SD_MOUNT_POINT
+ * @param cb   事件回调，可为 NULL
+ */
+esp_err_t media_library_start(const char *root, media_library_cb_t cb, void *ctx);
+
+/**
+ * @brief 重新遍历目录树并与当前索引比较，有变化时保存索引 (同步执行)
+ * @param[out] changed 可为 NULL，返回曲库是否发生变化
+ */
+esp_err_t media_library_refresh(bool *changed);
+
+/**
+ * @brief 标记卡是否在位。拔卡时置为 false，正在进行的扫描、标签读取和码流探测会尽快结束
+ */
+void media_library_set_online(bool online);
+
+bool media_library_is_online(void);
+
+/**
+ * @brief 请求曲库任务重新加载一遍，立即返回 (用于重新插卡后)
+ *
+ * 同一张卡 (序列号相同) 时与内存中的曲库逐目录比较签名，只重建变化的目录，
+ * 只为变化目录中新增或修改过的曲目读取标签；换了卡则改从新卡上的索引文件加载。
+ */
+esp_err_t media_library_rescan(void);
+
+/**
+ * @brief 曲库的只读视图，用于排序等需要批量访问的场合
+ */
+typedef struct {
+    const media_dir_t *dirs;
+    uint32_t dir_count;
+    const media_track_t *tracks;
+    uint32_t track_count;
+    const char *pool;
+    uint32_t pool_size;
+} media_library_view_t;
+
+/**
+ * @brief 加锁并取得曲库的只读视图
+ * @note  视图在 media_library_unlock() 之前有效，期间不要调用其他 media_library_* 接口
+ */
+void media_library_lock(media_library_view_t *view);
+
+void media_library_unlock(void);
+
+/* 以下读取接口均为线程安全，结果拷贝到调用者的缓冲区 */
+
+uint32_t media_library_track_count(void);
+
+bool media_library_get_track(uint32_t index, media_track_t *out);
+
+/**
+ * @brief 拷贝曲目的文件名 (不含目录)
+ * @return 名称长度，失败返回 -1
+ */
+int media_library_track_name(uint32_t index, char *buf, size_t len);
+
+/**
+ * @brief 拼出曲目的完整 VFS 路径，如 "/sdcard/Album/01.mp3"
+ * @return 路径长度，失败返回 -1
+ */
+int media_library_track_path(uint32_t index, char *buf, size_t len);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // MEDIA_LIBRARY_H
@@ -0,0 +1,582 @@
+// main/task/media_meta.c
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdbool.h>
+#include <unistd.h>
+#include "freertos/FreeRTOS.h"
+#include "freertos/semphr.h"
+#include "esp_log.h"
+#include "esp_heap_caps.h"
+#include "esp_rom_crc.h"
+
+#include "media_meta.h"
+
+static const char *TAG = "MEDIA_META";
+
+#define POOL_MIN_CAP        4096
+#define STRINGS_MIN_CAP     64
+#define BUCKETS_MIN         128
+#define MAX_STRINGS         UINT16_MAX  // 编号为 16 位，桶里保存编号 + 1
+
+#define CACHE_MAGIC         0x4741544D  // "MTAG"
+#define CACHE_VERSION       1
+
+#define FNV_OFFSET_BASIS    2166136261u
+#define FNV_PRIME           16777619u
+
+/*
+ * 缓存文件格式 (小端):
+ *   cache_header_t
+ *   title[count] artist[count] album[count] track_no[count]
+ *   duration_ms[count] bitrate_kbps[count] sample_rate[count] flags[count]
+ *   strings[string_count]
+ *   char pool[pool_size]
+ * 哈希表不保存，加载后按 strings[] 重新建立。
+ */
+typedef struct {
+    uint32_t magic;
+    uint16_t version;
+    uint16_t header_size;
+    uint32_t key;           // 调用者给出的键，与所属曲库索引对应
+    uint32_t count;
+    uint32_t string_count;
+    uint32_t pool_size;
+    uint32_t crc;           // 头部之后所有数据的 CRC32
+} cache_header_t;
+
+typedef struct {
+    void *ptr;
+    size_t elem_size;
+} cache_array_t;
+
+static media_meta_t s_meta;
+static SemaphoreHandle_t s_lock;
+
+/* =========================== 内存管理 =========================== */
+static void *meta_realloc(void *ptr, size_t size)
+{
+    void *p = heap_caps_realloc(ptr, size, MALLOC_CAP_SPIRAM | MALLOC_CAP_8BIT);
+    return p ? p : realloc(ptr, size);
+}
+
+static void meta_free(media_meta_t *m)
+{
+    free(m->title);
+    free(m->artist);
+    free(m->album);
+    free(m->track_no);
+    free(m->duration_ms);
+    free(m->bitrate_kbps);
+    free(m->sample_rate);
+    free(m->flags);
+    free(m->pool);
+    free(m->strings);
+    free(m->buckets);
+    memset(m, 0, sizeof(*m));
+}
+
+// 按 1.5 倍扩容
+static bool grow(void **array, uint32_t *cap, uint32_t need, size_t elem_size, uint32_t min_cap)
+{
+    if (need <= *cap) {
+        return true;
+    }
+    uint32_t n = *cap ? *cap : min_cap;
+    while (n < need) {
+        n += n / 2 + 1;
+    }
+    void *p = meta_realloc(*array, (size_t)n * elem_size);
+    if (p == NULL) {
+        return false;
+    }
+    *array = p;
+    *cap = n;
+    return true;
+}
+
+static uint32_t pool_add(media_meta_t *m, const char *str)
+{
+    uint32_t len = (uint32_t)strlen(str) + 1;
+    if (!grow((void **)&m->pool, &m->pool_cap, m->pool_size + len, 1, POOL_MIN_CAP)) {
+        return UINT32_MAX;
+    }
+    uint32_t off = m->pool_size;
+    memcpy(m->pool + off, str, len);
+    m->pool_size += len;
+    return off;
+}
+
+/* =========================== 字符串驻留 =========================== */
+static uint32_t hash_str(const char *s)
+{
+    uint32_t h = FNV_OFFSET_BASIS;
+    while (*s) {
+        h = (h ^ (uint8_t)*s++) * FNV_PRIME;
+    }
+    return h;
+}
+
+static void bucket_insert(uint16_t *buckets, uint32_t bucket_count, const char *str, uint16_t id)
+{
+    uint32_t i = hash_str(str) & (bucket_count - 1);
+    while (buckets[i] != 0) {
+        i = (i + 1) & (bucket_count - 1);
+    }
+    buckets[i] = (uint16_t)(id + 1);
+}
+
+// 装载率超过一半时加倍并重新散列
+static bool rehash(media_meta_t *m)
+{
+    uint32_t n = m->bucket_count ? m->bucket_count * 2 : BUCKETS_MIN;
+    uint16_t *b = heap_caps_calloc(n, sizeof(uint16_t), MALLOC_CAP_SPIRAM | MALLOC_CAP_8BIT);
+    if (b == NULL) {
+        b = calloc(n, sizeof(uint16_t));
+        if (b == NULL) {
+            return false;
+        }
+    }
+    for (uint32_t id = 1; id < m->string_count; id++) {
+        bucket_insert(b, n, media_meta_string(m, (uint16_t)id), (uint16_t)id);
+    }
+    free(m->buckets);
+    m->buckets = b;
+    m->bucket_count = n;
+    return true;
+}
+
+// 返回字符串的编号，首次出现时加入字符串池；失败或空串返回 MEDIA_META_UNKNOWN
+static uint16_t intern(media_meta_t *m, const char *str)
+{
+    if (str[0] == '\0') {
+        return MEDIA_META_UNKNOWN;
+    }
+
+    uint32_t mask = m->bucket_count - 1;
+    for (uint32_t i = hash_str(str) & mask; m->buckets[i] != 0; i = (i + 1) & mask) {
+        uint16_t id = (uint16_t)(m->buckets[i] - 1);
+        if (strcmp(media_meta_string(m, id), str) == 0) {
+            return id;
+        }
+    }
+
+    if (m->string_count >= MAX_STRINGS) {
+        ESP_LOGW(TAG, "驻留字符串已满，忽略: %s", str);
+        return MEDIA_META_UNKNOWN;
+    }
+    if ((m->string_count + 1) * 2 > m->bucket_count && !rehash(m)) {
+        return MEDIA_META_UNKNOWN;
+    }
+    if (!grow((void **)&m->strings, &m->string_cap, m->string_count + 1, sizeof(uint32_t), STRINGS_MIN_CAP)) {
+        return MEDIA_META_UNKNOWN;
+    }
+    uint32_t off = pool_add(m, str);
+    if (off == UINT32_MAX) {
+        return MEDIA_META_UNKNOWN;
+    }
+
+    uint16_t id = (uint16_t)m->string_count++;
+    m->strings[id] = off;
+    bucket_insert(m->buckets, m->bucket_count, str, id);
+    return id;
+}
+
+/* =========================== 对外接口 =========================== */
+esp_err_t media_meta_init(void)
+{
+    if (s_lock == NULL) {
+        s_lock = xSemaphoreCreateMutex();
+        if (s_lock == NULL) {
+            return ESP_ERR_NO_MEM;
+        }
+    }
+    return ESP_OK;
+}
+
+// 为 count 首曲目分配各数组并建立空记录，编号 0 固定为空串
+static esp_err_t meta_create(media_meta_t *m, uint32_t count)
+{
+    memset(m, 0, sizeof(*m));
+
+    uint32_t cap = count ? count : 1;
+    m->title = meta_realloc(NULL, (size_t)cap * sizeof(uint32_t));
+    m->artist = meta_realloc(NULL, (size_t)cap * sizeof(uint16_t));
+    m->album = meta_realloc(NULL, (size_t)cap * sizeof(uint16_t));
+    m->track_no = meta_realloc(NULL, (size_t)cap * sizeof(uint16_t));
+    m->duration_ms = meta_realloc(NULL, (size_t)cap * sizeof(uint32_t));
+    m->bitrate_kbps = meta_realloc(NULL, (size_t)cap * sizeof(uint16_t));
+    m->sample_rate = meta_realloc(NULL, (size_t)cap * sizeof(uint32_t));
+    m->flags = meta_realloc(NULL, cap);
+    if (!m->title || !m->artist || !m->album || !m->track_no || !m->duration_ms || !m->bitrate_kbps ||
+        !m->sample_rate || !m->flags) {
+        meta_free(m);
+        return ESP_ERR_NO_MEM;
+    }
+    m->count = count;
+    m->cap = cap;
+    memset(m->title, 0xFF, (size_t)cap * sizeof(uint32_t));
+    memset(m->artist, 0, (size_t)cap * sizeof(uint16_t));
+    memset(m->album, 0, (size_t)cap * sizeof(uint16_t));
+    memset(m->track_no, 0, (size_t)cap * sizeof(uint16_t));
+    memset(m->duration_ms, 0, (size_t)cap * sizeof(uint32_t));
+    memset(m->bitrate_kbps, 0, (size_t)cap * sizeof(uint16_t));
+    memset(m->sample_rate, 0, (size_t)cap * sizeof(uint32_t));
+    memset(m->flags, 0, cap);
+
+    if (!rehash(m) || !grow((void **)&m->strings, &m->string_cap, 1, sizeof(uint32_t), STRINGS_MIN_CAP) ||
+        pool_add(m, "") == UINT32_MAX) {
+        meta_free(m);
+        return ESP_ERR_NO_MEM;
+    }
+    m->strings[0] = 0;
+    m->string_count = 1;
+    return ESP_OK;
+}
+
+static void meta_publish(media_meta_t *m)
+{
+    xSemaphoreTake(s_lock, portMAX_DELAY);
+    meta_free(&s_meta);
+    s_meta = *m;
+    xSemaphoreGive(s_lock);
+}
+
+esp_err_t media_meta_reset(uint32_t count)
+{
+    media_meta_t m;
+    esp_err_t ret = meta_create(&m, count);
+    if (ret == ESP_OK) {
+        meta_publish(&m);
+    }
+    return ret;
+}
+
+esp_err_t media_meta_set(uint32_t index, const media_tags_t *tags)
+{
+    esp_err_t ret = ESP_OK;
+
+    xSemaphoreTake(s_lock, portMAX_DELAY);
+    media_meta_t *m = &s_meta;
+    if (index >= m->count) {
+        ret = ESP_ERR_INVALID_ARG;
+    } else {
+        m->artist[index] = intern(m, tags->artist);
+        m->album[index] = intern(m, tags->album);
+        m->track_no[index] = tags->track_no;
+        m->flags[index] |= MEDIA_META_F_TAGS;
+        // 已经探测过码流时保留精确的时长
+        if (m->sample_rate[index] == 0) {
+            m->duration_ms[index] = tags->duration_ms;
+        }
+        if (tags->title[0]) {
+            uint32_t off = pool_add(m, tags->title);
+            m->title[index] = (off == UINT32_MAX) ? MEDIA_META_NO_TAGS : off;
+            if (off == UINT32_MAX) {
+                ret = ESP_ERR_NO_MEM;
+            }
+        }
+    }
+    xSemaphoreGive(s_lock);
+    return ret;
+}
+
+esp_err_t media_meta_set_stream(uint32_t index, uint32_t duration_ms, uint16_t bitrate_kbps, uint32_t sample_rate)
+{
+    esp_err_t ret = ESP_OK;
+
+    xSemaphoreTake(s_lock, portMAX_DELAY);
+    media_meta_t *m = &s_meta;
+    if (index >= m->count) {
+        ret = ESP_ERR_INVALID_ARG;
+    } else {
+        m->duration_ms[index] = duration_ms;
+        m->bitrate_kbps[index] = bitrate_kbps;
+        m->sample_rate[index] = sample_rate;
+    }
+    xSemaphoreGive(s_lock);
+    return ret;
+}
+
+bool media_meta_get_stream(uint32_t index, uint32_t *duration_ms, uint16_t *bitrate_kbps, uint32_t *sample_rate)
+{
+    bool ok = false;
+
+    if (s_lock == NULL) {
+        return false;
+    }
+    xSemaphoreTake(s_lock, portMAX_DELAY);
+    const media_meta_t *m = &s_meta;
+    if (index < m->count && m->sample_rate[index] != 0) {
+        *duration_ms = m->duration_ms[index];
+        *bitrate_kbps = m->bitrate_kbps[index];
+        *sample_rate = m->sample_rate[index];
+        ok = true;
+    }
+    xSemaphoreGive(s_lock);
+    return ok;
+}
+
+uint32_t media_meta_count(void)
+{
+    xSemaphoreTake(s_lock, portMAX_DELAY);
+    uint32_t count = s_meta.count;
+    xSemaphoreGive(s_lock);
+    return count;
+}
+
+bool media_meta_tags_read(uint32_t index)
+{
+    xSemaphoreTake(s_lock, portMAX_DELAY);
+    bool read = index < s_meta.count && (s_meta.flags[index] & MEDIA_META_F_TAGS);
+    xSemaphoreGive(s_lock);
+    return read;
+}
+
+esp_err_t media_meta_remap(uint32_t count, const uint32_t *from)
+{
+    media_meta_t m;
+    esp_err_t ret = meta_create(&m, count);
+    if (ret != ESP_OK) {
+        return ret;
+    }
+
+    // 重新驻留字符串，顺带丢掉已删除曲目在字符串池中留下的空间
+    xSemaphoreTake(s_lock, portMAX_DELAY);
+    const media_meta_t *old = &s_meta;
+    for (uint32_t i = 0; i < count && ret == ESP_OK; i++) {
+        uint32_t o = from[i];
+        if (o >= old->count) {
+            continue;
+        }
+        m.artist[i] = intern(&m, media_meta_string(old, old->artist[o]));
+        m.album[i] = intern(&m, media_meta_string(old, old->album[o]));
+        m.track_no[i] = old->track_no[o];
+        m.duration_ms[i] = old->duration_ms[o];
+        m.bitrate_kbps[i] = old->bitrate_kbps[o];
+        m.sample_rate[i] = old->sample_rate[o];
+        m.flags[i] = old->flags[o];
+        if (old->title[o] != MEDIA_META_NO_TAGS) {
+            m.title[i] = pool_add(&m, old->pool + old->title[o]);
+            if (m.title[i] == UINT32_MAX) {
+                ret = ESP_ERR_NO_MEM;
+            }
+        }
+    }
+    if (ret == ESP_OK) {
+        meta_free(&s_meta);
+        s_meta = m;
+    }
+    xSemaphoreGive(s_lock);
+
+    if (ret != ESP_OK) {
+        meta_free(&m);
+    }
+    return ret;
+}
+
+static void cache_arrays(const media_meta_t *m, cache_array_t arrays[9])
+{
+    arrays[0] = (cache_array_t){ m->title, sizeof(uint32_t) };
+    arrays[1] = (cache_array_t){ m->artist, sizeof(uint16_t) };
+    arrays[2] = (cache_array_t){ m->album, sizeof(uint16_t) };
+    arrays[3] = (cache_array_t){ m->track_no, sizeof(uint16_t) };
+    arrays[4] = (cache_array_t){ m->duration_ms, sizeof(uint32_t) };
+    arrays[5] = (cache_array_t){ m->bitrate_kbps, sizeof(uint16_t) };
+    arrays[6] = (cache_array_t){ m->sample_rate, sizeof(uint32_t) };
+    arrays[7] = (cache_array_t){ m->flags, sizeof(uint8_t) };
+    arrays[8] = (cache_array_t){ m->strings, sizeof(uint32_t) };
+}
+
+esp_err_t media_meta_save(const char *path, uint32_t key)
+{
+    char tmp_path[64];
+    snprintf(tmp_path, sizeof(tmp_path), "%s.tmp", path);
+
+    FILE *fp = fopen(tmp_path, "wb");
+    if (fp == NULL) {
+        return ESP_FAIL;
+    }
+
+    // 持锁写完整个文件，期间元数据不会被修改
+    xSemaphoreTake(s_lock, portMAX_DELAY);
+    const media_meta_t *m = &s_meta;
+    cache_array_t arrays[9];
+    cache_arrays(m, arrays);
+    cache_header_t hdr = {
+        .magic = CACHE_MAGIC,
+        .version = CACHE_VERSION,
+        .header_size = sizeof(cache_header_t),
+        .key = key,
+        .count = m->count,
+        .string_count = m->string_count,
+        .pool_size = m->pool_size,
+    };
+    for (int i = 0; i < 9; i++) {
+        uint32_t n = (i == 8) ? m->string_count : m->count;
+        hdr.crc = esp_rom_crc32_le(hdr.crc, arrays[i].ptr, n * arrays[i].elem_size);
+    }
+    hdr.crc = esp_rom_crc32_le(hdr.crc, (const uint8_t *)m->pool, m->pool_size);
+
+    bool ok = fwrite(&hdr, 1, sizeof(hdr), fp) == sizeof(hdr);
+    for (int i = 0; i < 9 && ok; i++) {
+        uint32_t n = (i == 8) ? m->string_count : m->count;
+        ok = fwrite(arrays[i].ptr, arrays[i].elem_size, n, fp) == n;
+    }
+    ok = ok && fwrite(m->pool, 1, m->pool_size, fp) == m->pool_size;
+    xSemaphoreGive(s_lock);
+    ok = (fclose(fp) == 0) && ok;
+
+    if (ok) {
+        unlink(path);
+        ok = rename(tmp_path, path) == 0;
+    }
+    if (!ok) {
+        unlink(tmp_path);
+        return ESP_FAIL;
+    }
+    return ESP_OK;
+}
+
+// 偏移和编号都在范围内，加载后可以直接使用
+static bool cache_valid(const media_meta_t *m)
+{
+    if (m->pool_size == 0 || m->pool[m->pool_size - 1] != '\0' || m->string_count == 0 || m->strings[0] != 0) {
+        return false;
+    }
+    for (uint32_t i = 0; i < m->string_count; i++) {
+        if (m->strings[i] >= m->pool_size) {
+            return false;
+        }
+    }
+    for (uint32_t i = 0; i < m->count; i++) {
+        if ((m->title[i] != MEDIA_META_NO_TAGS && m->title[i] >= m->pool_size) ||
+            m->artist[i] >= m->string_count || m->album[i] >= m->string_count) {
+            return false;
+        }
+    }
+    return true;
+}
+
+esp_err_t media_meta_load(const char *path, uint32_t key, uint32_t count)
+{
+    FILE *fp = fopen(path, "rb");
+    if (fp == NULL) {
+        return ESP_ERR_NOT_FOUND;
+    }
+
+    media_meta_t m;
+    memset(&m, 0, sizeof(m));
+    esp_err_t ret = ESP_OK;
+    cache_header_t hdr;
+    if (fread(&hdr, 1, sizeof(hdr), fp) != sizeof(hdr) ||
+        hdr.magic != CACHE_MAGIC || hdr.version != CACHE_VERSION || hdr.header_size != sizeof(hdr) ||
+        hdr.string_count > MAX_STRINGS) {
+        ret = ESP_ERR_INVALID_VERSION;
+        goto out;
+    }
+    if (hdr.key != key || hdr.count != count) {
+        ret = ESP_ERR_INVALID_STATE;
+        goto out;
+    }
+
+    ret = meta_create(&m, count);
+    if (ret != ESP_OK) {
+        goto out;
+    }
+    // 表中此时只有空串，先把哈希表扩到装载率一半以下，读入字符串后再逐个插入
+    while ((hdr.string_count + 1) * 2 > m.bucket_count) {
+        if (!rehash(&m)) {
+            ret = ESP_ERR_NO_MEM;
+            goto out;
+        }
+    }
+    if (!grow((void **)&m.strings, &m.string_cap, hdr.string_count, sizeof(uint32_t), STRINGS_MIN_CAP) ||
+        !grow((void **)&m.pool, &m.pool_cap, hdr.pool_size, 1, POOL_MIN_CAP)) {
+        ret = ESP_ERR_NO_MEM;
+        goto out;
+    }
+    m.string_count = hdr.string_count;
+    m.pool_size = hdr.pool_size;
+
+    cache_array_t arrays[9];
+    cache_arrays(&m, arrays);
+    uint32_t crc = 0;
+    for (int i = 0; i < 9 && ret == ESP_OK; i++) {
+        uint32_t n = (i == 8) ? m.string_count : m.count;
+        if (fread(arrays[i].ptr, arrays[i].elem_size, n, fp) != n) {
+            ret = ESP_ERR_INVALID_SIZE;
+        }
+        crc = esp_rom_crc32_le(crc, arrays[i].ptr, n * arrays[i].elem_size);
+    }
+    if (ret == ESP_OK && fread(m.pool, 1, m.pool_size, fp) != m.pool_size) {
+        ret = ESP_ERR_INVALID_SIZE;
+    }
+    if (ret != ESP_OK) {
+        goto out;
+    }
+    crc = esp_rom_crc32_le(crc, (const uint8_t *)m.pool, m.pool_size);
+    if (crc != hdr.crc) {
+        ret = ESP_ERR_INVALID_CRC;
+        goto out;
+    }
+    if (!cache_valid(&m)) {
+        ret = ESP_ERR_INVALID_STATE;
+        goto out;
+    }
+
+    // 按保存的字符串重新建立哈希表，之后还能继续驻留新字符串
+    for (uint32_t id = 1; id < m.string_count; id++) {
+        bucket_insert(m.buckets, m.bucket_count, media_meta_string(&m, (uint16_t)id), (uint16_t)id);
+    }
+    meta_publish(&m);
+    memset(&m, 0, sizeof(m));
+
+out:
+    meta_free(&m);
+    fclose(fp);
+    return ret;
+}
+
+const media_meta_t *media_meta_lock(void)
+{
+    xSemaphoreTake(s_lock, portMAX_DELAY);
+    return &s_meta;
+}
+
+void media_meta_unlock(void)
+{
+    xSemaphoreGive(s_lock);
+}
+
+int media_meta_display_name(uint32_t index, char *buf, size_t len)
+{
+    int n = -1;
+
+    if (s_lock == NULL) {
+        return -1;
+    }
+    xSemaphoreTake(s_lock, portMAX_DELAY);
+    const media_meta_t *m = &s_meta;
+    if (index < m->count && m->title[index] != MEDIA_META_NO_TAGS) {
+        const char *title = m->pool + m->title[index];
+        if (m->artist[index] != MEDIA_META_UNKNOWN) {
+            n = snprintf(buf, len, "%s - %s", media_meta_string(m, m->artist[index]), title);
+        } else {
+            n = snprintf(buf, len, "%s", title);
+        }
+    }
+    xSemaphoreGive(s_lock);
+    // 截断的名称仍然可以显示
+    return n < 0 ? -1 : (int)strlen(buf);
+}
+
+size_t media_meta_memory_usage(void)
+{
+    xSemaphoreTake(s_lock, portMAX_DELAY);
+    const media_meta_t *m = &s_meta;
+    size_t bytes = (size_t)m->cap * (3 * sizeof(uint32_t) + 4 * sizeof(uint16_t) + 1) + m->pool_cap +
+                   (size_t)m->string_cap * sizeof(uint32_t) + (size_t)m->bucket_count * sizeof(uint16_t);
+    xSemaphoreGive(s_lock);
+    return bytes;
+}
@@ -0,0 +1,129 @@
+// main/task/media_meta.h
+#ifndef MEDIA_META_H
+#define MEDIA_META_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
+#include "esp_err.h"
+#include "media_tags.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define MEDIA_META_NO_TAGS      UINT32_MAX  // title[] 中表示该曲目没有标签
+#define MEDIA_META_UNKNOWN      0           // 字符串编号 0 固定为空串
+#define MEDIA_META_NO_ENTRY     UINT32_MAX  // media_meta_remap() 中表示该曲目没有旧记录
+
+#define MEDIA_META_F_TAGS       0x01        // 已读取过标签 (文件本身可能没有标签)
+
+/**
+ * @brief 曲目元数据缓存，按曲库序号索引
+ *
+ * 每个字段单独一个数组 (struct-of-arrays)，按艺术家/专辑排序或分组时
+ * 只需要顺序扫描一两个紧凑的数组。艺术家和专辑名驻留 (intern) 为
+ * 16 位编号，相同字符串只保存一份，比较编号即可判断相等。
+ * 所有字符串保存在同一个 PSRAM 字符串池中。
+ */
+typedef struct {
+    uint32_t count;
+    uint32_t cap;
+    uint32_t *title;        // 标题在字符串池中的偏移
+    uint16_t *artist;       // 驻留字符串编号
+    uint16_t *album;
+    uint16_t *track_no;
+    uint32_t *duration_ms;  // 时长，探测码流之前为标签给出的提示，0 为未知
+    uint16_t *bitrate_kbps; // 平均码率，0 为未探测
+    uint32_t *sample_rate;  // 采样率 (Hz)，0 为未探测
+    uint8_t *flags;         // MEDIA_META_F_*
+
+    char *pool;             // 字符串池
+    uint32_t pool_size;
+    uint32_t pool_cap;
+    uint32_t *strings;      // 驻留字符串编号 -> 池偏移
+    uint32_t string_count;
+    uint32_t string_cap;
+    uint16_t *buckets;      // 开放寻址哈希表，保存编号 + 1，0 为空槽
+    uint32_t bucket_count;  // 2 的幂
+} media_meta_t;
+
+esp_err_t media_meta_init(void);
+
+/**
+ * @brief 丢弃已有数据，为 count 首曲目建立空记录
+ */
+esp_err_t media_meta_reset(uint32_t count);
+
+/**
+ * @brief 保存第 index 首曲目的标签
+ */
+esp_err_t media_meta_set(uint32_t index, const media_tags_t *tags);
+
+/**
+ * @brief 保存探测码流得到的时长、平均码率和采样率，覆盖标签中的时长提示
+ */
+esp_err_t media_meta_set_stream(uint32_t index, uint32_t duration_ms, uint16_t bitrate_kbps, uint32_t sample_rate);
+
+/**
+ * @brief 读取探测得到的码流信息
+ * @return 尚未探测或探测失败时返回 false
+ */
+bool media_meta_get_stream(uint32_t index, uint32_t *duration_ms, uint16_t *bitrate_kbps, uint32_t *sample_rate);
+
+uint32_t media_meta_count(void);
+
+/**
+ * @brief 第 index 首曲目的标签是否已经读取过
+ */
+bool media_meta_tags_read(uint32_t index);
+
+/**
+ * @brief 曲库变化后按新的序号重排缓存
+ *
+ * 新缓存共 count 首，第 i 首沿用旧缓存中第 from[i] 首的全部字段，
+ * from[i] 为 MEDIA_META_NO_ENTRY 或超出旧缓存时为空记录，需要重新读取标签。
+ */
+esp_err_t media_meta_remap(uint32_t count, const uint32_t *from);
+
+/**
+ * @brief 把整个缓存 (含码流信息) 写入文件，先写 path.tmp 再替换
+ * @param key 由调用者决定，加载时必须一致，如所属曲库索引的 CRC
+ */
+esp_err_t media_meta_save(const char *path, uint32_t key);
+
+/**
+ * @brief 从 media_meta_save() 写的文件加载缓存
+ * @return ESP_ERR_INVALID_STATE 键或曲目数与当前曲库不符；其余错误表示文件不存在或已损坏
+ */
+esp_err_t media_meta_load(const char *path, uint32_t key, uint32_t count);
+
+/**
+ * @brief 加锁后直接读取缓存，用于排序、分组等批量操作
+ * @note  返回的指针在 media_meta_unlock() 之前有效，期间不要调用其他 media_meta_* 接口
+ */
+const media_meta_t *media_meta_lock(void);
+
+void media_meta_unlock(void);
+
+static inline const char *media_meta_string(const media_meta_t *m, uint16_t id)
+{
+    return m->pool + m->strings[id];
+}
+
+/**
+ * @brief 生成显示名称 "艺术家 - 标题"，缺少艺术家时只有标题
+ * @return 名称长度；没有标题时返回 -1，调用者应改用文件名
+ */
+int media_meta_display_name(uint32_t index, char *buf, size_t len);
+
+/**
+ * @brief 当前占用的堆内存 (字节)
+ */
+size_t media_meta_memory_usage(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // MEDIA_META_H
@@ -0,0 +1,560 @@
+// main/task/media_probe.c
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <unistd.h>
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "esp_heap_caps.h"
+#include "esp_rom_crc.h"
+#include "mp3dec.h"
+
+#include "audio_player.h"
+#include "media_library.h"
+#include "media_meta.h"
+#include "media_probe.h"
+
+static const char *TAG = "MEDIA_PROBE";
+
+#define SIDECAR_MAGIC       0x49525450  // "PTRI"
+#define SIDECAR_VERSION     1
+#define SIDECAR_TMP         ".trackinfo.tmp"
+
+#define PROBE_BUF_SIZE      4096
+#define PROBE_CBR_FRAMES    64              // 开头这么多帧码率相同即视为 CBR
+#define PROBE_WALK_MAX      (1024 * 1024)   // 逐帧遍历最多读取的字节数
+#define PROBE_FLUSH_EVERY   16              // 每探测这么多首写回一次边车文件
+#define PROBE_PLAYING_DELAY_MS  50          // 播放时每首之间让出的时间
+
+#define ID3V2_HEADER_LEN    10
+#define ID3V1_LEN           128
+
+#define REC_F_PROBED        0x8000          // 内存中的标记: 记录有效 (成功或失败都不再重试)
+
+#define FNV_OFFSET_BASIS    2166136261u
+#define FNV_PRIME           16777619u
+
+/*
+ * 边车文件格式 (小端):
+ *   sidecar_header_t
+ *   sidecar_record_t records[count]
+ * 记录按名称哈希、大小和修改时间匹配曲目，目录内增删文件不影响其余记录。
+ */
+typedef struct {
+    uint32_t magic;
+    uint16_t version;
+    uint16_t record_size;
+    uint32_t count;
+    uint32_t crc;           // 记录部分的 CRC32
+} sidecar_header_t;
+
+typedef struct {
+    uint32_t name_hash;
+    uint32_t size;
+    uint32_t mtime;
+    uint32_t duration_ms;
+    uint32_t sample_rate;
+    uint16_t bitrate_kbps;
+    uint16_t flags;         // MEDIA_PROBE_F_*，失败的记录为 0
+} sidecar_record_t;
+
+typedef struct {
+    uint32_t cached;
+    uint32_t probed;
+    uint32_t failed;
+    int64_t probe_us;
+} probe_stats_t;
+
+/* 只在曲库任务中使用，不放在栈上 */
+static uint8_t s_buf[PROBE_BUF_SIZE];
+static HMP3Decoder s_mp3;
+static char s_track_path[MEDIA_LIBRARY_PATH_LEN];
+static char s_sidecar_path[MEDIA_LIBRARY_PATH_LEN];
+static char s_tmp_path[MEDIA_LIBRARY_PATH_LEN];
+
+static uint32_t be32(const uint8_t *p)
+{
+    return ((uint32_t)p[0] << 24) | ((uint32_t)p[1] << 16) | ((uint32_t)p[2] << 8) | p[3];
+}
+
+static uint32_t le32(const uint8_t *p)
+{
+    return ((uint32_t)p[3] << 24) | ((uint32_t)p[2] << 16) | ((uint32_t)p[1] << 8) | p[0];
+}
+
+static uint32_t fnv1a(const char *s)
+{
+    uint32_t h = FNV_OFFSET_BASIS;
+    while (*s) {
+        h = (h ^ (uint8_t)*s++) * FNV_PRIME;
+    }
+    return h;
+}
+
+static bool read_at(FILE *fp, long pos, void *buf, size_t len)
+{
+    return fseek(fp, pos, SEEK_SET) == 0 && fread(buf, 1, len, fp) == len;
+}
+
+// 音频数据前面 ID3v2 标签的总长度
+static uint32_t id3v2_size(FILE *fp)
+{
+    uint8_t h[ID3V2_HEADER_LEN];
+    if (!read_at(fp, 0, h, sizeof(h)) || memcmp(h, "ID3", 3) != 0 || ((h[6] | h[7] | h[8] | h[9]) & 0x80)) {
+        return 0;
+    }
+    uint32_t size = ((uint32_t)h[6] << 21) | ((uint32_t)h[7] << 14) | ((uint32_t)h[8] << 7) | h[9];
+    return ID3V2_HEADER_LEN + size + ((h[5] & 0x10) ? ID3V2_HEADER_LEN : 0);   // 带尾部
+}
+
+/* =========================== MP3 =========================== */
+// 第三层的帧长 (字节)
+static uint32_t mp3_frame_len(const MP3FrameInfo *fi, const uint8_t *hdr)
+{
+    uint32_t coef = (fi->version == MPEG1) ? 144 : 72;
+    return coef * (uint32_t)fi->bitrate / (uint32_t)fi->samprate + ((hdr[2] >> 1) & 1);
+}
+
+static bool mp3_header(const uint8_t *hdr, MP3FrameInfo *fi)
+{
+    return MP3GetNextFrameInfo(s_mp3, fi, (unsigned char *)hdr) == ERR_MP3_NONE && fi->bitrate > 0;
+}
+
+static void mp3_finish(media_probe_info_t *out, uint64_t samples, uint32_t sample_rate, uint32_t bytes)
+{
+    out->sample_rate = sample_rate;
+    out->duration_ms = (uint32_t)(samples * 1000 / sample_rate);
+    // 比特数 / 毫秒 = kbps
+    out->bitrate_kbps = out->duration_ms ? (uint16_t)((uint64_t)bytes * 8 / out->duration_ms) : 0;
+    out->flags |= MEDIA_PROBE_F_VALID;
+}
+
+/**
+ * 从 pos 开始逐帧解析帧头。开头 PROBE_CBR_FRAMES 帧码率都相同时按 CBR 计算；
+ * VBR 则一直走到文件末尾，超过 PROBE_WALK_MAX 时按已遍历部分的平均码率外推。
+ */
+static esp_err_t mp3_walk(FILE *fp, uint32_t start, uint32_t end, const MP3FrameInfo *first, media_probe_info_t *out)
+{
+    const uint32_t spf = (uint32_t)(first->outputSamps / first->nChans);
+    uint32_t pos = start;
+    uint32_t frames = 0;
+    uint32_t bytes = 0;
+    bool vbr = false;
+    MP3FrameInfo fi;
+
+    while (pos + 4 <= end && pos - start < PROBE_WALK_MAX) {
+        uint32_t want = end - pos < sizeof(s_buf) ? end - pos : sizeof(s_buf);
+        if (fseek(fp, (long)pos, SEEK_SET) != 0) {
+            break;
+        }
+        uint32_t n = (uint32_t)fread(s_buf, 1, want, fp);
+        if (n < 4) {
+            break;
+        }
+
+        uint32_t i = 0;
+        while (i + 4 <= n) {
+            if (!mp3_header(s_buf + i, &fi) || fi.samprate != first->samprate) {
+                // 帧之间夹着垃圾数据，重新找同步字
+                int j = MP3FindSyncWord(s_buf + i + 1, (int)(n - i - 1));
+                i = (j < 0) ? n - 1 : i + 1 + (uint32_t)j;
+                continue;
+            }
+            uint32_t len = mp3_frame_len(&fi, s_buf + i);
+            frames++;
+            bytes += len;
+            vbr |= (fi.bitrate != first->bitrate);
+            i += len;
+            if (frames == PROBE_CBR_FRAMES && !vbr) {
+                break;
+            }
+        }
+        pos += i;
+        if (frames == PROBE_CBR_FRAMES && !vbr) {
+            break;
+        }
+        taskYIELD();
+    }
+
+    if (frames == 0) {
+        return ESP_FAIL;
+    }
+    if (pos + 4 > end) {
+        mp3_finish(out, (uint64_t)frames * spf, (uint32_t)first->samprate, bytes);
+    } else {
+        // 由已遍历部分的平均帧长推算总帧数
+        uint64_t total = (uint64_t)(end - start) * frames / bytes;
+        mp3_finish(out, total * spf, (uint32_t)first->samprate, end - start);
+        if (vbr) {
+            out->flags |= MEDIA_PROBE_F_ESTIMATED;
+        }
+    }
+    if (vbr) {
+        out->flags |= MEDIA_PROBE_F_VBR;
+    }
+    return ESP_OK;
+}
+
+static esp_err_t probe_mp3(FILE *fp, uint32_t start, uint32_t file_size, media_probe_info_t *out)
+{
+    MP3FrameInfo fi;
+    uint8_t tag[3];
+    uint32_t end = file_size;
+
+    if (file_size >= ID3V1_LEN && read_at(fp, (long)(file_size - ID3V1_LEN), tag, sizeof(tag)) &&
+        memcmp(tag, "TAG", 3) == 0) {
+        end -= ID3V1_LEN;
+    }
+    if (start >= end || fseek(fp, (long)start, SEEK_SET) != 0) {
+        return ESP_FAIL;
+    }
+    uint32_t n = (uint32_t)fread(s_buf, 1, sizeof(s_buf), fp);
+
+    // 第一帧: 同步字后的帧头有效，且下一帧 (在缓冲区内时) 的帧头也有效
+    uint32_t off = 0;
+    for (;;) {
+        int i = (off + 4 <= n) ? MP3FindSyncWord(s_buf + off, (int)(n - off)) : -1;
+        if (i < 0 || off + (uint32_t)i + 4 > n) {
+            return ESP_FAIL;
+        }
+        off += (uint32_t)i;
+        if (mp3_header(s_buf + off, &fi)) {
+            uint32_t next = off + mp3_frame_len(&fi, s_buf + off);
+            MP3FrameInfo fn;
+            if (next + 4 > n || (mp3_header(s_buf + next, &fn) && fn.samprate == fi.samprate)) {
+                break;
+            }
+        }
+        off++;
+    }
+
+    const uint32_t frame_pos = start + off;
+    const uint32_t spf = (uint32_t)(fi.outputSamps / fi.nChans);
+    const uint32_t side = (fi.version == MPEG1) ? (fi.nChans == 1 ? 17 : 32) : (fi.nChans == 1 ? 9 : 17);
+    const uint8_t *x = s_buf + off + 4 + side;
+    const uint8_t *v = s_buf + off + 4 + 32;    // VBRI 固定在帧头后 32 字节
+    uint32_t frames = 0;
+    uint32_t bytes = 0;
+
+    if (off + 4 + side + 16 <= n && (memcmp(x, "Xing", 4) == 0 || memcmp(x, "Info", 4) == 0)) {
+        uint32_t flags = be32(x + 4);
+        const uint8_t *p = x + 8;
+        if (flags & 0x1) {
+            frames = be32(p);
+            p += 4;
+        }
+        if (flags & 0x2) {
+            bytes = be32(p);
+        }
+        if (x[0] == 'X') {
+            out->flags |= MEDIA_PROBE_F_VBR;    // "Info" 是 LAME 给 CBR 文件写的同样格式的头
+        }
+    } else if (off + 4 + 32 + 18 <= n && memcmp(v, "VBRI", 4) == 0) {
+        bytes = be32(v + 10);
+        frames = be32(v + 14);
+        out->flags |= MEDIA_PROBE_F_VBR;
+    }
+
+    if (frames > 0) {
+        if (bytes == 0 || bytes > end - frame_pos) {
+            bytes = end - frame_pos;
+        }
+        mp3_finish(out, (uint64_t)frames * spf, (uint32_t)fi.samprate, bytes);
+        return ESP_OK;
+    }
+    return mp3_walk(fp, frame_pos, end, &fi, out);
+}
+
+/* =========================== WAV / FLAC =========================== */
+static esp_err_t probe_wav(FILE *fp, uint32_t file_size, media_probe_info_t *out)
+{
+    uint8_t h[16];
+    uint32_t pos = 12;
+    uint32_t byte_rate = 0;
+
+    while (pos + 8 <= file_size && read_at(fp, (long)pos, h, 8)) {
+        uint32_t size = le32(h + 4);
+        if (memcmp(h, "fmt ", 4) == 0 && size >= 16 && read_at(fp, (long)pos + 8, h, 16)) {
+            out->sample_rate = le32(h + 4);
+            byte_rate = le32(h + 8);
+        } else if (memcmp(h, "data", 4) == 0) {
+            if (byte_rate == 0 || out->sample_rate == 0) {
+                return ESP_FAIL;
+            }
+            // 流式写入的文件 data 长度可能为 0 或 0xFFFFFFFF，以实际文件长度为准
+            if (size == 0 || size > file_size - pos - 8) {
+                size = file_size - pos - 8;
+            }
+            out->duration_ms = (uint32_t)((uint64_t)size * 1000 / byte_rate);
+            out->bitrate_kbps = (uint16_t)((uint64_t)byte_rate * 8 / 1000);
+            out->flags |= MEDIA_PROBE_F_VALID;
+            return ESP_OK;
+        }
+        pos += 8 + size + (size & 1);
+    }
+    return ESP_FAIL;
+}
+
+static esp_err_t probe_flac(FILE *fp, uint32_t start, uint32_t file_size, media_probe_info_t *out)
+{
+    uint8_t b[4 + 4 + 34];
+
+    // STREAMINFO 必须是第一个元数据块
+    if (!read_at(fp, (long)start, b, sizeof(b)) || (b[4] & 0x7F) != 0) {
+        return ESP_FAIL;
+    }
+    const uint8_t *si = b + 8;
+    uint32_t rate = ((uint32_t)si[10] << 12) | ((uint32_t)si[11] << 4) | (si[12] >> 4);
+    uint64_t samples = ((uint64_t)(si[13] & 0x0F) << 32) | be32(si + 14);
+    if (rate == 0 || samples == 0) {
+        return ESP_FAIL;    // 总采样数未知
+    }
+    out->sample_rate = rate;
+    out->duration_ms = (uint32_t)(samples * 1000 / rate);
+    out->bitrate_kbps = out->duration_ms ? (uint16_t)((uint64_t)(file_size - start) * 8 / out->duration_ms) : 0;
+    out->flags |= MEDIA_PROBE_F_VALID | MEDIA_PROBE_F_VBR;
+    return ESP_OK;
+}
+
+esp_err_t media_probe_file(const char *path, media_probe_info_t *out)
+{
+    uint8_t magic[12];
+    const char *ext = strrchr(path, '.');
+    esp_err_t ret = ESP_ERR_NOT_SUPPORTED;
+
+    memset(out, 0, sizeof(*out));
+    FILE *fp = fopen(path, "rb");
+    if (fp == NULL) {
+        return ESP_FAIL;
+    }
+    long file_size = (fseek(fp, 0, SEEK_END) == 0) ? ftell(fp) : -1;
+    uint32_t start = id3v2_size(fp);
+
+    if (file_size <= 0 || (uint32_t)file_size <= start || !read_at(fp, (long)start, magic, 4)) {
+        ret = ESP_FAIL;
+    } else if (memcmp(magic, "fLaC", 4) == 0) {
+        ret = probe_flac(fp, start, (uint32_t)file_size, out);
+    } else if (memcmp(magic, "RIFF", 4) == 0) {
+        ret = (read_at(fp, 0, magic, 12) && memcmp(magic + 8, "WAVE", 4) == 0)
+              ? probe_wav(fp, (uint32_t)file_size, out) : ESP_ERR_NOT_SUPPORTED;
+    } else if (s_mp3 && (magic[0] == 0xFF || start > 0 || (ext && strcasecmp(ext, ".mp3") == 0))) {
+        // 没有 ID3v2 时帧同步字之前也可能有少量填充，按扩展名判断
+        ret = probe_mp3(fp, start, (uint32_t)file_size, out);
+    }
+
+    fclose(fp);
+    if (ret != ESP_OK) {
+        memset(out, 0, sizeof(*out));
+    }
+    return ret;
+}
+
+/* =========================== 边车文件 =========================== */
+static sidecar_record_t *sidecar_load(const char *path, uint32_t *count)
+{
+    sidecar_header_t hdr;
+    sidecar_record_t *recs = NULL;
+
+    *count = 0;
+    FILE *fp = fopen(path, "rb");
+    if (fp == NULL) {
+        return NULL;
+    }
+    if (fread(&hdr, 1, sizeof(hdr), fp) == sizeof(hdr) && hdr.magic == SIDECAR_MAGIC &&
+        hdr.version == SIDECAR_VERSION && hdr.record_size == sizeof(sidecar_record_t) &&
+        hdr.count > 0 && hdr.count <= UINT16_MAX) {
+        size_t bytes = (size_t)hdr.count * sizeof(sidecar_record_t);
+        recs = malloc(bytes);
+        if (recs && (fread(recs, 1, bytes, fp) != bytes || esp_rom_crc32_le(0, (const uint8_t *)recs, bytes) != hdr.crc)) {
+            free(recs);
+            recs = NULL;
+        }
+        if (recs) {
+            *count = hdr.count;
+        }
+    }
+    fclose(fp);
+    return recs;
+}
+
+// 只写入已经探测过的记录；先写临时文件再替换
+static esp_err_t sidecar_save(const char *path, const char *tmp_path, const sidecar_record_t *recs, uint32_t n)
+{
+    sidecar_header_t hdr = {
+        .magic = SIDECAR_MAGIC,
+        .version = SIDECAR_VERSION,
+        .record_size = sizeof(sidecar_record_t),
+    };
+    uint32_t crc = 0;
+
+    for (uint32_t i = 0; i < n; i++) {
+        if (recs[i].flags & REC_F_PROBED) {
+            crc = esp_rom_crc32_le(crc, (const uint8_t *)&recs[i], sizeof(recs[i]));
+            hdr.count++;
+        }
+    }
+    hdr.crc = crc;
+
+    FILE *fp = fopen(tmp_path, "wb");
+    if (fp == NULL) {
+        return ESP_FAIL;
+    }
+    bool ok = fwrite(&hdr, 1, sizeof(hdr), fp) == sizeof(hdr);
+    for (uint32_t i = 0; i < n && ok; i++) {
+        if (recs[i].flags & REC_F_PROBED) {
+            ok = fwrite(&recs[i], 1, sizeof(recs[i]), fp) == sizeof(recs[i]);
+        }
+    }
+    ok = (fclose(fp) == 0) && ok;
+    if (ok) {
+        unlink(path);
+        ok = rename(tmp_path, path) == 0;
+    }
+    if (!ok) {
+        unlink(tmp_path);
+        return ESP_FAIL;
+    }
+    return ESP_OK;
+}
+
+static const sidecar_record_t *sidecar_find(const sidecar_record_t *old, uint32_t old_count,
+                                            const sidecar_record_t *key, uint32_t hint)
+{
+    // 目录未变时顺序一致，先试同一位置
+    for (uint32_t k = 0; k < old_count; k++) {
+        const sidecar_record_t *o = &old[(hint + k) % old_count];
+        if (o->name_hash == key->name_hash && o->size == key->size && o->mtime == key->mtime) {
+            return o;
+        }
+    }
+    return NULL;
+}
+
+/* =========================== 后台探测 =========================== */
+static void publish(uint32_t index, const sidecar_record_t *rec)
+{
+    if (rec->flags & MEDIA_PROBE_F_VALID) {
+        media_meta_set_stream(index, rec->duration_ms, rec->bitrate_kbps, rec->sample_rate);
+    }
+}
+
+// 播放时把 SD 卡让给音频任务
+static void yield_to_playback(void)
+{
+    if (audio_player_get_state() == AUDIO_PLAYER_STATE_PLAYING) {
+        vTaskDelay(pdMS_TO_TICKS(PROBE_PLAYING_DELAY_MS));
+    } else {
+        vTaskDelay(1);
+    }
+}
+
+static void probe_dir(const char *root, uint32_t d, probe_stats_t *stats)
+{
+    media_library_view_t view;
+    sidecar_record_t *recs = NULL;
+    uint32_t first = 0;
+    uint32_t n = 0;
+
+    media_library_lock(&view);
+    if (d < view.dir_count && view.dirs[d].track_count > 0) {
+        const char *dir = view.pool + view.dirs[d].path_off;
+        const char *sep = dir[0] ? "/" : "";
+        snprintf(s_sidecar_path, sizeof(s_sidecar_path), "%s/%s%s%s", root, dir, sep, MEDIA_PROBE_SIDECAR);
+        snprintf(s_tmp_path, sizeof(s_tmp_path), "%s/%s%s%s", root, dir, sep, SIDECAR_TMP);
+        first = view.dirs[d].first_track;
+        n = view.dirs[d].track_count;
+        recs = calloc(n, sizeof(sidecar_record_t));
+        for (uint32_t i = 0; recs && i < n; i++) {
+            const media_track_t *t = &view.tracks[first + i];
+            recs[i].name_hash = fnv1a(view.pool + t->name_off);
+            recs[i].size = t->size;
+            recs[i].mtime = t->mtime;
+        }
+    }
+    media_library_unlock();
+    if (recs == NULL) {
+        return;
+    }
+
+    uint32_t old_count;
+    uint32_t matched = 0;
+    sidecar_record_t *old = sidecar_load(s_sidecar_path, &old_count);
+    for (uint32_t i = 0; i < n && old; i++) {
+        const sidecar_record_t *o = sidecar_find(old, old_count, &recs[i], i);
+        if (o) {
+            recs[i] = *o;
+            recs[i].flags |= REC_F_PROBED;
+            publish(first + i, &recs[i]);
+            matched++;
+        }
+    }
+    free(old);
+    stats->cached += matched;
+
+    uint32_t probed = 0;
+    for (uint32_t i = 0; i < n && media_library_is_online(); i++) {
+        if (recs[i].flags & REC_F_PROBED) {
+            continue;
+        }
+        media_probe_info_t info = { 0 };
+        int64_t t0 = esp_timer_get_time();
+        if (media_library_track_path(first + i, s_track_path, sizeof(s_track_path)) < 0 ||
+            media_probe_file(s_track_path, &info) != ESP_OK) {
+            stats->failed++;
+        }
+        stats->probe_us += esp_timer_get_time() - t0;
+
+        recs[i].duration_ms = info.duration_ms;
+        recs[i].sample_rate = info.sample_rate;
+        recs[i].bitrate_kbps = info.bitrate_kbps;
+        recs[i].flags = info.flags | REC_F_PROBED;
+        publish(first + i, &recs[i]);
+
+        if (++probed % PROBE_FLUSH_EVERY == 0) {
+            sidecar_save(s_sidecar_path, s_tmp_path, recs, n);
+        }
+        yield_to_playback();
+    }
+    stats->probed += probed;
+
+    // 有新结果或删除了文件 (旧记录多于匹配数) 时写回；卡已拔出时不再写，卸载在等本任务结束
+    if (media_library_is_online() &&
+        ((probed > 0 && probed % PROBE_FLUSH_EVERY != 0) || (probed == 0 && matched != old_count))) {
+        if (sidecar_save(s_sidecar_path, s_tmp_path, recs, n) != ESP_OK) {
+            ESP_LOGW(TAG, "无法写入 %s", s_sidecar_path);
+        }
+    }
+    free(recs);
+}
+
+void media_probe_scan(const char *root)
+{
+    media_library_view_t view;
+    probe_stats_t stats = { 0 };
+    int64_t t0 = esp_timer_get_time();
+
+    s_mp3 = MP3InitDecoder();
+    if (s_mp3 == NULL) {
+        ESP_LOGW(TAG, "MP3 解码器分配失败，跳过 MP3 文件");
+    }
+
+    media_library_lock(&view);
+    uint32_t dir_count = view.dir_count;
+    media_library_unlock();
+
+    for (uint32_t d = 0; d < dir_count && media_library_is_online(); d++) {
+        probe_dir(root, d, &stats);
+    }
+
+    if (s_mp3) {
+        MP3FreeDecoder(s_mp3);
+        s_mp3 = NULL;
+    }
+    ESP_LOGI(TAG, "码流探测完成: 沿用 %u 首, 探测 %u 首 (失败 %u, 平均 %lld ms/首), 用时 %lld ms",
+             (unsigned)stats.cached, (unsigned)stats.probed, (unsigned)stats.failed,
+             stats.probed ? stats.probe_us / stats.probed / 1000 : 0,
+             (esp_timer_get_time() - t0) / 1000);
+}
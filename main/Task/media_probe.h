@@ -0,0 +1,54 @@
+// main/task/media_probe.h
+#ifndef MEDIA_PROBE_H
+#define MEDIA_PROBE_H
+
+#include <stdint.h>
+#include "esp_err.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define MEDIA_PROBE_SIDECAR         ".trackinfo"    // 每个目录一份，保存该目录下曲目的探测结果
+
+#define MEDIA_PROBE_F_VALID         0x0001          // 探测成功，其余字段有效
+#define MEDIA_PROBE_F_VBR           0x0002          // 可变码率
+#define MEDIA_PROBE_F_ESTIMATED     0x0004          // 没有 Xing/VBRI 头的 VBR 文件，只遍历了开头的帧并按平均码率外推
+
+/**
+ * @brief 码流信息
+ */
+typedef struct {
+    uint32_t duration_ms;
+    uint32_t sample_rate;   // Hz
+    uint16_t bitrate_kbps;  // 平均码率
+    uint16_t flags;         // MEDIA_PROBE_F_*
+} media_probe_info_t;
+
+/**
+ * @brief 不解码音频，求出单个文件的时长、平均码率和采样率
+ *
+ * MP3 优先读取第一帧中的 Xing/Info 或 VBRI 头；没有时用 MP3GetNextFrameInfo()
+ * 逐帧解析帧头，开头若干帧码率相同则按 CBR 由文件大小直接计算。
+ * WAV 读取 fmt/data 块，FLAC 读取 STREAMINFO。
+ *
+ * @return ESP_OK 成功；ESP_ERR_NOT_SUPPORTED 不支持的格式；ESP_FAIL 文件无法解析
+ */
+esp_err_t media_probe_file(const char *path, media_probe_info_t *out);
+
+/**
+ * @brief 为曲库中的所有曲目探测码流信息，结果写入 media_meta (同步执行，在曲库任务中调用)
+ *
+ * 逐目录进行：先读取目录下的 MEDIA_PROBE_SIDECAR，名称、大小和修改时间都没变的曲目
+ * 直接沿用，其余曲目才打开文件探测。探测过程中每隔若干首写回一次，
+ * 重启后从中断的位置继续。正在播放时每首之间主动让出一段时间，避免抢占 SD 卡带宽。
+ *
+ * @param root 挂载点，如 BSP_SD_MOUNT_POINT
+ */
+void media_probe_scan(const char *root);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // MEDIA_PROBE_H
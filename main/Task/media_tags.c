@@ -0,0 +1,559 @@
+// main/task/media_tags.c
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <stdbool.h>
+
+#include "media_tags.h"
+
+#define ID3V2_HEADER_LEN    10
+#define ID3V1_LEN           128
+#define APE_FOOTER_LEN      32
+#define APE_KEY_MAX         256
+#define FRAME_BUF_LEN       (MEDIA_TAG_TEXT_MAX * 2 + 4)    // UTF-16 文本 + 编码字节 + BOM
+
+enum {
+    FIELD_NONE,
+    FIELD_TITLE,
+    FIELD_ARTIST,
+    FIELD_ALBUM,
+    FIELD_TRACK,
+    FIELD_LENGTH,
+};
+
+enum {
+    ENC_LATIN1 = 0,
+    ENC_UTF16_BOM = 1,
+    ENC_UTF16_BE = 2,
+    ENC_UTF8 = 3,
+};
+
+/* =========================== 工具函数 =========================== */
+static uint32_t be32(const uint8_t *p)
+{
+    return ((uint32_t)p[0] << 24) | ((uint32_t)p[1] << 16) | ((uint32_t)p[2] << 8) | p[3];
+}
+
+static uint32_t le32(const uint8_t *p)
+{
+    return ((uint32_t)p[3] << 24) | ((uint32_t)p[2] << 16) | ((uint32_t)p[1] << 8) | p[0];
+}
+
+// ID3v2 的同步安全整数，每字节只用低 7 位
+static uint32_t syncsafe32(const uint8_t *p)
+{
+    return ((uint32_t)(p[0] & 0x7F) << 21) | ((uint32_t)(p[1] & 0x7F) << 14) |
+           ((uint32_t)(p[2] & 0x7F) << 7) | (p[3] & 0x7F);
+}
+
+// 把 UTF-8 编码的码点追加到 dst，空间不足时返回 false (不写半个字符)
+static bool put_utf8(char *dst, size_t cap, size_t *pos, uint32_t cp)
+{
+    uint8_t tmp[4];
+    size_t n;
+    if (cp < 0x80) {
+        tmp[0] = (uint8_t)cp;
+        n = 1;
+    } else if (cp < 0x800) {
+        tmp[0] = (uint8_t)(0xC0 | (cp >> 6));
+        tmp[1] = (uint8_t)(0x80 | (cp & 0x3F));
+        n = 2;
+    } else if (cp < 0x10000) {
+        tmp[0] = (uint8_t)(0xE0 | (cp >> 12));
+        tmp[1] = (uint8_t)(0x80 | ((cp >> 6) & 0x3F));
+        tmp[2] = (uint8_t)(0x80 | (cp & 0x3F));
+        n = 3;
+    } else {
+        tmp[0] = (uint8_t)(0xF0 | (cp >> 18));
+        tmp[1] = (uint8_t)(0x80 | ((cp >> 12) & 0x3F));
+        tmp[2] = (uint8_t)(0x80 | ((cp >> 6) & 0x3F));
+        tmp[3] = (uint8_t)(0x80 | (cp & 0x3F));
+        n = 4;
+    }
+    if (*pos + n >= cap) {
+        return false;
+    }
+    memcpy(dst + *pos, tmp, n);
+    *pos += n;
+    return true;
+}
+
+/**
+ * 把标签文本转换为 UTF-8 写入 dst。遇到结束符即停止，
+ * ID3v2.4 中以 '\0' 分隔的多个值只取第一个。
+ */
+static void text_to_utf8(uint8_t enc, const uint8_t *src, size_t len, char *dst, size_t cap)
+{
+    size_t pos = 0;
+
+    if (enc == ENC_UTF16_BOM || enc == ENC_UTF16_BE) {
+        bool big_endian = (enc == ENC_UTF16_BE);
+        if (len >= 2 && ((src[0] == 0xFF && src[1] == 0xFE) || (src[0] == 0xFE && src[1] == 0xFF))) {
+            big_endian = (src[0] == 0xFE);
+            src += 2;
+            len -= 2;
+        }
+        for (size_t i = 0; i + 1 < len; i += 2) {
+            uint32_t cp = big_endian ? ((uint32_t)src[i] << 8 | src[i + 1]) : ((uint32_t)src[i + 1] << 8 | src[i]);
+            if (cp == 0) {
+                break;
+            }
+            if (cp >= 0xD800 && cp < 0xDC00 && i + 3 < len) {
+                uint32_t lo = big_endian ? ((uint32_t)src[i + 2] << 8 | src[i + 3]) : ((uint32_t)src[i + 3] << 8 | src[i + 2]);
+                if (lo >= 0xDC00 && lo < 0xE000) {
+                    cp = 0x10000 + ((cp - 0xD800) << 10) + (lo - 0xDC00);
+                    i += 2;
+                }
+            }
+            if (cp >= 0xD800 && cp < 0xE000) {
+                cp = 0xFFFD;    // 不成对的代理项
+            }
+            if (!put_utf8(dst, cap, &pos, cp)) {
+                break;
+            }
+        }
+    } else if (enc == ENC_UTF8) {
+        size_t n = 0;
+        while (n < len && src[n] != 0) {
+            n++;
+        }
+        if (n >= cap) {
+            // 截断时退回到字符边界
+            n = cap - 1;
+            while (n > 0 && (src[n] & 0xC0) == 0x80) {
+                n--;
+            }
+        }
+        memcpy(dst, src, n);
+        pos = n;
+    } else {
+        for (size_t i = 0; i < len && src[i] != 0; i++) {
+            if (!put_utf8(dst, cap, &pos, src[i])) {
+                break;
+            }
+        }
+    }
+
+    // 去掉尾部空白 (ID3v1 用空格补齐)
+    while (pos > 0 && (dst[pos - 1] == ' ' || dst[pos - 1] == '\t')) {
+        pos--;
+    }
+    dst[pos] = '\0';
+}
+
+// 去除 ID3v2 的反同步字节 (FF 00 -> FF)，返回新长度
+static size_t unsynchronise(uint8_t *buf, size_t len)
+{
+    size_t out = 0;
+    for (size_t i = 0; i < len; i++) {
+        buf[out++] = buf[i];
+        if (buf[i] == 0xFF && i + 1 < len && buf[i + 1] == 0x00) {
+            i++;
+        }
+    }
+    return out;
+}
+
+static uint32_t parse_uint(const char *s, uint32_t max)
+{
+    uint32_t v = 0;
+    while (*s == ' ') {
+        s++;
+    }
+    for (; *s >= '0' && *s <= '9'; s++) {
+        v = v * 10 + (uint32_t)(*s - '0');
+        if (v > max) {
+            return 0;
+        }
+    }
+    return v;
+}
+
+// 字段已有值时不覆盖，实现 ID3v2 > APEv2 > ID3v1 的优先级
+static void store_field(media_tags_t *out, int field, uint8_t enc, const uint8_t *src, size_t len)
+{
+    char *dst = NULL;
+    char num[16];
+
+    switch (field) {
+        case FIELD_TITLE:
+            dst = out->title;
+            break;
+        case FIELD_ARTIST:
+            dst = out->artist;
+            break;
+        case FIELD_ALBUM:
+            dst = out->album;
+            break;
+        case FIELD_TRACK:
+            if (out->track_no == 0) {
+                // "3/12" 只取序号
+                text_to_utf8(enc, src, len, num, sizeof(num));
+                out->track_no = (uint16_t)parse_uint(num, UINT16_MAX);
+            }
+            return;
+        case FIELD_LENGTH:
+            if (out->duration_ms == 0) {
+                text_to_utf8(enc, src, len, num, sizeof(num));
+                out->duration_ms = parse_uint(num, UINT32_MAX / 10);
+            }
+            return;
+        default:
+            return;
+    }
+
+    if (dst[0] == '\0') {
+        text_to_utf8(enc, src, len, dst, MEDIA_TAG_TEXT_MAX);
+    }
+}
+
+/* =========================== ID3v2 =========================== */
+static int id3v2_field(const uint8_t *id, uint8_t version)
+{
+    static const char *const v22[] = { "TT2", "TP1", "TAL", "TRK", "TLE" };
+    static const char *const v23[] = { "TIT2", "TPE1", "TALB", "TRCK", "TLEN" };
+
+    for (int i = 0; i < 5; i++) {
+        if (version == 2 ? memcmp(id, v22[i], 3) == 0 : memcmp(id, v23[i], 4) == 0) {
+            return FIELD_TITLE + i;
+        }
+    }
+    return FIELD_NONE;
+}
+
+// 帧遍历状态
+typedef struct {
+    uint8_t version;
+    bool unsync_all;        // v2.2/v2.3 整个标签做了反同步
+    long pos;               // 下一帧的位置
+    long end;               // 标签结束位置 (不含填充后的部分)
+} id3v2_iter_t;
+
+typedef struct {
+    uint8_t id[4];
+    uint32_t size;
+    uint16_t flags;         // v2.3/v2.4 帧标志
+    long data;              // 帧数据在文件中的位置
+} id3v2_frame_t;
+
+static bool id3v2_begin(FILE *fp, id3v2_iter_t *it)
+{
+    uint8_t h[ID3V2_HEADER_LEN];
+
+    if (fseek(fp, 0, SEEK_SET) != 0 || fread(h, 1, sizeof(h), fp) != sizeof(h)) {
+        return false;
+    }
+    if (memcmp(h, "ID3", 3) != 0 || h[3] < 2 || h[3] > 4 || ((h[6] | h[7] | h[8] | h[9]) & 0x80)) {
+        return false;
+    }
+
+    const uint8_t flags = h[5];
+    it->version = h[3];
+    it->unsync_all = (flags & 0x80) && it->version < 4;
+    it->end = ID3V2_HEADER_LEN + (long)syncsafe32(h + 6);
+    it->pos = ID3V2_HEADER_LEN;
+
+    if (it->version == 2 && (flags & 0x40)) {
+        return false;   // ID3v2.2 的压缩标签没有定义格式
+    }
+    if (it->version > 2 && (flags & 0x40)) {
+        // 扩展头: v2.3 的长度不含自身 4 字节，v2.4 为同步安全整数且包含自身
+        uint8_t ext[4];
+        if (fread(ext, 1, sizeof(ext), fp) != sizeof(ext)) {
+            return false;
+        }
+        it->pos += (it->version == 3) ? (long)be32(ext) + 4 : (long)syncsafe32(ext);
+    }
+    return true;
+}
+
+// 读取下一个帧头，帧数据不读，由调用者按需定位读取
+static bool id3v2_next(FILE *fp, id3v2_iter_t *it, id3v2_frame_t *frame)
+{
+    const long header_len = (it->version == 2) ? 6 : 10;
+    uint8_t fh[10];
+
+    if (it->pos + header_len > it->end || fseek(fp, it->pos, SEEK_SET) != 0 ||
+        fread(fh, 1, (size_t)header_len, fp) != (size_t)header_len || fh[0] == 0) {
+        return false;   // 结束或进入填充区
+    }
+
+    memset(frame, 0, sizeof(*frame));
+    if (it->version == 2) {
+        memcpy(frame->id, fh, 3);
+        frame->size = ((uint32_t)fh[3] << 16) | ((uint32_t)fh[4] << 8) | fh[5];
+    } else {
+        memcpy(frame->id, fh, 4);
+        frame->size = (it->version == 4) ? syncsafe32(fh + 4) : be32(fh + 4);
+        frame->flags = (uint16_t)((fh[8] << 8) | fh[9]);
+    }
+    frame->data = it->pos + header_len;
+    if (frame->size > (uint32_t)(it->end - frame->data)) {
+        return false;
+    }
+    it->pos = frame->data + (long)frame->size;
+    return true;
+}
+
+// 压缩或加密的帧无法直接读取
+static bool id3v2_frame_packed(const id3v2_iter_t *it, const id3v2_frame_t *frame)
+{
+    return (it->version == 3 && (frame->flags & 0x00C0)) || (it->version == 4 && (frame->flags & 0x000C));
+}
+
+static bool id3v2_frame_unsynced(const id3v2_iter_t *it, const id3v2_frame_t *frame)
+{
+    return it->unsync_all || (it->version == 4 && (frame->flags & 0x0002));
+}
+
+// v2.4 的数据长度指示占用帧数据开头 4 字节
+static uint32_t id3v2_frame_skip(const id3v2_iter_t *it, const id3v2_frame_t *frame)
+{
+    return (it->version == 4 && (frame->flags & 0x0001)) ? 4 : 0;
+}
+
+static bool parse_id3v2(FILE *fp, media_tags_t *out)
+{
+    uint8_t buf[FRAME_BUF_LEN];
+    id3v2_iter_t it;
+    id3v2_frame_t frame;
+
+    if (!id3v2_begin(fp, &it)) {
+        return false;
+    }
+
+    // 只读取需要的文本帧，其余帧 (包括封面 APIC) 只按长度跳过
+    while (id3v2_next(fp, &it, &frame)) {
+        int field = id3v2_field(frame.id, it.version);
+        if (field == FIELD_NONE || id3v2_frame_packed(&it, &frame) || frame.size <= 1) {
+            continue;
+        }
+        uint32_t skip = id3v2_frame_skip(&it, &frame);
+        if (frame.size <= skip) {
+            continue;
+        }
+        size_t n = frame.size - skip < sizeof(buf) ? frame.size - skip : sizeof(buf);
+        if (fseek(fp, frame.data + (long)skip, SEEK_SET) == 0 && fread(buf, 1, n, fp) == n) {
+            if (id3v2_frame_unsynced(&it, &frame)) {
+                n = unsynchronise(buf, n);
+            }
+            if (n > 1) {
+                store_field(out, field, buf[0], buf + 1, n - 1);
+            }
+        }
+    }
+
+    out->sources |= MEDIA_TAGS_F_ID3V2;
+    return true;
+}
+
+// 解析 APIC/PIC 帧头，返回图片数据相对帧数据的偏移，不是 JPEG 时返回 0
+static uint32_t apic_jpeg_offset(const uint8_t *p, size_t n, uint8_t version, uint8_t *type)
+{
+    size_t i = 1;   // 跳过文本编码
+    uint8_t enc = p[0];
+
+    if (version == 2) {
+        // v2.2 用 3 字节图片格式代替 MIME
+        if (n < 5 || strncasecmp((const char *)p + 1, "JPG", 3) != 0) {
+            return 0;
+        }
+        i = 4;
+    } else {
+        const uint8_t *mime = p + 1;
+        while (i < n && p[i] != 0) {
+            i++;
+        }
+        if (i >= n) {
+            return 0;
+        }
+        size_t mime_len = (size_t)(p + i - mime);
+        bool jpeg = (mime_len == 10 && strncasecmp((const char *)mime, "image/jpeg", 10) == 0) ||
+                    (mime_len == 9 && strncasecmp((const char *)mime, "image/jpg", 9) == 0);
+        if (!jpeg) {
+            return 0;
+        }
+        i++;
+    }
+    if (i >= n) {
+        return 0;
+    }
+    *type = p[i++];
+
+    // 描述文本，UTF-16 以两个 0 字节结束
+    bool wide = (enc == ENC_UTF16_BOM || enc == ENC_UTF16_BE);
+    while (i < n) {
+        if (!wide && p[i] == 0) {
+            return (uint32_t)(i + 1);
+        }
+        if (wide && i + 1 < n && p[i] == 0 && p[i + 1] == 0) {
+            return (uint32_t)(i + 2);
+        }
+        i += wide ? 2 : 1;
+    }
+    return 0;
+}
+
+/* =========================== APEv2 =========================== */
+static int ape_field(const char *key)
+{
+    static const char *const keys[] = { "Title", "Artist", "Album", "Track" };
+
+    for (int i = 0; i < 4; i++) {
+        if (strcasecmp(key, keys[i]) == 0) {
+            return FIELD_TITLE + i;
+        }
+    }
+    return FIELD_NONE;
+}
+
+// APE 标签位于文件末尾 (ID3v1 之前)，以 32 字节的尾部结构结束
+static bool parse_ape(FILE *fp, long tag_end, media_tags_t *out)
+{
+    uint8_t f[APE_FOOTER_LEN];
+    uint8_t buf[FRAME_BUF_LEN];
+    char key[APE_KEY_MAX];
+
+    if (tag_end < APE_FOOTER_LEN || fseek(fp, tag_end - APE_FOOTER_LEN, SEEK_SET) != 0 ||
+        fread(f, 1, sizeof(f), fp) != sizeof(f) || memcmp(f, "APETAGEX", 8) != 0) {
+        return false;
+    }
+
+    uint32_t size = le32(f + 12);       // 所有条目加尾部，不含头部
+    uint32_t items = le32(f + 16);
+    uint32_t flags = le32(f + 20);
+    if ((flags & (1u << 29)) || size < APE_FOOTER_LEN || size > (uint32_t)tag_end) {
+        return false;
+    }
+
+    long pos = tag_end - (long)size;
+    const long end = tag_end - APE_FOOTER_LEN;
+
+    for (uint32_t i = 0; i < items && pos + 8 < end; i++) {
+        uint8_t ih[8];
+        if (fseek(fp, pos, SEEK_SET) != 0 || fread(ih, 1, sizeof(ih), fp) != sizeof(ih)) {
+            break;
+        }
+        uint32_t value_len = le32(ih);
+        uint32_t item_flags = le32(ih + 4);
+
+        size_t avail = (size_t)(end - pos - 8) < sizeof(key) ? (size_t)(end - pos - 8) : sizeof(key);
+        size_t got = fread(key, 1, avail, fp);
+        char *nul = memchr(key, '\0', got);
+        if (nul == NULL) {
+            break;
+        }
+        pos += 8 + (nul - key) + 1;
+        if (value_len > (uint32_t)(end - pos)) {
+            break;
+        }
+
+        int field = ape_field(key);
+        // 条目类型 0 为 UTF-8 文本，二进制条目 (封面等) 直接跳过
+        if (field != FIELD_NONE && ((item_flags >> 1) & 0x3) == 0 && value_len > 0) {
+            size_t n = value_len < sizeof(buf) ? value_len : sizeof(buf);
+            if (fseek(fp, pos, SEEK_SET) == 0 && fread(buf, 1, n, fp) == n) {
+                store_field(out, field, ENC_UTF8, buf, n);
+            }
+        }
+        pos += (long)value_len;
+    }
+
+    out->sources |= MEDIA_TAGS_F_APE;
+    return true;
+}
+
+/* =========================== ID3v1 =========================== */
+static bool read_id3v1(FILE *fp, long file_size, uint8_t *tag)
+{
+    return file_size >= ID3V1_LEN && fseek(fp, file_size - ID3V1_LEN, SEEK_SET) == 0 &&
+           fread(tag, 1, ID3V1_LEN, fp) == ID3V1_LEN && memcmp(tag, "TAG", 3) == 0;
+}
+
+static void parse_id3v1(const uint8_t *tag, media_tags_t *out)
+{
+    store_field(out, FIELD_TITLE, ENC_LATIN1, tag + 3, 30);
+    store_field(out, FIELD_ARTIST, ENC_LATIN1, tag + 33, 30);
+    store_field(out, FIELD_ALBUM, ENC_LATIN1, tag + 63, 30);
+    // ID3v1.1: 注释的最后一个字节为音轨号
+    if (out->track_no == 0 && tag[125] == 0 && tag[126] != 0) {
+        out->track_no = tag[126];
+    }
+    out->sources |= MEDIA_TAGS_F_ID3V1;
+}
+
+/* =========================== 对外接口 =========================== */
+esp_err_t media_tags_read(FILE *fp, media_tags_t *out)
+{
+    uint8_t v1[ID3V1_LEN];
+
+    memset(out, 0, sizeof(*out));
+    parse_id3v2(fp, out);
+
+    if (fseek(fp, 0, SEEK_END) == 0) {
+        long file_size = ftell(fp);
+        bool has_v1 = read_id3v1(fp, file_size, v1);
+        parse_ape(fp, has_v1 ? file_size - ID3V1_LEN : file_size, out);
+        if (has_v1) {
+            parse_id3v1(v1, out);
+        }
+    }
+
+    return out->sources ? ESP_OK : ESP_ERR_NOT_FOUND;
+}
+
+esp_err_t media_tags_find_picture(FILE *fp, uint32_t *offset, uint32_t *size)
+{
+    uint8_t buf[FRAME_BUF_LEN];
+    id3v2_iter_t it;
+    id3v2_frame_t frame;
+    bool found = false;
+
+    if (!id3v2_begin(fp, &it)) {
+        return ESP_ERR_NOT_FOUND;
+    }
+    while (id3v2_next(fp, &it, &frame)) {
+        bool apic = (it.version == 2) ? memcmp(frame.id, "PIC", 3) == 0 : memcmp(frame.id, "APIC", 4) == 0;
+        // 反同步过的图片数据中插入了 00 字节，无法直接交给解码器
+        if (!apic || id3v2_frame_packed(&it, &frame) || id3v2_frame_unsynced(&it, &frame)) {
+            continue;
+        }
+        uint32_t skip = id3v2_frame_skip(&it, &frame);
+        if (frame.size <= skip) {
+            continue;
+        }
+        size_t n = frame.size - skip < sizeof(buf) ? frame.size - skip : sizeof(buf);
+        if (fseek(fp, frame.data + (long)skip, SEEK_SET) != 0 || fread(buf, 1, n, fp) != n) {
+            continue;
+        }
+
+        uint8_t type = 0;
+        uint32_t off = apic_jpeg_offset(buf, n, it.version, &type);
+        if (off == 0 || off >= frame.size - skip) {
+            continue;
+        }
+        // 优先使用类型 3 (封面正面)，否则取第一张 JPEG
+        if (!found || type == 3) {
+            *offset = (uint32_t)frame.data + skip + off;
+            *size = frame.size - skip - off;
+            found = true;
+        }
+        if (type == 3) {
+            break;
+        }
+    }
+    return found ? ESP_OK : ESP_ERR_NOT_FOUND;
+}
+
+esp_err_t media_tags_read_file(const char *path, media_tags_t *out)
+{
+    FILE *fp = fopen(path, "rb");
+    if (fp == NULL) {
+        memset(out, 0, sizeof(*out));
+        return ESP_FAIL;
+    }
+    esp_err_t ret = media_tags_read(fp, out);
+    fclose(fp);
+    return ret;
+}
@@ -0,0 +1,58 @@
+// main/task/media_tags.h
+#ifndef MEDIA_TAGS_H
+#define MEDIA_TAGS_H
+
+#include <stdio.h>
+#include <stdint.h>
+#include "esp_err.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define MEDIA_TAG_TEXT_MAX      128     // 单个字段 (UTF-8) 的最大长度，含结束符
+
+#define MEDIA_TAGS_F_ID3V2      0x01
+#define MEDIA_TAGS_F_APE        0x02
+#define MEDIA_TAGS_F_ID3V1      0x04
+
+/**
+ * @brief 从标签中解析出的元数据，字符串统一转换为 UTF-8，缺失的字段为空串/0
+ */
+typedef struct {
+    char title[MEDIA_TAG_TEXT_MAX];
+    char artist[MEDIA_TAG_TEXT_MAX];
+    char album[MEDIA_TAG_TEXT_MAX];
+    uint16_t track_no;
+    uint32_t duration_ms;   // ID3v2 TLEN 给出的时长提示，不一定准确
+    uint8_t sources;        // 实际找到的标签 MEDIA_TAGS_F_*
+} media_tags_t;
+
+/**
+ * @brief 读取文件开头的 ID3v2、末尾的 APEv2 和 ID3v1 标签
+ *
+ * 只读取标签头和需要的文本帧，封面 (APIC) 等其余帧按长度直接跳过，
+ * 不会读入音频数据。字段优先级 ID3v2 > APEv2 > ID3v1。
+ *
+ * @return ESP_OK 至少找到一种标签；ESP_ERR_NOT_FOUND 没有标签
+ */
+esp_err_t media_tags_read(FILE *fp, media_tags_t *out);
+
+esp_err_t media_tags_read_file(const char *path, media_tags_t *out);
+
+/**
+ * @brief 在 ID3v2 标签中查找内嵌的 JPEG 封面 (APIC/PIC)，优先取类型 3 (封面正面)
+ *
+ * 只读取各帧的帧头，不读图片数据。
+ *
+ * @param[out] offset 图片数据在文件中的偏移
+ * @param[out] size   图片数据的长度
+ * @return ESP_OK 找到；ESP_ERR_NOT_FOUND 没有 JPEG 封面
+ */
+esp_err_t media_tags_find_picture(FILE *fp, uint32_t *offset, uint32_t *size);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // MEDIA_TAGS_H
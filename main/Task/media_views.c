@@ -0,0 +1,396 @@
+// main/task/media_views.c
+#include <stdlib.h>
+#include <string.h>
+#include "freertos/FreeRTOS.h"
+#include "freertos/semphr.h"
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "esp_heap_caps.h"
+
+#include "media_library.h"
+#include "media_meta.h"
+#include "media_views.h"
+
+static const char *TAG = "MEDIA_VIEWS";
+
+static uint32_t *s_perm[MEDIA_VIEW_COUNT];
+static uint32_t s_count;
+static uint32_t s_generation;
+static SemaphoreHandle_t s_lock;
+
+/* =========================== 排序键 =========================== */
+// 排序键由两段组成: a [+ '/' + b]，只有路径视图用到第二段
+typedef struct {
+    const char *a;
+    const char *b;
+} view_key_t;
+
+typedef struct {
+    media_view_t view;
+    media_library_view_t lib;
+    const media_meta_t *meta;
+} view_ctx_t;
+
+// qsort 没有上下文参数，排序只在曲库任务中进行，指向排序用的副本
+static view_ctx_t s_sort_ctx;
+
+/* =========================== 排序用的副本 =========================== */
+// 排序键所需的曲库表、元数据数组和两个字符串池整块拷贝出来，
+// 加锁期间只做内存拷贝，排序时不再持有曲库和元数据的锁
+typedef struct {
+    void *blob;
+    media_meta_t meta;
+    view_ctx_t ctx;
+} sort_snapshot_t;
+
+static void *snapshot_take(uint8_t **p, const void *src, size_t bytes)
+{
+    void *dst = *p;
+    if (bytes) {
+        memcpy(dst, src, bytes);
+    }
+    *p += (bytes + 3) & ~(size_t)3;
+    return dst;
+}
+
+static esp_err_t snapshot_create(sort_snapshot_t *snap)
+{
+    media_library_view_t lib;
+    memset(snap, 0, sizeof(*snap));
+
+    media_library_lock(&lib);
+    const media_meta_t *m = media_meta_lock();
+    size_t bytes = (((size_t)lib.dir_count * sizeof(media_dir_t) + 3) & ~(size_t)3) +
+                   (((size_t)lib.track_count * sizeof(media_track_t) + 3) & ~(size_t)3) +
+                   (((size_t)lib.pool_size + 3) & ~(size_t)3) +
+                   (size_t)m->count * sizeof(uint32_t) +
+                   (((size_t)m->count * sizeof(uint16_t) + 3) & ~(size_t)3) * 3 +
+                   (size_t)m->string_count * sizeof(uint32_t) +
+                   m->pool_size;
+    uint8_t *p = heap_caps_malloc(bytes, MALLOC_CAP_SPIRAM | MALLOC_CAP_8BIT);
+    if (p == NULL) {
+        p = malloc(bytes);
+    }
+    if (p == NULL) {
+        media_meta_unlock();
+        media_library_unlock();
+        return ESP_ERR_NO_MEM;
+    }
+    snap->blob = p;
+
+    snap->ctx.lib.dirs = snapshot_take(&p, lib.dirs, (size_t)lib.dir_count * sizeof(media_dir_t));
+    snap->ctx.lib.dir_count = lib.dir_count;
+    snap->ctx.lib.tracks = snapshot_take(&p, lib.tracks, (size_t)lib.track_count * sizeof(media_track_t));
+    snap->ctx.lib.track_count = lib.track_count;
+    snap->ctx.lib.pool = snapshot_take(&p, lib.pool, lib.pool_size);
+    snap->ctx.lib.pool_size = lib.pool_size;
+
+    snap->meta.count = m->count;
+    snap->meta.title = snapshot_take(&p, m->title, (size_t)m->count * sizeof(uint32_t));
+    snap->meta.artist = snapshot_take(&p, m->artist, (size_t)m->count * sizeof(uint16_t));
+    snap->meta.album = snapshot_take(&p, m->album, (size_t)m->count * sizeof(uint16_t));
+    snap->meta.track_no = snapshot_take(&p, m->track_no, (size_t)m->count * sizeof(uint16_t));
+    snap->meta.strings = snapshot_take(&p, m->strings, (size_t)m->string_count * sizeof(uint32_t));
+    snap->meta.string_count = m->string_count;
+    snap->meta.pool = snapshot_take(&p, m->pool, m->pool_size);
+    snap->meta.pool_size = m->pool_size;
+    media_meta_unlock();
+    media_library_unlock();
+
+    snap->ctx.meta = &snap->meta;
+    return ESP_OK;
+}
+
+static void snapshot_free(sort_snapshot_t *snap)
+{
+    free(snap->blob);
+    snap->blob = NULL;
+}
+
+static inline uint8_t fold(uint8_t c)
+{
+    return (c >= 'A' && c <= 'Z') ? (uint8_t)(c + ('a' - 'A')) : c;
+}
+
+static const char *meta_string(const view_ctx_t *ctx, uint32_t t, const uint16_t *ids)
+{
+    return t < ctx->meta->count ? media_meta_string(ctx->meta, ids[t]) : "";
+}
+
+static const char *track_title(const view_ctx_t *ctx, uint32_t t)
+{
+    const media_meta_t *m = ctx->meta;
+    if (t < m->count && m->title[t] != MEDIA_META_NO_TAGS) {
+        return m->pool + m->title[t];
+    }
+    return ctx->lib.pool + ctx->lib.tracks[t].name_off;
+}
+
+static view_key_t track_key(const view_ctx_t *ctx, uint32_t t)
+{
+    view_key_t k = { "", NULL };
+    switch (ctx->view) {
+        case MEDIA_VIEW_TITLE:
+            k.a = track_title(ctx, t);
+            break;
+        case MEDIA_VIEW_ARTIST:
+            k.a = meta_string(ctx, t, ctx->meta->artist);
+            break;
+        case MEDIA_VIEW_ALBUM:
+            k.a = meta_string(ctx, t, ctx->meta->album);
+            break;
+        case MEDIA_VIEW_PATH:
+            k.a = ctx->lib.pool + ctx->lib.dirs[ctx->lib.tracks[t].dir].path_off;
+            k.b = ctx->lib.pool + ctx->lib.tracks[t].name_off;
+            if (k.a[0] == '\0') {
+                k.a = k.b;      // 根目录下的文件没有 '/' 前缀
+                k.b = NULL;
+            }
+            break;
+        default:
+            break;
+    }
+    return k;
+}
+
+// 逐字节取出折叠为小写的键，结束时返回 0
+static inline uint8_t key_next(view_key_t *k)
+{
+    if (*k->a == '\0') {
+        if (k->b == NULL) {
+            return 0;
+        }
+        k->a = k->b;
+        k->b = NULL;
+        return '/';
+    }
+    return fold((uint8_t)*k->a++);
+}
+
+static int key_cmp(view_key_t x, view_key_t y)
+{
+    for (;;) {
+        uint8_t a = key_next(&x);
+        uint8_t b = key_next(&y);
+        if (a != b) {
+            return a < b ? -1 : 1;
+        }
+        if (a == 0) {
+            return 0;
+        }
+    }
+}
+
+// 比较键的前 strlen(prefix) 个字符与 prefix (prefix 已折叠为小写)
+static int key_cmp_prefix(view_key_t k, const char *prefix)
+{
+    for (; *prefix; prefix++) {
+        uint8_t c = key_next(&k);
+        if (c != (uint8_t)*prefix) {
+            return c < (uint8_t)*prefix ? -1 : 1;
+        }
+    }
+    return 0;
+}
+
+static int str_cmp_folded(const char *a, const char *b)
+{
+    view_key_t x = { a, NULL };
+    view_key_t y = { b, NULL };
+    return key_cmp(x, y);
+}
+
+static int track_cmp(const void *pa, const void *pb)
+{
+    const view_ctx_t *ctx = &s_sort_ctx;
+    uint32_t a = *(const uint32_t *)pa;
+    uint32_t b = *(const uint32_t *)pb;
+
+    int r = key_cmp(track_key(ctx, a), track_key(ctx, b));
+    if (r != 0) {
+        return r;
+    }
+
+    // 主键相同时的次序: 艺术家视图按专辑，专辑视图按音轨号，最后按标题和曲库顺序
+    const media_meta_t *m = ctx->meta;
+    if (ctx->view == MEDIA_VIEW_ARTIST) {
+        r = str_cmp_folded(meta_string(ctx, a, m->album), meta_string(ctx, b, m->album));
+        if (r != 0) {
+            return r;
+        }
+    }
+    if ((ctx->view == MEDIA_VIEW_ARTIST || ctx->view == MEDIA_VIEW_ALBUM) && a < m->count && b < m->count &&
+        m->track_no[a] != m->track_no[b]) {
+        return m->track_no[a] < m->track_no[b] ? -1 : 1;
+    }
+    if (ctx->view != MEDIA_VIEW_TITLE && ctx->view != MEDIA_VIEW_PATH) {
+        r = str_cmp_folded(track_title(ctx, a), track_title(ctx, b));
+        if (r != 0) {
+            return r;
+        }
+    }
+    return a < b ? -1 : (a > b);
+}
+
+/* =========================== 对外接口 =========================== */
+esp_err_t media_views_init(void)
+{
+    if (s_lock == NULL) {
+        s_lock = xSemaphoreCreateMutex();
+        if (s_lock == NULL) {
+            return ESP_ERR_NO_MEM;
+        }
+    }
+    return ESP_OK;
+}
+
+esp_err_t media_views_build(void)
+{
+    uint32_t *perm[MEDIA_VIEW_COUNT] = { 0 };
+    sort_snapshot_t snap;
+    int64_t t0 = esp_timer_get_time();
+
+    // 只在拷贝排序键时短暂持有曲库和元数据的锁，排序期间界面仍可读取曲目名称
+    esp_err_t ret = snapshot_create(&snap);
+    if (ret != ESP_OK) {
+        return ret;
+    }
+    int64_t t1 = esp_timer_get_time();
+
+    uint32_t count = snap.ctx.lib.track_count;
+    for (int v = 0; v < MEDIA_VIEW_COUNT; v++) {
+        size_t bytes = (size_t)(count ? count : 1) * sizeof(uint32_t);
+        perm[v] = heap_caps_malloc(bytes, MALLOC_CAP_SPIRAM | MALLOC_CAP_8BIT);
+        if (perm[v] == NULL) {
+            perm[v] = malloc(bytes);
+        }
+        if (perm[v] == NULL) {
+            for (int i = 0; i < v; i++) {
+                free(perm[i]);
+            }
+            snapshot_free(&snap);
+            return ESP_ERR_NO_MEM;
+        }
+    }
+
+    s_sort_ctx = snap.ctx;
+    for (int v = 0; v < MEDIA_VIEW_COUNT; v++) {
+        s_sort_ctx.view = (media_view_t)v;
+        for (uint32_t i = 0; i < count; i++) {
+            perm[v][i] = i;
+        }
+        qsort(perm[v], count, sizeof(uint32_t), track_cmp);
+    }
+    snapshot_free(&snap);
+
+    xSemaphoreTake(s_lock, portMAX_DELAY);
+    for (int v = 0; v < MEDIA_VIEW_COUNT; v++) {
+        free(s_perm[v]);
+        s_perm[v] = perm[v];
+    }
+    s_count = count;
+    s_generation++;
+    xSemaphoreGive(s_lock);
+
+    ESP_LOGI(TAG, "排序视图已建立: %u 首曲目, 用时 %lld ms (持锁拷贝 %lld us)", (unsigned)count,
+             (esp_timer_get_time() - t0) / 1000, t1 - t0);
+    return ESP_OK;
+}
+
+uint32_t media_views_count(void)
+{
+    if (s_lock == NULL) {
+        return 0;
+    }
+    xSemaphoreTake(s_lock, portMAX_DELAY);
+    uint32_t count = s_count;
+    xSemaphoreGive(s_lock);
+    return count;
+}
+
+bool media_views_track(media_view_t view, uint32_t pos, uint32_t *track)
+{
+    if (s_lock == NULL || view >= MEDIA_VIEW_COUNT) {
+        return false;
+    }
+    xSemaphoreTake(s_lock, portMAX_DELAY);
+    bool ok = pos < s_count;
+    if (ok) {
+        *track = s_perm[view][pos];
+    }
+    xSemaphoreGive(s_lock);
+    return ok;
+}
+
+void media_search_begin(media_search_t *search, media_view_t view)
+{
+    memset(search, 0, sizeof(*search));
+    search->view = view;
+    search->generation = UINT32_MAX;
+}
+
+uint32_t media_search_update(media_search_t *search, const char *prefix)
+{
+    char folded[MEDIA_SEARCH_MAX];
+    size_t len = 0;
+    for (; prefix[len] && len < sizeof(folded) - 1; len++) {
+        folded[len] = (char)fold((uint8_t)prefix[len]);
+    }
+    folded[len] = '\0';
+
+    if (s_lock == NULL || search->view >= MEDIA_VIEW_COUNT) {
+        search->first = search->count = 0;
+        return 0;
+    }
+
+    xSemaphoreTake(s_lock, portMAX_DELAY);
+    uint32_t lo = 0;
+    uint32_t hi = s_count;
+    size_t old_len = strlen(search->prefix);
+    if (search->generation == s_generation && strncmp(folded, search->prefix, old_len) == 0) {
+        // 继续输入: 结果只会在上一次的范围内
+        lo = search->first;
+        hi = search->first + search->count;
+    }
+
+    view_ctx_t ctx;
+    ctx.view = search->view;
+    media_library_lock(&ctx.lib);
+    ctx.meta = media_meta_lock();
+    const uint32_t *perm = s_perm[search->view];
+    if (hi > ctx.lib.track_count) {
+        hi = lo = 0;    // 曲库已重新加载，视图尚未重建
+    }
+
+    // 第一个 >= prefix 的位置
+    uint32_t a = lo, b = hi;
+    while (a < b) {
+        uint32_t mid = a + (b - a) / 2;
+        if (key_cmp_prefix(track_key(&ctx, perm[mid]), folded) < 0) {
+            a = mid + 1;
+        } else {
+            b = mid;
+        }
+    }
+    uint32_t first = a;
+    // 第一个 > prefix 的位置
+    b = hi;
+    while (a < b) {
+        uint32_t mid = a + (b - a) / 2;
+        if (key_cmp_prefix(track_key(&ctx, perm[mid]), folded) <= 0) {
+            a = mid + 1;
+        } else {
+            b = mid;
+        }
+    }
+
+    media_meta_unlock();
+    media_library_unlock();
+
+    search->first = first;
+    search->count = a - first;
+    search->generation = s_generation;
+    memcpy(search->prefix, folded, len + 1);
+    xSemaphoreGive(s_lock);
+    return search->count;
+}
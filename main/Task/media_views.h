@@ -0,0 +1,74 @@
+// main/task/media_views.h
+#ifndef MEDIA_VIEWS_H
+#define MEDIA_VIEWS_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "esp_err.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define MEDIA_SEARCH_MAX    64      // 搜索前缀的最大长度，含结束符
+
+/**
+ * @brief 曲库的排序视图
+ */
+typedef enum {
+    MEDIA_VIEW_TITLE,       // 标题 (无标签时用文件名)
+    MEDIA_VIEW_ARTIST,      // 艺术家，其次专辑、音轨号
+    MEDIA_VIEW_ALBUM,       // 专辑，其次音轨号
+    MEDIA_VIEW_PATH,        // 目录路径 + 文件名
+    MEDIA_VIEW_COUNT,
+} media_view_t;
+
+/**
+ * @brief 增量搜索的状态，输入每多一个字符只需在上一次的结果范围内继续二分
+ */
+typedef struct {
+    media_view_t view;
+    uint32_t generation;    // 视图重建后之前的范围失效
+    uint32_t first;         // 匹配的条目为视图中的 [first, first + count)
+    uint32_t count;
+    char prefix[MEDIA_SEARCH_MAX];
+} media_search_t;
+
+esp_err_t media_views_init(void);
+
+/**
+ * @brief 根据当前曲库和元数据缓存重建所有排序视图
+ *
+ * 每个视图是一张曲库序号的排列 (uint32_t[count])，排序键按 ASCII 不区分大小写比较。
+ * 同一张排列也是该视图的前缀索引：匹配某个前缀的条目在排列中连续，二分查找即可定位。
+ * @note  只能在修改曲库的任务 (曲库扫描任务) 中调用
+ */
+esp_err_t media_views_build(void);
+
+/**
+ * @brief 视图中的条目数，视图尚未建立时为 0
+ */
+uint32_t media_views_count(void);
+
+/**
+ * @brief 取视图中第 pos 个条目对应的曲库序号
+ */
+bool media_views_track(media_view_t view, uint32_t pos, uint32_t *track);
+
+void media_search_begin(media_search_t *search, media_view_t view);
+
+/**
+ * @brief 按前缀 (不区分大小写) 更新搜索结果
+ *
+ * 新前缀以上一次的前缀开头时 (继续输入)，只在上一次的结果范围内查找；
+ * 否则 (删除字符、换了关键字) 在整个视图中查找。
+ *
+ * @return 匹配的条目数，结果范围见 search->first / search->count
+ */
+uint32_t media_search_update(media_search_t *search, const char *prefix);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // MEDIA_VIEWS_H
@@ -2,10 +2,12 @@
 #include <stdio.h>
 #include <string.h>
 #include <dirent.h>
-#include <strings.h>
 #include "freertos/FreeRTOS.h"
 #include "freertos/task.h"
+#include "freertos/semphr.h"
 #include "esp_log.h"
+#include "esp_timer.h"
+#include "esp_random.h"
 #include "esp_err.h"
 
 #include "audio_player.h"
@@ -14,75 +16,574 @@
 
 #include "mp3_task.h"
 #include "mp3_ui.h"
+#include "audio_analysis.h"
+#include "media_library.h"
+#include "media_meta.h"
+#include "playlist.h"
+#include "m3u_playlist.h"
+#include "cover_art.h"
+#include "sd_hotplug.h"
+#include "flash_audio.h"
+#include "track_cache.h"
+#include "boot_snapshot.h"
+#include "play_history.h"
+#include "player_ctrl.h"
 #include "esp_lvgl_port.h"
 
 static const char *TAG = "MP3_LOGIC";
 
-#define MAX_MP3_FILES 50
-#define MAX_FILENAME_LEN 256
+#define MAX_FILENAME_LEN MEDIA_LIBRARY_PATH_LEN
+#define UI_STATUS_PERIOD_US (200 * 1000)   // 扫描中曲目数的刷新间隔
+#define MAX_SKIP_MISSING 8                 // 连续跳过无法打开的曲目的上限
+#define STOP_WAIT_MS 500                   // 拔卡时等待播放停止的上限，超时由插拔任务稍后再试
 
-static char *playlist[MAX_MP3_FILES];
-static int file_count = 0;
-static int current_file_index = 0;
+#define NAME_CACHE_SLOTS 32                // 多于浏览页同时绑定的行数，相邻序号不会互相挤占
+#define NAME_TEXT_MAX 64
+
+static playlist_t playlist;     // 路径存放在 PSRAM 字符串池中，条目数不设上限
+static SemaphoreHandle_t playlist_lock;    // 扫描任务追加，UI/音频回调读取；持有期间不访问 SD 卡
+static SemaphoreHandle_t m3u_lock;         // 从卡上读 M3U 条目时持有，替换 m3u 时先取它再取 playlist_lock
+static m3u_playlist_t m3u;      // 正在播放的 M3U 列表，只保存各条目的文件偏移
+static bool m3u_active;         // 为 false 时播放整个曲库
+static uint32_t source_gen;     // 每次切换播放源加一，之前读出的路径和名称随之作废
+static volatile int current_file_index = 0;    // 只在 playlist_lock 下修改，对齐的 32 位读写是原子的，界面可以直接读取
+static int64_t first_playable_us;          // 首个可播放曲目就绪的时刻 (自启动起)
+static int64_t last_status_us;
+static volatile bool card_online;          // 拔卡后不再打开任何文件
+static bool resume_after_insert;           // 拔卡时正在播放，重新插卡扫描完后接着播放
+static volatile bool playing_builtin;      // 正在播放内置分区中的音频，播完不自动切到下一首
+static bool card_seen;                     // 已收到启动时第一次挂载的结果
+static char restore_path[MAX_FILENAME_LEN];    // 启动快照中的曲目，曲库就绪后按路径找回
+static int restore_index = -1;             // 找回的序号，第一次播放它时跳到上次的位置
+static uint32_t restore_position_ms;       // 播放记录中同一曲目的位置
+static boot_snapshot_t snapshot;
+
+// M3U 条目的显示名称，控制任务从卡上读出后填入，界面只读这里；第 i 条固定放在 i % NAME_CACHE_SLOTS
+typedef enum {
+    NAME_EMPTY,
+    NAME_PENDING,   // 界面要过，等控制任务读出
+    NAME_READY,
+    NAME_FAILED,    // 条目读不出 (序号越界、卡已拔出等)
+} name_state_t;
+
+static struct {
+    uint32_t gen;
+    uint32_t index;
+    name_state_t state;
+    char text[NAME_TEXT_MAX];
+} names[NAME_CACHE_SLOTS];
+static portMUX_TYPE names_lock = portMUX_INITIALIZER_UNLOCKED;  // 保护 names[]，m3u_active 和 source_gen 也在其中修改
 
 /* =========================== 文件扫描 (已修复) =========================== */
-static void scan_mp3_files(const char *dir_path) {
-    DIR *dir = opendir(dir_path);
-    if (!dir) {
-        ESP_LOGE(TAG, "Failed to open directory: %s", dir_path);
+// 把曲库中 [first, first + count) 追加到播放列表，调用者需持有 playlist_lock
+static void append_tracks_locked(uint32_t first, uint32_t count) {
+    char path[MAX_FILENAME_LEN];
+    for (uint32_t i = first; i < first + count; i++) {
+        // [已修复] 增加对路径长度的安全检查
+        if (media_library_track_path(i, path, sizeof(path)) < 0) {
+            ESP_LOGE(TAG, "File path too long, skipping track %u", (unsigned)i);
+            continue;
+        }
+        if (playlist_add(&playlist, path) != ESP_OK) {
+            ESP_LOGE(TAG, "Failed to allocate memory for filepath");
+            break;
+        }
+    }
+}
+
+// 曲库整体替换后重建播放列表，并按路径找回正在播放的曲目
+static void rebuild_playlist_locked(uint32_t total) {
+    char current[MAX_FILENAME_LEN] = "";
+    const char *p = playlist_get(&playlist, current_file_index);
+    if (p) {
+        strlcpy(current, p, sizeof(current));
+    }
+
+    playlist_clear(&playlist);
+    // 按平均 48 字节路径预留，通常一次分配即可
+    playlist_reserve(&playlist, total, total * 48);
+    append_tracks_locked(0, total);
+
+    current_file_index = 0;
+    for (uint32_t i = 0; current[0] && i < playlist_count(&playlist); i++) {
+        if (strcmp(playlist_get(&playlist, i), current) == 0) {
+            current_file_index = (int)i;
+            break;
+        }
+    }
+}
+
+// 在播放列表 [first, 末尾) 中找回快照中的曲目，调用者需持有 playlist_lock
+static void resolve_restore_locked(uint32_t first) {
+    if (restore_path[0] == '\0' || m3u_active) {
         return;
     }
-    struct dirent *entry;
-    file_count = 0;
-    while ((entry = readdir(dir)) != NULL && file_count < MAX_MP3_FILES) {
-        if (entry->d_type == DT_REG) {
-            char *dot = strrchr(entry->d_name, '.');
-            if (dot && (strcasecmp(dot, ".mp3") == 0)) {
-                char *filepath = malloc(MAX_FILENAME_LEN);
-                if (filepath) {
-                    // [已修复] 增加对 snprintf 返回值的安全检查
-                    int written_len = snprintf(filepath, MAX_FILENAME_LEN, "%s/%s", dir_path, entry->d_name);
-                    if (written_len < 0 || written_len >= MAX_FILENAME_LEN) {
-                        ESP_LOGE(TAG, "File path too long, skipping: %s/%s", dir_path, entry->d_name);
-                        free(filepath);
-                        continue;
-                    }
-                    playlist[file_count++] = filepath;
-                    ESP_LOGI(TAG, "Found MP3: %s", filepath);
-                } else {
-                    ESP_LOGE(TAG, "Failed to allocate memory for filepath");
-                    break;
-                }
+    for (uint32_t i = first; i < playlist_count(&playlist); i++) {
+        if (strcmp(playlist_get(&playlist, i), restore_path) == 0) {
+            current_file_index = (int)i;
+            restore_index = (int)i;
+            restore_path[0] = '\0';
+            return;
+        }
+    }
+}
+
+// 当前播放源 (曲库或 M3U) 的条目数，调用者需持有 playlist_lock
+static uint32_t source_count_locked(void) {
+    return m3u_active ? m3u_playlist_count(&m3u) : playlist_count(&playlist);
+}
+
+// 切换播放源，调用者需持有 m3u_lock 和 playlist_lock
+static void set_source_locked(bool use_m3u) {
+    taskENTER_CRITICAL(&names_lock);
+    m3u_active = use_m3u;
+    source_gen++;
+    taskEXIT_CRITICAL(&names_lock);
+}
+
+// 取第 gen 代播放源第 index 个条目的完整路径。M3U 条目此时才从文件中读出，
+// 读卡时只持有 m3u_lock，不挡住取曲目数、切歌序号等只访问内存的操作；播放源已切换时返回 false
+static bool source_path(uint32_t index, uint32_t gen, char *buf, size_t len) {
+    bool ok = false;
+
+    xSemaphoreTake(playlist_lock, portMAX_DELAY);
+    bool from_m3u = m3u_active;
+    if (!from_m3u && gen == source_gen) {
+        const char *p = playlist_get(&playlist, index);
+        if (p != NULL) {
+            strlcpy(buf, p, len);
+            ok = true;
+        }
+    }
+    xSemaphoreGive(playlist_lock);
+    if (!from_m3u) {
+        return ok;
+    }
+
+    xSemaphoreTake(m3u_lock, portMAX_DELAY);
+    if (m3u_active && gen == source_gen && sd_hotplug_io_begin()) {
+        ok = m3u_playlist_entry_path(&m3u, index, buf, len) >= 0;
+        sd_hotplug_io_end();
+    }
+    xSemaphoreGive(m3u_lock);
+    return ok;
+}
+
+static const char *basename_of(const char *path) {
+    const char *name = strrchr(path, '/');
+    return name ? name + 1 : path;
+}
+
+// 曲库扫描任务的回调：分批填充播放列表，并在界面上显示扫描进度
+static void library_event_cb(media_library_event_t event, uint32_t first, uint32_t count, void *ctx) {
+    char first_name[MAX_FILENAME_LEN] = "";
+
+    xSemaphoreTake(playlist_lock, portMAX_DELAY);
+    bool was_empty = playlist_count(&playlist) == 0;
+    switch (event) {
+        case MEDIA_LIBRARY_EVENT_LOADED:
+        case MEDIA_LIBRARY_EVENT_RELOADED:
+            if (m3u_active) {
+                // 正在播放 M3U 列表，当前序号不属于曲库
+                int saved = current_file_index;
+                rebuild_playlist_locked(count);
+                current_file_index = saved;
+            } else {
+                rebuild_playlist_locked(count);
+                resolve_restore_locked(0);
             }
+            break;
+        case MEDIA_LIBRARY_EVENT_TRACKS_ADDED:
+            append_tracks_locked(first, count);
+            resolve_restore_locked(first);
+            break;
+        default:
+            break;
+    }
+    uint32_t total = playlist_count(&playlist);
+    int resume_index = current_file_index;
+    bool show = !m3u_active;
+    bool done = event == MEDIA_LIBRARY_EVENT_DONE;
+    bool first_ready = was_empty && total > 0 && show;
+    // 快照中的曲名已经显示，曲库中没有这首时扫描完才换成当前曲目
+    bool show_name = first_ready && restore_index < 0 && restore_path[0] == '\0';
+    if (done && restore_path[0] != '\0') {
+        restore_path[0] = '\0';
+        show_name = total > 0 && show;
+    }
+    if (show_name) {
+        strlcpy(first_name, basename_of(playlist_get(&playlist, current_file_index)), sizeof(first_name));
+    }
+    xSemaphoreGive(playlist_lock);
+
+    if (first_ready && first_playable_us == 0) {
+        first_playable_us = esp_timer_get_time();
+        ESP_LOGI(TAG, "Time to first playable track: %lld ms after boot", first_playable_us / 1000);
+    }
+
+    int64_t now = esp_timer_get_time();
+    if (show && (first_ready || done || now - last_status_us >= UI_STATUS_PERIOD_US)) {
+        last_status_us = now;
+        lvgl_port_lock(0);
+        mp3_ui_update_library_status(total, !done);
+        if (show_name) {
+            mp3_ui_update_filename(first_name);
+        } else if (done && total == 0) {
+            mp3_ui_update_filename("No MP3 files found!");
+        }
+        lvgl_port_unlock();
+    }
+
+    if (done) {
+        ESP_LOGI(TAG, "Playlist: %u tracks, %u bytes", (unsigned)total,
+                 (unsigned)playlist_memory_usage(&playlist));
+        boot_snapshot_set_track_count(total);
+        if (resume_after_insert) {
+            resume_after_insert = false;
+            player_ctrl_post(PLAYER_CMD_PLAY_INDEX, resume_index, false);
         }
     }
-    closedir(dir);
+}
+
+/* =========================== 随机播放 =========================== */
+/*
+ * 随机顺序由以 seed 为密钥的 Feistel 网络给出：它是 [0, 4^h) 上的双射，
+ * 对超出 [0, n) 的结果重复加密 (cycle-walking) 即得到 [0, n) 上的置换。
+ * 播放位置 pos 经置换得到曲目序号，前后移动只需改 pos，内存占用固定，
+ * 一轮 n 首内不会重复。曲库变化后按当前曲目反解出 pos 即可继续。
+ */
+#define SHUFFLE_ROUNDS 4
+
+static uint32_t feistel_f(uint32_t x, uint32_t key, uint32_t round) {
+    x ^= key + round * 0x9E3779B9u;
+    x *= 0x85EBCA6Bu;
+    x ^= x >> 13;
+    x *= 0xC2B2AE35u;
+    x ^= x >> 16;
+    return x;
+}
+
+static uint32_t feistel(uint32_t v, uint32_t half_bits, uint32_t key, bool inverse) {
+    uint32_t mask = (1u << half_bits) - 1;
+    uint32_t l = v >> half_bits;
+    uint32_t r = v & mask;
+    for (uint32_t i = 0; i < SHUFFLE_ROUNDS; i++) {
+        uint32_t t;
+        if (!inverse) {
+            t = r;
+            r = l ^ (feistel_f(r, key, i) & mask);
+            l = t;
+        } else {
+            t = l;
+            l = r ^ (feistel_f(l, key, SHUFFLE_ROUNDS - 1 - i) & mask);
+            r = t;
+        }
+    }
+    return (l << half_bits) | r;
+}
+
+// inverse 为 false 时把位置映射为曲目序号，为 true 时反之
+static uint32_t shuffle_map(uint32_t v, uint32_t n, uint32_t key, bool inverse) {
+    uint32_t half_bits = 1;
+    while (((uint64_t)1 << (2 * half_bits)) < n) {
+        half_bits++;
+    }
+    // 定义域最多为 4n，平均不到 4 次即可落入 [0, n)
+    do {
+        v = feistel(v, half_bits, key, inverse);
+    } while (v >= n);
+    return v;
+}
+
+static struct {
+    bool enabled;
+    uint32_t seed;      // 本轮顺序的密钥
+    uint32_t pos;       // 当前曲目在本轮顺序中的位置
+} shuffle;
+
+// 播完一轮后换下一个密钥，保存 (seed, pos) 即可完整复现播放顺序
+static uint32_t shuffle_next_seed(uint32_t seed) {
+    return seed * 1664525u + 1013904223u;
+}
+
+// shuffle_next_seed 的逆运算，0xFEE058C5 是 1664525 模 2^32 的逆元
+static uint32_t shuffle_prev_seed(uint32_t seed) {
+    return (seed - 1013904223u) * 0xFEE058C5u;
+}
+
+// 本轮第一首正好是上一轮最后一首时，本轮的前两首互换，换轮时不会连续播放同一首。
+// 两首以内无法打乱，按原顺序轮流播放
+static bool shuffle_swapped(uint32_t n, uint32_t seed) {
+    return n > 2 && shuffle_map(0, n, seed, false) == shuffle_map(n - 1, n, shuffle_prev_seed(seed), false);
+}
+
+// 本轮第 pos 首的曲目序号
+static uint32_t shuffle_track(uint32_t pos, uint32_t n, uint32_t seed) {
+    if (n <= 2) {
+        return pos;
+    }
+    if (pos <= 1 && shuffle_swapped(n, seed)) {
+        pos ^= 1;
+    }
+    return shuffle_map(pos, n, seed, false);
+}
+
+// 曲目在本轮中的位置
+static uint32_t shuffle_pos(uint32_t track, uint32_t n, uint32_t seed) {
+    if (n <= 2) {
+        return track;
+    }
+    uint32_t pos = shuffle_map(track, n, seed, true);
+    if (pos <= 1 && shuffle_swapped(n, seed)) {
+        pos ^= 1;
+    }
+    return pos;
 }
 
 /* =========================== 播放器核心函数 =========================== */
-void play_music_by_index(int index) {
-    if (file_count == 0 || index < 0 || index >= file_count) {
-        return;
+
+// 已预读到 PSRAM 的曲目直接在缓存中解码，不访问 SD 卡；
+// 卡上的文件优先经 FatFs 直接读取 (绕过 VFS 和 newlib 的 128 字节 stdio 缓冲)，
+// 组件未启用该路径时退回 fopen。只有文件打不开时返回 ESP_ERR_NOT_FOUND
+static esp_err_t play_from_card(const char *filepath) {
+    const size_t mount_len = strlen(BSP_SD_MOUNT_POINT);
+    if (strncmp(filepath, BSP_SD_MOUNT_POINT, mount_len) == 0 && filepath[mount_len] == '/') {
+        char fatfs_path[MAX_FILENAME_LEN];
+        snprintf(fatfs_path, sizeof(fatfs_path), "%s%s", bsp_sdcard_fatfs_drive(), filepath + mount_len);
+        esp_err_t ret = audio_player_play_fatfs(fatfs_path);
+        if (ret != ESP_ERR_NOT_SUPPORTED) {
+            return ret;
+        }
     }
-    current_file_index = index;
-    const char *filepath = playlist[current_file_index];
 
     FILE *fp = fopen(filepath, "r");
     if (fp == NULL) {
-        ESP_LOGE(TAG, "Failed to open: %s", filepath);
+        return ESP_ERR_NOT_FOUND;
+    }
+    esp_err_t ret = audio_player_play(fp);
+    if (ret != ESP_OK) {
+        fclose(fp);
+    }
+    return ret;
+}
+
+// 打开的文件交给音频任务后由 audio_player_stop_and_wait() 负责，这里只需覆盖打开的过程
+static esp_err_t start_playback(const char *filepath) {
+    audio_player_source_t cached;
+    if (track_cache_acquire(filepath, &cached)) {
+        esp_err_t ret = audio_player_play_source(&cached);
+        if (ret != ESP_OK) {
+            cached.ops->close(cached.ctx);
+        }
+        return ret;
+    }
+
+    if (!sd_hotplug_io_begin()) {
+        return ESP_ERR_INVALID_STATE;
+    }
+    esp_err_t ret = play_from_card(filepath);
+    sd_hotplug_io_end();
+    return ret;
+}
+
+// 按播放顺序取当前曲目之后的几首交给预读任务，不改变随机播放的位置
+static void prefetch_upcoming(void) {
+    static char paths[TRACK_CACHE_PREFETCH][MAX_FILENAME_LEN];
+    const char *list[TRACK_CACHE_PREFETCH];
+    uint32_t upcoming[TRACK_CACHE_PREFETCH];
+    uint32_t wanted = 0;
+    int count = 0;
+
+    // 持锁只算出序号，路径在放开锁后再读
+    xSemaphoreTake(playlist_lock, portMAX_DELAY);
+    uint32_t gen = source_gen;
+    uint32_t n = source_count_locked();
+    uint32_t cur = (current_file_index >= 0 && (uint32_t)current_file_index < n) ? (uint32_t)current_file_index : 0;
+    uint32_t seed = shuffle.seed;
+    uint32_t pos = shuffle.enabled && n > 0 ? shuffle_pos(cur, n, seed) : cur;
+    for (uint32_t k = 0; k < TRACK_CACHE_PREFETCH && k + 1 < n; k++) {
+        uint32_t index;
+        if (!shuffle.enabled) {
+            index = (cur + 1 + k) % n;
+        } else {
+            if (++pos >= n) {
+                pos = 0;
+                seed = shuffle_next_seed(seed);
+            }
+            index = shuffle_track(pos, n, seed);
+        }
+        upcoming[wanted++] = index;
+    }
+    xSemaphoreGive(playlist_lock);
+
+    for (uint32_t k = 0; k < wanted; k++) {
+        if (source_path(upcoming[k], gen, paths[count], sizeof(paths[count]))) {
+            list[count] = paths[count];
+            count++;
+        }
+    }
+    track_cache_prefetch(list, count);
+}
+
+// 播放记录任务采样位置用，内置音频不记录
+static bool history_position(uint32_t *position_ms) {
+    audio_player_state_t state = audio_player_get_state();
+    if (playing_builtin || (state != AUDIO_PLAYER_STATE_PLAYING && state != AUDIO_PLAYER_STATE_PAUSE)) {
+        return false;
+    }
+    *position_ms = audio_player_get_position();
+    return true;
+}
+
+static void history_update_shuffle(void) {
+    xSemaphoreTake(playlist_lock, portMAX_DELAY);
+    bool enabled = shuffle.enabled;
+    uint32_t seed = shuffle.seed;
+    uint32_t pos = shuffle.pos;
+    xSemaphoreGive(playlist_lock);
+    play_history_set_shuffle(enabled, seed, pos);
+}
+
+void play_music_by_index(int index) {
+    char filepath[MAX_FILENAME_LEN];
+    esp_err_t ret = ESP_ERR_NOT_FOUND;
+    bool from_m3u = false;
+
+    if (!card_online) {
+        return;
+    }
+    playing_builtin = false;
+
+    // 条目在即将播放时才检查，打不开的 (M3U 中已删除的文件等) 依次跳过
+    for (int attempt = 0; attempt < MAX_SKIP_MISSING && ret == ESP_ERR_NOT_FOUND; attempt++) {
+        if (index < 0) {
+            return;
+        }
+        xSemaphoreTake(playlist_lock, portMAX_DELAY);
+        bool valid = (uint32_t)index < source_count_locked();
+        uint32_t gen = source_gen;
+        from_m3u = m3u_active;
+        if (valid) {
+            current_file_index = index;
+        }
+        xSemaphoreGive(playlist_lock);
+        if (!valid) {
+            return;
+        }
+
+        bool ok = source_path((uint32_t)index, gen, filepath, sizeof(filepath));
+        ret = ok ? start_playback(filepath) : ESP_ERR_NOT_FOUND;
+        if (ret == ESP_ERR_NOT_FOUND) {
+            ESP_LOGE(TAG, "Failed to open: %s", ok ? filepath : "(invalid entry)");
+            index = advance_music_index(1);
+        }
+    }
+    if (ret == ESP_ERR_NOT_FOUND) {
+        return;
+    }
+    if (ret != ESP_OK) {
+        // 内存不足、请求队列满等，曲目没有开始播放: 不记录历史和快照，也不预读
+        ESP_LOGE(TAG, "Failed to start playback: %s", esp_err_to_name(ret));
+        if (card_online) {
+            lvgl_port_lock(0);
+            mp3_ui_update_filename("Playback error");
+            mp3_ui_update_play_button(false);
+            lvgl_port_unlock();
+        }
         return;
     }
 
     ESP_LOGI(TAG, "Playing: %s", filepath);
-    audio_player_play(fp);
+    play_history_track_started(filepath);
+    history_update_shuffle();
+
+    // 启动后第一次播放快照中的曲目时，从上次记录的位置继续
+    if (index == restore_index && restore_position_ms > 0) {
+        audio_player_seek(restore_position_ms);
+    }
+    restore_index = -1;
+    restore_position_ms = 0;
+
+    // 有标签时显示 "艺术家 - 标题"，否则显示文件名 (曲库播放列表与曲库序号一致)
+    char display[MEDIA_TAG_TEXT_MAX];
+    const char *name = basename_of(filepath);
+    if (!from_m3u && media_meta_display_name((uint32_t)index, display, sizeof(display)) >= 0) {
+        name = display;
+    }
 
-    char *filename_only = strrchr(filepath, '/');
-    filename_only = filename_only ? filename_only + 1 : (char *)filepath;
-    
     lvgl_port_lock(0);
-    mp3_ui_update_filename(filename_only);
+    mp3_ui_update_filename(name);
     mp3_ui_update_play_button(true);
     lvgl_port_unlock();
+
+    boot_snapshot_set_track(filepath, name);
+    cover_art_request(filepath);
+    prefetch_upcoming();
+}
+
+// 按播放顺序前进 (step > 0) 或后退一首，返回新的曲目序号，播放列表为空时返回 -1
+int advance_music_index(int step) {
+    int next = -1;
+
+    xSemaphoreTake(playlist_lock, portMAX_DELAY);
+    uint32_t n = source_count_locked();
+    if (n > 0) {
+        uint32_t cur = (current_file_index >= 0 && (uint32_t)current_file_index < n) ? (uint32_t)current_file_index : 0;
+        if (!shuffle.enabled) {
+            next = (int)((cur + n + (step > 0 ? 1 : n - 1)) % n);
+        } else {
+            // 直接选曲或曲库变化后位置与当前曲目不对应，反解出新位置
+            if (shuffle.pos >= n || shuffle_track(shuffle.pos, n, shuffle.seed) != cur) {
+                shuffle.pos = shuffle_pos(cur, n, shuffle.seed);
+            }
+            if (step > 0) {
+                if (++shuffle.pos >= n) {
+                    shuffle.pos = 0;
+                    shuffle.seed = shuffle_next_seed(shuffle.seed);
+                }
+            } else if (shuffle.pos == 0) {
+                // 回到上一轮的最后一首，而不是本轮的末尾
+                shuffle.pos = n - 1;
+                shuffle.seed = shuffle_prev_seed(shuffle.seed);
+            } else {
+                shuffle.pos--;
+            }
+            next = (int)shuffle_track(shuffle.pos, n, shuffle.seed);
+        }
+    }
+    xSemaphoreGive(playlist_lock);
+    return next;
+}
+
+void mp3_player_set_shuffle(bool enable) {
+    xSemaphoreTake(playlist_lock, portMAX_DELAY);
+    if (enable && !shuffle.enabled) {
+        shuffle.seed = esp_random();
+        shuffle.pos = UINT32_MAX;   // 下一次前进时从当前曲目反解
+    }
+    shuffle.enabled = enable;
+    xSemaphoreGive(playlist_lock);
+    history_update_shuffle();
+    ESP_LOGI(TAG, "Shuffle %s", enable ? "on" : "off");
+}
+
+bool mp3_player_get_shuffle(void) {
+    return shuffle.enabled;
+}
+
+void mp3_player_get_shuffle_state(uint32_t *seed, uint32_t *pos) {
+    xSemaphoreTake(playlist_lock, portMAX_DELAY);
+    *seed = shuffle.seed;
+    *pos = shuffle.pos;
+    xSemaphoreGive(playlist_lock);
+}
+
+void mp3_player_restore_shuffle(uint32_t seed, uint32_t pos) {
+    xSemaphoreTake(playlist_lock, portMAX_DELAY);
+    shuffle.enabled = true;
+    shuffle.seed = seed;
+    shuffle.pos = pos;
+    xSemaphoreGive(playlist_lock);
 }
 
 int get_current_music_index() {
@@ -90,25 +591,206 @@ int get_current_music_index() {
 }
 
 int get_music_file_count() {
-    return file_count;
+    xSemaphoreTake(playlist_lock, portMAX_DELAY);
+    int count = (int)source_count_locked();
+    xSemaphoreGive(playlist_lock);
+    return count;
 }
 
+// 返回的指针指向内部缓冲区，在下次调用前有效
 const char* get_music_filename_by_index(int index) {
-    if (index < 0 || index >= file_count) {
+    static char name[MAX_FILENAME_LEN];
+
+    xSemaphoreTake(playlist_lock, portMAX_DELAY);
+    uint32_t gen = source_gen;
+    xSemaphoreGive(playlist_lock);
+    if (index < 0 || !source_path((uint32_t)index, gen, name, sizeof(name))) {
         return "Invalid Index";
     }
-    const char *filepath = playlist[index];
-    char *filename_only = strrchr(filepath, '/');
-    return filename_only ? filename_only + 1 : (char *)filepath;
+    memmove(name, basename_of(name), strlen(basename_of(name)) + 1);
+    return name;
+}
+
+esp_err_t mp3_player_track_name(int index, char *buf, size_t len) {
+    if (index < 0) {
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    // 曲库的名称都在内存中；M3U 条目只查名称缓存，没有时登记下来交给控制任务去读
+    esp_err_t ret = ESP_OK;
+    bool request = false;
+    taskENTER_CRITICAL(&names_lock);
+    bool from_m3u = m3u_active;
+    if (from_m3u) {
+        uint32_t slot = (uint32_t)index % NAME_CACHE_SLOTS;
+        bool same = names[slot].gen == source_gen && names[slot].index == (uint32_t)index;
+        if (same && names[slot].state == NAME_READY) {
+            strlcpy(buf, names[slot].text, len);
+        } else if (same && names[slot].state == NAME_FAILED) {
+            ret = ESP_ERR_NOT_FOUND;
+        } else {
+            request = !same || names[slot].state != NAME_PENDING;
+            names[slot].gen = source_gen;
+            names[slot].index = (uint32_t)index;
+            names[slot].state = NAME_PENDING;
+            ret = ESP_ERR_NOT_FINISHED;
+        }
+    }
+    taskEXIT_CRITICAL(&names_lock);
+
+    if (from_m3u) {
+        if (request && !player_ctrl_post(PLAYER_CMD_RESOLVE_NAMES, 0, false)) {
+            // 队列满了，下次取这一条时再登记
+            taskENTER_CRITICAL(&names_lock);
+            names[(uint32_t)index % NAME_CACHE_SLOTS].state = NAME_EMPTY;
+            taskEXIT_CRITICAL(&names_lock);
+        }
+        return ret;
+    }
+    // 曲库播放列表与曲库序号一致
+    if (media_meta_display_name((uint32_t)index, buf, len) < 0 &&
+        media_library_track_name((uint32_t)index, buf, len) < 0) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    return ESP_OK;
+}
+
+void mp3_player_resolve_names(void) {
+    char path[MAX_FILENAME_LEN];
+
+    for (uint32_t slot = 0; slot < NAME_CACHE_SLOTS; slot++) {
+        taskENTER_CRITICAL(&names_lock);
+        bool pending = names[slot].state == NAME_PENDING && names[slot].gen == source_gen;
+        uint32_t gen = names[slot].gen;
+        uint32_t index = names[slot].index;
+        taskEXIT_CRITICAL(&names_lock);
+        if (!pending) {
+            continue;
+        }
+
+        bool ok = source_path(index, gen, path, sizeof(path));
+        taskENTER_CRITICAL(&names_lock);
+        // 读卡期间界面可能已改要别的条目，或者播放源已切换
+        bool same = names[slot].gen == gen && names[slot].index == index && names[slot].state == NAME_PENDING;
+        if (same) {
+            names[slot].state = ok ? NAME_READY : NAME_FAILED;
+            strlcpy(names[slot].text, ok ? basename_of(path) : "", sizeof(names[slot].text));
+        }
+        taskEXIT_CRITICAL(&names_lock);
+
+        if (same) {
+            lvgl_port_lock(0);
+            mp3_ui_update_track_name(index);
+            lvgl_port_unlock();
+        }
+    }
+}
+
+/* =========================== 播放源切换 =========================== */
+esp_err_t mp3_player_open_m3u(const char *path) {
+    m3u_playlist_t opened;
+
+    // 扫描文件不持锁，完成后再替换
+    if (!sd_hotplug_io_begin()) {
+        return ESP_ERR_INVALID_STATE;
+    }
+    esp_err_t ret = m3u_playlist_open(&opened, path, BSP_SD_MOUNT_POINT);
+    sd_hotplug_io_end();
+    if (ret != ESP_OK) {
+        return ret;
+    }
+    if (m3u_playlist_count(&opened) == 0) {
+        m3u_playlist_close(&opened);
+        return ESP_ERR_NOT_FOUND;
+    }
+
+    uint32_t count = m3u_playlist_count(&opened);
+    xSemaphoreTake(m3u_lock, portMAX_DELAY);
+    xSemaphoreTake(playlist_lock, portMAX_DELAY);
+    m3u_playlist_close(&m3u);
+    m3u = opened;
+    set_source_locked(true);
+    current_file_index = 0;
+    xSemaphoreGive(playlist_lock);
+    xSemaphoreGive(m3u_lock);
+
+    lvgl_port_lock(0);
+    mp3_ui_update_source_status(basename_of(path), count);
+    lvgl_port_unlock();
+
+    play_music_by_index(0);
+    return ESP_OK;
+}
+
+void mp3_player_use_library(void) {
+    xSemaphoreTake(m3u_lock, portMAX_DELAY);
+    xSemaphoreTake(playlist_lock, portMAX_DELAY);
+    bool was_m3u = m3u_active;
+    m3u_playlist_close(&m3u);
+    set_source_locked(false);
+    current_file_index = 0;
+    uint32_t total = playlist_count(&playlist);
+    xSemaphoreGive(playlist_lock);
+    xSemaphoreGive(m3u_lock);
+
+    lvgl_port_lock(0);
+    mp3_ui_update_library_status(total, false);
+    lvgl_port_unlock();
+
+    if (was_m3u) {
+        play_music_by_index(0);
+    }
+}
+
+// 在 SD 卡根目录中按目录顺序切换到下一个播放列表，最后一个之后回到曲库
+void mp3_player_next_source(void) {
+    char current[M3U_PATH_MAX] = "";
+    char next[M3U_PATH_MAX] = "";
+
+    xSemaphoreTake(playlist_lock, portMAX_DELAY);
+    if (m3u_active) {
+        strlcpy(current, basename_of(m3u.path), sizeof(current));
+    }
+    xSemaphoreGive(playlist_lock);
+
+    bool io = sd_hotplug_io_begin();
+    DIR *dir = io ? opendir(BSP_SD_MOUNT_POINT) : NULL;
+    if (dir != NULL) {
+        bool passed = (current[0] == '\0');
+        struct dirent *entry;
+        while ((entry = readdir(dir)) != NULL) {
+            if (entry->d_type != DT_REG || !m3u_playlist_is_playlist(entry->d_name)) {
+                continue;
+            }
+            if (passed) {
+                snprintf(next, sizeof(next), "%s/%s", BSP_SD_MOUNT_POINT, entry->d_name);
+                break;
+            }
+            passed = (strcmp(entry->d_name, current) == 0);
+        }
+        closedir(dir);
+    }
+    if (io) {
+        sd_hotplug_io_end();
+    }
+
+    if (next[0] == '\0' || mp3_player_open_m3u(next) != ESP_OK) {
+        mp3_player_use_library();
+    }
 }
 
 /* =========================== 播放器硬件回调 =========================== */
 static esp_err_t i2s_write_fn(void *audio_buffer, size_t len, size_t *bytes_written, uint32_t timeout_ms) {
-    return bsp_audio_play(audio_buffer, len, bytes_written, pdMS_TO_TICKS(timeout_ms));
+    // 顺带提取电平/频段/节拍特征，供 WS2812 律动灯效使用
+    audio_analysis_feed(audio_buffer, len);
+    esp_err_t ret = bsp_audio_play(audio_buffer, len, bytes_written, pdMS_TO_TICKS(timeout_ms));
+    player_ctrl_on_audio_written();
+    return ret;
 }
 static esp_err_t i2s_reconfig_clk_fn(uint32_t rate, uint32_t bits_per_sample, i2s_slot_mode_t ch) {
     i2s_chan_handle_t tx_handle = bsp_get_i2s_tx_handle();
     if (tx_handle == NULL) return ESP_FAIL;
+    audio_analysis_set_format(rate, bits_per_sample, ch == I2S_SLOT_MODE_MONO ? 1 : 2);
     i2s_std_config_t std_cfg = {
         .clk_cfg = I2S_STD_CLK_DEFAULT_CONFIG(rate),
         .slot_cfg = I2S_STD_PHILIPS_SLOT_DEFAULT_CONFIG((i2s_data_bit_width_t)bits_per_sample, ch),
@@ -122,37 +804,170 @@ static esp_err_t i2s_reconfig_clk_fn(uint32_t rate, uint32_t bits_per_sample, i2
     return ESP_OK;
 }
 static esp_err_t mute_fn(AUDIO_PLAYER_MUTE_SETTING setting) {
-    bsp_audio_set_volume(setting == AUDIO_PLAYER_MUTE ? 0 : BSP_AUDIO_DEFAULT_VOLUME);
+    // 取消静音时恢复用户设置的音量
+    player_ctrl_state_t st;
+    player_ctrl_get_state(&st);
+    bsp_audio_set_volume(setting == AUDIO_PLAYER_MUTE ? 0 : st.volume);
+    return ESP_OK;
+}
+
+esp_err_t mp3_player_play_builtin(const char *name) {
+    const void *data;
+    size_t len;
+    int index = flash_audio_find(name);
+    if (index < 0 || !flash_audio_get((uint32_t)index, &data, &len)) {
+        return ESP_ERR_NOT_FOUND;
+    }
+
+    // 数据直接从 flash 映射中读取，不访问 SD 卡
+    playing_builtin = true;
+    esp_err_t ret = audio_player_play_memory(data, len);
+    if (ret != ESP_OK) {
+        playing_builtin = false;
+        return ret;
+    }
+
+    lvgl_port_lock(0);
+    mp3_ui_update_filename(basename_of(name));
+    mp3_ui_update_cover(NULL);
+    lvgl_port_unlock();
     return ESP_OK;
 }
 
 /* =========================== 播放器状态回调 =========================== */
 static void audio_player_status_cb(audio_player_cb_ctx_t *ctx) {
+    player_ctrl_on_player_event(ctx->audio_event);
     switch (ctx->audio_event) {
         case AUDIO_PLAYER_CALLBACK_EVENT_PLAYING:
             ESP_LOGI(TAG, "Event: PLAYING");
+            boot_time_mark(BOOT_MILESTONE_FIRST_AUDIO);
             break;
         case AUDIO_PLAYER_CALLBACK_EVENT_PAUSE:
             ESP_LOGI(TAG, "Event: PAUSE");
+            play_history_flush();
             lvgl_port_lock(0);
             mp3_ui_update_play_button(false);
             lvgl_port_unlock();
             break;
         case AUDIO_PLAYER_CALLBACK_EVENT_IDLE:
             ESP_LOGI(TAG, "Event: IDLE (Song Finished)");
-            current_file_index++;
-            if (current_file_index >= file_count) {
-                current_file_index = 0;
+            // 拔卡时主动停止的不算播完
+            if (card_online && !playing_builtin) {
+                player_ctrl_post(PLAYER_CMD_AUTO_NEXT, 0, false);
             }
-            play_music_by_index(current_file_index);
             break;
         default:
             break;
     }
 }
 
+/* =========================== SD 卡插拔 =========================== */
+// 拔卡后可能被调用多次: 插拔任务等各任务结束访问后还会再确认一次，播放没停下时每个周期重试
+static bool sd_hotplug_cb(sd_hotplug_event_t event, void *ctx) {
+    if (event == SD_HOTPLUG_EVENT_REMOVED) {
+        bool first = card_online;
+        card_online = false;
+        media_library_set_online(false);
+
+        if (first) {
+            resume_after_insert = (audio_player_get_state() == AUDIO_PLAYER_STATE_PLAYING);
+
+            // 重新插入的可能是另一张卡，缓存的曲目不再可信；预读中的曲目随即关闭文件
+            track_cache_clear();
+
+            // M3U 只记录了文件偏移，重新插入的可能已不是同一个文件
+            xSemaphoreTake(m3u_lock, portMAX_DELAY);
+            xSemaphoreTake(playlist_lock, portMAX_DELAY);
+            bool was_m3u = m3u_active;
+            if (was_m3u) {
+                m3u_playlist_close(&m3u);
+                set_source_locked(false);
+                current_file_index = 0;
+            }
+            uint32_t total = playlist_count(&playlist);
+            xSemaphoreGive(playlist_lock);
+            xSemaphoreGive(m3u_lock);
+
+            lvgl_port_lock(0);
+            mp3_ui_update_filename("SD card removed");
+            mp3_ui_update_play_button(false);
+            mp3_ui_update_cover(NULL);
+            if (was_m3u) {
+                mp3_ui_update_library_status(total, false);
+            }
+            lvgl_port_unlock();
+        }
+
+        // 音频任务关闭了正在播放和排队的文件、建链接表的任务也关闭了文件，才允许卸载
+        esp_err_t ret = audio_player_stop_and_wait(STOP_WAIT_MS);
+        if (ret == ESP_OK) {
+            ret = audio_player_fatfs_suspend(STOP_WAIT_MS);
+        }
+        if (ret != ESP_OK) {
+            ESP_LOGW(TAG, "Playback still holds the card: %s", esp_err_to_name(ret));
+        }
+        return ret == ESP_OK;
+    } else if (event == SD_HOTPLUG_EVENT_ABSENT) {
+        card_seen = true;
+        lvgl_port_lock(0);
+        mp3_ui_update_filename("No SD card");
+        mp3_ui_update_library_status(0, false);
+        lvgl_port_unlock();
+    } else {
+        // 启动时的挂载不覆盖快照中的曲名
+        bool boot_mount = !card_seen;
+        card_seen = true;
+        card_online = true;
+        media_library_set_online(true);
+        audio_player_fatfs_resume();
+
+        if (!boot_mount) {
+            lvgl_port_lock(0);
+            mp3_ui_update_filename("SD card inserted");
+            lvgl_port_unlock();
+        }
+
+        // 同一张卡只重扫有变化的目录，扫描完 (DONE) 后按需继续播放
+        media_library_rescan();
+    }
+    return true;
+}
+
 /* =========================== 初始化函数 =========================== */
+// 封面任务回调 (在封面任务中执行)
+static void cover_art_ready_cb(const uint16_t *pixels, void *ctx) {
+    lvgl_port_lock(0);
+    mp3_ui_update_cover(pixels);
+    lvgl_port_unlock();
+}
+
+esp_err_t mp3_player_ui_init(void) {
+    playlist_lock = xSemaphoreCreateMutex();
+    m3u_lock = xSemaphoreCreateMutex();
+    if (playlist_lock == NULL || m3u_lock == NULL) {
+        return ESP_ERR_NO_MEM;
+    }
+
+    // 先按上次的状态画出界面，SD 卡挂载和曲库校验随后在后台进行
+    bool have_snapshot = boot_snapshot_load(&snapshot) == ESP_OK;
+    if (have_snapshot) {
+        strlcpy(restore_path, snapshot.path, sizeof(restore_path));
+        ESP_LOGI(TAG, "Boot snapshot: %s, %u tracks", snapshot.title, (unsigned)snapshot.track_count);
+    }
+
+    ESP_LOGI(TAG, "Initializing MP3 Player UI...");
+    lvgl_port_lock(0);
+    mp3_ui_init();
+    mp3_ui_update_filename(have_snapshot && snapshot.title[0] ? snapshot.title : "Scanning...");
+    mp3_ui_update_library_status(have_snapshot ? snapshot.track_count : 0, true);
+    lv_refr_now(NULL);
+    lvgl_port_unlock();
+    boot_time_mark(BOOT_MILESTONE_FIRST_FRAME);
+    return ESP_OK;
+}
+
 esp_err_t mp3_player_init(void) {
+
     ESP_LOGI(TAG, "Initializing Audio Player...");
     audio_player_config_t player_config = {
         .write_fn = i2s_write_fn,
@@ -164,22 +979,48 @@ esp_err_t mp3_player_init(void) {
     ESP_ERROR_CHECK(audio_player_new(player_config));
     ESP_ERROR_CHECK(audio_player_callback_register(audio_player_status_cb, NULL));
 
-    ESP_LOGI(TAG, "Scanning SD card for MP3 files...");
-    scan_mp3_files(BSP_SD_MOUNT_POINT);
+    // 内置音频分区可选，没有时只是不能播放内置音频
+    if (flash_audio_init() != ESP_OK) {
+        ESP_LOGI(TAG, "No built-in audio");
+    }
 
-    ESP_LOGI(TAG, "Initializing MP3 Player UI...");
-    lvgl_port_lock(0);
-    mp3_ui_init();
-    lvgl_port_unlock();
-    
-    lvgl_port_lock(0);
-    if (file_count > 0) {
-        mp3_ui_update_filename(get_music_filename_by_index(0));
-    } else {
-        mp3_ui_update_filename("No MP3 files found!");
+    // 续播位置和随机顺序: 只有记录的曲目就是快照中的曲目时才跳到记录的位置
+    play_history_resume_t resume;
+    if (play_history_init(history_position) == ESP_OK && play_history_get_resume(&resume)) {
+        if (restore_path[0] != '\0' && resume.path_hash == play_history_hash(restore_path)) {
+            restore_position_ms = resume.position_ms;
+        }
+        if (resume.shuffle) {
+            mp3_player_restore_shuffle(resume.shuffle_seed, resume.shuffle_pos);
+        }
+        ESP_LOGI(TAG, "Resume at %u ms, shuffle %s", (unsigned)restore_position_ms, resume.shuffle ? "on" : "off");
     }
-    lvgl_port_unlock();
-    
-    return ESP_OK;
+
+    // 界面的操作都经由控制任务执行，之后曲库事件和自动切歌也投递到这里
+    esp_err_t ret = player_ctrl_init();
+    if (ret != ESP_OK) {
+        return ret;
+    }
+
+    // 整曲缓存需要 PSRAM，没有时每首都从 SD 卡读取
+    if (track_cache_init(TRACK_CACHE_BUDGET) != ESP_OK) {
+        ESP_LOGW(TAG, "Track cache disabled");
+    }
+
+    // 封面解码较慢，放在独立的低优先级任务中，失败时只是不显示封面
+    if (cover_art_init(cover_art_ready_cb, NULL) != ESP_OK) {
+        ESP_LOGW(TAG, "Cover art disabled");
+    }
+
+    // 曲库在后台任务中加载，首批曲目就绪后界面即可操作；
+    // 启动时卡通常已挂载，否则由插拔检测任务挂载，挂载后 (INSERTED) 才开始扫描
+    ESP_LOGI(TAG, "Loading media library...");
+    card_online = bsp_sdcard_is_present();
+    card_seen = card_online;
+    ret = media_library_start(BSP_SD_MOUNT_POINT, library_event_cb, NULL);
+    if (ret != ESP_OK) {
+        return ret;
+    }
+    return sd_hotplug_start(sd_hotplug_cb, NULL);
 }
 
@@ -2,6 +2,9 @@
 #ifndef MP3_TASK_H
 #define MP3_TASK_H
 
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
 #include "esp_err.h"
 
 #ifdef __cplusplus
@@ -9,10 +12,87 @@ extern "C" {
 #endif
 
 /**
- * @brief 初始化MP3播放器后端逻辑和UI界面
+ * @brief 创建界面并按上次保存的快照显示曲名和曲库规模，返回前刷新一帧
+ * @note  在 bsp_lvgl_init() 之后、SD 卡挂载之前调用
+ */
+esp_err_t mp3_player_ui_init(void);
+
+/**
+ * @brief 初始化MP3播放器后端逻辑，并在后台挂载 SD 卡、加载曲库
+ * @note  在 mp3_player_ui_init() 和 bsp_audio_init() 之后调用
  */
 esp_err_t mp3_player_init(void);
 
+/**
+ * @brief 开关随机播放，打开时生成新的随机密钥
+ */
+void mp3_player_set_shuffle(bool enable);
+
+bool mp3_player_get_shuffle(void);
+
+/**
+ * @brief 读取随机播放的密钥和位置，保存后可用 mp3_player_restore_shuffle() 复现播放顺序
+ */
+void mp3_player_get_shuffle_state(uint32_t *seed, uint32_t *pos);
+
+/**
+ * @brief 以保存的密钥和位置打开随机播放
+ */
+void mp3_player_restore_shuffle(uint32_t seed, uint32_t pos);
+
+/**
+ * @brief 当前播放源第 index 条的显示名称，曲库中有标签时为 "艺术家 - 标题"，否则为文件名
+ * @note  只读内存，可以在 LVGL 任务中调用。M3U 条目的名称要从卡上的列表文件中读出，
+ *        第一次取时交给控制任务去读，读好后经 mp3_ui_update_track_name() 通知界面
+ * @return ESP_ERR_NOT_FINISHED 名称还在读取；ESP_ERR_INVALID_ARG / ESP_ERR_NOT_FOUND 序号无效或条目读不出
+ */
+esp_err_t mp3_player_track_name(int index, char *buf, size_t len);
+
+/**
+ * @brief 读出界面要过的 M3U 条目名称，在控制任务中调用
+ */
+void mp3_player_resolve_names(void);
+
+/**
+ * @brief 播放当前播放源的第 index 条，打不开时依次跳过后面的几首
+ * @note  会打开文件，只在控制任务中调用
+ */
+void play_music_by_index(int index);
+
+/**
+ * @brief 按播放顺序前进 (step > 0) 或后退一首
+ * @return 新的曲目序号，播放源为空时返回 -1
+ */
+int advance_music_index(int step);
+
+int get_current_music_index(void);
+
+int get_music_file_count(void);
+
+/**
+ * @brief 播放内置 audio 分区中的条目 (演示曲目、提示音等)，不访问 SD 卡
+ *
+ * 播完后停止，不会接着播放曲库中的下一首。
+ * @param name 打包时的相对路径，如 "demo/intro.mp3"
+ * @return ESP_ERR_NOT_FOUND 没有该条目
+ */
+esp_err_t mp3_player_play_builtin(const char *name);
+
+/**
+ * @brief 改为播放 M3U/M3U8 播放列表并从第一首开始
+ */
+esp_err_t mp3_player_open_m3u(const char *path);
+
+/**
+ * @brief 回到播放整个曲库
+ */
+void mp3_player_use_library(void);
+
+/**
+ * @brief 依次切换到 SD 卡根目录下的下一个播放列表，最后一个之后回到曲库
+ */
+void mp3_player_next_source(void);
+
 #ifdef __cplusplus
 }
 #endif
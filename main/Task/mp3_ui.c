@@ -1,22 +1,218 @@
 // main/task/mp3_ui.c
+#include <string.h>
 #include "mp3_ui.h"
 #include "audio_player.h"
 #include "esp32_s3_hpy.h"  // [新增] 引入BSP头文件以获取默认音量
+#include "mp3_task.h"
+#include "cover_art.h"
+#include "track_list.h"
+#include "player_ctrl.h"
+#include "sdkconfig.h"
 
-// 引入后端逻辑函数
-extern void play_music_by_index(int index);
-extern int get_current_music_index();
-extern int get_music_file_count();
-
-// [新增] 引入BSP的音量设置函数
-extern esp_err_t bsp_audio_set_volume(int volume);
+#define STATE_POLL_MS   50      // 检查控制任务是否发布了新状态的周期
 
 // UI组件句柄
 static lv_obj_t *play_label;
 static lv_obj_t *file_label;
+static lv_obj_t *library_label;
+static lv_obj_t *cover_img;
+static lv_obj_t *shuffle_btn;
+static lv_img_dsc_t cover_dsc;
+static lv_obj_t *browser;          // 曲目浏览页，盖在播放界面上，平时隐藏
+static track_list_t *track_list;
+static lv_obj_t *volume_slider;
+static int current_track = -1;
+static uint32_t source_count;      // 后端最近一次报告的当前播放源曲目数
+static uint32_t applied_seq;       // 已显示到界面上的控制任务状态
+
+
+/* =========================== 频谱柱状图 =========================== */
+#if CONFIG_AUDIO_PLAYER_ENABLE_SPECTRUM
+
+#define SPECTRUM_BAR_COUNT      16
+#define SPECTRUM_HEIGHT         60
+#define SPECTRUM_BAR_GAP        4
+#define SPECTRUM_PERIOD_MS      33
+#define SPECTRUM_DECAY_PX       3   // 无新数据(暂停/WAV)时每帧下落的像素
+
+// 每根柱子覆盖的子带范围 [edge[i], edge[i+1])，低频细分、高频合并
+static const uint8_t s_bar_edges[SPECTRUM_BAR_COUNT + 1] = {
+    0, 1, 2, 3, 4, 5, 6, 7, 8, 10, 12, 14, 16, 19, 22, 26, 32
+};
+
+static lv_obj_t *spectrum_obj;
+static uint8_t s_bar_height[SPECTRUM_BAR_COUNT];
+static uint32_t s_spectrum_seq;
+
+// 计算第 i 根柱子的绝对坐标区域 (高度为 h)
+static void spectrum_bar_area(int i, int h, lv_area_t *area)
+{
+    lv_area_t content;
+    lv_obj_get_content_coords(spectrum_obj, &content);
+    lv_coord_t slot = lv_area_get_width(&content) / SPECTRUM_BAR_COUNT;
+
+    area->x1 = content.x1 + i * slot;
+    area->x2 = area->x1 + slot - SPECTRUM_BAR_GAP - 1;
+    area->y2 = content.y2;
+    area->y1 = content.y2 - h + 1;
+}
+
+// 能量 -> 柱高：按 log2 映射，便于同时看清强弱频段
+static uint8_t spectrum_energy_to_height(uint32_t energy)
+{
+    if (energy < 64) return 0;
+    int log2_q2 = (31 - __builtin_clz(energy)) * 4 + ((energy >> (29 - __builtin_clz(energy))) & 0x3);
+    int h = (log2_q2 - 6 * 4) * SPECTRUM_HEIGHT / (16 * 4);
+    if (h < 0) h = 0;
+    if (h > SPECTRUM_HEIGHT) h = SPECTRUM_HEIGHT;
+    return (uint8_t)h;
+}
+
+static void spectrum_draw_event_cb(lv_event_t *e)
+{
+    lv_draw_ctx_t *draw_ctx = lv_event_get_draw_ctx(e);
+
+    lv_draw_rect_dsc_t dsc;
+    lv_draw_rect_dsc_init(&dsc);
+    dsc.bg_color = lv_palette_main(LV_PALETTE_BLUE);
+    dsc.radius = 2;
+
+    for (int i = 0; i < SPECTRUM_BAR_COUNT; i++) {
+        if (s_bar_height[i] == 0) continue;
+        lv_area_t bar;
+        spectrum_bar_area(i, s_bar_height[i], &bar);
+        lv_draw_rect(draw_ctx, &dsc, &bar);
+    }
+}
+
+// LVGL 定时器回调，已在 LVGL 任务中持锁运行
+static void spectrum_timer_cb(lv_timer_t *timer)
+{
+    uint32_t bands[AUDIO_PLAYER_SPECTRUM_BANDS];
+    uint32_t seq = 0;
+    bool fresh = (audio_player_get_state() == AUDIO_PLAYER_STATE_PLAYING) &&
+                 (audio_player_get_spectrum(bands, &seq) == ESP_OK) &&
+                 (seq != s_spectrum_seq);
+    if (fresh) s_spectrum_seq = seq;
+
+    for (int i = 0; i < SPECTRUM_BAR_COUNT; i++) {
+        uint8_t h;
+        if (fresh) {
+            uint32_t sum = 0;
+            for (int b = s_bar_edges[i]; b < s_bar_edges[i + 1]; b++) {
+                sum += bands[b];
+            }
+            h = spectrum_energy_to_height(sum / (s_bar_edges[i + 1] - s_bar_edges[i]));
+        } else {
+            h = s_bar_height[i] > SPECTRUM_DECAY_PX ? s_bar_height[i] - SPECTRUM_DECAY_PX : 0;
+        }
+
+        // 只重绘高度变化的柱子，且只重绘新旧高度中较高的那一段
+        if (h != s_bar_height[i]) {
+            lv_area_t dirty;
+            spectrum_bar_area(i, h > s_bar_height[i] ? h : s_bar_height[i], &dirty);
+            s_bar_height[i] = h;
+            lv_obj_invalidate_area(spectrum_obj, &dirty);
+        }
+    }
+}
+
+static void spectrum_create(lv_obj_t *parent)
+{
+    spectrum_obj = lv_obj_create(parent);
+    lv_obj_remove_style_all(spectrum_obj);
+    lv_obj_set_size(spectrum_obj, lv_pct(80), SPECTRUM_HEIGHT);
+    lv_obj_align(spectrum_obj, LV_ALIGN_TOP_MID, 0, 70);
+    lv_obj_clear_flag(spectrum_obj, LV_OBJ_FLAG_SCROLLABLE | LV_OBJ_FLAG_CLICKABLE);
+    lv_obj_add_event_cb(spectrum_obj, spectrum_draw_event_cb, LV_EVENT_DRAW_MAIN, NULL);
+
+    lv_timer_create(spectrum_timer_cb, SPECTRUM_PERIOD_MS, NULL);
+}
+
+#endif // CONFIG_AUDIO_PLAYER_ENABLE_SPECTRUM
+
+
+/* =========================== 曲目浏览 =========================== */
+
+#define BROWSER_HEADER_HEIGHT   44
+#define BROWSER_PENDING_TEXT    "..."   // M3U 条目的名称还在从卡上读取
+
+// 只读内存中的名称，读不到的由控制任务去读，读好后经 mp3_ui_update_track_name() 刷新该行
+static void browser_text_cb(uint32_t index, char *buf, size_t len, void *ctx)
+{
+    esp_err_t ret = mp3_player_track_name((int)index, buf, len);
+    if (ret == ESP_ERR_NOT_FINISHED) {
+        strlcpy(buf, BROWSER_PENDING_TEXT, len);
+    } else if (ret != ESP_OK) {
+        buf[0] = '\0';
+    }
+}
+
+static void browser_select_cb(uint32_t index, void *ctx)
+{
+    lv_obj_add_flag(browser, LV_OBJ_FLAG_HIDDEN);
+    player_ctrl_post(PLAYER_CMD_PLAY_INDEX, (int32_t)index, true);
+}
+
+// 浏览页打开时跟上播放源的变化，reload 为 true 时序号的含义可能已变，重新取文字
+static void browser_sync(bool reload)
+{
+    if (track_list == NULL || lv_obj_has_flag(browser, LV_OBJ_FLAG_HIDDEN)) {
+        return;
+    }
+    track_list_set_count(track_list, source_count);
+    if (reload) {
+        track_list_reload(track_list);
+    }
+}
+
+static void browser_back_event_handler(lv_event_t *e)
+{
+    lv_obj_add_flag(browser, LV_OBJ_FLAG_HIDDEN);
+}
+
+static void browser_open(void)
+{
+    if (track_list == NULL) {
+        return;
+    }
+    lv_obj_clear_flag(browser, LV_OBJ_FLAG_HIDDEN);
+    browser_sync(true);
+    track_list_set_current(track_list, current_track);
+    if (current_track >= 0) {
+        track_list_show_index(track_list, (uint32_t)current_track);
+    }
+}
 
-// [新增] 全局变量，用于保存当前音量值
-static uint8_t g_current_volume = BSP_AUDIO_DEFAULT_VOLUME;
+static void browser_create(lv_obj_t *scr)
+{
+    browser = lv_obj_create(scr);
+    lv_obj_remove_style_all(browser);
+    lv_obj_set_size(browser, BSP_LCD_H_RES, BSP_LCD_V_RES);
+    lv_obj_set_style_bg_color(browser, lv_color_white(), 0);
+    lv_obj_set_style_bg_opa(browser, LV_OPA_COVER, 0);
+    lv_obj_clear_flag(browser, LV_OBJ_FLAG_SCROLLABLE);
+    lv_obj_add_flag(browser, LV_OBJ_FLAG_HIDDEN);
+
+    lv_obj_t *back_btn = lv_btn_create(browser);
+    lv_obj_set_size(back_btn, 60, BROWSER_HEADER_HEIGHT - 8);
+    lv_obj_align(back_btn, LV_ALIGN_TOP_LEFT, 4, 4);
+    lv_obj_add_event_cb(back_btn, browser_back_event_handler, LV_EVENT_CLICKED, NULL);
+    lv_obj_t *back_label = lv_label_create(back_btn);
+    lv_label_set_text(back_label, LV_SYMBOL_LEFT);
+    lv_obj_center(back_label);
+
+    lv_obj_t *title = lv_label_create(browser);
+    lv_label_set_text(title, "Tracks");
+    lv_obj_align(title, LV_ALIGN_TOP_MID, 0, 14);
+
+    // 一首一个 lv_obj 在 32 KB 的 LVGL 内存里放不下，只为可见的行创建对象
+    track_list = track_list_create(browser, BSP_LCD_H_RES, BSP_LCD_V_RES - BROWSER_HEADER_HEIGHT,
+                                   browser_text_cb, browser_select_cb, NULL);
+    if (track_list) {
+        lv_obj_align(track_list_get_obj(track_list), LV_ALIGN_TOP_LEFT, 0, BROWSER_HEADER_HEIGHT);
+    }
+}
 
 
 /* =========================== 事件回调函数 =========================== */
@@ -25,14 +221,8 @@ static uint8_t g_current_volume = BSP_AUDIO_DEFAULT_VOLUME;
 static void volume_slider_event_handler(lv_event_t *e)
 {
     lv_obj_t *slider = lv_event_get_target(e);
-    // 从滑条获取0-100的百分比值
-    int volume_percent = lv_slider_get_value(slider);
-    
-    // 更新全局音量变量
-    g_current_volume = (uint8_t)volume_percent;
-    
-    // 调用BSP函数，实际设置硬件音量
-    bsp_audio_set_volume(g_current_volume);
+    // 从滑条获取0-100的百分比值，拖动时连续的命令在控制任务中合并
+    player_ctrl_post(PLAYER_CMD_VOLUME, lv_slider_get_value(slider), true);
 }
 
 
@@ -42,32 +232,34 @@ static void button_event_handler(lv_event_t *e)
     if (lv_event_get_code(e) != LV_EVENT_CLICKED) return;
 
     uintptr_t btn_id = (uintptr_t)lv_event_get_user_data(e);
-    int current_index = get_current_music_index();
-    int total_files = get_music_file_count();
 
-    if (total_files == 0) return;
+    if (btn_id == 3) { // 随机播放 (可选中按钮，CLICKED 时状态已切换)
+        player_ctrl_post(PLAYER_CMD_SHUFFLE, lv_obj_has_state(lv_event_get_target(e), LV_STATE_CHECKED), true);
+        return;
+    }
+    if (btn_id == 4) { // 曲目列表
+        browser_open();
+        return;
+    }
+    if (source_count == 0) return;
 
+    // 切歌要打开文件，放在控制任务中执行，界面只投递命令
     if (btn_id == 0) { // 上一首
-        current_index--;
-        if (current_index < 0) current_index = total_files - 1;
-        play_music_by_index(current_index);
+        player_ctrl_post(PLAYER_CMD_PREV, 0, true);
     } else if (btn_id == 1) { // 播放/暂停
-        audio_player_state_t state = audio_player_get_state();
-        if (state == AUDIO_PLAYER_STATE_PLAYING) {
-            audio_player_pause();
-        } else if (state == AUDIO_PLAYER_STATE_PAUSE) {
-            audio_player_resume();
-        } else {
-            play_music_by_index(current_index);
-        }
+        player_ctrl_post(PLAYER_CMD_TOGGLE, 0, true);
     } else if (btn_id == 2) { // 下一首
-        current_index++;
-        if (current_index >= total_files) current_index = 0;
-        play_music_by_index(current_index);
+        player_ctrl_post(PLAYER_CMD_NEXT, 0, true);
     }
 }
 
 
+static void source_label_event_handler(lv_event_t *e)
+{
+    player_ctrl_post(PLAYER_CMD_NEXT_SOURCE, 0, true);
+}
+
+
 /* =========================== UI 更新函数 =========================== */
 
 void mp3_ui_update_play_button(bool is_playing)
@@ -77,6 +269,31 @@ void mp3_ui_update_play_button(bool is_playing)
     }
 }
 
+// 控制任务每执行完一条命令发布一次状态，这里把新状态显示到界面上
+static void state_timer_cb(lv_timer_t *timer)
+{
+    player_ctrl_state_t st;
+    player_ctrl_get_state(&st);
+    if (st.seq == applied_seq) {
+        return;
+    }
+    applied_seq = st.seq;
+
+    if (st.shuffle) {
+        lv_obj_add_state(shuffle_btn, LV_STATE_CHECKED);
+    } else {
+        lv_obj_clear_state(shuffle_btn, LV_STATE_CHECKED);
+    }
+    current_track = st.index;
+    if (track_list) {
+        track_list_set_current(track_list, st.index);
+    }
+    // 正在拖动时以手指的位置为准
+    if (!lv_obj_has_state(volume_slider, LV_STATE_PRESSED)) {
+        lv_slider_set_value(volume_slider, st.volume, LV_ANIM_OFF);
+    }
+}
+
 void mp3_ui_update_filename(const char *filename)
 {
     if (file_label && filename) {
@@ -84,6 +301,49 @@ void mp3_ui_update_filename(const char *filename)
     }
 }
 
+void mp3_ui_update_library_status(uint32_t count, bool scanning)
+{
+    source_count = count;
+    if (library_label) {
+        lv_label_set_text_fmt(library_label, scanning ? "Scanning... %u tracks" : "%u tracks",
+                              (unsigned)count);
+    }
+    // 扫描中只是追加，扫描完成时元数据和序号都可能变了
+    browser_sync(!scanning);
+}
+
+void mp3_ui_update_source_status(const char *name, uint32_t count)
+{
+    source_count = count;
+    if (library_label && name) {
+        lv_label_set_text_fmt(library_label, "%s: %u tracks", name, (unsigned)count);
+    }
+    browser_sync(true);
+}
+
+void mp3_ui_update_track_name(uint32_t index)
+{
+    if (track_list && !lv_obj_has_flag(browser, LV_OBJ_FLAG_HIDDEN)) {
+        track_list_refresh_index(track_list, index);
+    }
+}
+
+void mp3_ui_update_cover(const uint16_t *pixels)
+{
+    if (cover_img == NULL) {
+        return;
+    }
+    if (pixels == NULL) {
+        lv_obj_add_flag(cover_img, LV_OBJ_FLAG_HIDDEN);
+        return;
+    }
+    // 描述符地址不变，换了像素数据后需要让图片缓存失效
+    cover_dsc.data = (const uint8_t *)pixels;
+    lv_img_cache_invalidate_src(&cover_dsc);
+    lv_img_set_src(cover_img, &cover_dsc);
+    lv_obj_clear_flag(cover_img, LV_OBJ_FLAG_HIDDEN);
+}
+
 
 /* =========================== UI 界面初始化 (已修改) =========================== */
 void mp3_ui_init(void)
@@ -98,10 +358,33 @@ void mp3_ui_init(void)
     lv_label_set_text(file_label, "Starting...");
     lv_obj_set_style_text_align(file_label, LV_TEXT_ALIGN_CENTER, 0);
 
-    /* 2. 创建播放控制按钮容器 (中部) */
+    /* 1.2 [新增] 曲库状态标签 (文件名上方)，后台扫描时显示进度 */
+    library_label = lv_label_create(scr);
+    lv_obj_align(library_label, LV_ALIGN_TOP_MID, 0, 12);
+    lv_label_set_text(library_label, "");
+    // 点击切换播放源: 曲库 -> 根目录下的各个播放列表 -> 曲库
+    lv_obj_add_flag(library_label, LV_OBJ_FLAG_CLICKABLE);
+    lv_obj_add_event_cb(library_label, source_label_event_handler, LV_EVENT_CLICKED, NULL);
+
+#if CONFIG_AUDIO_PLAYER_ENABLE_SPECTRUM
+    /* 1.5 [新增] 频谱柱状图 (文件名下方) */
+    spectrum_create(scr);
+#endif
+
+    /* 1.6 [新增] 专辑封面 (左侧)，像素由封面任务提供，没有封面时隐藏 */
+    cover_dsc.header.cf = LV_IMG_CF_TRUE_COLOR;
+    cover_dsc.header.w = COVER_ART_SIZE;
+    cover_dsc.header.h = COVER_ART_SIZE;
+    cover_dsc.data_size = COVER_ART_SIZE * COVER_ART_SIZE * LV_COLOR_SIZE / 8;
+    cover_img = lv_img_create(scr);
+    lv_obj_set_size(cover_img, COVER_ART_SIZE, COVER_ART_SIZE);
+    lv_obj_align(cover_img, LV_ALIGN_LEFT_MID, 12, 20);
+    lv_obj_add_flag(cover_img, LV_OBJ_FLAG_HIDDEN);
+
+    /* 2. 创建播放控制按钮容器 (中部，给左侧封面让出位置) */
     lv_obj_t *cont = lv_obj_create(scr);
-    lv_obj_set_size(cont, lv_pct(100), 80);
-    lv_obj_align(cont, LV_ALIGN_CENTER, 0, 20); // [修改] 垂直居中，并稍微向下偏移
+    lv_obj_set_size(cont, lv_pct(75), 80);
+    lv_obj_align(cont, LV_ALIGN_CENTER, 60, 20); // [修改] 垂直居中，并稍微向下偏移
     lv_obj_set_flex_flow(cont, LV_FLEX_FLOW_ROW);
     lv_obj_set_flex_align(cont, LV_FLEX_ALIGN_SPACE_EVENLY, LV_FLEX_ALIGN_CENTER, LV_FLEX_ALIGN_CENTER);
     lv_obj_clear_flag(cont, LV_OBJ_FLAG_SCROLLABLE);
@@ -128,13 +411,28 @@ void mp3_ui_init(void)
     lv_obj_t *next_label = lv_label_create(next_btn);
     lv_label_set_text(next_label, LV_SYMBOL_NEXT);
     lv_obj_center(next_label);
+
+    // [新增] 随机播放按钮
+    shuffle_btn = lv_btn_create(cont);
+    lv_obj_add_flag(shuffle_btn, LV_OBJ_FLAG_CHECKABLE);
+    lv_obj_add_event_cb(shuffle_btn, button_event_handler, LV_EVENT_CLICKED, (void *)3);
+    lv_obj_t *shuffle_label = lv_label_create(shuffle_btn);
+    lv_label_set_text(shuffle_label, LV_SYMBOL_SHUFFLE);
+    lv_obj_center(shuffle_label);
+
+    // 曲目列表按钮
+    lv_obj_t *list_btn = lv_btn_create(cont);
+    lv_obj_add_event_cb(list_btn, button_event_handler, LV_EVENT_CLICKED, (void *)4);
+    lv_obj_t *list_label = lv_label_create(list_btn);
+    lv_label_set_text(list_label, LV_SYMBOL_LIST);
+    lv_obj_center(list_label);
     
     /* 3. [新增] 创建音量调节滑条 (底部) */
-    lv_obj_t *volume_slider = lv_slider_create(scr);
+    volume_slider = lv_slider_create(scr);
     lv_obj_set_width(volume_slider, lv_pct(60)); // 宽度为屏幕的60%
     lv_obj_align(volume_slider, LV_ALIGN_BOTTOM_MID, 0, -40); // 对齐到底部中央，向上偏移40
     lv_slider_set_range(volume_slider, 0, 100); // 设置范围为 0 - 100
-    lv_slider_set_value(volume_slider, g_current_volume, LV_ANIM_OFF); // 设置初始值为默认音量
+    lv_slider_set_value(volume_slider, BSP_AUDIO_DEFAULT_VOLUME, LV_ANIM_OFF); // 设置初始值为默认音量
     lv_obj_add_event_cb(volume_slider, volume_slider_event_handler, LV_EVENT_VALUE_CHANGED, NULL);
 
     // 在滑条左侧添加音量小图标
@@ -146,5 +444,11 @@ void mp3_ui_init(void)
     lv_obj_t *label_vol_max = lv_label_create(scr);
     lv_label_set_text(label_vol_max, LV_SYMBOL_VOLUME_MAX);
     lv_obj_align_to(label_vol_max, volume_slider, LV_ALIGN_OUT_RIGHT_MID, 10, 0);
+
+    /* 4. 曲目浏览页，最后创建以盖住上面的控件 */
+    browser_create(scr);
+
+    // 随机播放、当前曲目和音量以控制任务发布的状态为准
+    lv_timer_create(state_timer_cb, STATE_POLL_MS, NULL);
 }
 
@@ -4,6 +4,7 @@
 
 #include "lvgl.h"
 #include <stdbool.h>
+#include <stdint.h>
 
 #ifdef __cplusplus
 extern "C" {
@@ -28,6 +29,31 @@ void mp3_ui_update_play_button(bool is_playing);
  */
 void mp3_ui_update_filename(const char *filename);
 
+/**
+ * @brief 更新曲库状态 (曲目数、是否仍在扫描)
+ * @note 此函数不是线程安全的，调用前必须使用 lvgl_port_lock()
+ */
+void mp3_ui_update_library_status(uint32_t count, bool scanning);
+
+/**
+ * @brief 显示正在播放的播放列表名称和条目数
+ * @note 此函数不是线程安全的，调用前必须使用 lvgl_port_lock()
+ */
+void mp3_ui_update_source_status(const char *name, uint32_t count);
+
+/**
+ * @brief 控制任务读出了第 index 条的名称，浏览页正显示这一条时刷新
+ * @note 此函数不是线程安全的，调用前必须使用 lvgl_port_lock()
+ */
+void mp3_ui_update_track_name(uint32_t index);
+
+/**
+ * @brief 显示专辑封面
+ * @note 此函数不是线程安全的，调用前必须使用 lvgl_port_lock()
+ * @param pixels COVER_ART_SIZE 见方的 RGB565 像素，需保持有效直到下次调用；NULL 隐藏封面
+ */
+void mp3_ui_update_cover(const uint16_t *pixels);
+
 
 #ifdef __cplusplus
 }
@@ -0,0 +1,361 @@
+// main/task/play_history.c
+#include <stddef.h>
+#include <string.h>
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "freertos/semphr.h"
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "esp_system.h"
+#include "esp_rom_crc.h"
+#include "nvs.h"
+
+#include "play_history.h"
+#include "boot_snapshot.h"
+
+static const char *TAG = "PLAY_HISTORY";
+
+#define HISTORY_TASK_STACK      3072
+#define HISTORY_TASK_PRIORITY   1
+
+#define RESUME_KEY              "resume"
+#define COUNTS_KEY              "counts"
+#define PLAYS_KEY               "plays"
+#define PLAY_LOG_MAX            16      // 追加记录满了才重写整张播放次数表
+#define RESUME_VERSION          1
+#define RESUME_F_SHUFFLE        0x100
+
+#define FNV_OFFSET_BASIS        2166136261u
+#define FNV_PRIME               16777619u
+
+/*
+ * 续播记录 24 字节，播放中每 PLAY_HISTORY_FLUSH_MS 最多写一次。
+ * NVS 本身按追加方式写入并在新条目写完后才作废旧条目，断电时旧记录仍在；
+ * 这里的 CRC 用来拒绝格式不同或内容损坏的记录。
+ */
+typedef struct {
+    uint32_t version_flags;     // 低 8 位版本号，RESUME_F_*
+    uint32_t path_hash;
+    uint32_t position_ms;
+    uint32_t shuffle_seed;
+    uint32_t shuffle_pos;
+    uint32_t crc;               // 前面各字段的 CRC32
+} resume_record_t;
+
+/*
+ * 播放次数: uint32_t seq，count_entry_t entries[n]，最后一个 uint32_t CRC32，最大约 2 KB。
+ * 每次开始播放只在小的追加记录 play_log_t 中加一个哈希，随续播记录一起写入；
+ * 追加记录满了才把整张表以 seq + 1 重写一次并清空追加记录。
+ * 启动时只应用 base_seq 与表的 seq 相同的追加记录，重写表后断电留下的旧追加记录被忽略。
+ */
+typedef struct {
+    uint32_t path_hash;
+    uint32_t count;
+} count_entry_t;
+
+typedef struct {
+    uint32_t base_seq;
+    uint32_t n;
+    uint32_t hashes[PLAY_LOG_MAX];
+    uint32_t crc;               // 前面各字段的 CRC32
+} play_log_t;
+
+static SemaphoreHandle_t s_lock;
+static play_history_position_fn_t s_position_fn;
+static resume_record_t s_resume;        // 内存中的最新状态
+static resume_record_t s_saved;         // 上次写入 flash 的内容
+static bool s_have_saved;               // 启动时读到了有效记录
+static count_entry_t s_counts[PLAY_HISTORY_MAX_COUNTS];   // 已应用追加记录的播放次数
+static uint32_t s_count_n;
+static uint32_t s_count_seq;            // flash 中播放次数表的 seq
+static play_log_t s_log;                // 表之后的播放
+static bool s_log_dirty;
+static int64_t s_last_flush_us;
+static uint8_t s_io[sizeof(uint32_t) + sizeof(s_counts) + sizeof(uint32_t)];  // 读写 NVS 时的 seq + 条目 + CRC
+
+static void count_play_locked(uint32_t hash);
+
+uint32_t play_history_hash(const char *path)
+{
+    uint32_t h = FNV_OFFSET_BASIS;
+    for (const char *p = path; *p; p++) {
+        h = (h ^ (uint8_t)*p) * FNV_PRIME;
+    }
+    return h;
+}
+
+static uint32_t resume_crc(const resume_record_t *r)
+{
+    return esp_rom_crc32_le(0, (const uint8_t *)r, offsetof(resume_record_t, crc));
+}
+
+static uint32_t log_crc(const play_log_t *l)
+{
+    return esp_rom_crc32_le(0, (const uint8_t *)l, offsetof(play_log_t, crc));
+}
+
+static void load(void)
+{
+    nvs_handle_t h;
+    if (nvs_open(PLAY_HISTORY_NAMESPACE, NVS_READONLY, &h) != ESP_OK) {
+        return;
+    }
+
+    resume_record_t r;
+    size_t len = sizeof(r);
+    if (nvs_get_blob(h, RESUME_KEY, &r, &len) == ESP_OK && len == sizeof(r) &&
+        (r.version_flags & 0xff) == RESUME_VERSION && r.crc == resume_crc(&r)) {
+        s_resume = r;
+        s_saved = r;
+        s_have_saved = true;
+    }
+
+    len = sizeof(s_io);
+    if (nvs_get_blob(h, COUNTS_KEY, s_io, &len) == ESP_OK && len >= 2 * sizeof(uint32_t) &&
+        (len - 2 * sizeof(uint32_t)) % sizeof(count_entry_t) == 0) {
+        size_t bytes = len - sizeof(uint32_t);
+        uint32_t crc;
+        memcpy(&crc, s_io + bytes, sizeof(crc));
+        if (esp_rom_crc32_le(0, s_io, bytes) == crc) {
+            memcpy(&s_count_seq, s_io, sizeof(s_count_seq));
+            s_count_n = (bytes - sizeof(uint32_t)) / sizeof(count_entry_t);
+            memcpy(s_counts, s_io + sizeof(uint32_t), s_count_n * sizeof(count_entry_t));
+        }
+    }
+
+    // 按原顺序重放，淘汰结果与写入前内存中的相同
+    play_log_t l;
+    len = sizeof(l);
+    uint32_t replay = 0;
+    if (nvs_get_blob(h, PLAYS_KEY, &l, &len) == ESP_OK && len == sizeof(l) && l.crc == log_crc(&l) &&
+        l.base_seq == s_count_seq && l.n <= PLAY_LOG_MAX) {
+        replay = l.n;
+    }
+    s_log.base_seq = s_count_seq;
+    for (uint32_t i = 0; i < replay; i++) {
+        count_play_locked(l.hashes[i]);
+    }
+    s_log_dirty = false;
+    nvs_close(h);
+}
+
+// 重写整张播放次数表并清空追加记录，调用者需持有 s_lock
+static esp_err_t write_counts_locked(nvs_handle_t h)
+{
+    uint32_t seq = s_count_seq + 1;
+    size_t bytes = sizeof(seq) + s_count_n * sizeof(count_entry_t);
+    memcpy(s_io, &seq, sizeof(seq));
+    memcpy(s_io + sizeof(seq), s_counts, s_count_n * sizeof(count_entry_t));
+    uint32_t crc = esp_rom_crc32_le(0, s_io, bytes);
+    memcpy(s_io + bytes, &crc, sizeof(crc));
+    esp_err_t ret = nvs_set_blob(h, COUNTS_KEY, s_io, bytes + sizeof(crc));
+    if (ret == ESP_OK) {
+        s_count_seq = seq;
+        s_log.base_seq = seq;
+        s_log.n = 0;
+    }
+    return ret;
+}
+
+// 调用者需持有 s_lock
+static void write_locked(bool resume, bool counts)
+{
+    nvs_handle_t h;
+    esp_err_t ret = nvs_open(PLAY_HISTORY_NAMESPACE, NVS_READWRITE, &h);
+    if (ret != ESP_OK) {
+        ESP_LOGW(TAG, "打开 NVS 失败: %s", esp_err_to_name(ret));
+        return;
+    }
+    if (resume) {
+        s_resume.crc = resume_crc(&s_resume);
+        ret = nvs_set_blob(h, RESUME_KEY, &s_resume, sizeof(s_resume));
+        if (ret == ESP_OK) {
+            s_saved = s_resume;
+        }
+    }
+    if (counts && ret == ESP_OK) {
+        if (s_log.n == PLAY_LOG_MAX) {
+            ret = write_counts_locked(h);
+        }
+        if (ret == ESP_OK) {
+            s_log.crc = log_crc(&s_log);
+            ret = nvs_set_blob(h, PLAYS_KEY, &s_log, sizeof(s_log));
+        }
+        if (ret == ESP_OK) {
+            s_log_dirty = false;
+        }
+    }
+    if (ret == ESP_OK) {
+        ret = nvs_commit(h);
+    }
+    nvs_close(h);
+    s_last_flush_us = esp_timer_get_time();
+    if (ret != ESP_OK) {
+        ESP_LOGW(TAG, "保存播放记录失败: %s", esp_err_to_name(ret));
+    }
+}
+
+// 采样播放位置，有变化且 (force 或距上次写入已满间隔) 时写入，调用者需持有 s_lock
+static void flush_locked(bool force)
+{
+    uint32_t pos;
+    if (s_position_fn && s_position_fn(&pos)) {
+        s_resume.position_ms = pos;
+    }
+    bool resume = memcmp(&s_resume, &s_saved, offsetof(resume_record_t, crc)) != 0;
+    bool snapshot = boot_snapshot_dirty();
+    if (!resume && !s_log_dirty && !snapshot) {
+        return;
+    }
+    if (!force && esp_timer_get_time() - s_last_flush_us < PLAY_HISTORY_FLUSH_MS * 1000LL) {
+        return;
+    }
+    // 界面快照与续播记录同一时刻写入，连续切歌时两者都只写最后一首
+    if (resume || s_log_dirty) {
+        write_locked(resume, s_log_dirty);
+    } else {
+        s_last_flush_us = esp_timer_get_time();
+    }
+    if (snapshot) {
+        boot_snapshot_flush();
+    }
+}
+
+static void history_task(void *arg)
+{
+    for (;;) {
+        vTaskDelay(pdMS_TO_TICKS(PLAY_HISTORY_FLUSH_MS));
+        xSemaphoreTake(s_lock, portMAX_DELAY);
+        flush_locked(false);
+        xSemaphoreGive(s_lock);
+    }
+}
+
+esp_err_t play_history_init(play_history_position_fn_t position_fn)
+{
+    s_position_fn = position_fn;
+    s_lock = xSemaphoreCreateMutex();
+    if (s_lock == NULL) {
+        return ESP_ERR_NO_MEM;
+    }
+
+    load();
+    if (!s_have_saved) {
+        // 没有记录时不为空状态写一次 flash
+        s_resume.version_flags = RESUME_VERSION;
+        s_saved = s_resume;
+    }
+    ESP_LOGI(TAG, "续播记录%s, %u 首曲目的播放次数", s_have_saved ? "有效" : "无",
+             (unsigned)s_count_n);
+
+    if (xTaskCreate(history_task, "play_history", HISTORY_TASK_STACK, NULL, HISTORY_TASK_PRIORITY, NULL) != pdPASS) {
+        ESP_LOGE(TAG, "创建播放记录任务失败");
+        return ESP_FAIL;
+    }
+    // 重启前写入最后的位置；掉电来不及写，最多丢失一个写入间隔
+    esp_register_shutdown_handler(play_history_flush);
+    return ESP_OK;
+}
+
+bool play_history_get_resume(play_history_resume_t *resume)
+{
+    if (s_lock == NULL || !s_have_saved) {
+        return false;
+    }
+    xSemaphoreTake(s_lock, portMAX_DELAY);
+    resume->path_hash = s_saved.path_hash;
+    resume->position_ms = s_saved.position_ms;
+    resume->shuffle = (s_saved.version_flags & RESUME_F_SHUFFLE) != 0;
+    resume->shuffle_seed = s_saved.shuffle_seed;
+    resume->shuffle_pos = s_saved.shuffle_pos;
+    xSemaphoreGive(s_lock);
+    return true;
+}
+
+// 调用者需持有 s_lock
+static void count_play_locked(uint32_t hash)
+{
+    count_entry_t *slot = NULL;
+    for (uint32_t i = 0; i < s_count_n; i++) {
+        if (s_counts[i].path_hash == hash) {
+            slot = &s_counts[i];
+            break;
+        }
+    }
+    if (slot == NULL) {
+        if (s_count_n < PLAY_HISTORY_MAX_COUNTS) {
+            slot = &s_counts[s_count_n++];
+        } else {
+            slot = &s_counts[0];
+            for (uint32_t i = 1; i < s_count_n; i++) {
+                if (s_counts[i].count < slot->count) {
+                    slot = &s_counts[i];
+                }
+            }
+        }
+        slot->path_hash = hash;
+        slot->count = 0;
+    }
+    slot->count++;
+    // 追加记录满了且重写表失败时不再追加，内存中的次数仍然正确，下次写入时重写整张表
+    if (s_log.n < PLAY_LOG_MAX) {
+        s_log.hashes[s_log.n++] = hash;
+    }
+    s_log_dirty = true;
+}
+
+void play_history_track_started(const char *path)
+{
+    if (s_lock == NULL) {
+        return;
+    }
+    uint32_t hash = play_history_hash(path);
+
+    xSemaphoreTake(s_lock, portMAX_DELAY);
+    s_resume.path_hash = hash;
+    s_resume.position_ms = 0;
+    count_play_locked(hash);
+    xSemaphoreGive(s_lock);
+}
+
+void play_history_set_shuffle(bool enabled, uint32_t seed, uint32_t pos)
+{
+    if (s_lock == NULL) {
+        return;
+    }
+    xSemaphoreTake(s_lock, portMAX_DELAY);
+    s_resume.version_flags = enabled ? (s_resume.version_flags | RESUME_F_SHUFFLE)
+                                     : (s_resume.version_flags & ~RESUME_F_SHUFFLE);
+    s_resume.shuffle_seed = seed;
+    s_resume.shuffle_pos = pos;
+    xSemaphoreGive(s_lock);
+}
+
+void play_history_flush(void)
+{
+    if (s_lock == NULL) {
+        return;
+    }
+    xSemaphoreTake(s_lock, portMAX_DELAY);
+    flush_locked(true);
+    xSemaphoreGive(s_lock);
+}
+
+uint32_t play_history_play_count(const char *path)
+{
+    if (s_lock == NULL) {
+        return 0;
+    }
+    uint32_t hash = play_history_hash(path);
+    uint32_t count = 0;
+
+    xSemaphoreTake(s_lock, portMAX_DELAY);
+    for (uint32_t i = 0; i < s_count_n; i++) {
+        if (s_counts[i].path_hash == hash) {
+            count = s_counts[i].count;
+            break;
+        }
+    }
+    xSemaphoreGive(s_lock);
+    return count;
+}
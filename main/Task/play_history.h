@@ -0,0 +1,70 @@
+// main/task/play_history.h
+#ifndef PLAY_HISTORY_H
+#define PLAY_HISTORY_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "esp_err.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define PLAY_HISTORY_NAMESPACE  "history"   // NVS 命名空间
+#define PLAY_HISTORY_FLUSH_MS   5000        // 播放中两次写 flash 的最小间隔，断电后续播最多差这么多
+#define PLAY_HISTORY_MAX_COUNTS 256         // 记录播放次数的曲目数上限，满了替换次数最少的
+
+typedef struct {
+    uint32_t path_hash;     // 曲目路径的哈希，见 play_history_hash()
+    uint32_t position_ms;
+    bool shuffle;
+    uint32_t shuffle_seed;
+    uint32_t shuffle_pos;
+} play_history_resume_t;
+
+/**
+ * @brief 取当前播放位置，返回 false 表示没有在播放可记录的曲目 (如内置音频)
+ * @note  在历史记录任务中调用
+ */
+typedef bool (*play_history_position_fn_t)(uint32_t *position_ms);
+
+/**
+ * @brief 读取上次的续播记录和播放次数，创建后台写入任务
+ *
+ * 变化先记在内存中，由后台任务每 PLAY_HISTORY_FLUSH_MS 检查一次，有变化才写入 NVS，
+ * boot_snapshot 的变化也在同一次写入。播放次数平时只追加一条曲目哈希，
+ * 每若干首才重写整张表。重启 (esp_restart) 前会再写一次。
+ *
+ * @note  需要先初始化 NVS (nvs_flash_init)
+ * @param position_fn 后台任务用它采样播放位置
+ */
+esp_err_t play_history_init(play_history_position_fn_t position_fn);
+
+/**
+ * @brief 取上次保存的续播记录
+ * @return false 没有记录或记录损坏
+ */
+bool play_history_get_resume(play_history_resume_t *resume);
+
+uint32_t play_history_hash(const char *path);
+
+/**
+ * @brief 开始播放一首曲目：位置归零，播放次数加一
+ */
+void play_history_track_started(const char *path);
+
+void play_history_set_shuffle(bool enabled, uint32_t seed, uint32_t pos);
+
+/**
+ * @brief 采样当前位置并立即写入，不受写入间隔限制
+ * @note  在暂停、关机或进入低功耗前调用
+ */
+void play_history_flush(void);
+
+uint32_t play_history_play_count(const char *path);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // PLAY_HISTORY_H
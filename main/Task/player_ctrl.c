@@ -0,0 +1,295 @@
+// main/task/player_ctrl.c
+#include <string.h>
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "freertos/queue.h"
+#include "esp_log.h"
+#include "esp_timer.h"
+
+#include "esp32_s3_hpy.h"
+#include "mp3_task.h"
+#include "player_ctrl.h"
+
+static const char *TAG = "PLAYER_CTRL";
+
+#define CTRL_TASK_STACK     6144    // 切歌时在本任务中打开文件、更新界面
+#define CTRL_TASK_PRIORITY  3       // 低于播放任务，高于曲库扫描和预读
+#define SEEK_MATCH_MS       1000    // 位置落在目标之后这么多毫秒内即视为跳转已生效
+
+typedef struct {
+    player_cmd_t cmd;
+    int32_t arg;
+    bool touch;
+    int64_t posted_us;
+} player_msg_t;
+
+// 正在等待的 "出声" 时刻
+typedef enum {
+    WAIT_NONE,
+    WAIT_START,     // 等播放器收到播放请求 (PLAYING / COMPLETED_PLAYING_NEXT)
+    WAIT_WRITE,     // 等新曲目的第一块 PCM 写入 I2S
+    WAIT_PAUSE,     // 等 PAUSE 事件
+    WAIT_SEEK,      // 等位置跳到目标附近后的第一次写入
+} latency_wait_t;
+
+static QueueHandle_t s_queue;
+static portMUX_TYPE s_lock = portMUX_INITIALIZER_UNLOCKED;  // 保护以下所有状态
+static player_ctrl_state_t s_state;
+static uint8_t s_volume = BSP_AUDIO_DEFAULT_VOLUME;
+
+// 拖动滑条产生的命令在队列中只保留一条，执行时取最新的参数
+static bool s_pending[PLAYER_CMD_MAX];
+static int32_t s_latest_arg[PLAYER_CMD_MAX];
+static int64_t s_latest_us[PLAYER_CMD_MAX];
+
+static volatile latency_wait_t s_wait;
+static int64_t s_wait_t0;
+static uint32_t s_wait_seek_ms;
+static player_ctrl_latency_t s_latency;
+static const uint16_t s_bucket_ms[PLAYER_CTRL_LATENCY_BUCKETS - 1] = { 10, 20, 50, 100, 200, 500, 1000 };
+
+static bool is_coalesced(player_cmd_t cmd)
+{
+    return cmd == PLAYER_CMD_SEEK || cmd == PLAYER_CMD_VOLUME || cmd == PLAYER_CMD_RESOLVE_NAMES;
+}
+
+/* =========================== 延迟统计 =========================== */
+static void record_latency(int64_t t0)
+{
+    uint32_t ms = (uint32_t)((esp_timer_get_time() - t0) / 1000);
+    int b = 0;
+    while (b < PLAYER_CTRL_LATENCY_BUCKETS - 1 && ms >= s_bucket_ms[b]) {
+        b++;
+    }
+
+    taskENTER_CRITICAL(&s_lock);
+    s_latency.buckets[b]++;
+    s_latency.count++;
+    if (ms > s_latency.max_ms) {
+        s_latency.max_ms = ms;
+    }
+    player_ctrl_latency_t snap = s_latency;
+    taskEXIT_CRITICAL(&s_lock);
+
+    ESP_LOGD(TAG, "触摸到出声 %u ms", (unsigned)ms);
+    if (snap.count % PLAYER_CTRL_LATENCY_LOG_EVERY == 0) {
+        const uint32_t *n = snap.buckets;
+        ESP_LOGI(TAG, "触摸到出声延迟 (%u 次, 最长 %u ms): <10:%u <20:%u <50:%u <100:%u <200:%u <500:%u <1000:%u >=1000:%u",
+                 (unsigned)snap.count, (unsigned)snap.max_ms, (unsigned)n[0], (unsigned)n[1], (unsigned)n[2],
+                 (unsigned)n[3], (unsigned)n[4], (unsigned)n[5], (unsigned)n[6], (unsigned)n[7]);
+    }
+}
+
+// t0 为 0 (非触摸发出的命令) 时取消正在等待的统计
+static void arm_latency(latency_wait_t wait, int64_t t0, uint32_t seek_ms)
+{
+    taskENTER_CRITICAL(&s_lock);
+    s_wait = t0 ? wait : WAIT_NONE;
+    s_wait_t0 = t0;
+    s_wait_seek_ms = seek_ms;
+    taskEXIT_CRITICAL(&s_lock);
+}
+
+// 当前等待的是 from 时结束等待并返回起始时刻，否则返回 0
+static int64_t take_wait(latency_wait_t from)
+{
+    int64_t t0 = 0;
+    taskENTER_CRITICAL(&s_lock);
+    if (s_wait == from) {
+        s_wait = WAIT_NONE;
+        t0 = s_wait_t0;
+    }
+    taskEXIT_CRITICAL(&s_lock);
+    return t0;
+}
+
+void player_ctrl_on_player_event(audio_player_callback_event_t event)
+{
+    if (event == AUDIO_PLAYER_CALLBACK_EVENT_PLAYING || event == AUDIO_PLAYER_CALLBACK_EVENT_COMPLETED_PLAYING_NEXT) {
+        // 之后的第一次写入就是新请求的音频
+        taskENTER_CRITICAL(&s_lock);
+        if (s_wait == WAIT_START) {
+            s_wait = WAIT_WRITE;
+        }
+        taskEXIT_CRITICAL(&s_lock);
+    } else if (event == AUDIO_PLAYER_CALLBACK_EVENT_PAUSE) {
+        int64_t t0 = take_wait(WAIT_PAUSE);
+        if (t0) {
+            record_latency(t0);
+        }
+    }
+}
+
+void player_ctrl_on_audio_written(void)
+{
+    latency_wait_t wait = s_wait;
+    int64_t t0 = 0;
+
+    if (wait == WAIT_WRITE) {
+        t0 = take_wait(WAIT_WRITE);
+    } else if (wait == WAIT_SEEK) {
+        uint32_t pos = audio_player_get_position();
+        if (pos >= s_wait_seek_ms && pos < s_wait_seek_ms + SEEK_MATCH_MS) {
+            t0 = take_wait(WAIT_SEEK);
+        }
+    }
+    if (t0) {
+        record_latency(t0);
+    }
+}
+
+void player_ctrl_get_latency(player_ctrl_latency_t *latency)
+{
+    taskENTER_CRITICAL(&s_lock);
+    *latency = s_latency;
+    taskEXIT_CRITICAL(&s_lock);
+}
+
+/* =========================== 控制任务 =========================== */
+static void publish(void)
+{
+    player_ctrl_state_t st = {
+        .index = get_current_music_index(),
+        .count = (uint32_t)get_music_file_count(),
+        .shuffle = mp3_player_get_shuffle(),
+        .volume = s_volume,
+    };
+
+    taskENTER_CRITICAL(&s_lock);
+    st.seq = s_state.seq + 1;
+    s_state = st;
+    taskEXIT_CRITICAL(&s_lock);
+}
+
+static void execute(player_msg_t *msg)
+{
+    if (is_coalesced(msg->cmd)) {
+        taskENTER_CRITICAL(&s_lock);
+        s_pending[msg->cmd] = false;
+        msg->arg = s_latest_arg[msg->cmd];
+        msg->posted_us = s_latest_us[msg->cmd];
+        taskEXIT_CRITICAL(&s_lock);
+    }
+    int64_t t0 = msg->touch ? msg->posted_us : 0;
+
+    switch (msg->cmd) {
+        case PLAYER_CMD_PLAY_INDEX:
+            arm_latency(WAIT_START, t0, 0);
+            play_music_by_index(msg->arg);
+            break;
+        case PLAYER_CMD_NEXT:
+        case PLAYER_CMD_PREV:
+            arm_latency(WAIT_START, t0, 0);
+            play_music_by_index(advance_music_index(msg->cmd == PLAYER_CMD_NEXT ? 1 : -1));
+            break;
+        case PLAYER_CMD_AUTO_NEXT:
+            play_music_by_index(advance_music_index(1));
+            break;
+        case PLAYER_CMD_TOGGLE: {
+            audio_player_state_t state = audio_player_get_state();
+            if (state == AUDIO_PLAYER_STATE_PLAYING) {
+                arm_latency(WAIT_PAUSE, t0, 0);
+                audio_player_pause();
+            } else if (state == AUDIO_PLAYER_STATE_PAUSE) {
+                arm_latency(WAIT_START, t0, 0);
+                audio_player_resume();
+            } else {
+                arm_latency(WAIT_START, t0, 0);
+                play_music_by_index(get_current_music_index());
+            }
+            break;
+        }
+        case PLAYER_CMD_SEEK:
+            arm_latency(WAIT_SEEK, t0, (uint32_t)msg->arg);
+            audio_player_seek((uint32_t)msg->arg);
+            break;
+        case PLAYER_CMD_VOLUME:
+            s_volume = (uint8_t)(msg->arg < 0 ? 0 : msg->arg > 100 ? 100 : msg->arg);
+            bsp_audio_set_volume(s_volume);
+            // 写完编解码器的寄存器就已生效
+            if (t0) {
+                record_latency(t0);
+            }
+            break;
+        case PLAYER_CMD_SHUFFLE:
+            mp3_player_set_shuffle(msg->arg != 0);
+            break;
+        case PLAYER_CMD_NEXT_SOURCE:
+            mp3_player_next_source();
+            break;
+        case PLAYER_CMD_RESOLVE_NAMES:
+            // 不改变播放状态，不必发布
+            mp3_player_resolve_names();
+            return;
+        default:
+            return;
+    }
+    publish();
+}
+
+static void player_ctrl_task(void *arg)
+{
+    player_msg_t msg;
+
+    while (xQueueReceive(s_queue, &msg, portMAX_DELAY) == pdPASS) {
+        execute(&msg);
+    }
+    vTaskDelete(NULL);
+}
+
+/* =========================== 对外接口 =========================== */
+esp_err_t player_ctrl_init(void)
+{
+    s_queue = xQueueCreate(PLAYER_CTRL_QUEUE_LEN, sizeof(player_msg_t));
+    if (s_queue == NULL) {
+        return ESP_ERR_NO_MEM;
+    }
+    publish();
+    if (xTaskCreate(player_ctrl_task, "player_ctrl", CTRL_TASK_STACK, NULL, CTRL_TASK_PRIORITY, NULL) != pdPASS) {
+        ESP_LOGE(TAG, "创建播放控制任务失败");
+        return ESP_FAIL;
+    }
+    return ESP_OK;
+}
+
+bool player_ctrl_post(player_cmd_t cmd, int32_t arg, bool touch)
+{
+    if (s_queue == NULL || cmd >= PLAYER_CMD_MAX) {
+        return false;
+    }
+    player_msg_t msg = {
+        .cmd = cmd,
+        .arg = arg,
+        .touch = touch,
+        .posted_us = esp_timer_get_time(),
+    };
+
+    if (is_coalesced(cmd)) {
+        taskENTER_CRITICAL(&s_lock);
+        bool queued = s_pending[cmd];
+        s_pending[cmd] = true;
+        s_latest_arg[cmd] = arg;
+        s_latest_us[cmd] = msg.posted_us;
+        taskEXIT_CRITICAL(&s_lock);
+        if (queued) {
+            return true;
+        }
+    }
+    if (xQueueSend(s_queue, &msg, 0) != pdPASS) {
+        if (is_coalesced(cmd)) {
+            taskENTER_CRITICAL(&s_lock);
+            s_pending[cmd] = false;
+            taskEXIT_CRITICAL(&s_lock);
+        }
+        ESP_LOGW(TAG, "命令队列已满，丢弃命令 %d", cmd);
+        return false;
+    }
+    return true;
+}
+
+void player_ctrl_get_state(player_ctrl_state_t *state)
+{
+    taskENTER_CRITICAL(&s_lock);
+    *state = s_state;
+    taskEXIT_CRITICAL(&s_lock);
+}
@@ -0,0 +1,85 @@
+// main/task/player_ctrl.h
+#ifndef PLAYER_CTRL_H
+#define PLAYER_CTRL_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "esp_err.h"
+#include "audio_player.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define PLAYER_CTRL_QUEUE_LEN       8
+#define PLAYER_CTRL_LATENCY_BUCKETS 8       // 上限依次为 10/20/50/100/200/500/1000 ms 和更长
+#define PLAYER_CTRL_LATENCY_LOG_EVERY 16    // 每记录这么多次打印一次直方图
+
+typedef enum {
+    PLAYER_CMD_PLAY_INDEX,      // arg: 当前播放源中的序号
+    PLAYER_CMD_NEXT,
+    PLAYER_CMD_PREV,
+    PLAYER_CMD_TOGGLE,          // 播放中暂停，暂停时继续，停止时播放当前曲目
+    PLAYER_CMD_SEEK,            // arg: 毫秒，连续拖动时只执行最新的一次
+    PLAYER_CMD_VOLUME,          // arg: 0-100，连续拖动时只执行最新的一次
+    PLAYER_CMD_SHUFFLE,         // arg: 0 关 / 1 开
+    PLAYER_CMD_NEXT_SOURCE,     // 切换到下一个播放列表
+    PLAYER_CMD_AUTO_NEXT,       // 一首播完后接着播放下一首
+    PLAYER_CMD_RESOLVE_NAMES,   // 读出浏览页要显示的 M3U 条目名称，排队时只保留一条
+    PLAYER_CMD_MAX,
+} player_cmd_t;
+
+/**
+ * @brief 控制任务每执行完一条命令发布一次的状态
+ */
+typedef struct {
+    uint32_t seq;               // 每次发布加一，界面据此判断是否需要刷新
+    int index;                  // 当前曲目序号
+    uint32_t count;             // 当前播放源的曲目数
+    bool shuffle;
+    uint8_t volume;
+} player_ctrl_state_t;
+
+typedef struct {
+    uint32_t count;
+    uint32_t max_ms;
+    uint32_t buckets[PLAYER_CTRL_LATENCY_BUCKETS];
+} player_ctrl_latency_t;
+
+/**
+ * @brief 创建播放控制任务
+ *
+ * 切歌、暂停、跳转、音量等操作都由这一个任务串行执行，界面只投递命令，
+ * SD 卡再慢也不会卡住 LVGL 任务。
+ */
+esp_err_t player_ctrl_init(void);
+
+/**
+ * @brief 投递一条命令，立即返回
+ * @param touch 由触摸操作发出时为 true，会记录从投递到出声的延迟
+ * @return false 队列已满或控制任务未创建
+ */
+bool player_ctrl_post(player_cmd_t cmd, int32_t arg, bool touch);
+
+/**
+ * @brief 取最近一次发布的状态
+ */
+void player_ctrl_get_state(player_ctrl_state_t *state);
+
+/**
+ * @brief 播放器开始播放或暂停 (在播放器状态回调中调用)
+ */
+void player_ctrl_on_player_event(audio_player_callback_event_t event);
+
+/**
+ * @brief 一块 PCM 已交给 I2S (在 write_fn 中调用)
+ */
+void player_ctrl_on_audio_written(void);
+
+void player_ctrl_get_latency(player_ctrl_latency_t *latency);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // PLAYER_CTRL_H
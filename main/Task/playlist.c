@@ -0,0 +1,95 @@
+// main/task/playlist.c
+#include <stdlib.h>
+#include <string.h>
+#include "esp_heap_caps.h"
+
+#include "playlist.h"
+
+#define POOL_MIN_CAP        4096
+#define OFFSETS_MIN_CAP     256
+
+static void *pl_realloc(void *ptr, size_t size)
+{
+    void *p = heap_caps_realloc(ptr, size, MALLOC_CAP_SPIRAM | MALLOC_CAP_8BIT);
+    return p ? p : realloc(ptr, size);
+}
+
+// 按 1.5 倍扩容，比翻倍浪费的尾部空间少
+static uint32_t next_cap(uint32_t cap, uint32_t need, uint32_t min_cap)
+{
+    uint32_t n = cap ? cap : min_cap;
+    while (n < need) {
+        n += n / 2 + 1;
+    }
+    return n;
+}
+
+void playlist_init(playlist_t *pl)
+{
+    memset(pl, 0, sizeof(*pl));
+}
+
+esp_err_t playlist_reserve(playlist_t *pl, uint32_t count, uint32_t pool_bytes)
+{
+    if (count > pl->cap) {
+        uint32_t *p = pl_realloc(pl->offsets, (size_t)count * sizeof(uint32_t));
+        if (p == NULL) {
+            return ESP_ERR_NO_MEM;
+        }
+        pl->offsets = p;
+        pl->cap = count;
+    }
+    if (pool_bytes > pl->pool_cap) {
+        char *p = pl_realloc(pl->pool, pool_bytes);
+        if (p == NULL) {
+            return ESP_ERR_NO_MEM;
+        }
+        pl->pool = p;
+        pl->pool_cap = pool_bytes;
+    }
+    return ESP_OK;
+}
+
+esp_err_t playlist_add(playlist_t *pl, const char *path)
+{
+    size_t len = strlen(path) + 1;
+    if (len > UINT32_MAX - pl->pool_size || pl->count == UINT32_MAX) {
+        return ESP_ERR_INVALID_SIZE;
+    }
+
+    esp_err_t ret = playlist_reserve(pl,
+                                     pl->count < pl->cap ? pl->cap : next_cap(pl->cap, pl->count + 1, OFFSETS_MIN_CAP),
+                                     pl->pool_size + len <= pl->pool_cap ? pl->pool_cap
+                                         : next_cap(pl->pool_cap, pl->pool_size + len, POOL_MIN_CAP));
+    if (ret != ESP_OK) {
+        return ret;
+    }
+
+    memcpy(pl->pool + pl->pool_size, path, len);
+    pl->offsets[pl->count++] = pl->pool_size;
+    pl->pool_size += len;
+    return ESP_OK;
+}
+
+const char *playlist_get(const playlist_t *pl, uint32_t index)
+{
+    return index < pl->count ? pl->pool + pl->offsets[index] : NULL;
+}
+
+void playlist_clear(playlist_t *pl)
+{
+    pl->count = 0;
+    pl->pool_size = 0;
+}
+
+void playlist_free(playlist_t *pl)
+{
+    free(pl->pool);
+    free(pl->offsets);
+    playlist_init(pl);
+}
+
+size_t playlist_memory_usage(const playlist_t *pl)
+{
+    return (size_t)pl->pool_cap + (size_t)pl->cap * sizeof(uint32_t);
+}
@@ -0,0 +1,69 @@
+// main/task/playlist.h
+#ifndef PLAYLIST_H
+#define PLAYLIST_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include "esp_err.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * @brief 播放列表容器
+ *
+ * 所有路径依次追加到一块只增不减的字符串池 (bump arena) 中，
+ * 条目表只保存 32 位偏移。池扩容时整体搬移，偏移保持有效；
+ * 每个条目的额外开销为 4 字节偏移加 1 字节结束符。
+ * 内存优先分配在 PSRAM。
+ */
+typedef struct {
+    char *pool;             // 字符串池
+    uint32_t pool_size;     // 已使用字节数
+    uint32_t pool_cap;
+    uint32_t *offsets;      // 第 i 个条目在池中的偏移
+    uint32_t count;
+    uint32_t cap;
+} playlist_t;
+
+void playlist_init(playlist_t *pl);
+
+/**
+ * @brief 追加一个路径 (拷贝到字符串池)
+ */
+esp_err_t playlist_add(playlist_t *pl, const char *path);
+
+/**
+ * @brief 预留容量，已知条目数时可避免多次扩容
+ */
+esp_err_t playlist_reserve(playlist_t *pl, uint32_t count, uint32_t pool_bytes);
+
+/**
+ * @brief 获取第 index 个路径，O(1)
+ * @note  指针在下一次 playlist_add()/playlist_clear() 之前有效
+ */
+const char *playlist_get(const playlist_t *pl, uint32_t index);
+
+static inline uint32_t playlist_count(const playlist_t *pl)
+{
+    return pl->count;
+}
+
+/**
+ * @brief 清空条目但保留已分配的内存，便于重建
+ */
+void playlist_clear(playlist_t *pl);
+
+void playlist_free(playlist_t *pl);
+
+/**
+ * @brief 当前占用的堆内存 (字节)
+ */
+size_t playlist_memory_usage(const playlist_t *pl);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // PLAYLIST_H
@@ -0,0 +1,164 @@
+// main/task/sd_hotplug.c
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "esp_log.h"
+#include "esp_timer.h"
+
+#include "esp32_s3_hpy.h"
+#include "sd_hotplug.h"
+
+static const char *TAG = "SD_HOTPLUG";
+
+#define HOTPLUG_TASK_STACK      4096
+#define HOTPLUG_TASK_PRIORITY   2
+#define POLL_PERIOD_MS          1000    // 已挂载时查询卡状态的间隔
+#define REMOUNT_PERIOD_MS       2000    // 未挂载时尝试挂载的间隔，每次失败都有初始化超时和日志
+#define REMOVE_THRESHOLD        2       // 连续无响应的次数，避免偶发的命令超时被当成拔卡
+#define IO_DRAIN_MS             2000    // 拔卡后等待后台任务结束访问的上限，超时则下个周期再试
+#define IO_DRAIN_STEP_MS        10
+
+static sd_hotplug_cb_t s_cb;
+static void *s_cb_ctx;
+static volatile bool s_present;
+static bool s_unmount_pending;      // 已拔出但还有访问没有结束，文件系统仍挂载着
+
+// 正在访问卡的任务数；拔卡到重新挂载之间不允许开始新的访问
+static portMUX_TYPE s_io_lock = portMUX_INITIALIZER_UNLOCKED;
+static uint32_t s_io_users;
+static bool s_io_blocked;
+
+static bool notify(sd_hotplug_event_t event)
+{
+    return s_cb ? s_cb(event, s_cb_ctx) : true;
+}
+
+static void io_block(bool blocked)
+{
+    taskENTER_CRITICAL(&s_io_lock);
+    s_io_blocked = blocked;
+    taskEXIT_CRITICAL(&s_io_lock);
+}
+
+// 等已开始的访问全部结束 (各任务关闭文件后调用 sd_hotplug_io_end)
+static bool io_drain(uint32_t timeout_ms)
+{
+    for (uint32_t waited = 0; ; waited += IO_DRAIN_STEP_MS) {
+        taskENTER_CRITICAL(&s_io_lock);
+        uint32_t users = s_io_users;
+        taskEXIT_CRITICAL(&s_io_lock);
+        if (users == 0) {
+            return true;
+        }
+        if (waited >= timeout_ms) {
+            ESP_LOGW(TAG, "仍有 %u 个任务在访问 SD 卡", (unsigned)users);
+            return false;
+        }
+        vTaskDelay(pdMS_TO_TICKS(IO_DRAIN_STEP_MS));
+    }
+}
+
+/**
+ * 各任务的访问都结束后，再发一次 REMOVED 由回调确认播放已停止 (等待期间开始的播放也在此停下)，
+ * 之后才卸载；否则保持挂载，返回 false 由调用者在下个周期重试
+ */
+static bool try_unmount(void)
+{
+    if (!io_drain(IO_DRAIN_MS)) {
+        return false;
+    }
+    if (!notify(SD_HOTPLUG_EVENT_REMOVED)) {
+        ESP_LOGW(TAG, "播放尚未停止，暂不卸载");
+        return false;
+    }
+    bsp_sdcard_deinit();
+    return true;
+}
+
+static void sd_hotplug_task(void *arg)
+{
+    int misses = 0;
+    bool boot = !s_present;     // 启动时的第一次挂载不等待
+
+    for (;;) {
+        if (s_unmount_pending) {
+            vTaskDelay(pdMS_TO_TICKS(POLL_PERIOD_MS));
+            s_unmount_pending = !try_unmount();
+        } else if (s_present) {
+            vTaskDelay(pdMS_TO_TICKS(POLL_PERIOD_MS));
+            if (bsp_sdcard_is_present()) {
+                misses = 0;
+                continue;
+            }
+            if (++misses < REMOVE_THRESHOLD) {
+                continue;
+            }
+
+            ESP_LOGW(TAG, "SD 卡已拔出");
+            s_present = false;
+            misses = 0;
+            io_block(true);
+            notify(SD_HOTPLUG_EVENT_REMOVED);   // 先让各任务停下，返回值在 try_unmount 中确认
+            s_unmount_pending = !try_unmount();
+        } else {
+            if (!boot) {
+                vTaskDelay(pdMS_TO_TICKS(REMOUNT_PERIOD_MS));
+            }
+            int64_t t0 = esp_timer_get_time();
+            esp_err_t ret = bsp_sdcard_init(NULL);
+            if (boot) {
+                boot = false;
+                ESP_LOGI(TAG, "启动挂载 %s, %lld ms", ret == ESP_OK ? "成功" : "失败",
+                         (esp_timer_get_time() - t0) / 1000);
+                if (ret != ESP_OK) {
+                    notify(SD_HOTPLUG_EVENT_ABSENT);
+                }
+            }
+            if (ret != ESP_OK) {
+                continue;
+            }
+            ESP_LOGI(TAG, "SD 卡已插入 (序列号 %08lx)", (unsigned long)bsp_sdcard_serial());
+            io_block(false);
+            s_present = true;
+            notify(SD_HOTPLUG_EVENT_INSERTED);
+        }
+    }
+}
+
+esp_err_t sd_hotplug_start(sd_hotplug_cb_t cb, void *ctx)
+{
+    s_cb = cb;
+    s_cb_ctx = ctx;
+    s_present = bsp_sdcard_is_present();
+
+    if (xTaskCreate(sd_hotplug_task, "sd_hotplug", HOTPLUG_TASK_STACK, NULL, HOTPLUG_TASK_PRIORITY, NULL) != pdPASS) {
+        ESP_LOGE(TAG, "创建插拔检测任务失败");
+        return ESP_FAIL;
+    }
+    return ESP_OK;
+}
+
+bool sd_hotplug_card_present(void)
+{
+    return s_present;
+}
+
+bool sd_hotplug_io_begin(void)
+{
+    bool ok;
+    taskENTER_CRITICAL(&s_io_lock);
+    ok = !s_io_blocked;
+    if (ok) {
+        s_io_users++;
+    }
+    taskEXIT_CRITICAL(&s_io_lock);
+    return ok;
+}
+
+void sd_hotplug_io_end(void)
+{
+    taskENTER_CRITICAL(&s_io_lock);
+    if (s_io_users > 0) {
+        s_io_users--;
+    }
+    taskEXIT_CRITICAL(&s_io_lock);
+}
@@ -0,0 +1,60 @@
+// main/task/sd_hotplug.h
+#ifndef SD_HOTPLUG_H
+#define SD_HOTPLUG_H
+
+#include <stdbool.h>
+#include "esp_err.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef enum {
+    SD_HOTPLUG_EVENT_REMOVED,   // 卡已拔出，回调确认且所有访问结束后卸载文件系统
+    SD_HOTPLUG_EVENT_INSERTED,  // 卡已插入并挂载
+    SD_HOTPLUG_EVENT_ABSENT,    // 启动后第一次挂载失败 (没有卡)
+} sd_hotplug_event_t;
+
+/**
+ * @brief 插拔事件回调，在检测任务中调用
+ * @note  REMOVED 回调中应停止所有 SD 卡访问 (如正在播放的文件)，全部关闭后返回 true。
+ *        REMOVED 会发出多次: 拔卡时一次，sd_hotplug_io_begin() 开始的访问都结束后再确认一次；
+ *        返回 false 时暂不卸载，之后每个查询周期再确认，直到返回 true。其余事件的返回值被忽略
+ */
+typedef bool (*sd_hotplug_cb_t)(sd_hotplug_event_t event, void *ctx);
+
+/**
+ * @brief 创建 SD 卡插拔检测任务
+ *
+ * 板上没有卡检测引脚：已挂载时定期发送 CMD13 查询卡状态，连续两次无响应即视为拔出；
+ * 未挂载时定期尝试重新挂载。卡尚未挂载时，任务启动后立即挂载一次 (与其他初始化并行)，
+ * 成功发出 INSERTED，失败发出 ABSENT，之后插卡时发出 INSERTED。
+ */
+esp_err_t sd_hotplug_start(sd_hotplug_cb_t cb, void *ctx);
+
+/**
+ * @brief 卡当前是否已挂载可用
+ */
+bool sd_hotplug_card_present(void);
+
+/**
+ * @brief 开始一段 SD 卡访问 (从打开文件到关闭文件)
+ *
+ * 后台任务读写卡上的文件前调用，检测到拔卡后返回 false，直到重新挂载；
+ * 卸载前等所有已开始的访问都调用 sd_hotplug_io_end()。
+ * 访问期间应检查 media_library_is_online() 等标志，拔卡后尽快关闭文件结束访问。
+ *
+ * @return true 可以访问，之后必须调用 sd_hotplug_io_end()；false 正在卸载或已拔出
+ */
+bool sd_hotplug_io_begin(void);
+
+/**
+ * @brief 结束 sd_hotplug_io_begin() 开始的访问，调用前关闭所有打开的文件
+ */
+void sd_hotplug_io_end(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // SD_HOTPLUG_H
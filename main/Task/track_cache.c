@@ -0,0 +1,364 @@
+// main/task/track_cache.c
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "freertos/queue.h"
+#include "freertos/semphr.h"
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "esp_heap_caps.h"
+
+#include "audio_player.h"
+#include "media_library.h"
+#include "track_cache.h"
+#include "sd_hotplug.h"
+
+static const char *TAG = "TRACK_CACHE";
+
+#define CACHE_TASK_STACK        3072
+#define CACHE_TASK_PRIORITY     1           // 低于封面和曲库扫描任务
+#define LOAD_CHUNK              (16 * 1024) // 每次从卡上读取的字节数
+#define LOAD_PLAYING_DELAY_MS   20          // 播放时每块之间让出 SD 卡的时间
+
+typedef enum {
+    SLOT_FREE,
+    SLOT_LOADING,           // 预读任务正在写入，不可取用也不可淘汰
+    SLOT_READY,
+} slot_state_t;
+
+typedef struct {
+    slot_state_t state;
+    char *path;
+    uint8_t *data;          // PSRAM 中的整个文件
+    size_t len;
+    uint32_t last_use;      // 取用/预读时更新，数值最小的最先淘汰
+    int refs;               // 正在播放的引用数，非 0 时不可淘汰
+    bool stale;             // 已被 clear，引用释放或读取结束后回收
+} cache_slot_t;
+
+typedef struct {
+    int count;
+    char paths[TRACK_CACHE_PREFETCH][MEDIA_LIBRARY_PATH_LEN];
+} prefetch_request_t;
+
+static cache_slot_t s_slots[TRACK_CACHE_MAX_ENTRIES];
+static SemaphoreHandle_t s_lock;    // 保护 s_slots 和 s_stats
+static QueueHandle_t s_queue;
+static prefetch_request_t s_req;    // 预读任务正在处理的请求，其中的曲目不淘汰
+static uint32_t s_tick;
+static track_cache_stats_t s_stats;
+
+/* =========================== 缓存项 =========================== */
+// 以下函数调用者需持有 s_lock
+static cache_slot_t *find_locked(const char *path)
+{
+    for (int i = 0; i < TRACK_CACHE_MAX_ENTRIES; i++) {
+        if (s_slots[i].state != SLOT_FREE && !s_slots[i].stale && strcmp(s_slots[i].path, path) == 0) {
+            return &s_slots[i];
+        }
+    }
+    return NULL;
+}
+
+static void free_slot_locked(cache_slot_t *slot)
+{
+    if (slot->state == SLOT_READY) {
+        s_stats.entries--;
+    }
+    s_stats.used -= slot->len;
+    heap_caps_free(slot->data);
+    free(slot->path);
+    memset(slot, 0, sizeof(*slot));
+}
+
+static bool in_request(const char *path)
+{
+    for (int i = 0; i < s_req.count; i++) {
+        if (strcmp(s_req.paths[i], path) == 0) {
+            return true;
+        }
+    }
+    return false;
+}
+
+// 淘汰最久未用、未在播放、也不在当前预读列表中的一项
+static bool evict_one_locked(void)
+{
+    cache_slot_t *victim = NULL;
+    for (int i = 0; i < TRACK_CACHE_MAX_ENTRIES; i++) {
+        cache_slot_t *s = &s_slots[i];
+        if (s->state == SLOT_READY && s->refs == 0 && !in_request(s->path) &&
+            (victim == NULL || s->last_use < victim->last_use)) {
+            victim = s;
+        }
+    }
+    if (victim == NULL) {
+        return false;
+    }
+    ESP_LOGD(TAG, "淘汰 %s (%u KB)", victim->path, (unsigned)(victim->len / 1024));
+    free_slot_locked(victim);
+    s_stats.evictions++;
+    return true;
+}
+
+static cache_slot_t *free_entry_locked(void)
+{
+    for (int i = 0; i < TRACK_CACHE_MAX_ENTRIES; i++) {
+        if (s_slots[i].state == SLOT_FREE) {
+            return &s_slots[i];
+        }
+    }
+    return NULL;
+}
+
+// 腾出 len 字节和一个空位并占用，失败返回 NULL
+static cache_slot_t *reserve_locked(const char *path, size_t len)
+{
+    while (s_stats.used + len > s_stats.budget) {
+        if (!evict_one_locked()) {
+            return NULL;
+        }
+    }
+    cache_slot_t *slot;
+    while ((slot = free_entry_locked()) == NULL) {
+        if (!evict_one_locked()) {
+            return NULL;
+        }
+    }
+    slot->path = strdup(path);
+    if (slot->path == NULL) {
+        return NULL;
+    }
+    slot->state = SLOT_LOADING;
+    slot->len = len;
+    s_stats.used += len;
+    return slot;
+}
+
+/* =========================== 后台预读 =========================== */
+// 拔卡或缓存被清空时中止读取
+static bool load_cancelled(cache_slot_t *slot)
+{
+    return !media_library_is_online() || slot->stale;
+}
+
+static void load_track(const char *path, uint8_t *chunk)
+{
+    xSemaphoreTake(s_lock, portMAX_DELAY);
+    cache_slot_t *slot = find_locked(path);
+    if (slot) {
+        slot->last_use = ++s_tick;
+    }
+    xSemaphoreGive(s_lock);
+    if (slot) {
+        return;
+    }
+
+    int fd = open(path, O_RDONLY);
+    if (fd < 0) {
+        return;
+    }
+    struct stat st;
+    // 单曲不超过预算的一半，保证正在播放的和下一首能同时留在缓存中
+    if (fstat(fd, &st) != 0 || st.st_size == 0 || (size_t)st.st_size > s_stats.budget / 2) {
+        close(fd);
+        return;
+    }
+    size_t len = (size_t)st.st_size;
+
+    xSemaphoreTake(s_lock, portMAX_DELAY);
+    slot = reserve_locked(path, len);
+    xSemaphoreGive(s_lock);
+    if (slot == NULL) {
+        ESP_LOGD(TAG, "缓存已满，不预读 %s", path);
+        close(fd);
+        return;
+    }
+
+    // PSRAM 不能做 SDMMC 的 DMA 目标，经内部 RAM 中的整块缓冲读入后再拷贝
+    int64_t t0 = esp_timer_get_time();
+    uint8_t *data = heap_caps_malloc(len, MALLOC_CAP_SPIRAM | MALLOC_CAP_8BIT);
+    size_t done = 0;
+    while (data && done < len && !load_cancelled(slot)) {
+        size_t want = len - done < LOAD_CHUNK ? len - done : LOAD_CHUNK;
+        ssize_t got = read(fd, chunk, want);
+        if (got <= 0) {
+            break;
+        }
+        memcpy(data + done, chunk, (size_t)got);
+        done += (size_t)got;
+        if (audio_player_get_state() == AUDIO_PLAYER_STATE_PLAYING) {
+            vTaskDelay(pdMS_TO_TICKS(LOAD_PLAYING_DELAY_MS));
+        }
+    }
+    close(fd);
+    int64_t dt = esp_timer_get_time() - t0;
+
+    xSemaphoreTake(s_lock, portMAX_DELAY);
+    slot->data = data;
+    bool ok = data && done == len && !slot->stale;
+    if (ok) {
+        slot->state = SLOT_READY;
+        slot->last_use = ++s_tick;
+        s_stats.entries++;
+        s_stats.loads++;
+        s_stats.bytes_loaded += len;
+        s_stats.load_us += dt;
+    } else {
+        free_slot_locked(slot);
+    }
+    track_cache_stats_t stats = s_stats;
+    xSemaphoreGive(s_lock);
+
+    if (ok) {
+        ESP_LOGI(TAG, "预读 %s: %u KB, %lld ms (已用 %u/%u KB, %u 首, 淘汰 %u 次)",
+                 path, (unsigned)(len / 1024), dt / 1000,
+                 (unsigned)(stats.used / 1024), (unsigned)(stats.budget / 1024),
+                 (unsigned)stats.entries, (unsigned)stats.evictions);
+    }
+}
+
+static void track_cache_task(void *arg)
+{
+    while (xQueueReceive(s_queue, &s_req, portMAX_DELAY) == pdPASS) {
+        uint8_t *chunk = heap_caps_aligned_alloc(64, LOAD_CHUNK, MALLOC_CAP_DMA | MALLOC_CAP_INTERNAL);
+        if (chunk == NULL) {
+            continue;
+        }
+        // 按播放顺序读入，有了新请求就放弃这一轮
+        for (int i = 0; i < s_req.count && uxQueueMessagesWaiting(s_queue) == 0; i++) {
+            if (!media_library_is_online() || !sd_hotplug_io_begin()) {
+                break;
+            }
+            // 拔卡时 load_cancelled() 让读取尽快结束，关闭文件后卸载才继续
+            load_track(s_req.paths[i], chunk);
+            sd_hotplug_io_end();
+        }
+        heap_caps_free(chunk);
+    }
+    vTaskDelete(NULL);
+}
+
+/* =========================== 对外接口 =========================== */
+static void release_cb(void *ctx)
+{
+    cache_slot_t *slot = ctx;
+
+    xSemaphoreTake(s_lock, portMAX_DELAY);
+    slot->refs--;
+    if (slot->stale && slot->refs == 0) {
+        free_slot_locked(slot);
+    }
+    xSemaphoreGive(s_lock);
+}
+
+static const audio_player_source_ops_t release_ops = {
+    .close = release_cb,
+};
+
+esp_err_t track_cache_init(size_t budget)
+{
+    size_t free_psram = heap_caps_get_free_size(MALLOC_CAP_SPIRAM);
+    if (free_psram == 0) {
+        return ESP_ERR_NOT_SUPPORTED;
+    }
+    if (budget > free_psram / 2) {
+        budget = free_psram / 2;
+    }
+    s_stats.budget = budget;
+
+    s_lock = xSemaphoreCreateMutex();
+    s_queue = xQueueCreate(1, sizeof(prefetch_request_t));
+    if (s_lock == NULL || s_queue == NULL) {
+        return ESP_ERR_NO_MEM;
+    }
+    if (xTaskCreate(track_cache_task, "track_cache", CACHE_TASK_STACK, NULL, CACHE_TASK_PRIORITY, NULL) != pdPASS) {
+        ESP_LOGE(TAG, "创建预读任务失败");
+        return ESP_FAIL;
+    }
+    ESP_LOGI(TAG, "整曲缓存 %u KB", (unsigned)(budget / 1024));
+    return ESP_OK;
+}
+
+void track_cache_prefetch(const char *const *paths, int count)
+{
+    static prefetch_request_t req;
+
+    if (s_queue == NULL) {
+        return;
+    }
+    req.count = count < TRACK_CACHE_PREFETCH ? count : TRACK_CACHE_PREFETCH;
+    for (int i = 0; i < req.count; i++) {
+        strlcpy(req.paths[i], paths[i], sizeof(req.paths[i]));
+    }
+    xQueueOverwrite(s_queue, &req);
+}
+
+bool track_cache_acquire(const char *path, audio_player_source_t *source)
+{
+    if (s_lock == NULL) {
+        return false;
+    }
+
+    xSemaphoreTake(s_lock, portMAX_DELAY);
+    cache_slot_t *slot = find_locked(path);
+    bool hit = slot && slot->state == SLOT_READY;
+    if (hit) {
+        slot->refs++;
+        slot->last_use = ++s_tick;
+        s_stats.hits++;
+    } else {
+        s_stats.misses++;
+    }
+    uint32_t hits = s_stats.hits;
+    uint32_t misses = s_stats.misses;
+    xSemaphoreGive(s_lock);
+
+    ESP_LOGI(TAG, "%s (命中 %u 次, 未命中 %u 次)", hit ? "从缓存播放" : "未缓存", (unsigned)hits, (unsigned)misses);
+    if (!hit) {
+        return false;
+    }
+    source->ops = &release_ops;
+    source->ctx = slot;
+    source->data = slot->data;
+    source->len = slot->len;
+    return true;
+}
+
+void track_cache_clear(void)
+{
+    if (s_lock == NULL) {
+        return;
+    }
+
+    xQueueReset(s_queue);
+    xSemaphoreTake(s_lock, portMAX_DELAY);
+    for (int i = 0; i < TRACK_CACHE_MAX_ENTRIES; i++) {
+        cache_slot_t *s = &s_slots[i];
+        if (s->state == SLOT_FREE) {
+            continue;
+        }
+        if (s->state == SLOT_LOADING || s->refs > 0) {
+            s->stale = true;
+        } else {
+            free_slot_locked(s);
+        }
+    }
+    xSemaphoreGive(s_lock);
+}
+
+void track_cache_get_stats(track_cache_stats_t *stats)
+{
+    if (s_lock == NULL) {
+        memset(stats, 0, sizeof(*stats));
+        return;
+    }
+    xSemaphoreTake(s_lock, portMAX_DELAY);
+    *stats = s_stats;
+    xSemaphoreGive(s_lock);
+}
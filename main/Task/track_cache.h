@@ -0,0 +1,68 @@
+// main/task/track_cache.h
+#ifndef TRACK_CACHE_H
+#define TRACK_CACHE_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
+#include "esp_err.h"
+#include "audio_player.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define TRACK_CACHE_BUDGET      (4 * 1024 * 1024)   // 默认预算 (字节)，8 MB PSRAM 的一半
+#define TRACK_CACHE_MAX_ENTRIES 16                  // 缓存的曲目数上限
+#define TRACK_CACHE_PREFETCH    3                   // 每次预读当前曲目之后的几首
+
+typedef struct {
+    size_t budget;          // 字节预算
+    size_t used;            // 已缓存的字节数
+    uint32_t entries;
+    uint32_t hits;          // 开始播放时命中的次数
+    uint32_t misses;
+    uint32_t evictions;     // 为腾出空间淘汰的曲目数
+    uint32_t loads;         // 读入缓存的曲目数
+    uint64_t bytes_loaded;
+    int64_t load_us;        // 读入缓存的累计耗时
+} track_cache_stats_t;
+
+/**
+ * @brief 在 PSRAM 中建立整曲缓存并创建后台预读任务
+ *
+ * 缓存的是压缩后的原始文件，按最近使用淘汰。预读任务优先级最低，
+ * 播放时每读一块就让出 SD 卡，不影响正在播放的曲目。
+ *
+ * @param budget 缓存可用的字节数，超过可用 PSRAM 的一半时按一半计
+ * @return ESP_ERR_NOT_SUPPORTED 没有 PSRAM
+ */
+esp_err_t track_cache_init(size_t budget);
+
+/**
+ * @brief 提交接下来要播放的曲目 (按播放顺序)，立即返回
+ * @note  只保留最新的请求；列表中的曲目在预读期间不会被淘汰
+ */
+void track_cache_prefetch(const char *const *paths, int count);
+
+/**
+ * @brief 取得已缓存曲目的数据，交给 audio_player_play_source() 直接在 PSRAM 中解码
+ *
+ * 返回 true 时缓存项被引用，播放结束时由 source 的 close 回调释放；
+ * audio_player_play_source() 失败时需由调用者调用 source->ops->close(source->ctx)。
+ * 同时统计命中/未命中次数。
+ */
+bool track_cache_acquire(const char *path, audio_player_source_t *source);
+
+/**
+ * @brief 丢弃全部缓存 (拔卡后卡上的文件可能已不同)，正在播放的一项在播完后释放
+ */
+void track_cache_clear(void);
+
+void track_cache_get_stats(track_cache_stats_t *stats);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // TRACK_CACHE_H
@@ -0,0 +1,289 @@
+// main/task/track_list.c
+#include <stdlib.h>
+#include <string.h>
+
+#include "track_list.h"
+
+#define UNBOUND             UINT32_MAX
+#define DRAG_THRESHOLD_PX   8       // 移动超过这么多才算拖动，否则松手时算点击
+#define FLING_PERIOD_MS     16
+#define FLING_DECAY_PCT     92      // 惯性滚动每帧保留的速度
+#define THUMB_WIDTH         4
+#define THUMB_MIN_HEIGHT    24
+
+struct track_list {
+    lv_obj_t *cont;
+    lv_obj_t *thumb;
+    lv_timer_t *fling;
+    track_list_text_fn_t text_fn;
+    track_list_select_fn_t select_fn;
+    void *ctx;
+    uint32_t count;
+    int current;
+    int64_t offset;         // 第 0 条顶端到可见区顶端的距离，可超过 16 位坐标
+    lv_coord_t view_h;
+    lv_coord_t press_y;     // 按下时的位置，用来判断是否拖动
+    lv_coord_t last_y;
+    int32_t velocity;       // 最近一次移动的像素数，松手后按它惯性滚动
+    bool dragged;
+    int row_count;
+    lv_obj_t **rows;        // 第 i 条总是放在 rows[i % row_count]
+    uint32_t *bound;        // 每行当前显示的条目序号
+};
+
+static int64_t max_offset(const track_list_t *tl)
+{
+    int64_t total = (int64_t)tl->count * TRACK_LIST_ROW_HEIGHT;
+    return total > tl->view_h ? total - tl->view_h : 0;
+}
+
+static void update_thumb(track_list_t *tl)
+{
+    int64_t total = (int64_t)tl->count * TRACK_LIST_ROW_HEIGHT;
+    if (total <= tl->view_h) {
+        lv_obj_add_flag(tl->thumb, LV_OBJ_FLAG_HIDDEN);
+        return;
+    }
+    lv_coord_t h = (lv_coord_t)((int64_t)tl->view_h * tl->view_h / total);
+    if (h < THUMB_MIN_HEIGHT) {
+        h = THUMB_MIN_HEIGHT;
+    }
+    lv_obj_set_height(tl->thumb, h);
+    lv_obj_set_y(tl->thumb, (lv_coord_t)(tl->offset * (tl->view_h - h) / max_offset(tl)));
+    lv_obj_clear_flag(tl->thumb, LV_OBJ_FLAG_HIDDEN);
+}
+
+// 按当前滚动位置摆放各行，只有换了条目的行才取文字
+static void layout(track_list_t *tl)
+{
+    char text[TRACK_LIST_TEXT_MAX];
+    uint32_t first = (uint32_t)(tl->offset / TRACK_LIST_ROW_HEIGHT);
+    // 上方留一行，其余余量放在下方
+    uint32_t start = first > 0 ? first - 1 : 0;
+
+    for (int k = 0; k < tl->row_count; k++) {
+        uint32_t i = start + (uint32_t)k;
+        int slot = (int)(i % (uint32_t)tl->row_count);
+        lv_obj_t *row = tl->rows[slot];
+
+        if (i >= tl->count) {
+            lv_obj_add_flag(row, LV_OBJ_FLAG_HIDDEN);
+            tl->bound[slot] = UNBOUND;
+            continue;
+        }
+        if (tl->bound[slot] != i) {
+            tl->text_fn(i, text, sizeof(text), tl->ctx);
+            lv_label_set_text(row, text);
+            if ((int)i == tl->current) {
+                lv_obj_add_state(row, LV_STATE_CHECKED);
+            } else {
+                lv_obj_clear_state(row, LV_STATE_CHECKED);
+            }
+            tl->bound[slot] = i;
+        }
+        lv_obj_set_y(row, (lv_coord_t)((int64_t)i * TRACK_LIST_ROW_HEIGHT - tl->offset));
+        lv_obj_clear_flag(row, LV_OBJ_FLAG_HIDDEN);
+    }
+    update_thumb(tl);
+}
+
+static int64_t clamp_offset(const track_list_t *tl, int64_t offset)
+{
+    int64_t max = max_offset(tl);
+    return offset < 0 ? 0 : offset > max ? max : offset;
+}
+
+// 移动 delta 像素 (正数向下翻)，到头时返回 false
+static bool scroll_by(track_list_t *tl, int64_t delta)
+{
+    int64_t target = clamp_offset(tl, tl->offset + delta);
+    bool inside = target == tl->offset + delta;
+    if (target != tl->offset) {
+        tl->offset = target;
+        layout(tl);
+    }
+    return inside;
+}
+
+static void fling_cb(lv_timer_t *timer)
+{
+    track_list_t *tl = timer->user_data;
+
+    tl->velocity = tl->velocity * FLING_DECAY_PCT / 100;
+    if (tl->velocity == 0 || !scroll_by(tl, -tl->velocity)) {
+        tl->velocity = 0;
+        lv_timer_pause(timer);
+    }
+}
+
+static void cont_event_cb(lv_event_t *e)
+{
+    track_list_t *tl = lv_event_get_user_data(e);
+    lv_event_code_t code = lv_event_get_code(e);
+    lv_indev_t *indev = lv_indev_get_act();
+    lv_point_t p;
+
+    if (indev == NULL) {
+        return;
+    }
+    lv_indev_get_point(indev, &p);
+
+    if (code == LV_EVENT_PRESSED) {
+        lv_timer_pause(tl->fling);
+        tl->velocity = 0;
+        tl->dragged = false;
+        tl->press_y = p.y;
+        tl->last_y = p.y;
+    } else if (code == LV_EVENT_PRESSING) {
+        if (!tl->dragged && LV_ABS(p.y - tl->press_y) < DRAG_THRESHOLD_PX) {
+            return;
+        }
+        tl->dragged = true;
+        tl->velocity = p.y - tl->last_y;
+        tl->last_y = p.y;
+        scroll_by(tl, -tl->velocity);
+    } else if (code == LV_EVENT_RELEASED) {
+        if (tl->dragged && tl->velocity != 0) {
+            lv_timer_resume(tl->fling);
+        }
+    } else if (code == LV_EVENT_CLICKED) {
+        if (tl->dragged) {
+            return;
+        }
+        lv_area_t area;
+        lv_obj_get_coords(tl->cont, &area);
+        int64_t y = tl->offset + (p.y - area.y1);
+        if (y >= 0 && y / TRACK_LIST_ROW_HEIGHT < tl->count) {
+            tl->select_fn((uint32_t)(y / TRACK_LIST_ROW_HEIGHT), tl->ctx);
+        }
+    }
+}
+
+static void cont_delete_cb(lv_event_t *e)
+{
+    track_list_t *tl = lv_event_get_user_data(e);
+
+    lv_timer_del(tl->fling);
+    free(tl->rows);
+    free(tl->bound);
+    free(tl);
+}
+
+track_list_t *track_list_create(lv_obj_t *parent, lv_coord_t width, lv_coord_t height,
+                                track_list_text_fn_t text_fn, track_list_select_fn_t select_fn, void *ctx)
+{
+    track_list_t *tl = calloc(1, sizeof(*tl));
+    if (tl == NULL) {
+        return NULL;
+    }
+    tl->row_count = (height + TRACK_LIST_ROW_HEIGHT - 1) / TRACK_LIST_ROW_HEIGHT + TRACK_LIST_MARGIN_ROWS;
+    tl->rows = calloc(tl->row_count, sizeof(*tl->rows));
+    tl->bound = malloc(tl->row_count * sizeof(*tl->bound));
+    if (tl->rows == NULL || tl->bound == NULL) {
+        free(tl->rows);
+        free(tl->bound);
+        free(tl);
+        return NULL;
+    }
+    tl->text_fn = text_fn;
+    tl->select_fn = select_fn;
+    tl->ctx = ctx;
+    tl->current = -1;
+    tl->view_h = height;
+
+    // 滚动由本模块处理，容器本身不可滚动，拖动也不传给父对象
+    tl->cont = lv_obj_create(parent);
+    lv_obj_remove_style_all(tl->cont);
+    lv_obj_set_size(tl->cont, width, height);
+    lv_obj_clear_flag(tl->cont, LV_OBJ_FLAG_SCROLLABLE | LV_OBJ_FLAG_SCROLL_CHAIN);
+    lv_obj_add_event_cb(tl->cont, cont_event_cb, LV_EVENT_ALL, tl);
+    lv_obj_add_event_cb(tl->cont, cont_delete_cb, LV_EVENT_DELETE, tl);
+
+    for (int k = 0; k < tl->row_count; k++) {
+        lv_obj_t *row = lv_label_create(tl->cont);
+        lv_label_set_long_mode(row, LV_LABEL_LONG_DOT);
+        lv_obj_set_size(row, width - THUMB_WIDTH * 2, TRACK_LIST_ROW_HEIGHT);
+        lv_obj_set_style_pad_hor(row, 12, 0);
+        lv_obj_set_style_pad_top(row, (TRACK_LIST_ROW_HEIGHT - lv_font_get_line_height(LV_FONT_DEFAULT)) / 2, 0);
+        lv_obj_set_style_border_side(row, LV_BORDER_SIDE_BOTTOM, 0);
+        lv_obj_set_style_border_width(row, 1, 0);
+        lv_obj_set_style_border_color(row, lv_palette_lighten(LV_PALETTE_GREY, 2), 0);
+        lv_obj_set_style_bg_color(row, lv_palette_lighten(LV_PALETTE_BLUE, 4), LV_STATE_CHECKED);
+        lv_obj_set_style_bg_opa(row, LV_OPA_COVER, LV_STATE_CHECKED);
+        lv_obj_add_flag(row, LV_OBJ_FLAG_HIDDEN);
+        tl->rows[k] = row;
+        tl->bound[k] = UNBOUND;
+    }
+
+    tl->thumb = lv_obj_create(tl->cont);
+    lv_obj_remove_style_all(tl->thumb);
+    lv_obj_set_width(tl->thumb, THUMB_WIDTH);
+    lv_obj_align(tl->thumb, LV_ALIGN_TOP_RIGHT, -2, 0);
+    lv_obj_set_style_bg_color(tl->thumb, lv_palette_main(LV_PALETTE_GREY), 0);
+    lv_obj_set_style_bg_opa(tl->thumb, LV_OPA_60, 0);
+    lv_obj_set_style_radius(tl->thumb, THUMB_WIDTH / 2, 0);
+    lv_obj_clear_flag(tl->thumb, LV_OBJ_FLAG_CLICKABLE);
+    lv_obj_add_flag(tl->thumb, LV_OBJ_FLAG_HIDDEN);
+
+    tl->fling = lv_timer_create(fling_cb, FLING_PERIOD_MS, tl);
+    lv_timer_pause(tl->fling);
+    return tl;
+}
+
+lv_obj_t *track_list_get_obj(track_list_t *list)
+{
+    return list->cont;
+}
+
+void track_list_set_count(track_list_t *list, uint32_t count)
+{
+    if (count == list->count) {
+        return;
+    }
+    list->count = count;
+    list->offset = clamp_offset(list, list->offset);
+    layout(list);
+}
+
+void track_list_set_current(track_list_t *list, int index)
+{
+    if (index == list->current) {
+        return;
+    }
+    list->current = index;
+    for (int k = 0; k < list->row_count; k++) {
+        if (list->bound[k] != UNBOUND && (int)list->bound[k] == index) {
+            lv_obj_add_state(list->rows[k], LV_STATE_CHECKED);
+        } else {
+            lv_obj_clear_state(list->rows[k], LV_STATE_CHECKED);
+        }
+    }
+}
+
+void track_list_show_index(track_list_t *list, uint32_t index)
+{
+    lv_timer_pause(list->fling);
+    list->velocity = 0;
+    int64_t target = (int64_t)index * TRACK_LIST_ROW_HEIGHT - (list->view_h - TRACK_LIST_ROW_HEIGHT) / 2;
+    list->offset = clamp_offset(list, target);
+    layout(list);
+}
+
+void track_list_reload(track_list_t *list)
+{
+    for (int k = 0; k < list->row_count; k++) {
+        list->bound[k] = UNBOUND;
+    }
+    layout(list);
+}
+
+void track_list_refresh_index(track_list_t *list, uint32_t index)
+{
+    int slot = (int)(index % (uint32_t)list->row_count);
+    if (list->bound[slot] != index) {
+        return;
+    }
+    char text[TRACK_LIST_TEXT_MAX];
+    list->text_fn(index, text, sizeof(text), list->ctx);
+    lv_label_set_text(list->rows[slot], text);
+}
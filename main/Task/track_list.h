@@ -0,0 +1,75 @@
+// main/task/track_list.h
+#ifndef TRACK_LIST_H
+#define TRACK_LIST_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include "lvgl.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define TRACK_LIST_ROW_HEIGHT   40      // 行高 (像素)
+#define TRACK_LIST_MARGIN_ROWS  2       // 可见行之外预先绑定的行数，小幅滚动时不取文字
+#define TRACK_LIST_TEXT_MAX     96      // 每行文字的最大长度，含结束符
+
+/**
+ * @brief 取第 index 条的显示文字，在 LVGL 任务中调用
+ * @note  每次滚动都会调用，只能读内存；文字还没准备好时先给出占位文字，
+ *        准备好后调用 track_list_refresh_index() 更新这一行
+ */
+typedef void (*track_list_text_fn_t)(uint32_t index, char *buf, size_t len, void *ctx);
+
+/**
+ * @brief 点击了第 index 条，在 LVGL 任务中调用
+ */
+typedef void (*track_list_select_fn_t)(uint32_t index, void *ctx);
+
+typedef struct track_list track_list_t;
+
+/**
+ * @brief 创建虚拟列表
+ *
+ * 只创建可见行数加 TRACK_LIST_MARGIN_ROWS 个标签，滚动时按序号回收复用，
+ * 行进入可见范围时才通过 text_fn 取文字。滚动位置自行维护 (不受 16 位坐标限制)，
+ * 所以内存占用和每帧的工作量与条目数无关。
+ *
+ * @note  以下函数都不是线程安全的，调用前必须使用 lvgl_port_lock()
+ * @return NULL 内存不足
+ */
+track_list_t *track_list_create(lv_obj_t *parent, lv_coord_t width, lv_coord_t height,
+                                track_list_text_fn_t text_fn, track_list_select_fn_t select_fn, void *ctx);
+
+lv_obj_t *track_list_get_obj(track_list_t *list);
+
+/**
+ * @brief 更新条目数，已绑定的行保持不变
+ */
+void track_list_set_count(track_list_t *list, uint32_t count);
+
+/**
+ * @brief 高亮正在播放的条目，-1 取消高亮
+ */
+void track_list_set_current(track_list_t *list, int index);
+
+/**
+ * @brief 滚动到让第 index 条位于中间
+ */
+void track_list_show_index(track_list_t *list, uint32_t index);
+
+/**
+ * @brief 所有行重新取文字 (换了播放源或元数据更新后)
+ */
+void track_list_reload(track_list_t *list);
+
+/**
+ * @brief 第 index 条的文字有了变化，该条正绑定在某一行上时重新取文字
+ */
+void track_list_refresh_index(track_list_t *list, uint32_t index);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // TRACK_LIST_H
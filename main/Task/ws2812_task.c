@@ -2,11 +2,13 @@
 #include "freertos/task.h"
 #include "esp_log.h"
 #include "esp_err.h"
+#include "esp_timer.h"
 
 // 引入 BSP 头文件以使用 WS2812 驱动
 #include "esp32_s3_hpy.h"
 // 引入自己的头文件
 #include "ws2812_task.h"
+#include "audio_analysis.h"
 
 static const char *TAG = "WS2812_TASK";
 
@@ -40,6 +42,151 @@ static void hsv_to_rgb(uint16_t h, uint8_t s, uint8_t v, uint8_t *r, uint8_t *g,
     }
 }
 
+/* =========================== 律动灯效引擎 =========================== */
+
+#define WS2812_FRAME_PERIOD_US  (20 * 1000) // 50 FPS，由 esp_timer 驱动
+#define AUDIO_STALE_FRAMES      10          // 超过 200ms 无新音频数据则回到彩虹待机效果
+#define LEVEL_FALL_PER_FRAME    6           // 电平下落速度 (0-255 刻度)
+#define BEAT_FLASH_MAX          255
+
+static TaskHandle_t s_task_handle = NULL;
+static esp_timer_handle_t s_frame_timer = NULL;
+static volatile ws2812_effect_t s_effect = WS2812_EFFECT_VU;
+
+// 帧状态，只在 WS2812 任务中访问
+static uint16_t s_hue = 0;
+static uint32_t s_last_seq = 0;
+static uint32_t s_last_beat = 0;
+static uint32_t s_stale_frames = AUDIO_STALE_FRAMES;
+static uint8_t s_level = 0;
+static uint8_t s_band_level[AUDIO_ANALYSIS_BANDS];
+static uint8_t s_flash = 0;
+
+// 8 位定点乘法：c * v / 255 (近似)
+static inline uint8_t scale8(uint8_t c, uint8_t v)
+{
+    return (uint8_t)(((uint16_t)c * ((uint16_t)v + 1)) >> 8);
+}
+
+static inline uint8_t add_sat8(uint8_t a, uint8_t b)
+{
+    uint16_t s = (uint16_t)a + b;
+    return s > 255 ? 255 : (uint8_t)s;
+}
+
+// 0-65535 线性电平 -> 0-255 亮度，用平方根压缩动态范围，更接近人眼感受
+static uint8_t level_to_brightness(uint16_t level)
+{
+    uint32_t x = level;
+    uint32_t res = 0;
+    uint32_t bit = 1u << 14;
+    while (bit > x) bit >>= 2;
+    while (bit) {
+        if (x >= res + bit) {
+            x -= res + bit;
+            res = (res >> 1) + bit;
+        } else {
+            res >>= 1;
+        }
+        bit >>= 2;
+    }
+    return res > 255 ? 255 : (uint8_t)res;
+}
+
+// 快起慢落：新值更大直接跟随，否则按固定速度回落
+static inline uint8_t follow(uint8_t cur, uint8_t target)
+{
+    if (target >= cur) return target;
+    return cur > target + LEVEL_FALL_PER_FRAME ? cur - LEVEL_FALL_PER_FRAME : target;
+}
+
+static void render_rainbow(void)
+{
+    uint8_t r, g, b;
+    for (int i = 0; i < BSP_WS2812_LED_COUNT; i++) {
+        // 计算当前 LED 的色调，使其产生彩虹带效果
+        uint16_t led_hue = (s_hue + i * 360 / BSP_WS2812_LED_COUNT) % 360;
+        hsv_to_rgb(led_hue, 255, 255, &r, &g, &b);
+        bsp_ws2812_set_pixel(i, r, g, b);
+    }
+}
+
+// 电平表：从中间向两边点亮，颜色随低/高频比例在红-蓝之间变化
+static void render_vu(void)
+{
+    const int half = BSP_WS2812_LED_COUNT / 2;
+    uint32_t lit = (uint32_t)s_level * half;  // 以 1/255 LED 为单位的点亮长度
+
+    uint16_t low = s_band_level[0];
+    uint16_t high = s_band_level[2];
+    uint16_t hue = (uint16_t)(240 * high / (low + high + 1));   // 低频多偏红，高频多偏蓝
+
+    for (int i = 0; i < half; i++) {
+        uint32_t pos = (uint32_t)i * 255;
+        uint8_t v = lit >= pos + 255 ? 255 : (lit > pos ? (uint8_t)(lit - pos) : 0);
+        uint8_t r, g, b;
+        hsv_to_rgb(hue + i * 12, 255, v, &r, &g, &b);
+        r = add_sat8(r, scale8(s_flash, v));
+        g = add_sat8(g, scale8(s_flash, v));
+        b = add_sat8(b, scale8(s_flash, v));
+        bsp_ws2812_set_pixel(half - 1 - i, r, g, b);
+        bsp_ws2812_set_pixel(half + i, r, g, b);
+    }
+}
+
+// 频段灯：三个频段分布在 8 颗灯上，相邻频段之间线性插值
+static void render_bands(void)
+{
+    for (int i = 0; i < BSP_WS2812_LED_COUNT; i++) {
+        // 位置映射到 [0, BANDS-1]，8 位小数
+        uint32_t pos = (uint32_t)i * ((AUDIO_ANALYSIS_BANDS - 1) << 8) / (BSP_WS2812_LED_COUNT - 1);
+        uint32_t idx = pos >> 8;
+        uint8_t frac = pos & 0xFF;
+        uint8_t v0 = s_band_level[idx];
+        uint8_t v1 = s_band_level[idx + 1 < AUDIO_ANALYSIS_BANDS ? idx + 1 : idx];
+        uint8_t v = (uint8_t)((v0 * (256 - frac) + v1 * frac) >> 8);
+
+        uint8_t r, g, b;
+        hsv_to_rgb((s_hue + i * 300 / BSP_WS2812_LED_COUNT) % 360, 255, v, &r, &g, &b);
+        bsp_ws2812_set_pixel(i, add_sat8(r, s_flash >> 2), add_sat8(g, s_flash >> 2), add_sat8(b, s_flash >> 2));
+    }
+}
+
+static void update_audio_state(void)
+{
+    audio_features_t f;
+    audio_analysis_get(&f);
+
+    if (f.seq != s_last_seq) {
+        s_last_seq = f.seq;
+        s_stale_frames = 0;
+        s_level = follow(s_level, level_to_brightness(f.rms));
+        for (int b = 0; b < AUDIO_ANALYSIS_BANDS; b++) {
+            s_band_level[b] = follow(s_band_level[b], level_to_brightness(f.band[b]));
+        }
+    } else {
+        if (s_stale_frames < AUDIO_STALE_FRAMES) s_stale_frames++;
+        s_level = follow(s_level, 0);
+        for (int b = 0; b < AUDIO_ANALYSIS_BANDS; b++) {
+            s_band_level[b] = follow(s_band_level[b], 0);
+        }
+    }
+
+    if (f.beat_count != s_last_beat) {
+        s_last_beat = f.beat_count;
+        s_flash = BEAT_FLASH_MAX;
+    } else {
+        // 指数衰减，s_flash >> 3 在 8 以下为 0，此时直接归零，否则闪光会停在 7
+        s_flash = s_flash > 8 ? s_flash - (s_flash >> 3) : 0;
+    }
+}
+
+static void frame_timer_cb(void *arg)
+{
+    // 只负责唤醒任务，RMT 刷新在任务上下文中完成
+    xTaskNotifyGive(s_task_handle);
+}
+
 /**
  * @brief WS2812 任务入口函数
  *
@@ -47,37 +194,39 @@ static void hsv_to_rgb(uint16_t h, uint8_t s, uint8_t v, uint8_t *r, uint8_t *g,
  */
 static void ws2812_task_entry(void *pvParameters)
 {
-    ESP_LOGI(TAG, "WS2812 任务已启动，开始显示彩虹效果。");
-
-    uint16_t hue = 0; // 色调起始值
-    uint8_t r, g, b;
+    ESP_LOGI(TAG, "WS2812 任务已启动，律动灯效引擎运行中。");
 
-    // 无限循环，实现动态效果
     while (1) {
-        // 循环为每个 LED 设置颜色
-        for (int i = 0; i < BSP_WS2812_LED_COUNT; i++) {
-            // 计算当前 LED 的色调，使其产生彩虹带效果
-            uint16_t led_hue = (hue + i * 360 / BSP_WS2812_LED_COUNT) % 360;
-            // 将 HSV 转换为 RGB
-            hsv_to_rgb(led_hue, 255, 255, &r, &g, &b);
-            // 设置像素颜色
-            bsp_ws2812_set_pixel(i, r, g, b);
+        // 等待 esp_timer 的帧节拍
+        ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+
+        update_audio_state();
+
+        ws2812_effect_t effect = s_effect;
+        if (s_stale_frames >= AUDIO_STALE_FRAMES || effect == WS2812_EFFECT_RAINBOW) {
+            render_rainbow();
+        } else if (effect == WS2812_EFFECT_BANDS) {
+            render_bands();
+        } else {
+            render_vu();
         }
 
         // 刷新灯带以显示颜色
         bsp_ws2812_refresh();
 
         // 增加起始色调，使彩虹流动起来
-        hue++;
-        if (hue >= 360) {
-            hue = 0;
+        s_hue++;
+        if (s_hue >= 360) {
+            s_hue = 0;
         }
-
-        // 延时 20 毫秒，控制动画速度，并让出 CPU 给其他任务
-        vTaskDelay(pdMS_TO_TICKS(20));
     }
 }
 
+void ws2812_task_set_effect(ws2812_effect_t effect)
+{
+    s_effect = effect;
+}
+
 /**
  * @brief 创建并启动 WS2812 任务
  */
@@ -89,14 +238,28 @@ esp_err_t ws2812_task_create(void)
         2048,                   // 任务栈大小 (bytes)
         NULL,                   // 任务参数
         5,                      // 任务优先级
-        NULL                    // 任务句柄 (不需要)
+        &s_task_handle          // 任务句柄 (供帧定时器唤醒)
     );
 
     if (ret != pdPASS) {
         ESP_LOGE(TAG, "创建 WS2812 任务失败");
         return ESP_FAIL;
     }
-    
+
+    const esp_timer_create_args_t timer_args = {
+        .callback = frame_timer_cb,
+        .name = "ws2812_frame",
+        .skip_unhandled_events = true,
+    };
+    esp_err_t err = esp_timer_create(&timer_args, &s_frame_timer);
+    if (err == ESP_OK) {
+        err = esp_timer_start_periodic(s_frame_timer, WS2812_FRAME_PERIOD_US);
+    }
+    if (err != ESP_OK) {
+        ESP_LOGE(TAG, "创建 WS2812 帧定时器失败: %s", esp_err_to_name(err));
+        return err;
+    }
+
     return ESP_OK;
 }
 
@@ -7,6 +7,12 @@
 extern "C" {
 #endif
 
+typedef enum {
+    WS2812_EFFECT_RAINBOW,  // 流动彩虹，不随音乐变化
+    WS2812_EFFECT_VU,       // 电平表，节拍时闪白
+    WS2812_EFFECT_BANDS,    // 低/中/高频段分布在灯带上
+} ws2812_effect_t;
+
 /**
  * @brief 创建并启动 WS2812 彩灯效果任务
  *
@@ -16,6 +22,12 @@ extern "C" {
  */
 esp_err_t ws2812_task_create(void);
 
+/**
+ * @brief 切换灯效
+ * @note  播放停止 200ms 后自动显示彩虹待机效果，恢复播放后回到所选灯效
+ */
+void ws2812_task_set_effect(ws2812_effect_t effect);
+
 #ifdef __cplusplus
 }
 #endif
@@ -12,6 +12,7 @@
 
 // SD 卡相关头文件
 #include "esp_vfs_fat.h"
+#include "diskio_sdmmc.h"
 #include "driver/sdmmc_host.h"
 
 // WS2812 相关头文件
@@ -32,6 +33,7 @@ esp_lcd_panel_io_handle_t g_io_handle = NULL;
 esp_lcd_touch_handle_t g_tp_handle = NULL;
 
 static sdmmc_card_t *g_sd_card = NULL;
+static char g_sd_fatfs_drive[3] = "0:";
 static led_strip_handle_t g_led_strip = NULL;
 static i2s_chan_handle_t g_i2s_tx_handle = NULL;
 static es8311_handle_t g_es8311_handle = NULL;
@@ -153,7 +155,7 @@ esp_err_t bsp_sdcard_init(sdmmc_card_t **card)
 {
     ESP_LOGI(TAG, "正在初始化 SD 卡");
     esp_vfs_fat_sdmmc_mount_config_t mount_config = {
-        .format_if_mount_failed = true,
+        .format_if_mount_failed = false,
         .max_files = 5,
         .allocation_unit_size = 16 * 1024
     };
@@ -174,6 +176,7 @@ esp_err_t bsp_sdcard_init(sdmmc_card_t **card)
     }
 
     ESP_LOGI(TAG, "SD卡成功挂载于 %s", BSP_SD_MOUNT_POINT);
+    g_sd_fatfs_drive[0] = (char)('0' + ff_diskio_get_pdrv_card(g_sd_card));
     if (card) {
         *card = g_sd_card;
     }
@@ -197,6 +200,21 @@ esp_err_t bsp_sdcard_deinit(void)
     return ESP_OK;
 }
 
+bool bsp_sdcard_is_present(void)
+{
+    return g_sd_card && sdmmc_get_status(g_sd_card) == ESP_OK;
+}
+
+uint32_t bsp_sdcard_serial(void)
+{
+    return g_sd_card ? (uint32_t)g_sd_card->cid.serial : 0;
+}
+
+const char *bsp_sdcard_fatfs_drive(void)
+{
+    return g_sd_fatfs_drive;
+}
+
 /*******************************************************************************
  ******************************** WS2812 彩灯 ********************************
  *******************************************************************************/
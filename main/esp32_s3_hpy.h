@@ -2,6 +2,7 @@
 #define ESP32_S3_HPY_H
 
 #include <stdint.h>
+#include <stdbool.h>
 #include "esp_err.h"
 #include "esp_lcd_panel_ops.h"
 #include "esp_lcd_touch.h"
@@ -82,9 +83,30 @@ esp_err_t bsp_lvgl_init(void);
 #define BSP_SD_CMD              (GPIO_NUM_4)
 #define BSP_SD_D0               (GPIO_NUM_6)
 
+/**
+ * @brief 挂载 SD 卡，可在卸载后再次调用以重新挂载
+ * @note  挂载失败时不会格式化，避免接触不良或拔卡过程中误清空卡上的数据
+ */
 esp_err_t bsp_sdcard_init(sdmmc_card_t **card);
 esp_err_t bsp_sdcard_deinit(void);
 
+/**
+ * @brief 通过 CMD13 (SEND_STATUS) 查询卡是否仍然在位并响应
+ * @note  板上没有卡检测引脚，拔卡只能靠命令线探测；未挂载时返回 false
+ */
+bool bsp_sdcard_is_present(void);
+
+/**
+ * @brief 卡的 CID 中的产品序列号，用于判断重新插入的是否为同一张卡；未挂载时返回 0
+ */
+uint32_t bsp_sdcard_serial(void);
+
+/**
+ * @brief 获取 SD 卡对应的 FatFs 逻辑驱动器前缀 (如 "0:")
+ * @note  用于绕过 VFS 直接调用 f_opendir/f_readdir 等 FatFs 接口
+ */
+const char *bsp_sdcard_fatfs_drive(void);
+
 
 /*******************************************************************************
  ******************************** WS2812 彩灯 ********************************
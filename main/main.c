@@ -4,31 +4,68 @@
 #include "freertos/task.h"
 #include "esp_log.h"
 #include "esp_err.h"
+#include "nvs_flash.h"
 
 #include "ws2812_task.h"
 #include "esp32_s3_hpy.h"
 #include "mp3_task.h"
+#include "boot_init.h"
 
 static const char *TAG = "MAIN_APP";
 
-void app_main(void)
+// 启动快照保存在 NVS 中，分区版本变化或写满时擦除重建
+static esp_err_t nvs_init(void)
+{
+    esp_err_t ret = nvs_flash_init();
+    if (ret == ESP_ERR_NVS_NO_FREE_PAGES || ret == ESP_ERR_NVS_NEW_VERSION_FOUND) {
+        ESP_ERROR_CHECK(nvs_flash_erase());
+        ret = nvs_flash_init();
+    }
+    return ret;
+}
+
+// 没有卡时由插拔检测任务继续尝试
+static esp_err_t sdcard_init(void)
 {
-    ESP_LOGI(TAG, "===== 启动 BSP 硬件初始化 =====");
-    ESP_ERROR_CHECK(bsp_display_init());
-    ESP_ERROR_CHECK(bsp_touch_init());
-    ESP_ERROR_CHECK(bsp_sdcard_init(NULL));
-    ESP_ERROR_CHECK(bsp_audio_init());
-    ESP_ERROR_CHECK(bsp_ws2812_init());
+    return bsp_sdcard_init(NULL);
+}
 
-    ESP_LOGI(TAG, "===== 初始化 LVGL =====");
-    ESP_ERROR_CHECK(bsp_lvgl_init());
+enum {
+    STEP_NVS,
+    STEP_DISPLAY,
+    STEP_TOUCH,
+    STEP_SDCARD,
+    STEP_AUDIO,
+    STEP_WS2812,
+    STEP_LVGL,
+    STEP_UI,
+    STEP_PLAYER,
+    STEP_LEDS,
+};
 
-    ESP_LOGI(TAG, "===== 启动 MP3 播放器 =====");
-    ESP_ERROR_CHECK(mp3_player_init());
-    
-    ESP_LOGI(TAG, "正在启用WS2812灯带特效...");
-    ESP_ERROR_CHECK(ws2812_task_create());
+/*
+ * 各外设互不相关，按依赖并行初始化。显示链路放在核 0，与 LVGL 和
+ * 播放任务同核；SD 卡握手、ES8311 和触摸的 I2C 探测大部分时间在等待，放在核 1。
+ */
+static const boot_init_step_t s_boot_steps[] = {
+    [STEP_NVS]     = { "nvs",     nvs_init,             0, 0 },
+    [STEP_DISPLAY] = { "display", bsp_display_init,     0, 0 },
+    [STEP_TOUCH]   = { "touch",   bsp_touch_init,       0, 1 },
+    [STEP_SDCARD]  = { "sdcard",  sdcard_init,          0, 1, .optional = true },
+    [STEP_AUDIO]   = { "audio",   bsp_audio_init,       0, 1 },
+    [STEP_WS2812]  = { "ws2812",  bsp_ws2812_init,      0, 1 },
+    [STEP_LVGL]    = { "lvgl",    bsp_lvgl_init,        BOOT_INIT_DEP(STEP_DISPLAY) | BOOT_INIT_DEP(STEP_TOUCH), 0 },
+    // 先显示上次的界面，不等 SD 卡和音频
+    [STEP_UI]      = { "ui",      mp3_player_ui_init,   BOOT_INIT_DEP(STEP_LVGL) | BOOT_INIT_DEP(STEP_NVS), 0 },
+    [STEP_PLAYER]  = { "player",  mp3_player_init,
+                       BOOT_INIT_DEP(STEP_UI) | BOOT_INIT_DEP(STEP_AUDIO) | BOOT_INIT_DEP(STEP_SDCARD), BOOT_INIT_ANY_CORE },
+    [STEP_LEDS]    = { "leds",    ws2812_task_create,
+                       BOOT_INIT_DEP(STEP_WS2812) | BOOT_INIT_DEP(STEP_PLAYER), BOOT_INIT_ANY_CORE },
+};
 
+void app_main(void)
+{
+    ESP_LOGI(TAG, "===== 启动硬件初始化 =====");
+    ESP_ERROR_CHECK(boot_init_run(s_boot_steps, sizeof(s_boot_steps) / sizeof(s_boot_steps[0])));
     ESP_LOGI(TAG, "===== 初始化完成 =====");
 }
-
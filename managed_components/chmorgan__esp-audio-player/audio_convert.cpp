@@ -0,0 +1,86 @@
+#include "sdkconfig.h"
+#include "audio_convert.h"
+
+using namespace audio_convert;
+
+#if defined(CONFIG_AUDIO_PLAYER_DOWNMIX_TO_MONO)
+static const bool downmix = true;
+#else
+static const bool downmix = false;
+#endif
+
+/** Output sample type for a source, int16_t unless the source has more than 16 bits */
+template<typename In> struct output_type { typedef int16_t type; };
+template<> struct output_type<pcm_s24> { typedef int32_t type; };
+template<> struct output_type<pcm_s32> { typedef int32_t type; };
+
+template<typename In>
+static audio_convert_fn select_channels(uint32_t channels)
+{
+    typedef typename output_type<In>::type Out;
+
+    switch(channels) {
+        case 1:
+            return convert<In, Out, 1, downmix>;
+        case 2:
+            return convert<In, Out, 2, downmix>;
+        default:
+            return convert<In, Out, 0, downmix>;
+    }
+}
+
+bool audio_convert_supported(const format &fmt)
+{
+    if(fmt.channels == 0) {
+        return false;
+    }
+    if(fmt.sample_format == SAMPLE_FORMAT_FLOAT) {
+        return fmt.bits_per_sample == 32;
+    }
+    switch(fmt.bits_per_sample) {
+        case 8:
+        case 16:
+        case 24:
+        case 32:
+            return true;
+        default:
+            return false;
+    }
+}
+
+size_t audio_convert_output_frame_bytes(const format &fmt)
+{
+    bool wide = fmt.sample_format == SAMPLE_FORMAT_INT && fmt.bits_per_sample > 16;
+    return 2 * (wide ? sizeof(int32_t) : sizeof(int16_t));
+}
+
+audio_convert_fn audio_convert_select(const format &fmt)
+{
+    if(!audio_convert_supported(fmt)) {
+        return NULL;
+    }
+
+    if(fmt.sample_format == SAMPLE_FORMAT_FLOAT) {
+        return select_channels<pcm_f32>(fmt.channels);
+    }
+
+    switch(fmt.bits_per_sample) {
+        case 8:
+            return select_channels<pcm_u8>(fmt.channels);
+        case 16:
+            // already what the i2s driver takes
+            if(fmt.channels == 2 && !downmix) {
+                return NULL;
+            }
+            return select_channels<pcm_s16>(fmt.channels);
+        case 24:
+            return select_channels<pcm_s24>(fmt.channels);
+        case 32:
+            if(fmt.channels == 2 && !downmix) {
+                return NULL;
+            }
+            return select_channels<pcm_s32>(fmt.channels);
+        default:
+            return NULL;
+    }
+}
@@ -0,0 +1,175 @@
+#pragma once
+
+#include <string.h>
+#include "audio_decode_types.h"
+
+/**
+ * Sample format conversion from decoder output to what the i2s driver is fed.
+ *
+ * The output is always two channels (the es8311 expects stereo frames even
+ * for its mono output) of int16_t, or of int32_t for sources with more than
+ * 16 bits. Each input layout is a separate template instantiation, picked by
+ * audio_convert_select() when the decoder format changes, so the per sample
+ * loop has no format branches.
+ *
+ * All conversions are in place in decode_data::samples. Frames grow from the
+ * back and shrink from the front so no input is overwritten before it is read.
+ */
+
+typedef struct {
+    uint32_t dither_seed;       /*!< TPDF dither LCG state */
+    uint32_t channels;          /*!< input channels for the generic channel count kernels */
+} audio_convert_state;
+
+/**
+ * @brief Convert pData->samples in place and update pData->fmt to the output format
+ *
+ * frame_count is unchanged.
+ */
+typedef void (*audio_convert_fn)(decode_data *pData, audio_convert_state *pState);
+
+/**
+ * @return the kernel for 'fmt', NULL if the samples can be written as they
+ *         are, or if the format isn't supported (check with audio_convert_supported())
+ */
+audio_convert_fn audio_convert_select(const format &fmt);
+
+bool audio_convert_supported(const format &fmt);
+
+/** Bytes per output frame after conversion of 'fmt' */
+size_t audio_convert_output_frame_bytes(const format &fmt);
+
+namespace audio_convert {
+
+/* **************** SAMPLE LOADERS **************** */
+
+// Loaders return the sample left justified in 32 bits so every input
+// shares one intermediate, the shifts fold away once a loader is paired
+// with an output type.
+
+struct pcm_u8 {
+    static const size_t bytes = 1;
+    static inline int32_t load(const uint8_t *p, uint32_t &) {
+        return (int32_t)((uint32_t)(p[0] ^ 0x80) << 24);
+    }
+};
+
+struct pcm_s16 {
+    static const size_t bytes = 2;
+    static inline int32_t load(const uint8_t *p, uint32_t &) {
+        int16_t v;
+        memcpy(&v, p, sizeof(v));
+        return (int32_t)((uint32_t)(uint16_t)v << 16);
+    }
+};
+
+struct pcm_s24 {
+    static const size_t bytes = 3;
+    static inline int32_t load(const uint8_t *p, uint32_t &) {
+        return (int32_t)(((uint32_t)p[0] << 8) | ((uint32_t)p[1] << 16) | ((uint32_t)p[2] << 24));
+    }
+};
+
+struct pcm_s32 {
+    static const size_t bytes = 4;
+    static inline int32_t load(const uint8_t *p, uint32_t &) {
+        int32_t v;
+        memcpy(&v, p, sizeof(v));
+        return v;
+    }
+};
+
+/**
+ * IEEE float, quantized to 16 bits with triangular (TPDF) dither: the sum
+ * of two uniform values of +-0.5 LSB each, which decorrelates the
+ * quantization error from the signal instead of leaving it as distortion.
+ */
+struct pcm_f32 {
+    static const size_t bytes = 4;
+    static inline int32_t load(const uint8_t *p, uint32_t &seed) {
+        float f;
+        memcpy(&f, p, sizeof(f));
+
+        // two LCG steps, the high half of each is a uniform 16 bit value
+        seed = seed * 1664525u + 1013904223u;
+        int32_t r1 = (int32_t)(seed >> 16) & 0xFFFF;
+        seed = seed * 1664525u + 1013904223u;
+        int32_t r2 = (int32_t)(seed >> 16) & 0xFFFF;
+        float dither = (float)(r1 + r2 - 0xFFFF) * (1.0f / 65536.0f);
+
+        float v = f * 32768.0f + dither;
+        if(v >= 32767.0f) return (int32_t)32767 << 16;
+        if(v <= -32768.0f) return (int32_t)-32768 * 65536;
+        int32_t i = (int32_t)(v < 0 ? v - 0.5f : v + 0.5f);
+        return i * 65536;
+    }
+};
+
+template<typename Out> static inline void store(uint8_t *p, int32_t v);
+
+template<> inline void store<int16_t>(uint8_t *p, int32_t v) {
+    int16_t s = (int16_t)(v >> 16);
+    memcpy(p, &s, sizeof(s));
+}
+
+template<> inline void store<int32_t>(uint8_t *p, int32_t v) {
+    memcpy(p, &v, sizeof(v));
+}
+
+/* **************** KERNELS **************** */
+
+/**
+ * Convert 'frames' frames of InCh channels of In into stereo Out.
+ *
+ * InCh == 0 takes the channel count from the state, for files with more
+ * than two channels, of which the first two (front left/right) are kept.
+ * Downmix writes (L + R) / 2 to both channels so a mono speaker plays both.
+ */
+template<typename In, typename Out, unsigned InCh, bool Downmix>
+static void convert_frames(uint8_t *buf, size_t frames, audio_convert_state *pState)
+{
+    const size_t in_ch = InCh ? InCh : pState->channels;
+    const size_t in_frame = In::bytes * in_ch;
+    const size_t out_frame = sizeof(Out) * 2;
+    uint32_t seed = pState->dither_seed;
+
+    if(frames == 0) {
+        return;
+    }
+
+    // growing frames are converted from the back, shrinking from the front
+    const bool backwards = out_frame > in_frame;
+    const uint8_t *in = buf + (backwards ? (frames - 1) * in_frame : 0);
+    uint8_t *out = buf + (backwards ? (frames - 1) * out_frame : 0);
+    const ptrdiff_t in_step = backwards ? -(ptrdiff_t)in_frame : (ptrdiff_t)in_frame;
+    const ptrdiff_t out_step = backwards ? -(ptrdiff_t)out_frame : (ptrdiff_t)out_frame;
+
+    for(size_t n = frames; n; n--) {
+        int32_t l = In::load(in, seed);
+        int32_t r = (in_ch == 1) ? l : In::load(in + In::bytes, seed);
+
+        if(Downmix && in_ch > 1) {
+            l = (l >> 1) + (r >> 1);
+            r = l;
+        }
+
+        store<Out>(out, l);
+        store<Out>(out + sizeof(Out), r);
+
+        in += in_step;
+        out += out_step;
+    }
+
+    pState->dither_seed = seed;
+}
+
+template<typename In, typename Out, unsigned InCh, bool Downmix>
+static void convert(decode_data *pData, audio_convert_state *pState)
+{
+    convert_frames<In, Out, InCh, Downmix>(pData->samples, pData->frame_count, pState);
+    pData->fmt.bits_per_sample = sizeof(Out) * BITS_PER_BYTE;
+    pData->fmt.channels = 2;
+    pData->fmt.sample_format = SAMPLE_FORMAT_INT;
+}
+
+} // namespace audio_convert
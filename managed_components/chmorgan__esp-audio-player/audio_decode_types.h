@@ -10,10 +10,16 @@ typedef enum {
     DECODE_STATUS_ERROR             /*< unrecoverable error */
 } DECODE_STATUS;
 
+typedef enum {
+    SAMPLE_FORMAT_INT,              /*< signed integer, unsigned for 8 bit */
+    SAMPLE_FORMAT_FLOAT             /*< IEEE float */
+} SAMPLE_FORMAT;
+
 typedef struct {
     int sample_rate;
     uint32_t bits_per_sample;
     uint32_t channels;
+    SAMPLE_FORMAT sample_format;
 } format;
 
 /**
@@ -0,0 +1,690 @@
+#include <string.h>
+#include <stdlib.h>
+#include "audio_flac.h"
+
+static const char *TAG = "flac";
+
+#define FLAC_READ_BUF_SIZE          4096
+#define FLAC_METADATA_STREAMINFO    0
+#define FLAC_METADATA_SEEKTABLE     3
+#define FLAC_SEEKPOINT_PLACEHOLDER  0xFFFFFFFFFFFFFFFFULL
+
+typedef enum {
+    FRAME_OK,
+    FRAME_INVALID,      /*!< corrupt frame, caller may resync */
+    FRAME_EOF,
+} frame_status;
+
+/* **************** BIT READER **************** */
+
+static void br_reset(flac_bitreader *br, audio_source_t *src)
+{
+    br->src = src;
+    br->data = NULL;
+    br->len = 0;
+    br->pos = 0;
+    br->cache = 0;
+    br->cache_bits = 0;
+    br->eof = false;
+}
+
+/**
+ * Make sure at least 'need' (<= 57) bits are in the cache, loading whole
+ * bytes from the read buffer and refilling it from the file as required.
+ */
+static inline bool br_fill(flac_bitreader *br, int need)
+{
+    while(br->cache_bits < need) {
+        if(br->pos >= br->len) {
+            // memory backed sources are parsed in place, the rest of the stream at once
+            br->data = audio_source_peek(br->src, &br->len);
+            if(br->data) {
+                audio_source_seek(br->src, (long)br->len, SEEK_CUR);
+            } else {
+                br->len = audio_source_read(br->src, br->buf, br->buf_size);
+                br->data = br->buf;
+            }
+            br->pos = 0;
+            if(br->len == 0) {
+                br->eof = true;
+                return false;
+            }
+        }
+        while(br->cache_bits <= 56 && br->pos < br->len) {
+            br->cache = (br->cache << 8) | br->data[br->pos++];
+            br->cache_bits += 8;
+        }
+    }
+    return true;
+}
+
+static inline uint32_t br_read(flac_bitreader *br, int n)
+{
+    if(n == 0) return 0;
+    if(!br_fill(br, n)) return 0;
+    br->cache_bits -= n;
+    return (uint32_t)(br->cache >> br->cache_bits) & (uint32_t)((1ULL << n) - 1);
+}
+
+static inline int32_t br_read_signed(flac_bitreader *br, int n)
+{
+    if(n == 0) return 0;
+    uint32_t v = br_read(br, n);
+    return (int32_t)(v << (32 - n)) >> (32 - n);
+}
+
+/** count zero bits up to the next 1 bit, consuming both */
+static inline uint32_t br_read_unary(flac_bitreader *br)
+{
+    uint32_t zeros = 0;
+    while(true) {
+        if(br->cache_bits == 0 && !br_fill(br, 1)) {
+            return zeros;
+        }
+        uint64_t window = br->cache << (64 - br->cache_bits);
+        if(window == 0) {
+            zeros += br->cache_bits;
+            br->cache_bits = 0;
+            continue;
+        }
+        int lz = __builtin_clzll(window);
+        zeros += lz;
+        br->cache_bits -= lz + 1;
+        return zeros;
+    }
+}
+
+static inline void br_align(flac_bitreader *br)
+{
+    br->cache_bits -= br->cache_bits % 8;
+}
+
+/* **************** METADATA **************** */
+
+static uint32_t be_read(const uint8_t *p, int bytes)
+{
+    uint32_t v = 0;
+    for(int i = 0; i < bytes; i++) {
+        v = (v << 8) | p[i];
+    }
+    return v;
+}
+
+static uint64_t be_read64(const uint8_t *p)
+{
+    return ((uint64_t)be_read(p, 4) << 32) | be_read(p + 4, 4);
+}
+
+static bool parse_streaminfo(audio_source_t *src, flac_instance *pInstance)
+{
+    uint8_t si[34];
+    if(audio_source_read(src, si, sizeof(si)) != sizeof(si)) {
+        return false;
+    }
+
+    pInstance->max_blocksize = be_read(si + 2, 2);
+    pInstance->sample_rate = be_read(si + 10, 3) >> 4;
+    pInstance->channels = ((si[12] >> 1) & 0x07) + 1;
+    pInstance->bits_per_sample = (((si[12] & 0x01) << 4) | (si[13] >> 4)) + 1;
+    pInstance->total_samples = ((uint64_t)(si[13] & 0x0F) << 32) | be_read(si + 14, 4);
+
+    return true;
+}
+
+static bool parse_seektable(audio_source_t *src, flac_instance *pInstance, uint32_t length)
+{
+    size_t count = length / 18;
+
+    // keep every 'step'th point so a large table still fits the fixed array
+    size_t step = (count + FLAC_MAX_SEEKPOINTS - 1) / FLAC_MAX_SEEKPOINTS;
+    if(step == 0) step = 1;
+
+    pInstance->seekpoint_count = 0;
+    for(size_t i = 0; i < count; i++) {
+        uint8_t point[18];
+        if(audio_source_read(src, point, sizeof(point)) != sizeof(point)) {
+            return false;
+        }
+
+        uint64_t sample = be_read64(point);
+        if((i % step) != 0 || sample == FLAC_SEEKPOINT_PLACEHOLDER ||
+            pInstance->seekpoint_count >= FLAC_MAX_SEEKPOINTS) {
+            continue;
+        }
+
+        flac_seekpoint_t *sp = &pInstance->seekpoints[pInstance->seekpoint_count++];
+        sp->sample = sample;
+        sp->offset = be_read64(point + 8);
+    }
+
+    // skip any trailing bytes that don't form a whole seek point
+    audio_source_seek(src, length - count * 18, SEEK_CUR);
+    return true;
+}
+
+/**
+ * @param src
+ * @param pInstance - Values can be considered valid if true is returned
+ * @return true if file is a flac file that this decoder can play,
+ *         file is left positioned at the first frame
+ */
+bool is_flac(audio_source_t *src, flac_instance *pInstance) {
+    audio_source_seek(src, 0, SEEK_SET);
+
+    uint8_t magic[4];
+    if(audio_source_read(src, magic, sizeof(magic)) != sizeof(magic)) {
+        return false;
+    }
+
+    // some taggers prepend an ID3v2 tag, skip it
+    if(memcmp(magic, "ID3", 3) == 0) {
+        uint8_t id3[6];
+        if(audio_source_read(src, id3, sizeof(id3)) != sizeof(id3)) {
+            return false;
+        }
+        uint32_t size = ((id3[2] & 0x7F) << 21) | ((id3[3] & 0x7F) << 14) |
+                        ((id3[4] & 0x7F) << 7) | (id3[5] & 0x7F);
+        if(id3[1] & 0x10) {
+            size += 10;     // footer present
+        }
+        audio_source_seek(src, size, SEEK_CUR);
+        if(audio_source_read(src, magic, sizeof(magic)) != sizeof(magic)) {
+            return false;
+        }
+    }
+
+    if(memcmp(magic, "fLaC", 4) != 0) {
+        return false;
+    }
+
+    bool have_streaminfo = false;
+    pInstance->seekpoint_count = 0;
+
+    bool last = false;
+    while(!last) {
+        uint8_t header[4];
+        if(audio_source_read(src, header, sizeof(header)) != sizeof(header)) {
+            return false;
+        }
+        last = (header[0] & 0x80) != 0;
+        uint8_t type = header[0] & 0x7F;
+        uint32_t length = be_read(header + 1, 3);
+
+        if(type == FLAC_METADATA_STREAMINFO && length >= 34) {
+            if(!parse_streaminfo(src, pInstance)) return false;
+            audio_source_seek(src, length - 34, SEEK_CUR);
+            have_streaminfo = true;
+        } else if(type == FLAC_METADATA_SEEKTABLE) {
+            if(!parse_seektable(src, pInstance, length)) return false;
+        } else {
+            // VORBIS_COMMENT, PICTURE, PADDING... are not needed for playback
+            audio_source_seek(src, length, SEEK_CUR);
+        }
+    }
+
+    if(!have_streaminfo) {
+        ESP_LOGE(TAG, "missing STREAMINFO");
+        return false;
+    }
+
+    if(pInstance->channels > FLAC_MAX_CHANNELS ||
+       pInstance->bits_per_sample < 4 || pInstance->bits_per_sample > 24 ||
+       pInstance->max_blocksize < 16 || pInstance->max_blocksize > FLAC_MAX_BLOCKSIZE) {
+        ESP_LOGE(TAG, "unsupported stream: ch %d, bps %d, blocksize %d",
+            pInstance->channels, pInstance->bits_per_sample, pInstance->max_blocksize);
+        return false;
+    }
+
+    // grow-only buffers sized by the stream's largest block
+    if(pInstance->channel_capacity < pInstance->max_blocksize) {
+        for(int ch = 0; ch < FLAC_MAX_CHANNELS; ch++) {
+            free(pInstance->channel_data[ch]);
+            pInstance->channel_data[ch] = static_cast<int32_t*>(malloc(pInstance->max_blocksize * sizeof(int32_t)));
+            if(!pInstance->channel_data[ch]) {
+                ESP_LOGE(TAG, "no memory for %d sample block", pInstance->max_blocksize);
+                pInstance->channel_capacity = 0;
+                return false;
+            }
+        }
+        pInstance->channel_capacity = pInstance->max_blocksize;
+    }
+
+    size_t span_len;
+    if(!pInstance->br.buf && !audio_source_peek(src, &span_len)) {
+        pInstance->br.buf = static_cast<uint8_t*>(malloc(FLAC_READ_BUF_SIZE));
+        if(!pInstance->br.buf) return false;
+        pInstance->br.buf_size = FLAC_READ_BUF_SIZE;
+    }
+
+    pInstance->first_frame_offset = audio_source_tell(src);
+    br_reset(&pInstance->br, src);
+    pInstance->block_size = 0;
+    pInstance->block_pos = 0;
+    pInstance->block_first_sample = 0;
+    pInstance->skip_to_sample = 0;
+
+    LOGI_2("sample_rate=%d, channels=%d, bps=%d, max_blocksize=%d, seekpoints=%d",
+            pInstance->sample_rate, pInstance->channels, pInstance->bits_per_sample,
+            pInstance->max_blocksize, pInstance->seekpoint_count);
+
+    return true;
+}
+
+void flac_instance_free(flac_instance *pInstance)
+{
+    for(int ch = 0; ch < FLAC_MAX_CHANNELS; ch++) {
+        free(pInstance->channel_data[ch]);
+        pInstance->channel_data[ch] = NULL;
+    }
+    pInstance->channel_capacity = 0;
+    free(pInstance->br.buf);
+    pInstance->br.buf = NULL;
+}
+
+/* **************** SUBFRAMES **************** */
+
+static bool decode_residual(flac_bitreader *br, uint32_t block_size, uint32_t order, int32_t *out)
+{
+    uint32_t method = br_read(br, 2);
+    if(method > 1) return false;
+
+    int param_bits = (method == 0) ? 4 : 5;
+    uint32_t escape = (method == 0) ? 15 : 31;
+    uint32_t partition_order = br_read(br, 4);
+    uint32_t partitions = 1u << partition_order;
+    uint32_t partition_samples = block_size >> partition_order;
+
+    if((partition_samples << partition_order) != block_size || partition_samples < order) {
+        return false;
+    }
+
+    // residuals go straight into the output array, prediction is a separate pass
+    int32_t *dst = out + order;
+    for(uint32_t p = 0; p < partitions; p++) {
+        uint32_t n = (p == 0) ? partition_samples - order : partition_samples;
+        uint32_t param = br_read(br, param_bits);
+
+        if(param == escape) {
+            int bits = (int)br_read(br, 5);
+            for(uint32_t i = 0; i < n; i++) {
+                dst[i] = br_read_signed(br, bits);
+            }
+        } else {
+            for(uint32_t i = 0; i < n; i++) {
+                uint32_t q = br_read_unary(br);
+                uint32_t u = (q << param) | br_read(br, param);
+                dst[i] = (int32_t)(u >> 1) ^ -(int32_t)(u & 1);
+            }
+        }
+        dst += n;
+    }
+
+    return !br->eof;
+}
+
+static void restore_fixed(int32_t *s, uint32_t n, uint32_t order)
+{
+    switch(order) {
+        case 1:
+            for(uint32_t i = 1; i < n; i++) s[i] += s[i - 1];
+            break;
+        case 2:
+            for(uint32_t i = 2; i < n; i++) s[i] += 2 * s[i - 1] - s[i - 2];
+            break;
+        case 3:
+            for(uint32_t i = 3; i < n; i++) s[i] += 3 * (s[i - 1] - s[i - 2]) + s[i - 3];
+            break;
+        case 4:
+            for(uint32_t i = 4; i < n; i++) s[i] += 4 * (s[i - 1] + s[i - 3]) - 6 * s[i - 2] - s[i - 4];
+            break;
+        default:
+            break;
+    }
+}
+
+/**
+ * 'rcoef' holds the coefficients in reverse order so the inner loop walks
+ * the history forwards over contiguous memory.
+ */
+static void restore_lpc(int32_t *s, uint32_t n, const int32_t *rcoef, uint32_t order, int shift, bool wide)
+{
+    if(!wide) {
+        for(uint32_t i = order; i < n; i++) {
+            const int32_t *hist = s + i - order;
+            int32_t sum = 0;
+            for(uint32_t j = 0; j < order; j++) {
+                sum += rcoef[j] * hist[j];
+            }
+            s[i] += sum >> shift;
+        }
+    } else {
+        for(uint32_t i = order; i < n; i++) {
+            const int32_t *hist = s + i - order;
+            int64_t sum = 0;
+            for(uint32_t j = 0; j < order; j++) {
+                sum += (int64_t)rcoef[j] * hist[j];
+            }
+            s[i] += (int32_t)(sum >> shift);
+        }
+    }
+}
+
+static bool decode_subframe(flac_bitreader *br, int bps, uint32_t block_size, int32_t *out)
+{
+    if(br_read(br, 1) != 0) return false;
+
+    uint32_t type = br_read(br, 6);
+    uint32_t wasted = 0;
+    if(br_read(br, 1)) {
+        wasted = br_read_unary(br) + 1;
+        if((int)wasted >= bps) return false;
+        bps -= wasted;
+    }
+
+    if(type == 0) {                             // CONSTANT
+        int32_t v = br_read_signed(br, bps);
+        for(uint32_t i = 0; i < block_size; i++) out[i] = v;
+    } else if(type == 1) {                      // VERBATIM
+        for(uint32_t i = 0; i < block_size; i++) out[i] = br_read_signed(br, bps);
+    } else if(type >= 8 && type <= 12) {        // FIXED
+        uint32_t order = type - 8;
+        if(order > block_size) return false;
+        for(uint32_t i = 0; i < order; i++) out[i] = br_read_signed(br, bps);
+        if(!decode_residual(br, block_size, order, out)) return false;
+        restore_fixed(out, block_size, order);
+    } else if(type >= 32) {                     // LPC
+        uint32_t order = type - 31;
+        if(order > block_size) return false;
+        for(uint32_t i = 0; i < order; i++) out[i] = br_read_signed(br, bps);
+
+        uint32_t precision = br_read(br, 4) + 1;
+        int shift = br_read_signed(br, 5);
+        if(precision == 16 || shift < 0) return false;
+
+        int32_t rcoef[FLAC_MAX_LPC_ORDER];
+        for(uint32_t j = 0; j < order; j++) {
+            rcoef[order - 1 - j] = br_read_signed(br, precision);
+        }
+        if(!decode_residual(br, block_size, order, out)) return false;
+
+        // stay in 32 bits unless the worst case sum could overflow
+        uint32_t order_bits = 32 - __builtin_clz(order);
+        bool wide = (bps + precision + order_bits) > 32;
+        restore_lpc(out, block_size, rcoef, order, shift, wide);
+    } else {
+        return false;
+    }
+
+    if(wasted) {
+        for(uint32_t i = 0; i < block_size; i++) out[i] <<= wasted;
+    }
+
+    return !br->eof;
+}
+
+/* **************** FRAMES **************** */
+
+static uint8_t crc8_update(uint8_t crc, uint8_t byte)
+{
+    crc ^= byte;
+    for(int i = 0; i < 8; i++) {
+        crc = (crc & 0x80) ? (uint8_t)((crc << 1) ^ 0x07) : (uint8_t)(crc << 1);
+    }
+    return crc;
+}
+
+static inline uint32_t read_byte_crc(flac_bitreader *br, uint8_t *crc)
+{
+    uint32_t b = br_read(br, 8);
+    *crc = crc8_update(*crc, (uint8_t)b);
+    return b;
+}
+
+static frame_status decode_frame(flac_instance *pInstance)
+{
+    flac_bitreader *br = &pInstance->br;
+
+    br_align(br);
+
+    // find 14 bit sync code 0b11111111111110 followed by a reserved 0 bit
+    uint32_t prev = 0;
+    while(true) {
+        uint32_t b = br_read(br, 8);
+        if(br->eof) return FRAME_EOF;
+        if(prev == 0xFF && (b & 0xFE) == 0xF8) {
+            prev = b;
+            break;
+        }
+        prev = b;
+    }
+
+    uint8_t crc = crc8_update(crc8_update(0, 0xFF), (uint8_t)prev);
+    bool variable_blocksize = prev & 0x01;
+
+    uint32_t b = read_byte_crc(br, &crc);
+    uint32_t blocksize_code = b >> 4;
+    uint32_t samplerate_code = b & 0x0F;
+
+    b = read_byte_crc(br, &crc);
+    uint32_t channel_assignment = b >> 4;
+    uint32_t samplesize_code = (b >> 1) & 0x07;
+
+    // UTF-8 style coded frame or sample number
+    uint64_t number = read_byte_crc(br, &crc);
+    int extra = 0;
+    if((number & 0x80) == 0) {
+        extra = 0;
+    } else if((number & 0xE0) == 0xC0) {
+        extra = 1; number &= 0x1F;
+    } else if((number & 0xF0) == 0xE0) {
+        extra = 2; number &= 0x0F;
+    } else if((number & 0xF8) == 0xF0) {
+        extra = 3; number &= 0x07;
+    } else if((number & 0xFC) == 0xF8) {
+        extra = 4; number &= 0x03;
+    } else if((number & 0xFE) == 0xFC) {
+        extra = 5; number &= 0x01;
+    } else if(number == 0xFE) {
+        extra = 6; number = 0;
+    } else {
+        return FRAME_INVALID;
+    }
+    for(int i = 0; i < extra; i++) {
+        uint32_t c = read_byte_crc(br, &crc);
+        if((c & 0xC0) != 0x80) return FRAME_INVALID;
+        number = (number << 6) | (c & 0x3F);
+    }
+
+    uint32_t block_size;
+    if(blocksize_code == 1) {
+        block_size = 192;
+    } else if(blocksize_code >= 2 && blocksize_code <= 5) {
+        block_size = 576u << (blocksize_code - 2);
+    } else if(blocksize_code == 6) {
+        block_size = read_byte_crc(br, &crc) + 1;
+    } else if(blocksize_code == 7) {
+        block_size = (read_byte_crc(br, &crc) << 8);
+        block_size = (block_size | read_byte_crc(br, &crc)) + 1;
+    } else if(blocksize_code >= 8) {
+        block_size = 256u << (blocksize_code - 8);
+    } else {
+        return FRAME_INVALID;
+    }
+
+    // sample rate changes mid-stream are not supported, only consume the bytes
+    if(samplerate_code == 12) {
+        read_byte_crc(br, &crc);
+    } else if(samplerate_code == 13 || samplerate_code == 14) {
+        read_byte_crc(br, &crc);
+        read_byte_crc(br, &crc);
+    } else if(samplerate_code == 15) {
+        return FRAME_INVALID;
+    }
+
+    uint8_t header_crc = (uint8_t)br_read(br, 8);
+    if(br->eof) return FRAME_EOF;
+    if(header_crc != crc) {
+        LOGI_2("header crc mismatch");
+        return FRAME_INVALID;
+    }
+
+    static const uint8_t sample_sizes[8] = { 0, 8, 12, 0, 16, 20, 24, 32 };
+    int bps = (samplesize_code == 0) ? pInstance->bits_per_sample : sample_sizes[samplesize_code];
+    uint32_t channels = (channel_assignment < 8) ? channel_assignment + 1 : 2;
+
+    if(bps == 0 || bps > 24 || channel_assignment > 10 ||
+       channels != pInstance->channels || block_size > pInstance->channel_capacity) {
+        return FRAME_INVALID;
+    }
+
+    for(uint32_t ch = 0; ch < channels; ch++) {
+        // the side channel carries one extra bit
+        int ch_bps = bps;
+        if((channel_assignment == 8 && ch == 1) ||
+           (channel_assignment == 9 && ch == 0) ||
+           (channel_assignment == 10 && ch == 1)) {
+            ch_bps++;
+        }
+        if(!decode_subframe(br, ch_bps, block_size, pInstance->channel_data[ch])) {
+            return br->eof ? FRAME_EOF : FRAME_INVALID;
+        }
+    }
+
+    // frame footer, CRC-16 is not verified as the header CRC already guards resync
+    br_align(br);
+    br_read(br, 16);
+
+    int32_t *c0 = pInstance->channel_data[0];
+    int32_t *c1 = pInstance->channel_data[1];
+    switch(channel_assignment) {
+        case 8:     // left/side
+            for(uint32_t i = 0; i < block_size; i++) c1[i] = c0[i] - c1[i];
+            break;
+        case 9:     // side/right
+            for(uint32_t i = 0; i < block_size; i++) c0[i] += c1[i];
+            break;
+        case 10:    // mid/side
+            for(uint32_t i = 0; i < block_size; i++) {
+                int32_t side = c1[i];
+                int32_t mid = (c0[i] << 1) | (side & 1);
+                c0[i] = (mid + side) >> 1;
+                c1[i] = (mid - side) >> 1;
+            }
+            break;
+        default:
+            break;
+    }
+
+    pInstance->block_size = block_size;
+    pInstance->block_pos = 0;
+    pInstance->block_first_sample = variable_blocksize ? number : number * pInstance->max_blocksize;
+
+    return FRAME_OK;
+}
+
+/**
+ * Each call outputs at most one output buffer worth of interleaved 16 bit
+ * frames from the current block, decoding the next frame only once the
+ * current block has been fully consumed.
+ */
+DECODE_STATUS decode_flac(audio_source_t *src, decode_data *pData, flac_instance *pInstance) {
+    (void)src;
+
+    if(pInstance->block_pos >= pInstance->block_size) {
+        frame_status status = decode_frame(pInstance);
+        if(status == FRAME_EOF) {
+            return DECODE_STATUS_DONE;
+        } else if(status == FRAME_INVALID) {
+            ESP_LOGE(TAG, "invalid frame, resyncing");
+            pInstance->block_size = 0;
+            pInstance->block_pos = 0;
+            pData->frame_count = 0;
+            return DECODE_STATUS_NO_DATA_CONTINUE;
+        }
+
+        // after a seek, drop the part of the block before the target sample
+        if(pInstance->skip_to_sample) {
+            uint64_t first = pInstance->block_first_sample;
+            if(pInstance->skip_to_sample >= first + pInstance->block_size) {
+                pInstance->block_pos = pInstance->block_size;
+                pData->frame_count = 0;
+                return DECODE_STATUS_NO_DATA_CONTINUE;
+            }
+            if(pInstance->skip_to_sample > first) {
+                pInstance->block_pos = (uint32_t)(pInstance->skip_to_sample - first);
+            }
+            pInstance->skip_to_sample = 0;
+        }
+    }
+
+    uint32_t channels = pInstance->channels;
+    uint32_t capacity_frames = pData->samples_capacity / (channels * sizeof(int16_t));
+    uint32_t frames = pInstance->block_size - pInstance->block_pos;
+    if(frames > capacity_frames) frames = capacity_frames;
+
+    int shift = (int)pInstance->bits_per_sample - 16;
+    int16_t *out = reinterpret_cast<int16_t*>(pData->samples);
+    for(uint32_t ch = 0; ch < channels; ch++) {
+        const int32_t *in = pInstance->channel_data[ch] + pInstance->block_pos;
+        int16_t *dst = out + ch;
+        if(shift >= 0) {
+            for(uint32_t i = 0; i < frames; i++, dst += channels) *dst = (int16_t)(in[i] >> shift);
+        } else {
+            for(uint32_t i = 0; i < frames; i++, dst += channels) *dst = (int16_t)(in[i] << -shift);
+        }
+    }
+    pInstance->block_pos += frames;
+
+    pData->fmt.sample_rate = pInstance->sample_rate;
+    pData->fmt.bits_per_sample = 16;
+    pData->fmt.channels = channels;
+    pData->frame_count = frames;
+
+    LOGI_3("frames %d, block_pos %d/%d", frames, pInstance->block_pos, pInstance->block_size);
+
+    return DECODE_STATUS_CONTINUE;
+}
+
+bool seek_flac(audio_source_t *src, flac_instance *pInstance, uint64_t sample)
+{
+    if(pInstance->total_samples && sample >= pInstance->total_samples) {
+        return false;
+    }
+
+    long offset = pInstance->first_frame_offset;
+
+    if(pInstance->seekpoint_count > 0) {
+        // last seek point at or before the target
+        size_t lo = 0;
+        size_t hi = pInstance->seekpoint_count;
+        while(lo < hi) {
+            size_t mid = (lo + hi) / 2;
+            if(pInstance->seekpoints[mid].sample <= sample) {
+                lo = mid + 1;
+            } else {
+                hi = mid;
+            }
+        }
+        if(lo > 0) {
+            offset += (long)pInstance->seekpoints[lo - 1].offset;
+        }
+    } else if(pInstance->total_samples) {
+        // no seek table, estimate assuming a constant compression ratio
+        audio_source_seek(src, 0, SEEK_END);
+        long audio_bytes = audio_source_tell(src) - pInstance->first_frame_offset;
+        offset += (long)((uint64_t)audio_bytes * sample / pInstance->total_samples);
+    }
+
+    if(audio_source_seek(src, offset, SEEK_SET) != 0) {
+        return false;
+    }
+
+    br_reset(&pInstance->br, src);
+    pInstance->block_size = 0;
+    pInstance->block_pos = 0;
+    pInstance->skip_to_sample = sample;
+
+    LOGI_1("seek to sample %llu, offset %ld", sample, offset);
+
+    return true;
+}
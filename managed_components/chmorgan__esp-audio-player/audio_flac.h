@@ -0,0 +1,75 @@
+#pragma once
+
+#include "audio_source.h"
+#include "audio_log.h"
+#include "audio_decode_types.h"
+
+/** Largest frame block size accepted, FLAC allows up to 65535 but encoders use <= 4608 */
+#define FLAC_MAX_BLOCKSIZE      16384
+
+/** Seek points kept from the SEEKTABLE, larger tables are decimated to fit */
+#define FLAC_MAX_SEEKPOINTS     128
+
+#define FLAC_MAX_CHANNELS       2
+#define FLAC_MAX_LPC_ORDER      32
+
+typedef struct {
+    uint64_t sample;        /*!< first sample in the target frame */
+    uint64_t offset;        /*!< byte offset of the frame from the first frame header */
+} flac_seekpoint_t;
+
+typedef struct {
+    audio_source_t *src;
+    uint8_t *buf;           /*!< read buffer, not allocated for memory backed sources */
+    size_t buf_size;
+    const uint8_t *data;    /*!< buf, or the source's own memory */
+    size_t len;             /*!< valid bytes in data */
+    size_t pos;             /*!< next byte to move into cache */
+    uint64_t cache;         /*!< low cache_bits bits are unread stream bits, msb first */
+    int cache_bits;
+    bool eof;
+} flac_bitreader;
+
+typedef struct {
+    // STREAMINFO
+    uint32_t sample_rate;
+    uint32_t channels;
+    uint32_t bits_per_sample;
+    uint32_t max_blocksize;
+    uint64_t total_samples;     /*!< 0 if unknown */
+
+    /** file offset of the first frame header, seek table offsets are relative to it */
+    long first_frame_offset;
+
+    flac_seekpoint_t seekpoints[FLAC_MAX_SEEKPOINTS];
+    size_t seekpoint_count;
+
+    flac_bitreader br;
+
+    /**
+     * Decoded samples of the current frame, one array per channel, sized for
+     * max_blocksize so memory is bounded by the stream's block size.
+     */
+    int32_t *channel_data[FLAC_MAX_CHANNELS];
+    uint32_t channel_capacity;
+
+    uint32_t block_size;        /*!< frames in the current decoded block */
+    uint32_t block_pos;         /*!< frames of the current block already output */
+    uint64_t block_first_sample;
+
+    /** frames to drop from the next decoded block after a seek */
+    uint64_t skip_to_sample;
+} flac_instance;
+
+bool is_flac(audio_source_t *src, flac_instance *pInstance);
+DECODE_STATUS decode_flac(audio_source_t *src, decode_data *pData, flac_instance *pInstance);
+
+/**
+ * @brief Position the stream so the next decode_flac() output starts at 'sample'
+ *
+ * Uses the SEEKTABLE when present, otherwise estimates the byte position
+ * from the file size and resyncs on the next valid frame header.
+ */
+bool seek_flac(audio_source_t *src, flac_instance *pInstance, uint64_t sample);
+
+void flac_instance_free(flac_instance *pInstance);
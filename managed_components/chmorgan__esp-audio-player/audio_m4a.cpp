@@ -0,0 +1,587 @@
+#include <string.h>
+#include <stdlib.h>
+#include "esp_heap_caps.h"
+#include "audio_m4a.h"
+
+static const char *TAG = "m4a";
+
+#define FOURCC(a, b, c, d)  (((uint32_t)(a) << 24) | ((uint32_t)(b) << 16) | ((uint32_t)(c) << 8) | (uint32_t)(d))
+
+#define M4A_MAX_DEPTH       8
+#define M4A_ESDS_MAX        128
+
+typedef struct {
+    uint32_t type;
+    long payload;           /*!< file offset of the box contents */
+    long end;               /*!< file offset just past the box */
+} m4a_box;
+
+/** Table positions and format of one 'trak', nothing is loaded */
+typedef struct {
+    bool is_audio;
+    bool is_aac;
+    uint32_t sample_rate;
+    uint32_t channels;
+    uint32_t object_type;
+    uint32_t timescale;
+
+    long stts_offset;   uint32_t stts_count;
+    long stsc_offset;   uint32_t stsc_count;
+    long stsz_offset;   uint32_t stsz_count;    uint32_t stsz_fixed;
+    long stco_offset;   uint32_t stco_count;    uint32_t stco_entry_size;
+} m4a_track;
+
+static const uint32_t aac_sample_rates[13] = {
+    96000, 88200, 64000, 48000, 44100, 32000, 24000, 22050, 16000, 12000, 11025, 8000, 7350
+};
+
+static uint32_t be32(const uint8_t *p)
+{
+    return ((uint32_t)p[0] << 24) | ((uint32_t)p[1] << 16) | ((uint32_t)p[2] << 8) | p[3];
+}
+
+static bool read_be32(audio_source_t *src, uint32_t *v)
+{
+    uint8_t b[4];
+    if(audio_source_read(src, b, sizeof(b)) != sizeof(b)) return false;
+    *v = be32(b);
+    return true;
+}
+
+static bool read_box(audio_source_t *src, long pos, long end, m4a_box *box)
+{
+    uint8_t h[8];
+    if(pos + 8 > end || audio_source_seek(src, pos, SEEK_SET) != 0 || audio_source_read(src, h, sizeof(h)) != sizeof(h)) {
+        return false;
+    }
+
+    uint64_t size = be32(h);
+    box->type = be32(h + 4);
+    box->payload = pos + 8;
+
+    if(size == 1) {
+        uint32_t hi, lo;
+        if(!read_be32(src, &hi) || !read_be32(src, &lo)) return false;
+        size = ((uint64_t)hi << 32) | lo;
+        box->payload += 8;
+    } else if(size == 0) {
+        size = end - pos;       // box extends to the end of its parent
+    }
+
+    if(size < (uint64_t)(box->payload - pos) || pos + size > (uint64_t)end) {
+        return false;
+    }
+    box->end = (long)(pos + size);
+    return true;
+}
+
+/* **************** TABLE WINDOWS **************** */
+
+static bool table_init(m4a_table *t, long offset, uint32_t count, uint32_t entry_size)
+{
+    t->offset = offset;
+    t->count = count;
+    t->entry_size = entry_size;
+    t->first = 0;
+    t->buffered = 0;
+    if(!t->buf) {
+        t->buf = static_cast<uint8_t*>(malloc(M4A_TABLE_WINDOW * 12));
+    }
+    return t->buf != NULL;
+}
+
+static void table_free(m4a_table *t)
+{
+    free(t->buf);
+    t->buf = NULL;
+}
+
+/** @return the bytes of entry 'idx', reading a new window from the file if needed */
+static const uint8_t *table_entry(audio_source_t *src, m4a_table *t, uint32_t idx)
+{
+    if(idx >= t->count) return NULL;
+
+    if(idx < t->first || idx >= t->first + t->buffered) {
+        uint32_t n = t->count - idx;
+        if(n > M4A_TABLE_WINDOW) n = M4A_TABLE_WINDOW;
+        if(audio_source_seek(src, t->offset + (long)idx * t->entry_size, SEEK_SET) != 0 ||
+           audio_source_read(src, t->buf, (size_t)t->entry_size * n) != (size_t)t->entry_size * n) {
+            t->buffered = 0;
+            return NULL;
+        }
+        t->first = idx;
+        t->buffered = n;
+    }
+
+    return t->buf + (idx - t->first) * t->entry_size;
+}
+
+/* **************** BOX PARSING **************** */
+
+static uint32_t read_descriptor_len(const uint8_t *buf, size_t size, size_t *pos)
+{
+    uint32_t len = 0;
+    for(int i = 0; i < 4 && *pos < size; i++) {
+        uint8_t b = buf[(*pos)++];
+        len = (len << 7) | (b & 0x7F);
+        if(!(b & 0x80)) break;
+    }
+    return len;
+}
+
+/** pull the AudioSpecificConfig out of an 'esds' box */
+static void parse_esds(audio_source_t *src, const m4a_box *box, m4a_track *track)
+{
+    uint8_t buf[M4A_ESDS_MAX];
+    size_t size = box->end - box->payload;
+    if(size > sizeof(buf)) size = sizeof(buf);
+    if(audio_source_seek(src, box->payload, SEEK_SET) != 0 || audio_source_read(src, buf, size) != size) return;
+
+    size_t pos = 4;     // version + flags
+    while(pos + 2 < size) {
+        uint8_t tag = buf[pos++];
+        uint32_t len = read_descriptor_len(buf, size, &pos);
+
+        if(tag == 0x03) {                   // ES_Descriptor, descend
+            if(pos + 3 > size) return;
+            uint8_t flags = buf[pos + 2];
+            pos += 3;
+            if(flags & 0x80) pos += 2;
+            if((flags & 0x40) && pos < size) pos += 1 + buf[pos];
+            if(flags & 0x20) pos += 2;
+        } else if(tag == 0x04) {            // DecoderConfigDescriptor, descend
+            if(pos >= size || buf[pos] != 0x40) return;     // not MPEG-4 audio
+            pos += 13;
+        } else if(tag == 0x05) {            // DecoderSpecificInfo = AudioSpecificConfig
+            if(len < 2 || pos + 2 > size) return;
+            uint32_t object_type = buf[pos] >> 3;
+            uint32_t freq_index = ((buf[pos] & 0x07) << 1) | (buf[pos + 1] >> 7);
+            uint32_t channel_config = (buf[pos + 1] >> 3) & 0x0F;
+
+            track->object_type = object_type;
+            if(freq_index < 13) track->sample_rate = aac_sample_rates[freq_index];
+            if(channel_config > 0) track->channels = channel_config;
+            track->is_aac = true;
+            return;
+        } else {
+            pos += len;
+        }
+    }
+}
+
+static void parse_stsd(audio_source_t *src, const m4a_box *box, m4a_track *track)
+{
+    // full box header + entry count, then the first sample entry
+    m4a_box entry;
+    if(!read_box(src, box->payload + 8, box->end, &entry) || entry.type != FOURCC('m', 'p', '4', 'a')) {
+        return;
+    }
+
+    // SampleEntry (8) + AudioSampleEntry v0 (20), QuickTime v1/v2 add 16/36 bytes
+    uint8_t ase[28];
+    if(audio_source_seek(src, entry.payload, SEEK_SET) != 0 || audio_source_read(src, ase, sizeof(ase)) != sizeof(ase)) return;
+
+    uint32_t version = (ase[8] << 8) | ase[9];
+    track->channels = (ase[16] << 8) | ase[17];
+    track->sample_rate = be32(ase + 24) >> 16;
+
+    long child = entry.payload + 28 + (version == 1 ? 16 : (version == 2 ? 36 : 0));
+    m4a_box b;
+    while(read_box(src, child, entry.end, &b)) {
+        if(b.type == FOURCC('e', 's', 'd', 's')) {
+            parse_esds(src, &b, track);
+            break;
+        }
+        child = b.end;
+    }
+}
+
+static bool parse_boxes(audio_source_t *src, long pos, long end, int depth, m4a_track *track, m4a_track *result)
+{
+    if(depth > M4A_MAX_DEPTH) return false;
+
+    m4a_box box;
+    uint8_t hdr[16];
+    while(read_box(src, pos, end, &box)) {
+        size_t payload = box.end - box.payload;
+
+        switch(box.type) {
+            case FOURCC('m', 'o', 'o', 'v'):
+            case FOURCC('m', 'd', 'i', 'a'):
+            case FOURCC('m', 'i', 'n', 'f'):
+            case FOURCC('s', 't', 'b', 'l'):
+                parse_boxes(src, box.payload, box.end, depth + 1, track, result);
+                break;
+
+            case FOURCC('t', 'r', 'a', 'k'): {
+                m4a_track t;
+                memset(&t, 0, sizeof(t));
+                parse_boxes(src, box.payload, box.end, depth + 1, &t, result);
+                // first AAC audio track with complete tables wins
+                if(!result->is_aac && t.is_audio && t.is_aac &&
+                   t.stts_count && t.stsc_count && t.stco_count && t.stsz_count) {
+                    *result = t;
+                }
+                break;
+            }
+
+            case FOURCC('h', 'd', 'l', 'r'):
+                if(track && payload >= 12 && audio_source_read(src, hdr, 12) == 12) {
+                    track->is_audio = be32(hdr + 8) == FOURCC('s', 'o', 'u', 'n');
+                }
+                break;
+
+            case FOURCC('m', 'd', 'h', 'd'):
+                if(track && payload >= 16 && audio_source_read(src, hdr, 16) == 16) {
+                    // version 1 uses 64 bit creation/modification times
+                    if(hdr[0] == 1) {
+                        if(audio_source_read(src, hdr, 16) != 16) break;
+                        track->timescale = be32(hdr + 4);
+                    } else {
+                        track->timescale = be32(hdr + 12);
+                    }
+                }
+                break;
+
+            case FOURCC('s', 't', 's', 'd'):
+                if(track) parse_stsd(src, &box, track);
+                break;
+
+            case FOURCC('s', 't', 't', 's'):
+                if(track && payload >= 8 && audio_source_read(src, hdr, 8) == 8) {
+                    track->stts_count = be32(hdr + 4);
+                    track->stts_offset = box.payload + 8;
+                }
+                break;
+
+            case FOURCC('s', 't', 's', 'c'):
+                if(track && payload >= 8 && audio_source_read(src, hdr, 8) == 8) {
+                    track->stsc_count = be32(hdr + 4);
+                    track->stsc_offset = box.payload + 8;
+                }
+                break;
+
+            case FOURCC('s', 't', 's', 'z'):
+                if(track && payload >= 12 && audio_source_read(src, hdr, 12) == 12) {
+                    track->stsz_fixed = be32(hdr + 4);
+                    track->stsz_count = be32(hdr + 8);
+                    track->stsz_offset = box.payload + 12;
+                }
+                break;
+
+            case FOURCC('s', 't', 'c', 'o'):
+            case FOURCC('c', 'o', '6', '4'):
+                if(track && payload >= 8 && audio_source_read(src, hdr, 8) == 8) {
+                    track->stco_count = be32(hdr + 4);
+                    track->stco_offset = box.payload + 8;
+                    track->stco_entry_size = (box.type == FOURCC('c', 'o', '6', '4')) ? 8 : 4;
+                }
+                break;
+
+            default:
+                // mdat, udta, free... skipped without reading
+                break;
+        }
+
+        pos = box.end;
+    }
+
+    return true;
+}
+
+/**
+ * Walk stco/co64 and stsc once, through small windows, to build the chunk
+ * index: 8 bytes per chunk instead of 4 bytes per sample for stsz.
+ */
+static bool build_chunk_index(audio_source_t *src, const m4a_track *track, m4a_instance *pInstance)
+{
+    m4a_table stco;
+    m4a_table stsc;
+    memset(&stco, 0, sizeof(stco));
+    memset(&stsc, 0, sizeof(stsc));
+
+    bool ok = false;
+    size_t bytes = track->stco_count * sizeof(m4a_chunk);
+    m4a_chunk *chunks = static_cast<m4a_chunk*>(heap_caps_malloc(bytes, MALLOC_CAP_SPIRAM | MALLOC_CAP_8BIT));
+    if(!chunks) {
+        chunks = static_cast<m4a_chunk*>(malloc(bytes));
+    }
+
+    if(!chunks ||
+       !table_init(&stco, track->stco_offset, track->stco_count, track->stco_entry_size) ||
+       !table_init(&stsc, track->stsc_offset, track->stsc_count, 12)) {
+        ESP_LOGE(TAG, "no memory for %u chunk index", (unsigned)track->stco_count);
+        goto done;
+    }
+
+    {
+        uint32_t stsc_idx = 0;
+        const uint8_t *e = table_entry(src, &stsc, 0);
+        if(!e) goto done;
+        uint32_t samples_per_chunk = be32(e + 4);
+        const uint8_t *next = table_entry(src, &stsc, 1);
+        uint32_t next_first_chunk = next ? be32(next) : UINT32_MAX;
+
+        uint32_t sample = 0;
+        for(uint32_t c = 0; c < track->stco_count; c++) {
+            // stsc first_chunk is 1 based
+            while(c + 1 >= next_first_chunk) {
+                stsc_idx++;
+                e = table_entry(src, &stsc, stsc_idx);
+                if(!e) goto done;
+                samples_per_chunk = be32(e + 4);
+                next = table_entry(src, &stsc, stsc_idx + 1);
+                next_first_chunk = next ? be32(next) : UINT32_MAX;
+            }
+
+            e = table_entry(src, &stco, c);
+            if(!e) goto done;
+            // FAT32 files are < 4 GB so the low word of a co64 entry is enough
+            chunks[c].offset = (track->stco_entry_size == 8) ? be32(e + 4) : be32(e);
+            chunks[c].first_sample = sample;
+            sample += samples_per_chunk;
+        }
+    }
+
+    pInstance->chunks = chunks;
+    pInstance->chunk_count = track->stco_count;
+    chunks = NULL;
+    ok = true;
+
+done:
+    free(chunks);
+    table_free(&stco);
+    table_free(&stsc);
+    return ok;
+}
+
+void m4a_instance_free(m4a_instance *pInstance)
+{
+    free(pInstance->chunks);
+    pInstance->chunks = NULL;
+    pInstance->chunk_count = 0;
+    table_free(&pInstance->stts);
+    table_free(&pInstance->stsz);
+    free(pInstance->frame_buf);
+    pInstance->frame_buf = NULL;
+}
+
+/**
+ * @param src
+ * @param pInstance - Values can be considered valid if true is returned
+ * @return true if file is an MP4/M4A container with an AAC-LC audio track
+ */
+bool is_m4a(audio_source_t *src, m4a_instance *pInstance) {
+    audio_source_seek(src, 0, SEEK_END);
+    long file_end = audio_source_tell(src);
+
+    m4a_box box;
+    if(!read_box(src, 0, file_end, &box) || box.type != FOURCC('f', 't', 'y', 'p')) {
+        return false;
+    }
+
+    // release the index of the previous file
+    free(pInstance->chunks);
+    pInstance->chunks = NULL;
+    pInstance->chunk_count = 0;
+
+    m4a_track track;
+    memset(&track, 0, sizeof(track));
+    parse_boxes(src, 0, file_end, 0, NULL, &track);
+
+    if(!track.is_aac) {
+        ESP_LOGE(TAG, "no AAC audio track");
+        return false;
+    }
+    if(track.object_type != 2 || track.channels == 0 || track.channels > 2) {
+        ESP_LOGE(TAG, "unsupported: object type %u, channels %u",
+            (unsigned)track.object_type, (unsigned)track.channels);
+        return false;
+    }
+
+    if(!build_chunk_index(src, &track, pInstance)) {
+        return false;
+    }
+
+    if(!table_init(&pInstance->stts, track.stts_offset, track.stts_count, 8) ||
+       !table_init(&pInstance->stsz, track.stsz_offset, track.stsz_fixed ? 0 : track.stsz_count, 4)) {
+        return false;
+    }
+    if(!pInstance->frame_buf && !src->span) {
+        pInstance->frame_buf = static_cast<uint8_t*>(malloc(M4A_MAX_SAMPLE_SIZE));
+        if(!pInstance->frame_buf) return false;
+    }
+
+    pInstance->sample_rate = track.sample_rate;
+    pInstance->channels = track.channels;
+    pInstance->object_type = track.object_type;
+    pInstance->timescale = track.timescale ? track.timescale : track.sample_rate;
+    pInstance->fixed_sample_size = track.stsz_fixed;
+    pInstance->sample_count = track.stsz_count;
+    pInstance->cur_sample = 0;
+    pInstance->cur_chunk = 0;
+    pInstance->next_offset = pInstance->chunks[0].offset;
+    pInstance->decoder_configured = false;
+
+    LOGI_1("aac: sr %u, ch %u, samples %u, chunks %u",
+        (unsigned)pInstance->sample_rate, (unsigned)pInstance->channels,
+        (unsigned)pInstance->sample_count, (unsigned)pInstance->chunk_count);
+
+    return true;
+}
+
+static bool sample_size(audio_source_t *src, m4a_instance *pInstance, uint32_t sample, uint32_t *size)
+{
+    if(pInstance->fixed_sample_size) {
+        *size = pInstance->fixed_sample_size;
+        return true;
+    }
+    const uint8_t *e = table_entry(src, &pInstance->stsz, sample);
+    if(!e) return false;
+    *size = be32(e);
+    return true;
+}
+
+DECODE_STATUS m4a_next_sample(audio_source_t *src, m4a_instance *pInstance, const uint8_t **data, uint32_t *size)
+{
+    if(pInstance->cur_sample >= pInstance->sample_count) {
+        return DECODE_STATUS_DONE;
+    }
+
+    if(!sample_size(src, pInstance, pInstance->cur_sample, size)) {
+        return DECODE_STATUS_ERROR;
+    }
+
+    uint32_t offset = pInstance->next_offset;
+
+    // advance to the next sample before decoding so a bad frame is skipped
+    pInstance->cur_sample++;
+    if(pInstance->cur_chunk + 1 < pInstance->chunk_count &&
+       pInstance->chunks[pInstance->cur_chunk + 1].first_sample == pInstance->cur_sample) {
+        pInstance->cur_chunk++;
+        pInstance->next_offset = pInstance->chunks[pInstance->cur_chunk].offset;
+    } else {
+        pInstance->next_offset = offset + *size;
+    }
+
+    if(*size == 0 || *size > M4A_MAX_SAMPLE_SIZE) {
+        ESP_LOGE(TAG, "skipping sample of %u bytes", (unsigned)*size);
+        return DECODE_STATUS_NO_DATA_CONTINUE;
+    }
+
+    if(src->span) {
+        // memory backed source: hand the sample to the decoder where it lies
+        if(offset > src->span_len || *size > src->span_len - offset) {
+            return DECODE_STATUS_DONE;
+        }
+        *data = src->span + offset;
+        audio_source_seek(src, offset + *size, SEEK_SET);
+    } else {
+        if((audio_source_tell(src) != (long)offset && audio_source_seek(src, offset, SEEK_SET) != 0) ||
+           audio_source_read(src, pInstance->frame_buf, *size) != *size) {
+            return DECODE_STATUS_DONE;
+        }
+        *data = pInstance->frame_buf;
+    }
+    return DECODE_STATUS_CONTINUE;
+}
+
+#if defined(CONFIG_AUDIO_PLAYER_ENABLE_AAC)
+DECODE_STATUS decode_m4a(HAACDecoder aac_decoder, audio_source_t *src, decode_data *pData, m4a_instance *pInstance) {
+    pData->frame_count = 0;
+
+    if(!pInstance->decoder_configured) {
+        // mp4 carries raw access units, give the decoder what ADTS headers would
+        AACFrameInfo info;
+        memset(&info, 0, sizeof(info));
+        info.nChans = pInstance->channels;
+        info.sampRateCore = pInstance->sample_rate;
+        info.profile = AAC_PROFILE_LC;
+        AACFlushCodec(aac_decoder);
+        if(AACSetRawBlockParams(aac_decoder, 0, &info) != ERR_AAC_NONE) {
+            ESP_LOGE(TAG, "AACSetRawBlockParams failed");
+            return DECODE_STATUS_ERROR;
+        }
+        pInstance->decoder_configured = true;
+    }
+
+    const uint8_t *data;
+    uint32_t size;
+    DECODE_STATUS status = m4a_next_sample(src, pInstance, &data, &size);
+    if(status != DECODE_STATUS_CONTINUE) {
+        return status;
+    }
+
+    // the decoder does not write to its input
+    uint8_t *in = const_cast<uint8_t*>(data);
+    int bytes_left = size;
+    int err = AACDecode(aac_decoder, &in, &bytes_left, reinterpret_cast<short*>(pData->samples));
+    if(err != ERR_AAC_NONE) {
+        ESP_LOGE(TAG, "AACDecode error %d", err);
+        return DECODE_STATUS_NO_DATA_CONTINUE;
+    }
+
+    AACFrameInfo info;
+    AACGetLastFrameInfo(aac_decoder, &info);
+    pData->fmt.sample_rate = info.sampRateOut;
+    pData->fmt.bits_per_sample = info.bitsPerSample;
+    pData->fmt.channels = info.nChans;
+    pData->frame_count = info.outputSamps / info.nChans;
+
+    LOGI_3("sample %u, %u bytes, frames %d", (unsigned)pInstance->cur_sample, (unsigned)size, pData->frame_count);
+
+    return DECODE_STATUS_CONTINUE;
+}
+#endif
+
+bool seek_m4a(audio_source_t *src, m4a_instance *pInstance, uint32_t position_ms)
+{
+    // time -> sample through the (usually one entry) stts run list
+    uint64_t target = (uint64_t)position_ms * pInstance->timescale / 1000;
+    uint64_t t = 0;
+    uint32_t sample = 0;
+    for(uint32_t i = 0; i < pInstance->stts.count; i++) {
+        const uint8_t *e = table_entry(src, &pInstance->stts, i);
+        if(!e) return false;
+        uint32_t count = be32(e);
+        uint32_t delta = be32(e + 4);
+        if(delta && t + (uint64_t)count * delta > target) {
+            sample += (uint32_t)((target - t) / delta);
+            break;
+        }
+        t += (uint64_t)count * delta;
+        sample += count;
+    }
+    if(sample >= pInstance->sample_count) {
+        return false;
+    }
+
+    // sample -> chunk, binary search for the last chunk starting at or before it
+    uint32_t lo = 0;
+    uint32_t hi = pInstance->chunk_count;
+    while(hi - lo > 1) {
+        uint32_t mid = (lo + hi) / 2;
+        if(pInstance->chunks[mid].first_sample <= sample) {
+            lo = mid;
+        } else {
+            hi = mid;
+        }
+    }
+
+    // offset within the chunk, at most one chunk's worth of stsz entries
+    uint32_t offset = pInstance->chunks[lo].offset;
+    for(uint32_t s = pInstance->chunks[lo].first_sample; s < sample; s++) {
+        uint32_t size;
+        if(!sample_size(src, pInstance, s, &size)) return false;
+        offset += size;
+    }
+
+    pInstance->cur_sample = sample;
+    pInstance->cur_chunk = lo;
+    pInstance->next_offset = offset;
+    pInstance->decoder_configured = false;
+
+    LOGI_1("seek to %u ms, sample %u, chunk %u", (unsigned)position_ms, (unsigned)sample, (unsigned)lo);
+
+    return true;
+}
@@ -0,0 +1,83 @@
+#pragma once
+
+#include "audio_source.h"
+#include "audio_log.h"
+#include "audio_decode_types.h"
+#if defined(CONFIG_AUDIO_PLAYER_ENABLE_AAC)
+#include "aacdec.h"
+#endif
+
+/** Entries of a sample table kept in RAM at a time, the rest stays on the card */
+#define M4A_TABLE_WINDOW        128
+
+/** Largest AAC access unit accepted, 6144 bits per channel */
+#define M4A_MAX_SAMPLE_SIZE     (768 * 2)
+
+/**
+ * Windowed reader for one big-endian MP4 sample table (stts, stsc, stsz, stco, co64).
+ * Only M4A_TABLE_WINDOW entries are buffered, so tables of any length cost
+ * the same RAM and nothing is read until it is needed.
+ */
+typedef struct {
+    long offset;                /*!< file offset of the first entry */
+    uint32_t count;             /*!< number of entries */
+    uint32_t entry_size;        /*!< bytes per entry */
+    uint32_t first;             /*!< index of the first buffered entry */
+    uint32_t buffered;          /*!< entries in buf */
+    uint8_t *buf;               /*!< M4A_TABLE_WINDOW * entry_size bytes */
+} m4a_table;
+
+/** One entry per chunk, a chunk's samples are contiguous in the file */
+typedef struct {
+    uint32_t offset;            /*!< file offset of the chunk */
+    uint32_t first_sample;      /*!< index of the chunk's first sample */
+} m4a_chunk;
+
+typedef struct {
+    // from the audio track's stsd/esds and mdhd
+    uint32_t sample_rate;
+    uint32_t channels;
+    uint32_t object_type;       /*!< MPEG-4 audio object type, 2 = AAC-LC */
+    uint32_t timescale;
+
+    m4a_table stts;
+    m4a_table stsz;
+    uint32_t fixed_sample_size; /*!< non-zero if stsz uses one size for all samples */
+    uint32_t sample_count;
+
+    /** compact chunk index, allocated in PSRAM when available */
+    m4a_chunk *chunks;
+    uint32_t chunk_count;
+
+    // playback position
+    uint32_t cur_sample;
+    uint32_t cur_chunk;
+    uint32_t next_offset;       /*!< file offset of cur_sample */
+
+    uint8_t *frame_buf;         /*!< one encoded access unit */
+
+    /** false until the raw (ADTS-less) stream parameters are passed to the decoder */
+    bool decoder_configured;
+} m4a_instance;
+
+bool is_m4a(audio_source_t *src, m4a_instance *pInstance);
+
+/**
+ * @brief Demux the next AAC access unit and move past it
+ *
+ * @param data - set to the sample, in place for memory backed sources, else in frame_buf
+ * @return DECODE_STATUS_CONTINUE with data and size set, DECODE_STATUS_NO_DATA_CONTINUE
+ *         for a sample that was skipped, DECODE_STATUS_DONE at the end of the track
+ */
+DECODE_STATUS m4a_next_sample(audio_source_t *src, m4a_instance *pInstance, const uint8_t **data, uint32_t *size);
+
+#if defined(CONFIG_AUDIO_PLAYER_ENABLE_AAC)
+DECODE_STATUS decode_m4a(HAACDecoder aac_decoder, audio_source_t *src, decode_data *pData, m4a_instance *pInstance);
+#endif
+
+/**
+ * @brief Position playback at 'position_ms', O(log n) in the number of chunks
+ */
+bool seek_m4a(audio_source_t *src, m4a_instance *pInstance, uint32_t position_ms);
+
+void m4a_instance_free(m4a_instance *pInstance);
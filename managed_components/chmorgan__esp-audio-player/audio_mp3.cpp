@@ -4,14 +4,148 @@
 
 static const char *TAG = "mp3";
 
-bool is_mp3(FILE *fp) {
+/**
+ * @return size of a leading ID3v2 tag including its header and footer, 0 if none
+ */
+static long id3v2_size(audio_source_t *src) {
+    mp3_id3_header_v2_t tag;
+
+    audio_source_seek(src, 0, SEEK_SET);
+    if (sizeof(tag) != audio_source_read(src, &tag, sizeof(tag)) ||
+        memcmp("ID3", (const void *) &tag, sizeof(tag.header)) != 0) {
+        return 0;
+    }
+
+    // tag size is 4 bytes of 7 bits each, excluding the 10 byte header
+    long size = ((tag.size[0] & 0x7F) << 21) | ((tag.size[1] & 0x7F) << 14) |
+                ((tag.size[2] & 0x7F) << 7) | (tag.size[3] & 0x7F);
+    if (tag.flag & 0x10) {
+        size += sizeof(tag);    // footer present
+    }
+    return size + sizeof(tag);
+}
+
+static const uint16_t layer3_kbps[2][15] = {
+    { 0, 32, 40, 48, 56, 64, 80, 96, 112, 128, 160, 192, 224, 256, 320 },   // MPEG-1
+    { 0, 8, 16, 24, 32, 40, 48, 56, 64, 80, 96, 112, 128, 144, 160 },       // MPEG-2 and 2.5
+};
+static const uint16_t mpeg1_sample_rates[3] = { 44100, 48000, 32000 };
+
+typedef struct {
+    uint32_t bitrate;
+    uint32_t sample_rate;
+    uint32_t samples;       /*!< per frame */
+    uint32_t length;        /*!< bytes including the header */
+    uint32_t side_info;     /*!< bytes between the header and a Xing/Info tag */
+} mp3_frame_header;
+
+/**
+ * @return false if the 4 bytes at h are not a layer III frame header with a
+ *         known bitrate (free format streams are not supported)
+ */
+static bool parse_frame_header(const uint8_t *h, mp3_frame_header *out) {
+    if (h[0] != 0xFF || (h[1] & 0xE0) != 0xE0) {
+        return false;
+    }
+    int version = (h[1] >> 3) & 3;      // 3 MPEG-1, 2 MPEG-2, 0 MPEG-2.5
+    int layer = (h[1] >> 1) & 3;        // 1 layer III
+    int bitrate_index = h[2] >> 4;
+    int rate_index = (h[2] >> 2) & 3;
+    if (version == 1 || layer != 1 || bitrate_index == 0 || bitrate_index == 15 || rate_index == 3) {
+        return false;
+    }
+
+    bool mpeg1 = (version == 3);
+    bool mono = (h[3] >> 6) == 3;
+    out->bitrate = layer3_kbps[mpeg1 ? 0 : 1][bitrate_index] * 1000;
+    out->sample_rate = mpeg1_sample_rates[rate_index] >> (mpeg1 ? 0 : (version == 2 ? 1 : 2));
+    out->samples = mpeg1 ? 1152 : 576;
+    out->length = out->samples / 8 * out->bitrate / out->sample_rate + ((h[2] >> 1) & 1);
+    out->side_info = mpeg1 ? (mono ? 17 : 32) : (mono ? 9 : 17);
+    return true;
+}
+
+static uint32_t read_be32(const uint8_t *p) {
+    return ((uint32_t)p[0] << 24) | ((uint32_t)p[1] << 16) | ((uint32_t)p[2] << 8) | p[3];
+}
+
+/**
+ * Find the first frame after any ID3v2 tag and read the Xing/Info or VBRI
+ * header it may carry. The first frame is the one followed by another valid
+ * header where its length says, so stray sync bytes in padding are skipped.
+ */
+static void read_layout(audio_source_t *src, mp3_instance *pInstance) {
+    pInstance->audio_start = id3v2_size(src);
+    pInstance->bitrate = 0;
+    pInstance->sample_rate = 0;
+    pInstance->samples_per_frame = 0;
+    pInstance->total_frames = 0;
+    pInstance->audio_bytes = 0;
+    pInstance->has_toc = false;
+
+    uint8_t *buf = pInstance->data_buf;
+    if (audio_source_seek(src, pInstance->audio_start, SEEK_SET) != 0) {
+        return;
+    }
+    size_t len = audio_source_read(src, buf, pInstance->data_buf_size);
+
+    mp3_frame_header hdr;
+    size_t pos;
+    for (pos = 0; pos + 4 <= len; pos++) {
+        mp3_frame_header next;
+        if (parse_frame_header(buf + pos, &hdr) &&
+            (pos + hdr.length + 4 > len || parse_frame_header(buf + pos + hdr.length, &next))) {
+            break;
+        }
+    }
+    if (pos + 4 > len) {
+        ESP_LOGE(TAG, "no frame header in the first %u bytes", (unsigned)len);
+        return;
+    }
+
+    pInstance->audio_start += pos;
+    pInstance->bitrate = hdr.bitrate;
+    pInstance->sample_rate = hdr.sample_rate;
+    pInstance->samples_per_frame = hdr.samples;
+
+    const uint8_t *end = buf + len;
+    const uint8_t *xing = buf + pos + 4 + hdr.side_info;
+    const uint8_t *vbri = buf + pos + 4 + 32;
+    if (xing + 8 <= end && (memcmp(xing, "Xing", 4) == 0 || memcmp(xing, "Info", 4) == 0)) {
+        uint32_t flags = read_be32(xing + 4);
+        const uint8_t *p = xing + 8;
+        if ((flags & 0x1) && p + 4 <= end) {
+            pInstance->total_frames = read_be32(p);
+            p += 4;
+        }
+        if ((flags & 0x2) && p + 4 <= end) {
+            pInstance->audio_bytes = read_be32(p);
+            p += 4;
+        }
+        // encoders write "Info" for CBR streams, where the linear estimate is exact
+        // and the TOC's 1/256 steps would only add error
+        if ((flags & 0x4) && p + sizeof(pInstance->toc) <= end && xing[0] == 'X') {
+            memcpy(pInstance->toc, p, sizeof(pInstance->toc));
+            pInstance->has_toc = true;
+        }
+    } else if (vbri + 18 <= end && memcmp(vbri, "VBRI", 4) == 0) {
+        pInstance->audio_bytes = read_be32(vbri + 10);
+        pInstance->total_frames = read_be32(vbri + 14);
+    }
+
+    LOGI_1("first frame at %ld, %u bps, %u frames, %u bytes, toc %d", pInstance->audio_start,
+           (unsigned)pInstance->bitrate, (unsigned)pInstance->total_frames,
+           (unsigned)pInstance->audio_bytes, pInstance->has_toc);
+}
+
+bool is_mp3(audio_source_t *src, mp3_instance *pInstance) {
     bool is_mp3_file = false;
 
-    fseek(fp, 0, SEEK_SET);
+    audio_source_seek(src, 0, SEEK_SET);
 
     // see https://en.wikipedia.org/wiki/List_of_file_signatures
     uint8_t magic[3];
-    if(sizeof(magic) == fread(magic, 1, sizeof(magic), fp)) {
+    if(sizeof(magic) == audio_source_read(src, magic, sizeof(magic))) {
         if((magic[0] == 0xFF) &&
             (magic[1] == 0xFB))
         {
@@ -28,11 +162,11 @@ bool is_mp3(FILE *fp) {
                   (magic[1] == 0x44) &&
                   (magic[2] == 0x33)) /* 'ID3' */
         {
-            fseek(fp, 0, SEEK_SET);
+            audio_source_seek(src, 0, SEEK_SET);
 
             /* Get ID3 head */
             mp3_id3_header_v2_t tag;
-            if (sizeof(mp3_id3_header_v2_t) == fread(&tag, 1, sizeof(mp3_id3_header_v2_t), fp)) {
+            if (sizeof(mp3_id3_header_v2_t) == audio_source_read(src, &tag, sizeof(mp3_id3_header_v2_t))) {
                 if (memcmp("ID3", (const void *) &tag, sizeof(tag.header)) == 0) {
                     is_mp3_file = true;
                 }
@@ -40,44 +174,24 @@ bool is_mp3(FILE *fp) {
         }
     }
 
+    if (is_mp3_file) {
+        read_layout(src, pInstance);
+    }
+
     // seek back to the start of the file to avoid
     // missing frames upon decode
-    fseek(fp, 0, SEEK_SET);
+    audio_source_seek(src, 0, SEEK_SET);
 
     return is_mp3_file;
 }
 
 /**
- * @return true if data remains, false on error or end of file
+ * Decode the next frame from pInstance->read_ptr, which may point into
+ * data_buf or directly into a memory backed source.
  */
-DECODE_STATUS decode_mp3(HMP3Decoder mp3_decoder, FILE *fp, decode_data *pData, mp3_instance *pInstance) {
+static DECODE_STATUS decode_frame(HMP3Decoder mp3_decoder, decode_data *pData, mp3_instance *pInstance, size_t unread_bytes) {
     MP3FrameInfo frame_info;
 
-    size_t unread_bytes = pInstance->bytes_in_data_buf - (pInstance->read_ptr - pInstance->data_buf);
-
-    /* somewhat arbitrary trigger to refill buffer - should always be enough for a full frame */
-    if (unread_bytes < 1.25 * MAINBUF_SIZE && !pInstance->eof_reached) {
-        uint8_t *write_ptr = pInstance->data_buf + unread_bytes;
-        size_t free_space = pInstance->data_buf_size - unread_bytes;
-
-    	/* move last, small chunk from end of buffer to start,
-           then fill with new data */
-        memmove(pInstance->data_buf, pInstance->read_ptr, unread_bytes);
-
-        size_t nRead = fread(write_ptr, 1, free_space, fp);
-
-        pInstance->bytes_in_data_buf = unread_bytes + nRead;
-        pInstance->read_ptr = pInstance->data_buf;
-
-        if ((nRead == 0) || feof(fp)) {
-            pInstance->eof_reached = true;
-        }
-
-        LOGI_2("pos %ld, nRead %d, eof %d", ftell(fp), nRead, pInstance->eof_reached);
-
-        unread_bytes = pInstance->bytes_in_data_buf;
-    }
-
     LOGI_3("data_buf 0x%p, read 0x%p", pInstance->data_buf, pInstance->read_ptr);
 
     if(unread_bytes == 0) {
@@ -167,3 +281,98 @@ DECODE_STATUS decode_mp3(HMP3Decoder mp3_decoder, FILE *fp, decode_data *pData,
 
     return DECODE_STATUS_CONTINUE;
 }
+
+/**
+ * @return true if data remains, false on error or end of file
+ */
+DECODE_STATUS decode_mp3(HMP3Decoder mp3_decoder, audio_source_t *src, decode_data *pData, mp3_instance *pInstance) {
+    size_t span_len;
+    const uint8_t *span = audio_source_peek(src, &span_len);
+    if (span) {
+        // memory backed source: decode in place, data_buf stays unused.
+        // libhelix only reads through the pointer it is given
+        pInstance->read_ptr = const_cast<uint8_t *>(span);
+        pInstance->bytes_in_data_buf = span_len;
+        // what the buffered path would see once the last read came up short
+        pInstance->eof_reached = span_len <= pInstance->data_buf_size;
+
+        DECODE_STATUS status = decode_frame(mp3_decoder, pData, pInstance, span_len);
+        audio_source_seek(src, (long)(pInstance->read_ptr - span), SEEK_CUR);
+        return status;
+    }
+
+    size_t unread_bytes = pInstance->bytes_in_data_buf - (pInstance->read_ptr - pInstance->data_buf);
+
+    /* somewhat arbitrary trigger to refill buffer - should always be enough for a full frame */
+    if (unread_bytes < 1.25 * MAINBUF_SIZE && !pInstance->eof_reached) {
+        uint8_t *write_ptr = pInstance->data_buf + unread_bytes;
+        size_t free_space = pInstance->data_buf_size - unread_bytes;
+
+    	/* move last, small chunk from end of buffer to start,
+           then fill with new data */
+        memmove(pInstance->data_buf, pInstance->read_ptr, unread_bytes);
+
+        size_t nRead = audio_source_read(src, write_ptr, free_space);
+
+        pInstance->bytes_in_data_buf = unread_bytes + nRead;
+        pInstance->read_ptr = pInstance->data_buf;
+
+        if ((nRead == 0) || audio_source_eof(src)) {
+            pInstance->eof_reached = true;
+        }
+
+        LOGI_2("pos %ld, nRead %d, eof %d", audio_source_tell(src), nRead, pInstance->eof_reached);
+
+        unread_bytes = pInstance->bytes_in_data_buf;
+    }
+
+    return decode_frame(mp3_decoder, pData, pInstance, unread_bytes);
+}
+
+bool seek_mp3(audio_source_t *src, mp3_instance *pInstance, uint32_t position_ms) {
+    if (pInstance->bitrate == 0) {
+        ESP_LOGE(TAG, "stream layout unknown, cannot seek");
+        return false;
+    }
+
+    uint64_t bytes = pInstance->audio_bytes;
+    if (bytes == 0 && audio_source_seek(src, 0, SEEK_END) == 0 &&
+        audio_source_tell(src) > pInstance->audio_start) {
+        bytes = audio_source_tell(src) - pInstance->audio_start;
+    }
+    uint64_t duration_ms = 0;
+    if (pInstance->total_frames) {
+        duration_ms = (uint64_t)pInstance->total_frames * pInstance->samples_per_frame * 1000 / pInstance->sample_rate;
+    }
+
+    uint64_t delta;
+    if (duration_ms && bytes) {
+        uint64_t ms = position_ms < duration_ms ? position_ms : duration_ms;
+        if (pInstance->has_toc) {
+            // percent of the duration with 8 fraction bits, interpolated between TOC entries
+            uint32_t pct = (uint32_t)(ms * 100 * 256 / duration_ms);
+            uint32_t index = pct >> 8;
+            uint32_t a = index < 100 ? pInstance->toc[index] : 256;
+            uint32_t b = index < 99 ? pInstance->toc[index + 1] : 256;
+            delta = bytes * (a * 256 + (b - a) * (pct & 0xFF)) / 65536;
+        } else {
+            delta = bytes * ms / duration_ms;
+        }
+    } else {
+        delta = (uint64_t)position_ms * pInstance->bitrate / 8000;
+    }
+
+    long offset = pInstance->audio_start + (long)delta;
+    if (audio_source_seek(src, offset, SEEK_SET) != 0) {
+        return false;
+    }
+
+    // drop buffered data, decode_mp3() resyncs on the next frame header
+    pInstance->bytes_in_data_buf = 0;
+    pInstance->read_ptr = pInstance->data_buf;
+    pInstance->eof_reached = false;
+
+    LOGI_1("seek to %d ms, offset %ld", (int)position_ms, offset);
+
+    return true;
+}
@@ -1,6 +1,6 @@
 #pragma once
 
-#include <stdio.h>
+#include "audio_source.h"
 #include "audio_decode_types.h"
 #include "mp3dec.h"
 
@@ -42,7 +42,42 @@ typedef struct {
 
     // set to true if the end of file has been reached
     bool eof_reached;
+
+    // Stream layout found by is_mp3(). seek_mp3() works from these rather than
+    // from the decoder, which has no frame info before the first decode and
+    // still holds the previous track's right after a track change.
+
+    /** file offset of the first frame header, after any ID3v2 tag */
+    long audio_start;
+
+    /** bits per second of the first frame, the whole stream if CBR */
+    uint32_t bitrate;
+
+    uint32_t sample_rate;
+    uint32_t samples_per_frame;
+
+    /** from a Xing/Info or VBRI header in the first frame, 0 if not present */
+    uint32_t total_frames;
+    uint32_t audio_bytes;   /*!< bytes from audio_start, including the header frame */
+
+    /** Xing TOC: byte position as 1/256 of audio_bytes at each 1% of the duration */
+    bool has_toc;
+    uint8_t toc[100];
 } mp3_instance;
 
-bool is_mp3(FILE *fp);
-DECODE_STATUS decode_mp3(HMP3Decoder mp3_decoder, FILE *fp, decode_data *pData, mp3_instance *pInstance);
+/**
+ * @brief Check for an mp3 stream and read its layout into pInstance
+ *
+ * Uses pInstance->data_buf as scratch space, decoding state is not touched.
+ */
+bool is_mp3(audio_source_t *src, mp3_instance *pInstance);
+DECODE_STATUS decode_mp3(HMP3Decoder mp3_decoder, audio_source_t *src, decode_data *pData, mp3_instance *pInstance);
+
+/**
+ * @brief Estimate the byte position of 'position_ms' and restart decoding there
+ *
+ * Uses the Xing TOC when present, else the frame count and byte size from a
+ * VBR header, else the bitrate of the first frame. Works before any frame of
+ * the current stream has been decoded.
+ */
+bool seek_mp3(audio_source_t *src, mp3_instance *pInstance, uint32_t position_ms);
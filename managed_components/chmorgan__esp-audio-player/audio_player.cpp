@@ -38,6 +38,12 @@
 
 #include "audio_wav.h"
 #include "audio_mp3.h"
+#include "audio_flac.h"
+#include "audio_convert.h"
+#include "audio_source.h"
+#if defined(CONFIG_AUDIO_PLAYER_ENABLE_AAC)
+#include "audio_m4a.h"
+#endif
 
 static const char *TAG = "audio";
 
@@ -47,6 +53,7 @@ typedef enum {
     AUDIO_PLAYER_REQUEST_RESUME,             /**< resumed paused playback */
     AUDIO_PLAYER_REQUEST_PLAY,               /**< initiate playing a new file */
     AUDIO_PLAYER_REQUEST_STOP,               /**< stop playback */
+    AUDIO_PLAYER_REQUEST_SEEK,               /**< move playback position of the current file */
     AUDIO_PLAYER_REQUEST_SHUTDOWN_THREAD,    /**< shutdown audio playback thread */
     AUDIO_PLAYER_REQUEST_MAX
 } audio_player_event_type_t;
@@ -54,8 +61,11 @@ typedef enum {
 typedef struct {
     audio_player_event_type_t type;
 
-    // valid if type == AUDIO_PLAYER_EVENT_TYPE_PLAY
-    FILE* fp;
+    // valid if type == AUDIO_PLAYER_EVENT_TYPE_PLAY, owned by the audio task once queued
+    audio_source_t src;
+
+    // valid if type == AUDIO_PLAYER_REQUEST_SEEK
+    uint32_t position_ms;
 } audio_player_event_t;
 
 typedef enum {
@@ -64,7 +74,13 @@ typedef enum {
     FILE_TYPE_MP3,
 #endif
 #if defined(CONFIG_AUDIO_PLAYER_ENABLE_WAV)
-    FILE_TYPE_WAV
+    FILE_TYPE_WAV,
+#endif
+#if defined(CONFIG_AUDIO_PLAYER_ENABLE_FLAC)
+    FILE_TYPE_FLAC,
+#endif
+#if defined(CONFIG_AUDIO_PLAYER_ENABLE_AAC)
+    FILE_TYPE_M4A,
 #endif
 } FILE_TYPE;
 
@@ -84,8 +100,19 @@ typedef struct audio_instance {
     void *audio_cb_usrt_ctx;
     audio_player_state_t state;
 
+    /* **************** STOP AND WAIT **************** */
+    volatile bool source_open;      // the audio task holds a source from a PLAY request
+    volatile bool discard;          // close queued PLAY sources without playing them
+
     audio_player_config_t config;
 
+    /* **************** PLAYBACK POSITION **************** */
+    // position_base_ms at the last seek or rate change, plus the frames written since
+    uint32_t position_base_ms;
+    uint64_t position_frames;
+    uint32_t position_rate;
+    volatile uint32_t position_ms;
+
 #if defined(CONFIG_AUDIO_PLAYER_ENABLE_WAV)
     wav_instance wav_data;
 #endif
@@ -94,6 +121,15 @@ typedef struct audio_instance {
     HMP3Decoder mp3_decoder;
     mp3_instance mp3_data;
 #endif
+
+#if defined(CONFIG_AUDIO_PLAYER_ENABLE_FLAC)
+    flac_instance flac_data;
+#endif
+
+#if defined(CONFIG_AUDIO_PLAYER_ENABLE_AAC)
+    HAACDecoder aac_decoder;
+    m4a_instance m4a_data;
+#endif
 } audio_instance_t;
 
 static audio_instance_t instance;
@@ -102,6 +138,53 @@ audio_player_state_t audio_player_get_state() {
     return instance.state;
 }
 
+uint32_t audio_player_get_position(void) {
+    return instance.position_ms;
+}
+
+static void position_set(audio_instance_t *i, uint32_t position_ms)
+{
+    i->position_base_ms = position_ms;
+    i->position_frames = 0;
+    i->position_ms = position_ms;
+}
+
+static void position_advance(audio_instance_t *i, uint32_t sample_rate, size_t frames)
+{
+    if(sample_rate == 0) return;
+    if(sample_rate != i->position_rate) {
+        i->position_rate = sample_rate;
+        position_set(i, i->position_ms);
+    }
+    i->position_frames += frames;
+    i->position_ms = i->position_base_ms + (uint32_t)(i->position_frames * 1000 / sample_rate);
+}
+
+esp_err_t audio_player_get_spectrum(uint32_t *bands, uint32_t *seq)
+{
+#if defined(CONFIG_AUDIO_PLAYER_ENABLE_SPECTRUM)
+    static_assert(MP3_NBANDS == AUDIO_PLAYER_SPECTRUM_BANDS, "band count mismatch");
+    ESP_RETURN_ON_FALSE(NULL != bands, ESP_ERR_INVALID_ARG, TAG, "bands is NULL");
+
+    unsigned int energy[MP3_NBANDS];
+    unsigned int energy_seq = 0;
+    if(MP3GetSubbandEnergy(instance.mp3_decoder, energy, &energy_seq) != 0) {
+        return ESP_ERR_INVALID_STATE;
+    }
+
+    for(int b = 0; b < AUDIO_PLAYER_SPECTRUM_BANDS; b++) {
+        bands[b] = energy[b];
+    }
+    if(seq) *seq = energy_seq;
+
+    return ESP_OK;
+#else
+    (void)bands;
+    (void)seq;
+    return ESP_ERR_NOT_SUPPORTED;
+#endif
+}
+
 esp_err_t audio_player_callback_register(audio_player_cb_t call_back, void *user_ctx)
 {
 #if CONFIG_IDF_TARGET_ARCH_XTENSA
@@ -193,61 +276,81 @@ static void audio_instance_init(audio_instance_t &i) {
     i.state = AUDIO_PLAYER_STATE_IDLE;
 }
 
-static esp_err_t mono_to_stereo(uint32_t output_bits_per_sample, decode_data &adata)
+static void seek_file(audio_instance_t *i, audio_source_t *src, FILE_TYPE file_type, uint32_t position_ms)
 {
-    size_t data = adata.frame_count * (output_bits_per_sample / BITS_PER_BYTE);
-    data *= 2;
+    bool ok = false;
 
-    // do we have enough space in the output buffer to convert mono to stereo?
-    if(data > adata.samples_capacity_max) {
-        ESP_LOGE(TAG, "insufficient space in output.samples to convert mono to stereo, need %d, have %d", data, adata.samples_capacity_max);
-        return ESP_ERR_NO_MEM;
+    switch(file_type) {
+#if defined(CONFIG_AUDIO_PLAYER_ENABLE_MP3)
+        case FILE_TYPE_MP3:
+            ok = seek_mp3(src, &i->mp3_data, position_ms);
+            break;
+#endif
+#if defined(CONFIG_AUDIO_PLAYER_ENABLE_WAV)
+        case FILE_TYPE_WAV:
+            ok = seek_wav(src, &i->wav_data, position_ms);
+            break;
+#endif
+#if defined(CONFIG_AUDIO_PLAYER_ENABLE_FLAC)
+        case FILE_TYPE_FLAC:
+            ok = seek_flac(src, &i->flac_data, (uint64_t)position_ms * i->flac_data.sample_rate / 1000);
+            break;
+#endif
+#if defined(CONFIG_AUDIO_PLAYER_ENABLE_AAC)
+        case FILE_TYPE_M4A:
+            ok = seek_m4a(src, &i->m4a_data, position_ms);
+            break;
+#endif
+        default:
+            break;
     }
 
-    size_t new_sample_count = adata.frame_count * 2;
-
-    // convert from back to front to allow conversion in-place
-    //
-    // NOTE: -1 is because we want to shift to the sample at position X
-    //       but if we do (ptr + X) we end up at the sample at index X instead
-    //       which is one further
-    int16_t *out = reinterpret_cast<int16_t*>(adata.samples) + (new_sample_count - 1);
-    int16_t *in = reinterpret_cast<int16_t*>(adata.samples) + (adata.frame_count - 1);
-    size_t samples = adata.frame_count;
-    while(samples) {
-        // write right channel
-        *out = *in;
-        out--;
-
-        // write left channel
-        *out = *in;
-        out--;
-
-        // move input buffer back and decrement samples
-        in--;
-        samples--;
+    if(!ok) {
+        ESP_LOGE(TAG, "seek to %u ms failed", (unsigned)position_ms);
+    } else {
+        position_set(i, position_ms);
     }
-
-    // adjust channels to 2
-    adata.fmt.channels = 2;
-
-    return ESP_OK;
 }
 
-static esp_err_t aplay_file(audio_instance_t *i, FILE *fp)
+static esp_err_t aplay_file(audio_instance_t *i, audio_source_t *src)
 {
     LOGI_1("start to decode");
 
     format i2s_format;
     memset(&i2s_format, 0, sizeof(i2s_format));
 
+    // conversion kernel for the current decoder output format, chosen when it changes
+    format decoded_format;
+    memset(&decoded_format, 0, sizeof(decoded_format));
+    memset(&i->output.fmt, 0, sizeof(i->output.fmt));
+    position_set(i, 0);
+    audio_convert_fn convert = NULL;
+    audio_convert_state convert_state = { .dither_seed = 1, .channels = 0 };
+
     esp_err_t ret = ESP_OK;
-    audio_player_event_t audio_event = { .type = AUDIO_PLAYER_REQUEST_NONE, .fp = NULL };
+    audio_player_event_t audio_event = { .type = AUDIO_PLAYER_REQUEST_NONE };
 
     FILE_TYPE file_type = FILE_TYPE_UNKNOWN;
 
+#if defined(CONFIG_AUDIO_PLAYER_ENABLE_FLAC)
+    // checked before mp3 as flac files may start with an ID3 tag too
+    if(is_flac(src, &i->flac_data)) {
+        file_type = FILE_TYPE_FLAC;
+        LOGI_1("file is flac");
+    }
+#endif
+
+#if defined(CONFIG_AUDIO_PLAYER_ENABLE_AAC)
+    // cppcheck-suppress knownConditionTrueFalse
+    if(file_type == FILE_TYPE_UNKNOWN && is_m4a(src, &i->m4a_data)) {
+        file_type = FILE_TYPE_M4A;
+        LOGI_1("file is m4a");
+    }
+#endif
+
 #if defined(CONFIG_AUDIO_PLAYER_ENABLE_MP3)
-    if(is_mp3(fp)) {
+    // cppcheck-suppress knownConditionTrueFalse
+    if(file_type == FILE_TYPE_UNKNOWN && is_mp3(src, &i->mp3_data)) {
         file_type = FILE_TYPE_MP3;
         LOGI_1("file is mp3");
 
@@ -263,7 +366,7 @@ static esp_err_t aplay_file(audio_instance_t *i, FILE *fp)
     // cppcheck-suppress knownConditionTrueFalse
     if(file_type == FILE_TYPE_UNKNOWN)
     {
-        if(is_wav(fp, &i->wav_data)) {
+        if(is_wav(src, &i->wav_data)) {
             file_type = FILE_TYPE_WAV;
             LOGI_1("file is wav");
         }
@@ -292,7 +395,11 @@ static esp_err_t aplay_file(audio_instance_t *i, FILE *fp)
                 while(1) {
                     xQueuePeek(i->event_queue, &audio_event, portMAX_DELAY);
 
-                    if((AUDIO_PLAYER_REQUEST_PLAY != audio_event.type) &&
+                    if(AUDIO_PLAYER_REQUEST_SEEK == audio_event.type) {
+                        // seeking while paused moves the position but stays paused
+                        xQueueReceive(i->event_queue, &audio_event, 0);
+                        seek_file(i, src, file_type, audio_event.position_ms);
+                    } else if((AUDIO_PLAYER_REQUEST_PLAY != audio_event.type) &&
                        (AUDIO_PLAYER_REQUEST_STOP != audio_event.type) &&
                        (AUDIO_PLAYER_REQUEST_RESUME != audio_event.type))
                     {
@@ -317,6 +424,10 @@ static esp_err_t aplay_file(audio_instance_t *i, FILE *fp)
                 (AUDIO_PLAYER_REQUEST_PLAY == audio_event.type)) {
                 ret = ESP_OK;
                 goto clean_up;
+            } else if (AUDIO_PLAYER_REQUEST_SEEK == audio_event.type) {
+                xQueueReceive(i->event_queue, &audio_event, 0);
+                seek_file(i, src, file_type, audio_event.position_ms);
+                continue;
             } else {
                 // receive to discard the event, this event has no
                 // impact on the state of playback
@@ -332,12 +443,22 @@ static esp_err_t aplay_file(audio_instance_t *i, FILE *fp)
         switch(file_type) {
 #if defined(CONFIG_AUDIO_PLAYER_ENABLE_MP3)
             case FILE_TYPE_MP3:
-                decode_status = decode_mp3(i->mp3_decoder, fp, &i->output, &i->mp3_data);
+                decode_status = decode_mp3(i->mp3_decoder, src, &i->output, &i->mp3_data);
                 break;
 #endif
 #if defined(CONFIG_AUDIO_PLAYER_ENABLE_WAV)
             case FILE_TYPE_WAV:
-                decode_status = decode_wav(fp, &i->output, &i->wav_data);
+                decode_status = decode_wav(src, &i->output, &i->wav_data);
+                break;
+#endif
+#if defined(CONFIG_AUDIO_PLAYER_ENABLE_FLAC)
+            case FILE_TYPE_FLAC:
+                decode_status = decode_flac(src, &i->output, &i->flac_data);
+                break;
+#endif
+#if defined(CONFIG_AUDIO_PLAYER_ENABLE_AAC)
+            case FILE_TYPE_M4A:
+                decode_status = decode_m4a(i->aac_decoder, src, &i->output, &i->m4a_data);
                 break;
 #endif
             case FILE_TYPE_UNKNOWN:
@@ -348,14 +469,31 @@ static esp_err_t aplay_file(audio_instance_t *i, FILE *fp)
         // break out and exit if we aren't supposed to continue decoding
         if(decode_status == DECODE_STATUS_CONTINUE)
         {
-            // if mono, convert to stereo as es8311 requires stereo input
-            // even though it is mono output
-            if(i->output.fmt.channels ==  1) {
-                LOGI_3("c == 1, mono -> stereo");
-                ret = mono_to_stereo(i->output.fmt.bits_per_sample, i->output);
-                if(ret != ESP_OK) {
+            if ((decoded_format.sample_rate != i->output.fmt.sample_rate) ||
+                    (decoded_format.channels != i->output.fmt.channels) ||
+                    (decoded_format.bits_per_sample != i->output.fmt.bits_per_sample) ||
+                    (decoded_format.sample_format != i->output.fmt.sample_format)) {
+                decoded_format = i->output.fmt;
+                if(!audio_convert_supported(decoded_format)) {
+                    ESP_LOGE(TAG, "unsupported sample format: bit=%d, ch=%d",
+                        decoded_format.bits_per_sample, decoded_format.channels);
+                    ret = ESP_ERR_NOT_SUPPORTED;
                     goto clean_up;
                 }
+                convert = audio_convert_select(decoded_format);
+                convert_state.channels = decoded_format.channels;
+            }
+
+            // convert to stereo (es8311 requires stereo input even though it is
+            // mono output) and to a bit depth the i2s driver takes
+            if(convert) {
+                size_t data = i->output.frame_count * audio_convert_output_frame_bytes(decoded_format);
+                if(data > i->output.samples_capacity_max) {
+                    ESP_LOGE(TAG, "insufficient space in output.samples to convert, need %d, have %d", data, i->output.samples_capacity_max);
+                    ret = ESP_ERR_NO_MEM;
+                    goto clean_up;
+                }
+                convert(&i->output, &convert_state);
             }
 
             /* Configure I2S clock if the output format changed */
@@ -392,6 +530,7 @@ static esp_err_t aplay_file(audio_instance_t *i, FILE *fp)
             if(bytes_to_write != i2s_bytes_written) {
                 ESP_LOGE(TAG, "to write %d != written %d", bytes_to_write, i2s_bytes_written);
             }
+            position_advance(i, i2s_format.sample_rate, i->output.frame_count);
         } else if(decode_status == DECODE_STATUS_NO_DATA_CONTINUE)
         {
             LOGI_2("no data");
@@ -422,10 +561,15 @@ static void audio_task(void *pvParam)
 
             int retval = xQueuePeek(i->event_queue, &audio_event, delay);
             if (pdPASS == retval) { // item on the queue, process it
+                // counted as open before it leaves the queue, see audio_player_stop_and_wait()
+                i->source_open = (AUDIO_PLAYER_REQUEST_PLAY == audio_event.type);
                 xQueueReceive(i->event_queue, &audio_event, 0);
 
                 // if the item is a play request, process it
-                if(AUDIO_PLAYER_REQUEST_PLAY == audio_event.type) {
+                if(AUDIO_PLAYER_REQUEST_PLAY == audio_event.type && i->discard) {
+                    audio_source_close(&audio_event.src);
+                    i->source_open = false;
+                } else if(AUDIO_PLAYER_REQUEST_PLAY == audio_event.type) {
                     if(i->state == AUDIO_PLAYER_STATE_PLAYING) {
                         dispatch_callback(i, AUDIO_PLAYER_CALLBACK_EVENT_COMPLETED_PLAYING_NEXT);
                     } else {
@@ -452,14 +596,16 @@ static void audio_task(void *pvParam)
         }
 
         i->config.mute_fn(AUDIO_PLAYER_UNMUTE);
-        esp_err_t ret_val = aplay_file(i, audio_event.fp);
+        audio_source_t src = audio_event.src;
+        esp_err_t ret_val = aplay_file(i, &src);
         if(ret_val != ESP_OK)
         {
             ESP_LOGE(TAG, "aplay_file() %d", ret_val);
         }
         i->config.mute_fn(AUDIO_PLAYER_MUTE);
 
-        if(audio_event.fp) fclose(audio_event.fp);
+        audio_source_close(&src);
+        i->source_open = false;
     }
 }
 
@@ -479,31 +625,129 @@ static esp_err_t audio_send_event(audio_instance_t *i, audio_player_event_t even
 esp_err_t audio_player_play(FILE *fp)
 {
     LOGI_1("%s", __FUNCTION__);
-    audio_player_event_t event = { .type = AUDIO_PLAYER_REQUEST_PLAY, .fp = fp };
+    audio_player_event_t event = { .type = AUDIO_PLAYER_REQUEST_PLAY };
+    audio_source_from_file(&event.src, fp);
+    return audio_send_event(&instance, event);
+}
+
+esp_err_t audio_player_play_source(const audio_player_source_t *source)
+{
+    LOGI_1("%s", __FUNCTION__);
+    audio_player_event_t event = { .type = AUDIO_PLAYER_REQUEST_PLAY };
+    esp_err_t ret = audio_source_from_user(&event.src, source);
+    if(ret != ESP_OK) {
+        return ret;
+    }
+    ret = audio_send_event(&instance, event);
+    if(ret != ESP_OK) {
+        // the caller keeps ownership on failure
+        audio_source_detach(&event.src);
+    }
+    return ret;
+}
+
+esp_err_t audio_player_play_memory(const void *data, size_t len)
+{
+    audio_player_source_t source = { .ops = NULL, .ctx = NULL, .data = data, .len = len };
+    return audio_player_play_source(&source);
+}
+
+esp_err_t audio_player_play_fatfs(const char *path)
+{
+    LOGI_1("%s %s", __FUNCTION__, path);
+#if defined(CONFIG_AUDIO_PLAYER_FATFS_SOURCE)
+    audio_player_event_t event = { .type = AUDIO_PLAYER_REQUEST_PLAY };
+    esp_err_t ret = audio_source_open_fatfs(&event.src, path);
+    if(ret != ESP_OK) {
+        return ret;
+    }
+    ret = audio_send_event(&instance, event);
+    if(ret != ESP_OK) {
+        audio_source_close(&event.src);
+    }
+    return ret;
+#else
+    (void)path;
+    return ESP_ERR_NOT_SUPPORTED;
+#endif
+}
+
+esp_err_t audio_player_seek(uint32_t position_ms)
+{
+    LOGI_1("%s %u", __FUNCTION__, (unsigned)position_ms);
+    audio_player_event_t event = { .type = AUDIO_PLAYER_REQUEST_SEEK, .position_ms = position_ms };
     return audio_send_event(&instance, event);
 }
 
 esp_err_t audio_player_pause(void)
 {
     LOGI_1("%s", __FUNCTION__);
-    audio_player_event_t event = { .type = AUDIO_PLAYER_REQUEST_PAUSE, .fp = NULL };
+    audio_player_event_t event = { .type = AUDIO_PLAYER_REQUEST_PAUSE };
     return audio_send_event(&instance, event);
 }
 
 esp_err_t audio_player_resume(void)
 {
     LOGI_1("%s", __FUNCTION__);
-    audio_player_event_t event = { .type = AUDIO_PLAYER_REQUEST_RESUME, .fp = NULL };
+    audio_player_event_t event = { .type = AUDIO_PLAYER_REQUEST_RESUME };
     return audio_send_event(&instance, event);
 }
 
 esp_err_t audio_player_stop(void)
 {
     LOGI_1("%s", __FUNCTION__);
-    audio_player_event_t event = { .type = AUDIO_PLAYER_REQUEST_STOP, .fp = NULL };
+    audio_player_event_t event = { .type = AUDIO_PLAYER_REQUEST_STOP };
     return audio_send_event(&instance, event);
 }
 
+esp_err_t audio_player_stop_and_wait(uint32_t timeout_ms)
+{
+    LOGI_1("%s", __FUNCTION__);
+    audio_instance_t *i = &instance;
+    ESP_RETURN_ON_FALSE(NULL != i->event_queue, ESP_ERR_INVALID_STATE,
+        TAG, "Audio task not started yet");
+
+    // set before the stop so a PLAY queued behind it is closed, not started
+    i->discard = true;
+    TickType_t start = xTaskGetTickCount();
+    bool stop_sent = false;
+    esp_err_t ret = ESP_OK;
+    while(i->source_open || uxQueueMessagesWaiting(i->event_queue) > 0) {
+        // retried while the queue is full; a STOP behind a PLAY ends it once it has started
+        if(i->source_open && !stop_sent) {
+            audio_player_event_t event = { .type = AUDIO_PLAYER_REQUEST_STOP };
+            stop_sent = xQueueSend(i->event_queue, &event, 0) == pdPASS;
+        }
+        if(xTaskGetTickCount() - start >= pdMS_TO_TICKS(timeout_ms)) {
+            ret = ESP_ERR_TIMEOUT;
+            break;
+        }
+        vTaskDelay(pdMS_TO_TICKS(10));
+        if(!i->source_open) {
+            stop_sent = false;
+        }
+    }
+    i->discard = false;
+    return ret;
+}
+
+esp_err_t audio_player_fatfs_suspend(uint32_t timeout_ms)
+{
+#if defined(CONFIG_AUDIO_PLAYER_FATFS_SOURCE)
+    return audio_source_fatfs_suspend(timeout_ms);
+#else
+    (void)timeout_ms;
+    return ESP_OK;
+#endif
+}
+
+void audio_player_fatfs_resume(void)
+{
+#if defined(CONFIG_AUDIO_PLAYER_FATFS_SOURCE)
+    audio_source_fatfs_resume();
+#endif
+}
+
 /**
  * Can only shut down the playback thread if the thread is not presently playing audio.
  * Call audio_player_stop()
@@ -511,7 +755,7 @@ esp_err_t audio_player_stop(void)
 static esp_err_t _internal_audio_player_shutdown_thread(void)
 {
     LOGI_1("%s", __FUNCTION__);
-    audio_player_event_t event = { .type = AUDIO_PLAYER_REQUEST_SHUTDOWN_THREAD, .fp = NULL };
+    audio_player_event_t event = { .type = AUDIO_PLAYER_REQUEST_SHUTDOWN_THREAD };
     return audio_send_event(&instance, event);
 }
 
@@ -520,6 +764,13 @@ static void cleanup_memory(audio_instance_t &i)
 #if defined(CONFIG_AUDIO_PLAYER_ENABLE_MP3)
     if(i.mp3_decoder) MP3FreeDecoder(i.mp3_decoder);
     if(i.mp3_data.data_buf) free(i.mp3_data.data_buf);
+#endif
+#if defined(CONFIG_AUDIO_PLAYER_ENABLE_FLAC)
+    flac_instance_free(&i.flac_data);
+#endif
+#if defined(CONFIG_AUDIO_PLAYER_ENABLE_AAC)
+    if(i.aac_decoder) AACFreeDecoder(i.aac_decoder);
+    m4a_instance_free(&i.m4a_data);
 #endif
     if(i.output.samples) free(i.output.samples);
 
@@ -541,6 +792,12 @@ esp_err_t audio_player_new(audio_player_config_t config)
     /** See https://github.com/ultraembedded/libhelix-mp3/blob/0a0e0673f82bc6804e5a3ddb15fb6efdcde747cd/testwrap/main.c#L74 */
     instance.output.samples_capacity = MAX_NCHAN * MAX_NGRAN * MAX_NSAMP;
     instance.output.samples_capacity_max = instance.output.samples_capacity * 2;
+#if defined(CONFIG_AUDIO_PLAYER_ENABLE_AAC)
+    // an AAC access unit is 1024 frames, doubled when the decoder applies SBR
+    if(instance.output.samples_capacity_max < AAC_MAX_NCHANS * AAC_MAX_NSAMPS * 2 * sizeof(short)) {
+        instance.output.samples_capacity_max = AAC_MAX_NCHANS * AAC_MAX_NSAMPS * 2 * sizeof(short);
+    }
+#endif
     instance.output.samples = static_cast<uint8_t*>(malloc(instance.output.samples_capacity_max));
     LOGI_1("samples_capacity %d bytes", instance.output.samples_capacity_max);
     int ret = ESP_OK;
@@ -556,6 +813,16 @@ esp_err_t audio_player_new(audio_player_config_t config)
     instance.mp3_decoder = MP3InitDecoder();
     ESP_GOTO_ON_FALSE(NULL != instance.mp3_decoder, ESP_ERR_NO_MEM, cleanup,
         TAG, "Failed create MP3 decoder");
+
+#if defined(CONFIG_AUDIO_PLAYER_ENABLE_SPECTRUM)
+    MP3EnableSubbandEnergy(instance.mp3_decoder, 1);
+#endif
+#endif
+
+#if defined(CONFIG_AUDIO_PLAYER_ENABLE_AAC)
+    instance.aac_decoder = AACInitDecoder();
+    ESP_GOTO_ON_FALSE(NULL != instance.aac_decoder, ESP_ERR_NO_MEM, cleanup,
+        TAG, "Failed create AAC decoder");
 #endif
 
     instance.running = true;
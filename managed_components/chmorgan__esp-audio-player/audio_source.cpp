@@ -0,0 +1,194 @@
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+
+#include "audio_source.h"
+
+/* **************** STDIO BACKEND **************** */
+
+static size_t file_read(void *ctx, void *buf, size_t len)
+{
+    return fread(buf, 1, len, (FILE *)ctx);
+}
+
+static int file_seek(void *ctx, long offset)
+{
+    return fseek((FILE *)ctx, offset, SEEK_SET);
+}
+
+static long file_size(void *ctx)
+{
+    struct stat st;
+    if(fstat(fileno((FILE *)ctx), &st) != 0) {
+        return -1;
+    }
+    return (long)st.st_size;
+}
+
+static void file_close(void *ctx)
+{
+    fclose((FILE *)ctx);
+}
+
+static const audio_source_ops_t file_ops = {
+    .read = file_read,
+    .seek = file_seek,
+    .size = file_size,
+    .close = file_close,
+};
+
+void audio_source_from_file(audio_source_t *src, FILE *fp)
+{
+    src->ops = &file_ops;
+    src->ctx = fp;
+    src->pos = ftell(fp);
+    src->eof = false;
+    src->span = NULL;
+    src->span_len = 0;
+}
+
+/* **************** MEMORY BACKEND **************** */
+
+typedef struct {
+    const uint8_t *data;
+    size_t len;
+    size_t pos;
+    void (*release)(void *ctx);     /*!< close callback of a user span */
+    void *release_ctx;
+} memory_source;
+
+static size_t memory_read(void *ctx, void *buf, size_t len)
+{
+    memory_source *m = (memory_source *)ctx;
+    size_t n = m->pos < m->len ? m->len - m->pos : 0;
+    if(n > len) n = len;
+    memcpy(buf, m->data + m->pos, n);
+    m->pos += n;
+    return n;
+}
+
+static int memory_seek(void *ctx, long offset)
+{
+    ((memory_source *)ctx)->pos = (size_t)offset;
+    return 0;
+}
+
+static long memory_size(void *ctx)
+{
+    return (long)((memory_source *)ctx)->len;
+}
+
+static void memory_close(void *ctx)
+{
+    memory_source *m = (memory_source *)ctx;
+    if(m->release) {
+        m->release(m->release_ctx);
+    }
+    free(m);
+}
+
+static const audio_source_ops_t memory_ops = {
+    .read = memory_read,
+    .seek = memory_seek,
+    .size = memory_size,
+    .close = memory_close,
+};
+
+esp_err_t audio_source_from_memory(audio_source_t *src, const void *data, size_t len)
+{
+    memory_source *m = (memory_source *)malloc(sizeof(memory_source));
+    if(!m) {
+        return ESP_ERR_NO_MEM;
+    }
+    m->data = (const uint8_t *)data;
+    m->len = len;
+    m->pos = 0;
+    m->release = NULL;
+    m->release_ctx = NULL;
+
+    src->ops = &memory_ops;
+    src->ctx = m;
+    src->pos = 0;
+    src->eof = false;
+    src->span = m->data;
+    src->span_len = len;
+    return ESP_OK;
+}
+
+/* **************** USER SOURCES **************** */
+
+esp_err_t audio_source_from_user(audio_source_t *src, const audio_player_source_t *source)
+{
+    if(source->data) {
+        esp_err_t ret = audio_source_from_memory(src, source->data, source->len);
+        if(ret == ESP_OK && source->ops) {
+            memory_source *m = (memory_source *)src->ctx;
+            m->release = source->ops->close;
+            m->release_ctx = source->ctx;
+        }
+        return ret;
+    }
+
+    if(!source->ops || !source->ops->read || !source->ops->seek) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    src->ops = source->ops;
+    src->ctx = source->ctx;
+    src->pos = 0;
+    src->eof = false;
+    src->span = NULL;
+    src->span_len = 0;
+    return ESP_OK;
+}
+
+void audio_source_detach(audio_source_t *src)
+{
+    if(src->ops == &memory_ops) {
+        ((memory_source *)src->ctx)->release = NULL;
+        audio_source_close(src);
+    }
+    src->ops = NULL;
+    src->ctx = NULL;
+}
+
+/* **************** STDIO-LIKE HELPERS **************** */
+
+size_t audio_source_read(audio_source_t *src, void *buf, size_t len)
+{
+    size_t n = src->ops->read(src->ctx, buf, len);
+    src->pos += (long)n;
+    if(n < len) {
+        src->eof = true;
+    }
+    return n;
+}
+
+int audio_source_seek(audio_source_t *src, long offset, int whence)
+{
+    long target = offset;
+    if(whence == SEEK_CUR) {
+        target += src->pos;
+    } else if(whence == SEEK_END) {
+        long size = src->ops->size ? src->ops->size(src->ctx) : -1;
+        if(size < 0) {
+            return -1;
+        }
+        target += size;
+    }
+    if(target < 0 || src->ops->seek(src->ctx, target) != 0) {
+        return -1;
+    }
+    src->pos = target;
+    src->eof = false;
+    return 0;
+}
+
+void audio_source_close(audio_source_t *src)
+{
+    if(src->ops && src->ops->close) {
+        src->ops->close(src->ctx);
+    }
+    src->ops = NULL;
+    src->ctx = NULL;
+}
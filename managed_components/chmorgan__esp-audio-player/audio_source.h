@@ -0,0 +1,95 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+
+#include "esp_err.h"
+#include "sdkconfig.h"
+#include "audio_player.h"
+
+/**
+ * Byte stream the decoders read from.
+ *
+ * Backends use the public audio_player_source_ops_t and only implement
+ * absolute positioning; the stdio-like helpers below track the position and
+ * eof flag so the decoders keep their fread/fseek/ftell/feof structure.
+ * Memory backed sources also expose the span so decoders can parse in place.
+ */
+typedef audio_player_source_ops_t audio_source_ops_t;
+
+typedef struct {
+    const audio_source_ops_t *ops;
+    void *ctx;
+    long pos;
+    bool eof;
+    const uint8_t *span;    /*!< whole stream when memory backed, else NULL */
+    size_t span_len;
+} audio_source_t;
+
+/**
+ * @brief Wrap a FILE*, the source takes ownership and fclose()s it on close
+ */
+void audio_source_from_file(audio_source_t *src, FILE *fp);
+
+/**
+ * @brief Read from memory that stays valid until playback ends, e.g. a
+ *        memory-mapped flash partition. The span is visible to the decoders
+ *        through audio_source_peek().
+ */
+esp_err_t audio_source_from_memory(audio_source_t *src, const void *data, size_t len);
+
+/**
+ * @brief Set up from a public source description, see audio_player_play_source()
+ */
+esp_err_t audio_source_from_user(audio_source_t *src, const audio_player_source_t *source);
+
+/**
+ * @brief Drop a source from audio_source_from_user() without calling the user's close
+ */
+void audio_source_detach(audio_source_t *src);
+
+#if defined(CONFIG_AUDIO_PLAYER_FATFS_SOURCE)
+/**
+ * @brief Open a file through FatFs directly, bypassing VFS and newlib stdio
+ *
+ * @param path FatFs path including the drive prefix, e.g. "0:/music/a.mp3"
+ * @return ESP_ERR_NOT_FOUND if f_open fails, ESP_ERR_NO_MEM if no DMA capable
+ *         read buffer could be allocated
+ */
+esp_err_t audio_source_open_fatfs(audio_source_t *src, const char *path);
+
+/**
+ * @brief See audio_player_fatfs_suspend() and audio_player_fatfs_resume()
+ */
+esp_err_t audio_source_fatfs_suspend(uint32_t timeout_ms);
+void audio_source_fatfs_resume(void);
+#endif
+
+size_t audio_source_read(audio_source_t *src, void *buf, size_t len);
+
+/**
+ * @brief fseek() equivalent, returns 0 on success and clears the eof flag
+ */
+int audio_source_seek(audio_source_t *src, long offset, int whence);
+
+static inline long audio_source_tell(const audio_source_t *src) { return src->pos; }
+
+static inline bool audio_source_eof(const audio_source_t *src) { return src->eof; }
+
+/**
+ * @brief Bytes from the read position to the end of a memory backed source
+ *
+ * Consume them with audio_source_seek(src, n, SEEK_CUR).
+ * @return NULL when the source is streamed, read it with audio_source_read()
+ */
+static inline const uint8_t *audio_source_peek(const audio_source_t *src, size_t *avail)
+{
+    if(!src->span) return NULL;
+    size_t pos = (size_t)src->pos < src->span_len ? (size_t)src->pos : src->span_len;
+    *avail = src->span_len - pos;
+    return src->span + pos;
+}
+
+void audio_source_close(audio_source_t *src);
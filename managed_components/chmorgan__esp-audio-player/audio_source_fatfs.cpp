@@ -0,0 +1,378 @@
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "esp_heap_caps.h"
+#include "esp_memory_utils.h"
+#include "esp_log.h"
+#include "ff.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "freertos/queue.h"
+#include "freertos/semphr.h"
+
+#include "audio_log.h"
+#include "audio_source.h"
+
+static const char *TAG = "fatfs_src";
+
+/* SDMMC/SPI DMA needs word alignment; a full cache line also keeps the buffer
+ * safe on targets where internal RAM is accessed through the data cache */
+#define FATFS_BUF_ALIGN     64
+
+/**
+ * Reads go through FatFs directly instead of VFS -> newlib stdio -> FatFs.
+ *
+ * newlib's FILE buffer is 128 bytes by default, so every refill of a decoder
+ * buffer turns into many small f_read() calls that FatFs serves one sector at
+ * a time out of its FIL buffer. Here the stream is refilled in units of whole
+ * clusters (or whole sectors if a cluster is larger than the configured read
+ * size) into a DMA capable buffer, so FatFs hands each refill to the card
+ * driver as a single multi-block transfer without a bounce copy.
+ */
+typedef struct {
+    FIL fil;                /*!< first member, its sector buffer is DMA capable too */
+    uint8_t *buf;
+    size_t buf_size;        /*!< multiple of the cluster size when it fits, else of the sector size */
+    size_t sector_size;
+    FSIZE_t buf_start;      /*!< file offset of buf[0], sector aligned */
+    size_t fill;            /*!< valid bytes in buf */
+    FSIZE_t pos;            /*!< read position, FIL's pointer only moves on refill */
+    int clmt;               /*!< link map pool slot, -1 if none */
+} fatfs_source;
+
+#if defined(CONFIG_AUDIO_PLAYER_FATFS_FASTSEEK)
+/**
+ * Without a cluster link map FatFs follows the FAT chain from the first
+ * cluster on every backward seek, one FAT sector read per 128 clusters in
+ * the best case and one per cluster when the file is fragmented. With the
+ * map (FF_USE_FASTSEEK) a seek is a lookup in a table of fragments.
+ *
+ * Building the map walks the whole chain once, so it is done by a low
+ * priority task on its own FIL while the first frames decode, and only
+ * handed to the playback FIL once complete.
+ */
+#define CLMT_SLOTS          2       // the next track is opened before the current one closes
+#define CLMT_QUEUE_LEN      (CLMT_SLOTS * 2)
+#define CLMT_TASK_STACK     3072
+#define CLMT_TASK_PRIORITY  1
+
+typedef enum {
+    CLMT_FREE,
+    CLMT_QUEUED,
+    CLMT_BUILDING,
+    CLMT_READY,
+    CLMT_FAILED,            /*!< too fragmented for the table, seeks walk the chain */
+} clmt_state;
+
+typedef struct {
+    DWORD tbl[CONFIG_AUDIO_PLAYER_FATFS_CLMT_SIZE];
+    clmt_state state;
+    FIL *owner;             /*!< cleared when the source closes, the slot is freed by whoever finishes last */
+    char *path;             /*!< only needed until the map is built */
+} clmt_slot;
+
+static clmt_slot clmt_pool[CLMT_SLOTS];
+static portMUX_TYPE clmt_lock = portMUX_INITIALIZER_UNLOCKED;
+static QueueHandle_t clmt_queue;
+static SemaphoreHandle_t clmt_busy;     // held from f_open to f_close of clmt_fil
+static volatile bool clmt_suspended;    // volume about to be unmounted, see audio_source_fatfs_suspend()
+static FIL clmt_fil;
+
+static void clmt_task(void *arg)
+{
+    int idx;
+    while(xQueueReceive(clmt_queue, &idx, portMAX_DELAY) == pdPASS) {
+        clmt_slot *slot = &clmt_pool[idx];
+
+        // stale entry of a source that closed before its map was built, or cancelled by a suspend
+        xSemaphoreTake(clmt_busy, portMAX_DELAY);
+        taskENTER_CRITICAL(&clmt_lock);
+        bool queued = slot->state == CLMT_QUEUED && !clmt_suspended;
+        if(queued) slot->state = CLMT_BUILDING;
+        taskEXIT_CRITICAL(&clmt_lock);
+        if(!queued) {
+            xSemaphoreGive(clmt_busy);
+            continue;
+        }
+
+        FRESULT res = f_open(&clmt_fil, slot->path, FA_READ);
+        if(res == FR_OK) {
+            slot->tbl[0] = CONFIG_AUDIO_PLAYER_FATFS_CLMT_SIZE;
+            clmt_fil.cltbl = slot->tbl;
+            res = f_lseek(&clmt_fil, CREATE_LINKMAP);
+            f_close(&clmt_fil);
+        }
+        xSemaphoreGive(clmt_busy);
+        if(res == FR_NOT_ENOUGH_CORE) {
+            ESP_LOGW(TAG, "%s: %u fragments, link map needs %u entries",
+                     slot->path, (unsigned)(slot->tbl[0] - 1) / 2, (unsigned)slot->tbl[0]);
+        } else if(res == FR_OK) {
+            LOGI_2("%s: link map of %u fragments", slot->path, (unsigned)(slot->tbl[0] - 1) / 2);
+        }
+        free(slot->path);
+        slot->path = NULL;
+
+        taskENTER_CRITICAL(&clmt_lock);
+        if(!slot->owner) {
+            slot->state = CLMT_FREE;
+        } else if(res == FR_OK) {
+            // complete before the playback FIL can see it; f_read and f_lseek only test the pointer
+            slot->owner->cltbl = slot->tbl;
+            slot->state = CLMT_READY;
+        } else {
+            slot->state = CLMT_FAILED;
+        }
+        taskEXIT_CRITICAL(&clmt_lock);
+    }
+    vTaskDelete(NULL);
+}
+
+static void clmt_request(fatfs_source *s, const char *path)
+{
+    if(!clmt_queue) {
+        if(!clmt_busy) {
+            clmt_busy = xSemaphoreCreateMutex();
+            if(!clmt_busy) return;
+        }
+        clmt_queue = xQueueCreate(CLMT_QUEUE_LEN, sizeof(int));
+        if(!clmt_queue) return;
+        if(xTaskCreate(clmt_task, "clmt", CLMT_TASK_STACK, NULL, CLMT_TASK_PRIORITY, NULL) != pdPASS) {
+            vQueueDelete(clmt_queue);
+            clmt_queue = NULL;
+            return;
+        }
+    }
+
+    char *copy = strdup(path);
+    if(!copy) return;
+
+    int idx = -1;
+    taskENTER_CRITICAL(&clmt_lock);
+    for(int k = 0; k < CLMT_SLOTS && !clmt_suspended; k++) {
+        if(clmt_pool[k].state == CLMT_FREE) {
+            clmt_pool[k].state = CLMT_QUEUED;
+            clmt_pool[k].owner = &s->fil;
+            clmt_pool[k].path = copy;
+            idx = k;
+            break;
+        }
+    }
+    taskEXIT_CRITICAL(&clmt_lock);
+
+    if(idx < 0) {
+        LOGI_2("no free link map slot for %s", path);
+        free(copy);
+        return;
+    }
+    if(xQueueSend(clmt_queue, &idx, 0) != pdPASS) {
+        // a suspend in between may already have taken the path
+        taskENTER_CRITICAL(&clmt_lock);
+        copy = clmt_pool[idx].path;
+        clmt_pool[idx].state = CLMT_FREE;
+        clmt_pool[idx].owner = NULL;
+        clmt_pool[idx].path = NULL;
+        taskEXIT_CRITICAL(&clmt_lock);
+        free(copy);
+        return;
+    }
+    s->clmt = idx;
+}
+
+/** @brief Called after f_close(); a map still being built is dropped by the task */
+static void clmt_release(fatfs_source *s)
+{
+    if(s->clmt < 0) return;
+
+    clmt_slot *slot = &clmt_pool[s->clmt];
+    char *path = NULL;
+    taskENTER_CRITICAL(&clmt_lock);
+    if(slot->state == CLMT_QUEUED) {
+        path = slot->path;
+        slot->path = NULL;
+        slot->state = CLMT_FREE;
+    } else if(slot->state != CLMT_BUILDING) {
+        slot->state = CLMT_FREE;
+    }
+    slot->owner = NULL;
+    taskEXIT_CRITICAL(&clmt_lock);
+    free(path);
+    s->clmt = -1;
+}
+#endif
+
+esp_err_t audio_source_fatfs_suspend(uint32_t timeout_ms)
+{
+#if defined(CONFIG_AUDIO_PLAYER_FATFS_FASTSEEK)
+    char *paths[CLMT_SLOTS] = { NULL };
+
+    // maps not started yet are given up; their sources see FAILED and keep walking the chain
+    clmt_suspended = true;
+    taskENTER_CRITICAL(&clmt_lock);
+    for(int k = 0; k < CLMT_SLOTS; k++) {
+        clmt_slot *slot = &clmt_pool[k];
+        if(slot->state == CLMT_QUEUED) {
+            paths[k] = slot->path;
+            slot->path = NULL;
+            slot->state = slot->owner ? CLMT_FAILED : CLMT_FREE;
+        }
+    }
+    taskEXIT_CRITICAL(&clmt_lock);
+    for(int k = 0; k < CLMT_SLOTS; k++) {
+        free(paths[k]);
+    }
+
+    // the task never takes the mutex for a new map once suspended, so holding it once is enough
+    if(clmt_busy) {
+        if(xSemaphoreTake(clmt_busy, pdMS_TO_TICKS(timeout_ms)) != pdTRUE) {
+            ESP_LOGW(TAG, "link map still being built after %u ms", (unsigned)timeout_ms);
+            return ESP_ERR_TIMEOUT;
+        }
+        xSemaphoreGive(clmt_busy);
+    }
+#else
+    (void)timeout_ms;
+#endif
+    return ESP_OK;
+}
+
+void audio_source_fatfs_resume(void)
+{
+#if defined(CONFIG_AUDIO_PLAYER_FATFS_FASTSEEK)
+    clmt_suspended = false;
+#endif
+}
+
+static size_t fatfs_read(void *ctx, void *buf, size_t len)
+{
+    fatfs_source *s = (fatfs_source *)ctx;
+    uint8_t *out = (uint8_t *)buf;
+    size_t done = 0;
+
+    while(done < len) {
+        if(s->pos >= s->buf_start && s->pos < s->buf_start + s->fill) {
+            size_t offset = (size_t)(s->pos - s->buf_start);
+            size_t n = s->fill - offset;
+            if(n > len - done) n = len - done;
+            memcpy(out + done, s->buf + offset, n);
+            done += n;
+            s->pos += n;
+            continue;
+        }
+
+        FSIZE_t aligned = s->pos - s->pos % s->sector_size;
+        if(f_tell(&s->fil) != aligned && f_lseek(&s->fil, aligned) != FR_OK) {
+            break;
+        }
+
+        // large sector aligned reads into DMA capable memory skip the copy
+        uint8_t *dst = out + done;
+        size_t remaining = len - done;
+        if(aligned == s->pos && remaining >= s->buf_size &&
+           esp_ptr_dma_capable(dst) && ((uintptr_t)dst & 3) == 0) {
+            UINT want = remaining - remaining % s->sector_size;
+            UINT got = 0;
+            FRESULT res = f_read(&s->fil, dst, want, &got);
+            s->fill = 0;
+            done += got;
+            s->pos += got;
+            if(res != FR_OK || got < want) {
+                break;
+            }
+            continue;
+        }
+
+        UINT got = 0;
+        s->fill = 0;
+        if(f_read(&s->fil, s->buf, s->buf_size, &got) != FR_OK || got <= s->pos - aligned) {
+            break;
+        }
+        s->buf_start = aligned;
+        s->fill = got;
+    }
+
+    return done;
+}
+
+static int fatfs_seek(void *ctx, long offset)
+{
+    fatfs_source *s = (fatfs_source *)ctx;
+    // the FIL pointer is moved lazily by the next refill, seeks inside the buffer cost nothing
+    s->pos = (FSIZE_t)offset;
+    return 0;
+}
+
+static long fatfs_size(void *ctx)
+{
+    return (long)f_size(&((fatfs_source *)ctx)->fil);
+}
+
+static void fatfs_close(void *ctx)
+{
+    fatfs_source *s = (fatfs_source *)ctx;
+    f_close(&s->fil);
+#if defined(CONFIG_AUDIO_PLAYER_FATFS_FASTSEEK)
+    clmt_release(s);
+#endif
+    heap_caps_free(s->buf);
+    heap_caps_free(s);
+}
+
+static const audio_source_ops_t fatfs_ops = {
+    .read = fatfs_read,
+    .seek = fatfs_seek,
+    .size = fatfs_size,
+    .close = fatfs_close,
+};
+
+esp_err_t audio_source_open_fatfs(audio_source_t *src, const char *path)
+{
+    fatfs_source *s = (fatfs_source *)heap_caps_calloc(1, sizeof(fatfs_source), MALLOC_CAP_DMA | MALLOC_CAP_INTERNAL);
+    if(!s) {
+        return ESP_ERR_NO_MEM;
+    }
+    if(f_open(&s->fil, path, FA_READ) != FR_OK) {
+        heap_caps_free(s);
+        return ESP_ERR_NOT_FOUND;
+    }
+
+    FATFS *fs = s->fil.obj.fs;
+#if FF_MAX_SS != FF_MIN_SS
+    s->sector_size = fs->ssize;
+#else
+    s->sector_size = FF_MAX_SS;
+#endif
+    size_t cluster = (size_t)fs->csize * s->sector_size;
+    size_t size = CONFIG_AUDIO_PLAYER_FATFS_READ_SIZE;
+    size -= (cluster <= size) ? size % cluster : size % s->sector_size;
+
+    while(size >= s->sector_size) {
+        s->buf = (uint8_t *)heap_caps_aligned_alloc(FATFS_BUF_ALIGN, size, MALLOC_CAP_DMA | MALLOC_CAP_INTERNAL);
+        if(s->buf) break;
+        size /= 2;
+        size -= size % s->sector_size;
+    }
+    if(!s->buf) {
+        f_close(&s->fil);
+        heap_caps_free(s);
+        return ESP_ERR_NO_MEM;
+    }
+    s->buf_size = size;
+    s->clmt = -1;
+#if defined(CONFIG_AUDIO_PLAYER_FATFS_FASTSEEK)
+    // a file within one cluster never walks the chain
+    if(f_size(&s->fil) > cluster) {
+        clmt_request(s, path);
+    }
+#endif
+
+    LOGI_2("%s: cluster %u, read size %u", path, (unsigned)cluster, (unsigned)size);
+
+    src->ops = &fatfs_ops;
+    src->ctx = s;
+    src->pos = 0;
+    src->eof = false;
+    src->span = NULL;
+    src->span_len = 0;
+    return ESP_OK;
+}
@@ -1,18 +1,19 @@
 #include <string.h>
 #include <stdio.h>
 #include "audio_wav.h"
+#include "audio_convert.h"
 
 static const char *TAG = "wav";
 
 /**
- * @param fp
+ * @param src
  * @param pInstance - Values can be considered valid if true is returned
  * @return true if file is a wav file
  */
-bool is_wav(FILE *fp, wav_instance *pInstance) {
-    fseek(fp, 0, SEEK_SET);
+bool is_wav(audio_source_t *src, wav_instance *pInstance) {
+    audio_source_seek(src, 0, SEEK_SET);
 
-    size_t bytes_read = fread(&pInstance->header, 1, sizeof(wav_header_t), fp);
+    size_t bytes_read = audio_source_read(src, &pInstance->header, sizeof(wav_header_t));
     if(bytes_read != sizeof(wav_header_t)) {
         return false;
     }
@@ -25,10 +26,35 @@ bool is_wav(FILE *fp, wav_instance *pInstance) {
         return false;
     }
 
+    uint16_t audio_format = static_cast<uint16_t>(wav_head->AudioFormat);
+    if(audio_format == WAVE_FORMAT_EXTENSIBLE && wav_head->Subchunk1Size >= 26) {
+        // cbSize, wValidBitsPerSample, dwChannelMask, then the SubFormat GUID
+        // whose first two bytes are the actual format tag
+        uint8_t ext[10];
+        if(audio_source_read(src, ext, sizeof(ext)) != sizeof(ext)) {
+            return false;
+        }
+        audio_format = ext[8] | (ext[9] << 8);
+    }
+
+    pInstance->fmt.sample_rate = wav_head->SampleRate;
+    pInstance->fmt.bits_per_sample = wav_head->BitsPerSample;
+    pInstance->fmt.channels = wav_head->NumChannels;
+    pInstance->fmt.sample_format = (audio_format == WAVE_FORMAT_IEEE_FLOAT) ? SAMPLE_FORMAT_FLOAT : SAMPLE_FORMAT_INT;
+
+    if((audio_format != WAVE_FORMAT_PCM && audio_format != WAVE_FORMAT_IEEE_FLOAT) ||
+       !audio_convert_supported(pInstance->fmt)) {
+        ESP_LOGE(TAG, "unsupported wav format 0x%x, %d bits", audio_format, wav_head->BitsPerSample);
+        return false;
+    }
+
+    // the fmt chunk may be longer than the 16 bytes of wav_header_t
+    audio_source_seek(src, offsetof(wav_header_t, AudioFormat) + wav_head->Subchunk1Size, SEEK_SET);
+
     // decode chunks until we find the 'data' one
     wav_subchunk_header_t subchunk;
     while(true) {
-        bytes_read = fread(&subchunk, 1, sizeof(wav_subchunk_header_t), fp);
+        bytes_read = audio_source_read(src, &subchunk, sizeof(wav_subchunk_header_t));
         if(bytes_read != sizeof(wav_subchunk_header_t)) {
             return false;
         }
@@ -38,14 +64,18 @@ bool is_wav(FILE *fp, wav_instance *pInstance) {
             break;
         } else {
             // advance beyond this subchunk, it could be a 'LIST' chunk with file info or some other unhandled subchunk
-            fseek(fp, subchunk.SubchunkSize, SEEK_CUR);
+            // chunks are padded to an even size
+            audio_source_seek(src, subchunk.SubchunkSize + (subchunk.SubchunkSize & 1), SEEK_CUR);
         }
     }
 
-    LOGI_2("sample_rate=%d, channels=%d, bps=%d",
+    pInstance->data_offset = audio_source_tell(src);
+
+    LOGI_2("sample_rate=%d, channels=%d, bps=%d, float=%d",
             wav_head->SampleRate,
             wav_head->NumChannels,
-            wav_head->BitsPerSample);
+            wav_head->BitsPerSample,
+            pInstance->fmt.sample_format == SAMPLE_FORMAT_FLOAT);
 
     return true;
 }
@@ -53,18 +83,22 @@ bool is_wav(FILE *fp, wav_instance *pInstance) {
 /**
  * @return true if data remains, false on error or end of file
  */
-DECODE_STATUS decode_wav(FILE *fp, decode_data *pData, wav_instance *pInstance) {
+DECODE_STATUS decode_wav(audio_source_t *src, decode_data *pData, wav_instance *pInstance) {
     // read an even multiple of frames that can fit into output_samples buffer, otherwise
     // we would have to manage what happens with partial frames in the output buffer
     size_t bytes_per_frame = (pInstance->header.BitsPerSample / BITS_PER_BYTE) * pInstance->header.NumChannels;
     size_t frames_to_read = pData->samples_capacity / bytes_per_frame;
+
+    // leave room for the frames to grow when converted to the i2s format
+    size_t max_frames = pData->samples_capacity_max / audio_convert_output_frame_bytes(pInstance->fmt);
+    if(frames_to_read > max_frames) {
+        frames_to_read = max_frames;
+    }
     size_t bytes_to_read = frames_to_read * bytes_per_frame;
 
-    size_t bytes_read = fread(pData->samples, 1, bytes_to_read, fp);
+    size_t bytes_read = audio_source_read(src, pData->samples, bytes_to_read);
 
-    pData->fmt.channels = pInstance->header.NumChannels;
-    pData->fmt.bits_per_sample = pInstance->header.BitsPerSample;
-    pData->fmt.sample_rate = pInstance->header.SampleRate;
+    pData->fmt = pInstance->fmt;
 
     if(bytes_read != 0)
     {
@@ -79,3 +113,10 @@ DECODE_STATUS decode_wav(FILE *fp, decode_data *pData, wav_instance *pInstance)
 
     return (bytes_read == 0) ? DECODE_STATUS_DONE : DECODE_STATUS_CONTINUE;
 }
+
+bool seek_wav(audio_source_t *src, wav_instance *pInstance, uint32_t position_ms) {
+    size_t bytes_per_frame = (pInstance->header.BitsPerSample / BITS_PER_BYTE) * pInstance->header.NumChannels;
+    uint64_t frame = (uint64_t)position_ms * pInstance->header.SampleRate / 1000;
+
+    return audio_source_seek(src, pInstance->data_offset + (long)(frame * bytes_per_frame), SEEK_SET) == 0;
+}
@@ -1,9 +1,13 @@
 #pragma once
 
-#include <stdio.h>
+#include "audio_source.h"
 #include "audio_log.h"
 #include "audio_decode_types.h"
 
+#define WAVE_FORMAT_PCM         0x0001
+#define WAVE_FORMAT_IEEE_FLOAT  0x0003
+#define WAVE_FORMAT_EXTENSIBLE  0xFFFE
+
 typedef struct {
     // The "RIFF" chunk descriptor
     uint8_t ChunkID[4];
@@ -28,7 +32,14 @@ typedef struct {
 
 typedef struct {
     wav_header_t header;
+
+    /** file offset of the first sample in the 'data' chunk */
+    long data_offset;
+
+    /** from AudioFormat, or the SubFormat of WAVE_FORMAT_EXTENSIBLE files */
+    format fmt;
 } wav_instance;
 
-bool is_wav(FILE *fp, wav_instance *pInstance);
-DECODE_STATUS decode_wav(FILE *fp, decode_data *pData, wav_instance *pInstance);
+bool is_wav(audio_source_t *src, wav_instance *pInstance);
+DECODE_STATUS decode_wav(audio_source_t *src, decode_data *pData, wav_instance *pInstance);
+bool seek_wav(audio_source_t *src, wav_instance *pInstance, uint32_t position_ms);
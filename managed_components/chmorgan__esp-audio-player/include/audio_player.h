@@ -48,6 +48,7 @@
 #pragma once
 
 #include <stddef.h>
+#include <stdint.h>
 #include <stdio.h>
 #include "esp_err.h"
 #include "freertos/FreeRTOS.h"
@@ -104,6 +105,95 @@ typedef void (*audio_player_cb_t)(audio_player_cb_ctx_t *);
  */
 esp_err_t audio_player_play(FILE *fp);
 
+/** Callbacks of a byte source for audio_player_play_source(), called from the audio task */
+typedef struct {
+    size_t (*read)(void *ctx, void *buf, size_t len);   /**< bytes read, fewer than len only at the end */
+    int (*seek)(void *ctx, long offset);                /**< absolute offset, 0 on success */
+    long (*size)(void *ctx);                            /**< total length in bytes, -1 if unknown. Optional */
+    void (*close)(void *ctx);                           /**< playback of the source has ended. Optional */
+} audio_player_source_ops_t;
+
+/**
+ * A byte source: either callbacks, or a contiguous span.
+ *
+ * When data is set the span is used and only ops->close (if any) is called,
+ * e.g. to free a PSRAM buffer. The mp3 and flac decoders parse frames in
+ * place from a span instead of copying them into their input buffers.
+ */
+typedef struct {
+    const audio_player_source_ops_t *ops;
+    void *ctx;
+    const void *data;
+    size_t len;
+} audio_player_source_t;
+
+/**
+ * @brief Play from an arbitrary byte source.
+ *
+ * @param source - Copied, may be a temporary. A span must stay valid until
+ *                 close is called (or playback ended, without close).
+ *                 Callback sources need read and seek.
+ * @return
+ *    - ESP_OK: Success in queuing play request, close will be called
+ *    - ESP_ERR_INVALID_ARG: neither a span nor read/seek callbacks
+ *    - Others: Fail, close is not called
+ */
+esp_err_t audio_player_play_source(const audio_player_source_t *source);
+
+/**
+ * @brief Play an encoded file held in memory.
+ *
+ * Shorthand for audio_player_play_source() with a span and no close callback,
+ * for memory-mapped flash (esp_partition_mmap()) or const arrays linked into
+ * the app: the data is read in place, never staged in RAM.
+ *
+ * @param data - Must stay valid until playback of it has ended.
+ * @param len - Length of the file in bytes.
+ * @return
+ *    - ESP_OK: Success in queuing play request
+ *    - Others: Fail
+ */
+esp_err_t audio_player_play_memory(const void *data, size_t len);
+
+/**
+ * @brief Play a file read through FatFs directly instead of VFS and stdio.
+ *
+ * The file is opened by the caller's task, so a missing file is reported
+ * here rather than through a callback. Requires CONFIG_AUDIO_PLAYER_FATFS_SOURCE.
+ *
+ * @param path - FatFs path including the logical drive, e.g. "0:/music/a.mp3".
+ *               Not the VFS path, the mount point is not part of it.
+ * @return
+ *    - ESP_OK: Success in queuing play request, the file is closed by the audio system
+ *    - ESP_ERR_NOT_FOUND: f_open() failed
+ *    - ESP_ERR_NO_MEM: no DMA capable read buffer
+ *    - ESP_ERR_NOT_SUPPORTED: direct FatFs reads are disabled, use audio_player_play()
+ *    - Others: Fail
+ */
+esp_err_t audio_player_play_fatfs(const char *path);
+
+/**
+ * @brief Move the playback position of the current file
+ *
+ * FLAC uses the file's SEEKTABLE, WAV is exact, MP3 is estimated from the
+ * bitrate. Seeking while paused keeps playback paused.
+ *
+ * @param position_ms - position from the start of the file, in milliseconds
+ * @return
+ *    - ESP_OK: Success in queuing seek request
+ *    - Others: Fail
+ */
+esp_err_t audio_player_seek(uint32_t position_ms);
+
+/**
+ * @brief Playback position of the current file in milliseconds
+ *
+ * Counts the frames handed to write_fn since the start of the file or the
+ * last seek, so it runs ahead of what is audible by the output buffering.
+ * Keeps its value after playback stops until the next file starts.
+ */
+uint32_t audio_player_get_position(void);
+
 /**
  * @brief Pause playback
  *
@@ -133,6 +223,43 @@ esp_err_t audio_player_resume(void);
  */
 esp_err_t audio_player_stop(void);
 
+/**
+ * @brief Stop playback and wait until the audio task has closed its file
+ *
+ * Play requests still queued when this is called are dropped and their
+ * sources closed without playing, so nothing is left open on the storage
+ * once this returns ESP_OK. Use before unmounting the filesystem the
+ * files were played from.
+ *
+ * @param timeout_ms - how long to wait for the audio task
+ * @return esp_err_t
+ *    - ESP_OK: no source is open and no request is pending
+ *    - ESP_ERR_TIMEOUT: the audio task is still playing or holds a source
+ *    - Others: Fail
+ */
+esp_err_t audio_player_stop_and_wait(uint32_t timeout_ms);
+
+/**
+ * @brief Stop background FatFs access before the volume goes away
+ *
+ * With CONFIG_AUDIO_PLAYER_FATFS_FASTSEEK a low priority task opens each
+ * file played through audio_player_play_fatfs() a second time to build its
+ * cluster link map. This cancels the maps not yet started and waits for the
+ * one being built to close its file; no new ones are queued until
+ * audio_player_fatfs_resume(). Sources stay usable, seeks walk the FAT chain.
+ *
+ * @param timeout_ms - how long to wait for the map in progress
+ * @return esp_err_t
+ *    - ESP_OK: the link map task holds no file (always when FASTSEEK is off)
+ *    - ESP_ERR_TIMEOUT: a map is still being built
+ */
+esp_err_t audio_player_fatfs_suspend(uint32_t timeout_ms);
+
+/**
+ * @brief Allow link maps again after audio_player_fatfs_suspend(), e.g. once the volume is remounted
+ */
+void audio_player_fatfs_resume(void);
+
 /**
  * @brief Register callback for audio event
  *
@@ -144,6 +271,25 @@ esp_err_t audio_player_stop(void);
  */
 esp_err_t audio_player_callback_register(audio_player_cb_t call_back, void *user_ctx);
 
+/** Number of values filled in by audio_player_get_spectrum() */
+#define AUDIO_PLAYER_SPECTRUM_BANDS 32
+
+/**
+ * @brief Get the per-subband energy of the most recently decoded mp3 granule
+ *
+ * Values come straight from the decoder's polyphase subbands, so no FFT is
+ * run on the output. Lock-free, may be called from any task.
+ *
+ * @param bands - AUDIO_PLAYER_SPECTRUM_BANDS values, lowest frequency first
+ * @param seq - optional, advances with every new granule. An unchanged value
+ *              means bands are unchanged since the previous call.
+ * @return
+ *    - ESP_OK: bands filled in
+ *    - ESP_ERR_NOT_SUPPORTED: CONFIG_AUDIO_PLAYER_ENABLE_SPECTRUM is disabled
+ *    - ESP_ERR_INVALID_STATE: no mp3 granule has been decoded yet
+ */
+esp_err_t audio_player_get_spectrum(uint32_t *bands, uint32_t *seq);
+
 typedef enum {
     AUDIO_PLAYER_MUTE,
     AUDIO_PLAYER_UNMUTE
@@ -280,3 +280,138 @@ TEST_CASE("audio player states and callbacks are correct", "[audio player]")
     ESP_LOGI(TAG, "NOTE: a memory leak will be reported the first time this test runs.\n");
     ESP_LOGI(TAG, "esp-idf v4.4.1 and v4.4.2 both leak memory between i2s_driver_install() and i2s_driver_uninstall()\n");
 }
+
+static size_t discarded_bytes;
+static int source_close_count;
+static uint32_t first_write_position;
+
+static esp_err_t discard_write(void *audio_buffer, size_t len, size_t *bytes_written, uint32_t timeout_ms)
+{
+    if(discarded_bytes == 0) {
+        first_write_position = audio_player_get_position();
+    }
+    discarded_bytes += len;
+    *bytes_written = len;
+    return ESP_OK;
+}
+
+static esp_err_t discard_reconfig_clk(uint32_t rate, uint32_t bits_cfg, i2s_slot_mode_t ch)
+{
+    return ESP_OK;
+}
+
+static void source_close(void *ctx)
+{
+    source_close_count++;
+}
+
+TEST_CASE("audio player decodes a memory span in place", "[audio player]")
+{
+    audio_player_callback_event_t event;
+
+    // no I2S, decoded audio is dropped so the 16 second track finishes quickly
+    audio_player_config_t config = { .mute_fn = audio_mute_function,
+                                     .write_fn = discard_write,
+                                     .clk_set_fn = discard_reconfig_clk,
+                                     .priority = 0,
+                                     .coreID = 0 };
+    esp_err_t ret = audio_player_new(config);
+    TEST_ASSERT_EQUAL(ret, ESP_OK);
+
+    event_queue = xQueueCreate(1, sizeof(audio_player_callback_event_t));
+    TEST_ASSERT_NOT_NULL(event_queue);
+
+    ret = audio_player_callback_register(audio_player_callback, NULL);
+    TEST_ASSERT_EQUAL(ret, ESP_OK);
+
+    extern const char mp3_start[] asm("_binary_gs_16b_1c_44100hz_mp3_start");
+    extern const char mp3_end[]   asm("_binary_gs_16b_1c_44100hz_mp3_end");
+    // cppcheck-suppress comparePointers
+    size_t mp3_size = (mp3_end - mp3_start) - 1;
+
+    static const audio_player_source_ops_t ops = { .close = source_close };
+    audio_player_source_t source = { .ops = &ops, .data = mp3_start, .len = mp3_size };
+    discarded_bytes = 0;
+    source_close_count = 0;
+
+    expected_event = AUDIO_PLAYER_CALLBACK_EVENT_PLAYING;
+    ret = audio_player_play_source(&source);
+    TEST_ASSERT_EQUAL(ret, ESP_OK);
+    TEST_ASSERT_EQUAL(xQueueReceive(event_queue, &event, pdMS_TO_TICKS(100)), pdPASS);
+
+    expected_event = AUDIO_PLAYER_CALLBACK_EVENT_IDLE;
+    TEST_ASSERT_EQUAL(xQueueReceive(event_queue, &event, pdMS_TO_TICKS(10000)), pdPASS);
+    TEST_ASSERT_EQUAL(audio_player_get_state(), AUDIO_PLAYER_STATE_IDLE);
+
+    // 16 seconds of 44.1 kHz 16 bit audio, written as stereo or mono
+    TEST_ASSERT_GREATER_OR_EQUAL(16 * 44100 * 2, discarded_bytes);
+    TEST_ASSERT_EQUAL(1, source_close_count);
+
+    expected_event = AUDIO_PLAYER_CALLBACK_EVENT_SHUTDOWN;
+    ret = audio_player_delete();
+    TEST_ASSERT_EQUAL(ret, ESP_OK);
+    TEST_ASSERT_EQUAL(xQueueReceive(event_queue, &event, pdMS_TO_TICKS(100)), pdPASS);
+
+    vQueueDelete(event_queue);
+}
+
+#define SEEK_TRACK_MS   15900   // length of gs-16b-1c-44100hz.mp3
+#define SEEK_TO_MS      8000
+#define SEEK_SLACK_MS   500
+
+TEST_CASE("audio player seeks an mp3 before its first frame", "[audio player]")
+{
+    audio_player_callback_event_t event;
+
+    // resuming a track after a reboot queues the seek right behind the play request
+    audio_player_config_t config = { .mute_fn = audio_mute_function,
+                                     .write_fn = discard_write,
+                                     .clk_set_fn = discard_reconfig_clk,
+                                     .priority = 0,
+                                     .coreID = 0 };
+    esp_err_t ret = audio_player_new(config);
+    TEST_ASSERT_EQUAL(ret, ESP_OK);
+
+    event_queue = xQueueCreate(1, sizeof(audio_player_callback_event_t));
+    TEST_ASSERT_NOT_NULL(event_queue);
+
+    ret = audio_player_callback_register(audio_player_callback, NULL);
+    TEST_ASSERT_EQUAL(ret, ESP_OK);
+
+    extern const char mp3_start[] asm("_binary_gs_16b_1c_44100hz_mp3_start");
+    extern const char mp3_end[]   asm("_binary_gs_16b_1c_44100hz_mp3_end");
+    // cppcheck-suppress comparePointers
+    size_t mp3_size = (mp3_end - mp3_start) - 1;
+
+    static const audio_player_source_ops_t ops = { .close = source_close };
+    audio_player_source_t source = { .ops = &ops, .data = mp3_start, .len = mp3_size };
+    discarded_bytes = 0;
+    source_close_count = 0;
+    first_write_position = 0;
+
+    expected_event = AUDIO_PLAYER_CALLBACK_EVENT_PLAYING;
+    ret = audio_player_play_source(&source);
+    TEST_ASSERT_EQUAL(ret, ESP_OK);
+    ret = audio_player_seek(SEEK_TO_MS);
+    TEST_ASSERT_EQUAL(ret, ESP_OK);
+    TEST_ASSERT_EQUAL(xQueueReceive(event_queue, &event, pdMS_TO_TICKS(100)), pdPASS);
+
+    expected_event = AUDIO_PLAYER_CALLBACK_EVENT_IDLE;
+    TEST_ASSERT_EQUAL(xQueueReceive(event_queue, &event, pdMS_TO_TICKS(10000)), pdPASS);
+    TEST_ASSERT_EQUAL(audio_player_get_state(), AUDIO_PLAYER_STATE_IDLE);
+
+    // the first samples written already come from the seek target, nothing before it was played
+    TEST_ASSERT_GREATER_OR_EQUAL(SEEK_TO_MS - SEEK_SLACK_MS, first_write_position);
+    TEST_ASSERT_LESS_OR_EQUAL(SEEK_TO_MS + SEEK_SLACK_MS, first_write_position);
+    // the rest of the track, 44.1 kHz 16 bit written as stereo or mono
+    TEST_ASSERT_GREATER_OR_EQUAL((SEEK_TRACK_MS - SEEK_TO_MS - SEEK_SLACK_MS) * 441 / 10 * 2, discarded_bytes);
+    TEST_ASSERT_LESS_OR_EQUAL((SEEK_TRACK_MS - SEEK_TO_MS + SEEK_SLACK_MS) * 441 / 10 * 4, discarded_bytes);
+    TEST_ASSERT_EQUAL(1, source_close_count);
+
+    expected_event = AUDIO_PLAYER_CALLBACK_EVENT_SHUTDOWN;
+    ret = audio_player_delete();
+    TEST_ASSERT_EQUAL(ret, ESP_OK);
+    TEST_ASSERT_EQUAL(xQueueReceive(event_queue, &event, pdMS_TO_TICKS(100)), pdPASS);
+
+    vQueueDelete(event_queue);
+}
@@ -210,6 +210,81 @@ void MP3GetLastFrameInfo(HMP3Decoder hMP3Decoder, MP3FrameInfo *mp3FrameInfo)
 	}
 }
 
+/**************************************************************************************
+ * Function:    MP3EnableSubbandEnergy
+ *
+ * Description: turn on/off accumulation of per-subband energy in Subband()
+ *
+ * Inputs:      valid MP3 decoder instance pointer (HMP3Decoder)
+ *              nonzero to enable, 0 to disable
+ *
+ * Outputs:     none
+ *
+ * Return:      none
+ *
+ * Notes:       when disabled, Subband() does no extra work
+ **************************************************************************************/
+void MP3EnableSubbandEnergy(HMP3Decoder hMP3Decoder, int enable)
+{
+	MP3DecInfo *mp3DecInfo = (MP3DecInfo *)hMP3Decoder;
+
+	if (!mp3DecInfo)
+		return;
+
+	mp3DecInfo->sbEnergyEnable = enable;
+}
+
+/**************************************************************************************
+ * Function:    MP3GetSubbandEnergy
+ *
+ * Description: copy the energy of each polyphase subband in the last decoded granule
+ *
+ * Inputs:      valid MP3 decoder instance pointer (HMP3Decoder)
+ *              buffer for MP3_NBANDS values
+ *              optional pointer to receive the snapshot sequence number
+ *
+ * Outputs:     filled-in energy buffer, lowest subband first
+ *              *seq (if non-null) advances by 2 for every new granule, so callers
+ *                can skip work when nothing changed
+ *
+ * Return:      0 on success, -1 if disabled, no granule decoded yet, or the writer
+ *                kept the snapshot busy for every retry
+ *
+ * Notes:       lock-free (seqlock), safe to call from a different task or core than
+ *                the one running MP3Decode()
+ *              values are sums of |sample| >> 8 over all blocks and channels in the
+ *                granule, a cheap energy proxy with no risk of 32-bit overflow
+ **************************************************************************************/
+int MP3GetSubbandEnergy(HMP3Decoder hMP3Decoder, unsigned int *energy, unsigned int *seq)
+{
+	MP3DecInfo *mp3DecInfo = (MP3DecInfo *)hMP3Decoder;
+	unsigned int s0, s1;
+	int retry, b;
+
+	if (!mp3DecInfo || !energy || !mp3DecInfo->sbEnergyEnable)
+		return -1;
+
+	for (retry = 0; retry < 4; retry++) {
+		s0 = mp3DecInfo->sbEnergySeq;
+		if (s0 == 0)
+			return -1;
+		if (s0 & 0x01)
+			continue;
+		__sync_synchronize();
+		for (b = 0; b < MP3_NBANDS; b++)
+			energy[b] = mp3DecInfo->sbEnergy[b];
+		__sync_synchronize();
+		s1 = mp3DecInfo->sbEnergySeq;
+		if (s0 == s1) {
+			if (seq)
+				*seq = s0;
+			return 0;
+		}
+	}
+
+	return -1;
+}
+
 /**************************************************************************************
  * Function:    MP3GetNextFrameInfo
  *
@@ -93,6 +93,14 @@ typedef struct _MP3DecInfo {
 
 	int part23Length[MAX_NGRAN][MAX_NCHAN];
 
+	/* optional per-subband energy snapshot, written by Subband() once per granule
+	 *   sbEnergySeq is odd while the writer is updating sbEnergy (seqlock), so a
+	 *   reader on another core can take a consistent copy without locking
+	 */
+	int sbEnergyEnable;
+	volatile unsigned int sbEnergySeq;
+	volatile unsigned int sbEnergy[MP3_NBANDS];
+
 } MP3DecInfo;
 
 typedef struct _SFBandTable {
@@ -78,6 +78,7 @@ extern "C" {
 #define MAX_NGRAN		2		/* max granules */
 #define MAX_NCHAN		2		/* max channels */
 #define MAX_NSAMP		576		/* max samples per channel, per granule */
+#define MP3_NBANDS		32		/* polyphase subbands, see MP3GetSubbandEnergy */
 
 /* map to 0,1,2 to make table indexing easier */
 typedef enum {
@@ -125,6 +126,9 @@ void MP3GetLastFrameInfo(HMP3Decoder hMP3Decoder, MP3FrameInfo *mp3FrameInfo);
 int MP3GetNextFrameInfo(HMP3Decoder hMP3Decoder, MP3FrameInfo *mp3FrameInfo, unsigned char *buf);
 int MP3FindSyncWord(unsigned char *buf, int nBytes);
 
+void MP3EnableSubbandEnergy(HMP3Decoder hMP3Decoder, int enable);
+int MP3GetSubbandEnergy(HMP3Decoder hMP3Decoder, unsigned int *energy, unsigned int *seq);
+
 #ifdef __cplusplus
 }
 #endif
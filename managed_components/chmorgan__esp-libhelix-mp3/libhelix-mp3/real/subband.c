@@ -45,6 +45,46 @@
 #include "coder.h"
 #include "assembly.h"
 
+/**************************************************************************************
+ * Function:    AccumulateSubbandEnergy
+ *
+ * Description: publish the energy of each subband in one granule, all channels
+ *
+ * Inputs:      filled MP3DecInfo structure, after calling IMDCT for all channels
+ *
+ * Outputs:     updated sbEnergy[] snapshot, sbEnergySeq advanced by 2
+ *
+ * Return:      none
+ *
+ * Notes:       reads the IMDCT output (subband domain) before synthesis, so costs one
+ *                abs + add per sample, no transform
+ **************************************************************************************/
+static void AccumulateSubbandEnergy(MP3DecInfo *mp3DecInfo, IMDCTInfo *mi)
+{
+	int ch, b, k, x;
+	unsigned int acc[NBANDS];
+
+	for (k = 0; k < NBANDS; k++)
+		acc[k] = 0;
+
+	for (ch = 0; ch < mp3DecInfo->nChans; ch++) {
+		for (b = 0; b < BLOCK_SIZE; b++) {
+			for (k = 0; k < NBANDS; k++) {
+				x = mi->outBuf[ch][b][k];
+				acc[k] += (unsigned int)((x < 0 ? -x : x) >> 8);
+			}
+		}
+	}
+
+	/* seqlock write: odd while updating */
+	mp3DecInfo->sbEnergySeq++;
+	__sync_synchronize();
+	for (k = 0; k < NBANDS; k++)
+		mp3DecInfo->sbEnergy[k] = acc[k];
+	__sync_synchronize();
+	mp3DecInfo->sbEnergySeq++;
+}
+
 /**************************************************************************************
  * Function:    Subband
  *
@@ -72,6 +112,9 @@ int Subband(MP3DecInfo *mp3DecInfo, short *pcmBuf)
 	mi = (IMDCTInfo *)(mp3DecInfo->IMDCTInfoPS);
 	sbi = (SubbandInfo*)(mp3DecInfo->SubbandInfoPS);
 
+	if (mp3DecInfo->sbEnergyEnable)
+		AccumulateSubbandEnergy(mp3DecInfo, mi);
+
 	if (mp3DecInfo->nChans == 2) {
 		/* stereo */
 		for (b = 0; b < BLOCK_SIZE; b++) {
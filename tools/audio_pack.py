@@ -0,0 +1,100 @@
+#!/usr/bin/env python3
+"""把一个目录打包成 audio 分区镜像 (格式见 main/Task/flash_audio.h)。
+
+用法: audio_pack.py <目录> <输出.bin> [--max-size 4M] [--list] [--aac]
+
+目录下的音频文件 (含子目录) 按相对路径 ("/" 分隔) 作为条目名，按字节序排序，
+固件中用二分查找按名称定位。固件默认不解码 AAC，目录中有 .m4a 时报错，
+只有固件启用了 CONFIG_AUDIO_PLAYER_ENABLE_AAC 才加 --aac 打包它们。
+"""
+import argparse
+import os
+import struct
+import sys
+import zlib
+
+MAGIC = 0x4B415041          # "APAK"
+VERSION = 1
+NAME_MAX = 56               # 含结尾的 '\0'
+ALIGN = 64
+HEADER = struct.Struct('<IHHII')
+ENTRY = struct.Struct('<%dsII' % NAME_MAX)
+EXTENSIONS = ('.mp3', '.wav', '.flac')
+AAC_EXTENSIONS = ('.m4a',)
+
+
+def parse_size(text):
+    units = {'k': 1024, 'm': 1024 * 1024}
+    suffix = text[-1].lower()
+    if suffix in units:
+        return int(text[:-1], 0) * units[suffix]
+    return int(text, 0)
+
+
+def collect(root, aac):
+    files = []
+    for dirpath, _, names in os.walk(root):
+        for name in names:
+            path = os.path.join(dirpath, name)
+            if name.lower().endswith(AAC_EXTENSIONS):
+                if not aac:
+                    sys.exit('固件默认不能播放 AAC: %s (固件启用 CONFIG_AUDIO_PLAYER_ENABLE_AAC 时加 --aac)' % path)
+            elif not name.lower().endswith(EXTENSIONS):
+                continue
+            rel = os.path.relpath(path, root).replace(os.sep, '/').encode('utf-8')
+            if len(rel) >= NAME_MAX:
+                sys.exit('名称过长 (最多 %d 字节): %s' % (NAME_MAX - 1, rel.decode()))
+            files.append((rel, path))
+    files.sort()
+    return files
+
+
+def pack(files):
+    table_end = HEADER.size + ENTRY.size * len(files)
+    offset = (table_end + ALIGN - 1) // ALIGN * ALIGN
+    entries = []
+    blobs = []
+    for rel, path in files:
+        with open(path, 'rb') as f:
+            data = f.read()
+        entries.append(ENTRY.pack(rel, offset, len(data)))
+        blobs.append((offset, data))
+        offset = (offset + len(data) + ALIGN - 1) // ALIGN * ALIGN
+
+    table = b''.join(entries)
+    total = blobs[-1][0] + len(blobs[-1][1]) if blobs else table_end
+    image = bytearray(b'\xff' * total)
+    image[0:HEADER.size] = HEADER.pack(MAGIC, VERSION, len(files), total, zlib.crc32(table))
+    image[HEADER.size:table_end] = table
+    for off, data in blobs:
+        image[off:off + len(data)] = data
+    return bytes(image)
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__.splitlines()[0])
+    parser.add_argument('input', help='要打包的目录')
+    parser.add_argument('output', help='输出镜像')
+    parser.add_argument('--max-size', default='4M', help='分区大小，超出时报错 (默认 4M)')
+    parser.add_argument('--list', action='store_true', help='列出打包的条目')
+    parser.add_argument('--aac', action='store_true', help='打包 .m4a，固件需启用 CONFIG_AUDIO_PLAYER_ENABLE_AAC')
+    args = parser.parse_args()
+
+    files = collect(args.input, args.aac)
+    if len(files) > 0xFFFF:
+        sys.exit('条目过多: %d' % len(files))
+    image = pack(files)
+    limit = parse_size(args.max_size)
+    if len(image) > limit:
+        sys.exit('镜像 %d 字节，超出分区大小 %d' % (len(image), limit))
+
+    with open(args.output, 'wb') as f:
+        f.write(image)
+    if args.list:
+        for rel, path in files:
+            print('%8d  %s' % (os.path.getsize(path), rel.decode()))
+    print('%d 个文件，%d 字节 -> %s' % (len(files), len(image), args.output))
+
+
+if __name__ == '__main__':
+    main()